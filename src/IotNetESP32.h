@@ -4,45 +4,108 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <Preferences.h>
-#include <PubSubClient.h>
 #include <WiFi.h>
 #include <WiFiClientSecure.h>
 #include <ota/OtaSessionState.h>
+#include <atomic>
 #include <esp_heap_caps.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <sys/time.h>
 #include <time.h>
+#include "core/AllocationGuard.h"
+#include "core/BatchFrame.h"
 #include "core/ClientConfig.h"
+#include "core/ConnectionStateMachine.h"
+#include "core/NetworkMailbox.h"
+#include "core/PinTable.h"
+#include "core/PublishGate.h"
+#include "core/PublishQueue.h"
+#include "core/ResumeSnapshot.h"
+#include "core/TopicAliasTable.h"
+#include "core/TopicRouter.h"
+#include "mqtt/MqttClient.h"
+#include "mqtt/ResumableTlsClient.h"
+#include "ota/FirmwareFlasher.h"
 
 class IotNetESP32 {
   public:
-    static constexpr int MAX_PINS = 50;
+    static constexpr int MAX_PINS = iotnet::core::PinTable::CAPACITY;
     static constexpr size_t MAX_TOPIC_LENGTH = 120;
-    static constexpr size_t MAX_VALUE_LENGTH = 32;
+    static constexpr size_t MAX_VALUE_LENGTH = iotnet::core::PinTable::VALUE_SIZE;
     static constexpr size_t MAX_MESSAGE_BUFFER_SIZE = 384;
     static constexpr size_t MAX_CREDENTIAL_LENGTH = 96;
-    static constexpr unsigned long RECONNECT_DELAY_MS = 5000;
+    static constexpr uint32_t RECONNECT_BACKOFF_MIN_MS = 1000;
+    static constexpr uint32_t RECONNECT_BACKOFF_MAX_MS = 60000;
+    static constexpr uint32_t CONNECT_STEP_TIMEOUT_MS = 15000;
+    // How long begin()/resume() wait for the first attempt in total.
+    static constexpr uint32_t INITIAL_CONNECT_BUDGET_MS = 5000;
     static constexpr unsigned long WIFI_TIMEOUT_MS = 30000;
-    static constexpr unsigned long MQTT_TIMEOUT_MS = 60000;
     static constexpr unsigned long OTA_SESSION_TIMEOUT_MS = 30000;
+    static constexpr uint8_t DEFAULT_FLOAT_PRECISION = 2;
+    static constexpr uint32_t NETWORK_TASK_INTERVAL_MS = 5;
+    static constexpr int BATCH_ALIAS_KEY = MAX_PINS;
+    // Longer log lines from logLine() are cut off.
+    static constexpr size_t MAX_LOG_LINE_LENGTH = 192;
+    static_assert(BATCH_ALIAS_KEY < iotnet::core::TopicAliasTable::CAPACITY,
+                  "every pin and the batch topic need an alias key");
+    static_assert(iotnet::core::BatchFrame::CAPACITY + MAX_TOPIC_LENGTH + 7 <=
+                      MAX_MESSAGE_BUFFER_SIZE,
+                  "a full batch frame must fit the MQTT packet buffer");
+
+    // Receives a view of the pin's value buffer; data is NUL-terminated and
+    // only valid for the duration of the call.
+    using PinDataCallback = void (*)(const char *data, size_t length, void *context);
+#ifndef IOTNET_STATIC_MEMORY
+    using StringCallback = void (*)(String);
+#endif
 
-    struct PinState {
-        char topic[MAX_TOPIC_LENGTH];
-        char value[MAX_VALUE_LENGTH];
-        bool updated;
-        bool initialized;
+    struct PinCallback {
+        PinDataCallback handler;
+        void *context;
     };
 
-    struct PinCallback {
-        int pinIndex;
-        void (*callback)(String);
+    using PublishPolicy = iotnet::core::PublishPolicy;
+    using PublishStats = iotnet::core::PublishStats;
+    using OverflowPolicy = iotnet::core::OverflowPolicy;
+    using ConnectionState = iotnet::core::ConnectionState;
+    using PublishQueueStats = iotnet::core::PublishQueueStats;
+    using TlsHandshakeStats = iotnet::core::TlsHandshakeStats;
+
+    enum class ReadStatus {
+        NoUpdate,
+        ParseError,
+        Ok
+    };
+
+    // How pins and OTA channels are subscribed after every (re)connect.
+    // PerPin sends one SUBSCRIBE per pin and OTA topic. Wildcard sends a
+    // single devices/<user>/<board>/# and filters locally, so reconnect cost
+    // does not grow with the pin count, at the price of also receiving this
+    // board's own publishes.
+    enum class SubscriptionMode {
+        PerPin,
+        Wildcard
     };
 
 
     IotNetESP32();
 
     void run();
+    // Moves the connection, reconnects, publishing and OTA onto a task pinned
+    // to `core`; run() then only applies received values and runs callbacks.
+    // Configure pins, policies and batching before starting it.
+    bool startNetworkTask(uint32_t stackBytes = 8192, UBaseType_t priority = 1,
+                          BaseType_t core = 0);
+    bool isNetworkTaskRunning() const;
+    // Progress of the non-blocking connection state machine driven by run().
+    ConnectionState connectionState() const;
+    unsigned long timeInConnectionState() const;
+    // Reconnects offer the previous TLS session so the broker can skip the
+    // full handshake. Persisting keeps it in RTC memory, so it also survives
+    // deep sleep and software resets.
+    void persistTlsSession(bool enable = true);
+    TlsHandshakeStats tlsHandshakeStats() const;
     void begin(const ClientConfig &config);
     void begin(const char *mqttUsername,
                const char *mqttPassword,
@@ -50,23 +113,84 @@ class IotNetESP32 {
                const char *firmwareVersion = nullptr,
                bool enableOta = false);
     void connect();
+    // Deep-sleep fast resume. prepareForSleep() sends queued writes, saves
+    // pins, values, subscriptions, the broker address and the TLS session in
+    // RTC memory and closes the connection cleanly, so the retained "online"
+    // status stays. Call it right before esp_deep_sleep_start(); it is not
+    // supported while the network task runs. resume() replaces begin() on
+    // wake: with a matching snapshot it skips the logo, DNS, the full TLS
+    // handshake, registration and the "online" publish; otherwise it falls
+    // back to begin() and returns false.
+    bool prepareForSleep();
+    bool resume(const ClientConfig &config);
     void version(const char *version);
     const char *version() const;
     void setStatusPin(int pin);
+    // Takes effect on the next connection; call it before begin().
+    void setSubscriptionMode(SubscriptionMode mode);
+    // Connects with cleanSession=false and subscribes with QoS 1, so the
+    // broker keeps the subscriptions and queues commands while the board is
+    // briefly offline. When the CONNACK reports a stored session nothing is
+    // re-subscribed. Call it before begin().
+    void setPersistentSession(bool enable = true);
+    // Connects with MQTT 5 and, when the broker allows topic aliases, sends
+    // repeated pin publishes with a 2-byte alias instead of the full topic.
+    // Call it before begin().
+    void setMqtt5(bool enable = true);
     void setMQTTServer();
 
     bool shouldUpdate(unsigned long &lastUpdate, unsigned long interval);
     bool hasNewValue(const char *pin);
-    void registerCallback(const char *pin, void (*callback)(String));
+#ifndef IOTNET_STATIC_MEMORY
+    void registerCallback(const char *pin, StringCallback callback);
+#endif
+    void registerCallback(const char *pin, PinDataCallback callback, void *context = nullptr);
+    // Decimals used when a float/double is written to the pin (0-9, default 2).
+    void setPinPrecision(const char *pin, uint8_t decimals);
+    // Filters virtualWrite() on a pin; suppressed writes return true before
+    // they are formatted or queued. Returns false when no policy slot is left.
+    bool setPublishPolicy(const char *pin, const PublishPolicy &policy);
+    void clearPublishPolicy(const char *pin);
+    PublishStats publishStats() const;
+    // Coalesces writes to pins other than V0 into one {"V2":5,...} frame on
+    // devices/<user>/<board>/batch, sent by run() once windowMs has passed
+    // since the first buffered write (0: on the next run()) or earlier when
+    // the frame fills up or a pin is written twice.
+    void enableBatching(unsigned long windowMs = 0);
+    // What virtualWrite() does when the outbound queue is full (default
+    // DropOldest). Block waits up to blockTimeoutMs for run() to make room, so
+    // it must not be used from the task that calls run().
+    void setOverflowPolicy(OverflowPolicy policy, unsigned long blockTimeoutMs = 10);
+    // "sent" counts values published from the queue; writes a publish policy
+    // suppressed never enter it. "dropped" includes values lost to a failed
+    // publish.
+    PublishQueueStats publishQueueStats() const;
+    void disableBatching();
 
     unsigned long getExecutionTime();
+    // "1h 2m 3s 4ms"; returns the length, or 0 when the buffer is too small.
+    size_t formatExecutionTime(char *buffer, size_t bufferSize);
+#ifndef IOTNET_STATIC_MEMORY
     String getFormattedExecutionTime();
+#endif
 
     // Time synchronization methods
     void configureTime(const char *timezone = "UTC", const char *ntpServer1 = "pool.ntp.org",
                        const char *ntpServer2 = "time.nist.gov", const char *ntpServer3 = nullptr);
     bool isTimeSet();
+    // strftime() of the local time; returns the length, or 0 when it does
+    // not fit.
+    size_t formatTime(char *buffer, size_t bufferSize,
+                      const char *format = "%Y-%m-%d %H:%M:%S");
+#ifndef IOTNET_STATIC_MEMORY
     String getFormattedTime(const char *format = "%Y-%m-%d %H:%M:%S");
+#endif
+
+    // Built with IOTNET_STATIC_MEMORY (and the malloc wrap linker flags),
+    // counts heap allocations made by the steady-state path: run(), the
+    // callbacks it invokes and the network loop. run() logs a FAIL line
+    // whenever the count grows. Always 0 otherwise.
+    uint32_t hotPathAllocations() const;
 
     // Board registration and status methods (public API)
     void publishBoardStatus(const char *status = "success");
@@ -75,9 +199,22 @@ class IotNetESP32 {
     // OTA update methods (public API)
     void enableOtaUpdates();
     bool isOtaInProgress() const;
-
+    // Size and number of the buffers between the download and the flash
+    // writer task (default 4 x 4096 bytes, allocated only during an update).
+    // More or larger chunks ride out longer flash stalls. Returns false and
+    // keeps the current setting for counts outside 2-8 or a zero size.
+    bool setOtaChunking(size_t chunkBytes, uint8_t chunkCount = 4);
+    // Refuses link responses without "sha256" instead of flashing the image
+    // unverified (the default, for backends that send no digest).
+    void requireVerifiedOta(bool require = true);
+
+    // Formats the value and queues it; run() publishes it. Safe to call from
+    // any FreeRTOS task. Returns false when the value was dropped.
     template <typename T> bool virtualWrite(const char *pin, T value);
     template <typename T> T virtualRead(const char *pin);
+    // Consumes the pin's pending update, if any, and reports why no value was
+    // produced instead of falling back to T().
+    template <typename T> ReadStatus tryRead(const char *pin, T &out);
 
   private:
     struct NetworkCredentials {
@@ -96,8 +233,8 @@ class IotNetESP32 {
         const char *caCert;
     };
 
-    WiFiClientSecure espClient;
-    PubSubClient mqttClient;
+    iotnetesp32::mqtt::ResumableTlsClient espClient;
+    iotnetesp32::mqtt::MqttClient mqttClient;
     Preferences preferences;
 
     NetworkCredentials credentials;
@@ -114,16 +251,81 @@ class IotNetESP32 {
     char timeZone[64];
     bool timeConfigured;
 
-    PinState pins[MAX_PINS];
+    iotnet::core::PinTable pinTable;
+    iotnet::core::TopicRouter topicRouter;
     PinCallback callbacks[MAX_PINS];
-    int numCallbacks;
+#ifndef IOTNET_STATIC_MEMORY
+    StringCallback stringCallbacks[MAX_PINS];
+#endif
+    iotnet::core::PinCallbackIndex callbackIndex;
+    uint8_t pinPrecision[MAX_PINS];
+    iotnet::core::PublishGate publishGate;
+    iotnet::core::PublishQueue publishQueue;
+    OverflowPolicy overflowPolicy;
+    unsigned long overflowBlockTimeoutMs;
+    // Only the task that owns the connection touches batchFrame; the flag is
+    // how the application side turns batching on and off.
+    iotnet::core::BatchFrame batchFrame;
+    std::atomic<bool> batchingEnabled;
+    unsigned long batchWindowMs;
+    unsigned long batchOpenedAt;
+
+    // Network task mode: the task owns the client and subscribedPins, the
+    // application side owns pinTable; they meet in the queues below.
+    TaskHandle_t networkTask;
+    iotnet::core::InboundQueue inboundQueue;
+    iotnet::core::AtomicPinSet pendingSubscriptions;
+    uint64_t subscribedPins;
+    SubscriptionMode subscriptionMode;
+    // The current connection holds the device wildcard subscription, as far
+    // as is known; a refused SUBACK clears it again.
+    bool wildcardSubscribed;
+    iotnet::core::SubackWatch wildcardAck;
+    // What a session the broker resumes subscribes to: the wildcard filter
+    // rather than per-pin topics. Only known for sessions set up since boot
+    // or before the last deep sleep; otherwise false.
+    bool sessionHoldsWildcard;
+    bool persistentSession;
+    // The broker resumed a stored session for the current connection.
+    bool brokerSessionPresent;
+    bool mqtt5;
+    // Keyed by pin; the batch topic uses BATCH_ALIAS_KEY.
+    iotnet::core::TopicAliasTable topicAliases;
+    uint32_t reportedHotPathAllocations;
+
+    class ConnectionSteps : public iotnet::core::ConnectionDriver {
+      public:
+        explicit ConnectionSteps(IotNetESP32 &owner) : owner(owner) {}
+
+        iotnet::core::StepResult resolve() override;
+        iotnet::core::StepResult connectTcp() override;
+        iotnet::core::StepResult handshakeTls() override;
+        iotnet::core::StepResult connectMqtt() override;
+        iotnet::core::StepResult subscribe() override;
+        bool isOnline() override;
+        void teardown() override;
+
+      private:
+        IotNetESP32 &owner;
+    };
+
+    ConnectionSteps connectionSteps;
+    iotnet::core::ConnectionStateMachine connection;
+    IPAddress brokerAddress;
+    // Set by resume() for the first connection after waking; holds the
+    // ResumeSnapshot flags that let restoreSession() skip work.
+    bool resumingFromSleep;
+    uint32_t resumeFlags;
+    bool boardRegistered;
 
     // OTA state
     bool otaUpdatesEnabled;
     bool otaInProgress;
-    char otaTopic[120];
-    char otaSessionRequestTopic[120];
-    char otaSessionResponseTopic[120];
+    bool verifiedOtaRequired;
+    iotnetesp32::ota::FlashPipelineConfig otaPipeline;
+    char otaTopic[MAX_TOPIC_LENGTH];
+    char otaSessionRequestTopic[MAX_TOPIC_LENGTH];
+    char otaSessionResponseTopic[MAX_TOPIC_LENGTH];
 
     // OTA session state (ephemeral)
     iotnetesp32::ota::OtaSessionState otaSession;
@@ -135,63 +337,136 @@ class IotNetESP32 {
     void setCertificates();
     void setupCertificates();
 
-    void checkConnections();
-    bool reconnectMQTT();
+    static void networkTaskEntry(void *instance);
+    void serviceNetwork();
+    void flushOutbound();
+    void dispatchCallbacks();
+    void applyInboundValues();
+    void reportHotPathAllocations();
+    void subscribePendingPins();
+    bool checkConnections();
+    bool connectOnce();
+    uint32_t configurationIdentity() const;
+    void restoreSession();
+    bool subscribeWildcard();
+    uint8_t subscriptionQos() const { return persistentSession ? 1 : 0; }
     void printLogo();
 
     int convertPinToIndex(const char *pin);
-    void initPinTopic(int pin);
-
-    static void staticMqttCallback(char *topic, byte *payload, unsigned int length);
-    void mqttCallback(char *topic, byte *payload, unsigned int length);
+    bool initPin(int pin);
+    int addCallback(const char *pin, PinDataCallback callback, void *context);
+#ifndef IOTNET_STATIC_MEMORY
+    static void deliverStringCallback(const char *data, size_t length, void *context);
+#endif
+    bool buildPinTopic(int pin, char *outTopic, size_t outSize);
+    void ensurePinSubscribed(int pin);
+    // Applies the pin's publish policy before a write is queued.
+    bool admitWrite(int pin, const iotnet::core::PublishSample &sample);
+    // The admitted write was dropped before it reached the broker.
+    void forgetWrite(int pin);
+    void forgetWrites(uint64_t pins);
+    bool publishOutbound(const iotnet::core::OutboundValue &outbound, bool batching);
+    void drainPublishQueue(bool batching);
+    bool appendToBatch(int pin, const char *value, size_t length, bool quoted);
+    bool flushBatch();
+    bool publishAliased(int aliasKey, const char *topic, const uint8_t *payload, size_t length,
+                        bool retain);
+
+    static uint32_t hardwareRandom(void *context);
+    // Serial.printf() allocates once a line passes 64 bytes; code that can
+    // run on the hot path logs through this stack-buffered version instead.
+    static void logLine(const char *format, ...) __attribute__((format(printf, 1, 2)));
+    static void staticMqttCallback(const iotnet::core::MqttPublish &message, void *context);
+    void mqttCallback(const iotnet::core::MqttPublish &message);
+    static void staticSubackCallback(const iotnet::core::MqttSuback &ack, void *context);
+    void subackCallback(const iotnet::core::MqttSuback &ack);
 
     void updateBoardStatusInternal(const char *status);
     void registerBoardInternal();
 
     // OTA update methods (private)
+    bool buildOtaTopics();
     void subscribeToOtaUpdates();
     void handleOtaMessage(const char* payload);
     void requestOtaSessionKey();
     void handleOtaSessionResponse(const char* payload);
-    bool fetchOtaLinkWithSessionKey(const char* sessionKey, const char* otaId, long nonce, const char* version);
-    bool downloadAndFlashFirmware(const char* url);
+    bool fetchOtaLinkWithSessionKey(const char* sessionKey, const char* otaId, long nonce,
+                                    const char* version, const char* baseVersion);
+    bool downloadAndFlashFirmware(const char* url, const uint8_t* sha256);
+    bool downloadAndPatchFirmware(const char* url, const uint8_t* sha256);
     bool copyPayloadToBuffer(const byte *payload, unsigned int length, char *buffer, size_t bufferSize);
 
     size_t getFreeHeap();
 
     template <typename T> bool publishToPin(const char *pin, T value);
-    template <typename T> const char *toString(T value, char *buffer, size_t bufferSize);
-    template <typename T> T fromString(const String &str);
+    // Writes value as a NUL-terminated payload and returns its length;
+    // precision only applies to floating point types.
+    template <typename T>
+    size_t toString(T value, uint8_t precision, char *buffer, size_t bufferSize);
+    template <typename T> bool fromChars(const char *text, size_t length, T &out);
+    template <typename T> iotnet::core::PublishSample publishSample(T value);
+    template <typename T>
+    void makeOutbound(int pin, T value, const iotnet::core::PublishSample &sample,
+                      iotnet::core::OutboundValue &out);
 };
 
 // toString specializations
-template <> const char *IotNetESP32::toString<float>(float value, char *buffer, size_t bufferSize);
 template <>
-const char *IotNetESP32::toString<double>(double value, char *buffer, size_t bufferSize);
-template <> const char *IotNetESP32::toString<int>(int value, char *buffer, size_t bufferSize);
+size_t IotNetESP32::toString<float>(float value, uint8_t precision, char *buffer,
+                                    size_t bufferSize);
+template <>
+size_t IotNetESP32::toString<double>(double value, uint8_t precision, char *buffer,
+                                     size_t bufferSize);
+template <>
+size_t IotNetESP32::toString<int>(int value, uint8_t precision, char *buffer,
+                                  size_t bufferSize);
 template <>
-const char *IotNetESP32::toString<unsigned int>(unsigned int value, char *buffer,
-                                                size_t bufferSize);
-template <> const char *IotNetESP32::toString<long>(long value, char *buffer, size_t bufferSize);
+size_t IotNetESP32::toString<unsigned int>(unsigned int value, uint8_t precision, char *buffer,
+                                           size_t bufferSize);
 template <>
-const char *IotNetESP32::toString<unsigned long>(unsigned long value, char *buffer,
-                                                 size_t bufferSize);
+size_t IotNetESP32::toString<long>(long value, uint8_t precision, char *buffer,
+                                   size_t bufferSize);
 template <>
-const char *IotNetESP32::toString<const char *>(const char *value, char *buffer, size_t bufferSize);
-template <> const char *IotNetESP32::toString<bool>(bool value, char *buffer, size_t bufferSize);
+size_t IotNetESP32::toString<unsigned long>(unsigned long value, uint8_t precision, char *buffer,
+                                            size_t bufferSize);
 template <>
-const char *IotNetESP32::toString<String>(String value, char *buffer, size_t bufferSize);
-
-// fromString specializations
-template <> int IotNetESP32::fromString<int>(const String &str);
-template <> unsigned int IotNetESP32::fromString<unsigned int>(const String &str);
-template <> long IotNetESP32::fromString<long>(const String &str);
-template <> unsigned long IotNetESP32::fromString<unsigned long>(const String &str);
-template <> float IotNetESP32::fromString<float>(const String &str);
-template <> double IotNetESP32::fromString<double>(const String &str);
-template <> bool IotNetESP32::fromString<bool>(const String &str);
-template <> String IotNetESP32::fromString<String>(const String &str);
-template <> char *IotNetESP32::fromString<char *>(const String &str);
+size_t IotNetESP32::toString<long long>(long long value, uint8_t precision, char *buffer,
+                                        size_t bufferSize);
+template <>
+size_t IotNetESP32::toString<unsigned long long>(unsigned long long value, uint8_t precision,
+                                                 char *buffer, size_t bufferSize);
+template <>
+size_t IotNetESP32::toString<const char *>(const char *value, uint8_t precision, char *buffer,
+                                           size_t bufferSize);
+template <>
+size_t IotNetESP32::toString<bool>(bool value, uint8_t precision, char *buffer,
+                                   size_t bufferSize);
+#ifndef IOTNET_STATIC_MEMORY
+template <>
+size_t IotNetESP32::toString<String>(String value, uint8_t precision, char *buffer,
+                                     size_t bufferSize);
+#endif
+
+// publishSample specializations
+template <>
+iotnet::core::PublishSample IotNetESP32::publishSample<const char *>(const char *value);
+#ifndef IOTNET_STATIC_MEMORY
+template <> iotnet::core::PublishSample IotNetESP32::publishSample<String>(String value);
+#endif
+
+// fromChars specializations
+template <> bool IotNetESP32::fromChars<int>(const char *text, size_t length, int &out);
+template <>
+bool IotNetESP32::fromChars<unsigned int>(const char *text, size_t length, unsigned int &out);
+template <> bool IotNetESP32::fromChars<long>(const char *text, size_t length, long &out);
+template <>
+bool IotNetESP32::fromChars<unsigned long>(const char *text, size_t length, unsigned long &out);
+template <> bool IotNetESP32::fromChars<float>(const char *text, size_t length, float &out);
+template <> bool IotNetESP32::fromChars<double>(const char *text, size_t length, double &out);
+template <> bool IotNetESP32::fromChars<bool>(const char *text, size_t length, bool &out);
+#ifndef IOTNET_STATIC_MEMORY
+template <> bool IotNetESP32::fromChars<String>(const char *text, size_t length, String &out);
+#endif
 
 // External template declarations for publishToPin
 extern template bool IotNetESP32::publishToPin<int>(const char *pin, int value);
@@ -201,8 +476,13 @@ extern template bool IotNetESP32::publishToPin<bool>(const char *pin, bool value
 extern template bool IotNetESP32::publishToPin<unsigned int>(const char *pin, unsigned int value);
 extern template bool IotNetESP32::publishToPin<long>(const char *pin, long value);
 extern template bool IotNetESP32::publishToPin<unsigned long>(const char *pin, unsigned long value);
+extern template bool IotNetESP32::publishToPin<long long>(const char *pin, long long value);
+extern template bool IotNetESP32::publishToPin<unsigned long long>(const char *pin,
+                                                                   unsigned long long value);
 extern template bool IotNetESP32::publishToPin<const char *>(const char *pin, const char *value);
+#ifndef IOTNET_STATIC_MEMORY
 extern template bool IotNetESP32::publishToPin<String>(const char *pin, String value);
+#endif
 
 // External template declarations for virtualWrite
 extern template bool IotNetESP32::virtualWrite<int>(const char *pin, int value);
@@ -212,8 +492,13 @@ extern template bool IotNetESP32::virtualWrite<bool>(const char *pin, bool value
 extern template bool IotNetESP32::virtualWrite<unsigned int>(const char *pin, unsigned int value);
 extern template bool IotNetESP32::virtualWrite<long>(const char *pin, long value);
 extern template bool IotNetESP32::virtualWrite<unsigned long>(const char *pin, unsigned long value);
+extern template bool IotNetESP32::virtualWrite<long long>(const char *pin, long long value);
+extern template bool IotNetESP32::virtualWrite<unsigned long long>(const char *pin,
+                                                                   unsigned long long value);
 extern template bool IotNetESP32::virtualWrite<const char *>(const char *pin, const char *value);
+#ifndef IOTNET_STATIC_MEMORY
 extern template bool IotNetESP32::virtualWrite<String>(const char *pin, String value);
+#endif
 
 // External template declarations for virtualRead
 extern template int IotNetESP32::virtualRead<int>(const char *pin);
@@ -223,6 +508,22 @@ extern template bool IotNetESP32::virtualRead<bool>(const char *pin);
 extern template unsigned int IotNetESP32::virtualRead<unsigned int>(const char *pin);
 extern template long IotNetESP32::virtualRead<long>(const char *pin);
 extern template unsigned long IotNetESP32::virtualRead<unsigned long>(const char *pin);
+#ifndef IOTNET_STATIC_MEMORY
 extern template String IotNetESP32::virtualRead<String>(const char *pin);
+#endif
+
+// External template declarations for tryRead
+extern template IotNetESP32::ReadStatus IotNetESP32::tryRead<int>(const char *pin, int &out);
+extern template IotNetESP32::ReadStatus IotNetESP32::tryRead<float>(const char *pin, float &out);
+extern template IotNetESP32::ReadStatus IotNetESP32::tryRead<double>(const char *pin, double &out);
+extern template IotNetESP32::ReadStatus IotNetESP32::tryRead<bool>(const char *pin, bool &out);
+extern template IotNetESP32::ReadStatus IotNetESP32::tryRead<unsigned int>(const char *pin,
+                                                                           unsigned int &out);
+extern template IotNetESP32::ReadStatus IotNetESP32::tryRead<long>(const char *pin, long &out);
+extern template IotNetESP32::ReadStatus IotNetESP32::tryRead<unsigned long>(const char *pin,
+                                                                            unsigned long &out);
+#ifndef IOTNET_STATIC_MEMORY
+extern template IotNetESP32::ReadStatus IotNetESP32::tryRead<String>(const char *pin, String &out);
+#endif
 
 #endif
@@ -0,0 +1,90 @@
+#include "core/AllocationGuard.h"
+
+#include <atomic>
+
+namespace iotnet::core {
+
+namespace {
+
+// Plain thread-locals: reading them must not allocate, or the hooks would
+// recurse.
+thread_local uint32_t hotPathDepth = 0;
+std::atomic<uint32_t> allocationCount{0};
+std::atomic<size_t> lastAllocationSize{0};
+
+}
+
+AllocationGuard::HotPath::HotPath() {
+    hotPathDepth++;
+}
+
+AllocationGuard::HotPath::~HotPath() {
+    hotPathDepth--;
+}
+
+AllocationGuard::Exempt::Exempt() : savedDepth(hotPathDepth) {
+    hotPathDepth = 0;
+}
+
+AllocationGuard::Exempt::~Exempt() {
+    hotPathDepth = savedDepth;
+}
+
+bool AllocationGuard::enabled() {
+#ifdef IOTNET_STATIC_MEMORY
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool AllocationGuard::inHotPath() {
+    return hotPathDepth > 0;
+}
+
+void AllocationGuard::recordAllocation(size_t size) {
+    if (hotPathDepth == 0) {
+        return;
+    }
+    lastAllocationSize.store(size, std::memory_order_relaxed);
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t AllocationGuard::hotPathAllocations() {
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+size_t AllocationGuard::lastHotPathAllocationSize() {
+    return lastAllocationSize.load(std::memory_order_relaxed);
+}
+
+}
+
+#ifdef IOTNET_STATIC_MEMORY
+
+// Linker-level hooks (--wrap): every reference to malloc in the image,
+// including the ones inside operator new and String, lands here first.
+extern "C" {
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    iotnet::core::AllocationGuard::recordAllocation(size);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    iotnet::core::AllocationGuard::recordAllocation(count * size);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+    iotnet::core::AllocationGuard::recordAllocation(size);
+    return __real_realloc(pointer, size);
+}
+
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef IOTNET_ALLOCATION_GUARD_H
+#define IOTNET_ALLOCATION_GUARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace iotnet::core {
+
+// Counts heap allocations made on a thread while it runs a hot path. With
+// IOTNET_STATIC_MEMORY defined, malloc, calloc and realloc are wrapped and
+// report here; link with -Wl,--wrap=malloc -Wl,--wrap=calloc
+// -Wl,--wrap=realloc. Without it nothing reports and the counter stays 0.
+class AllocationGuard {
+  public:
+    // Marks the enclosing block as hot path for the calling thread. Scopes
+    // nest.
+    class HotPath {
+      public:
+        HotPath();
+        ~HotPath();
+        HotPath(const HotPath &) = delete;
+        HotPath &operator=(const HotPath &) = delete;
+    };
+
+    // Inside a hot path, lets a rare slow path (OTA) allocate uncounted.
+    class Exempt {
+      public:
+        Exempt();
+        ~Exempt();
+        Exempt(const Exempt &) = delete;
+        Exempt &operator=(const Exempt &) = delete;
+
+      private:
+        uint32_t savedDepth;
+    };
+
+    // True when the allocation hooks are built in.
+    static bool enabled();
+    static bool inHotPath();
+    // Called by the hooks for every allocation.
+    static void recordAllocation(size_t size);
+    // Allocations seen inside hot paths, on any thread, since start-up.
+    static uint32_t hotPathAllocations();
+    static size_t lastHotPathAllocationSize();
+};
+
+}
+
+#endif
@@ -0,0 +1,178 @@
+#include "core/BatchFrame.h"
+
+#include <string.h>
+
+namespace iotnet::core {
+
+namespace {
+
+// Room kept for the closing brace and terminator.
+constexpr size_t TAIL_RESERVE = 2;
+constexpr size_t ENTRY_LIMIT = BatchFrame::CAPACITY - TAIL_RESERVE;
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool isJsonNumber(const char *text, size_t length) {
+    size_t i = 0;
+    if (i < length && text[i] == '-') {
+        i++;
+    }
+    if (i == length || !isDigit(text[i])) {
+        return false;
+    }
+    if (text[i] == '0' && i + 1 < length && isDigit(text[i + 1])) {
+        return false;
+    }
+    while (i < length && isDigit(text[i])) {
+        i++;
+    }
+    if (i < length && text[i] == '.') {
+        i++;
+        if (i == length || !isDigit(text[i])) {
+            return false;
+        }
+        while (i < length && isDigit(text[i])) {
+            i++;
+        }
+    }
+    if (i < length && (text[i] == 'e' || text[i] == 'E')) {
+        i++;
+        if (i < length && (text[i] == '+' || text[i] == '-')) {
+            i++;
+        }
+        if (i == length || !isDigit(text[i])) {
+            return false;
+        }
+        while (i < length && isDigit(text[i])) {
+            i++;
+        }
+    }
+    return i == length;
+}
+
+bool isJsonLiteral(const char *text, size_t length) {
+    return (length == 4 && memcmp(text, "true", 4) == 0) ||
+           (length == 5 && memcmp(text, "false", 5) == 0);
+}
+
+}
+
+bool BatchFrame::beginEntry(int pin, size_t *cursor) {
+    if (!PinTable::isValidPin(pin) || contains(pin)) {
+        return false;
+    }
+
+    char digits[4];
+    size_t digitCount = 0;
+    do {
+        digits[digitCount++] = static_cast<char>('0' + pin % 10);
+        pin /= 10;
+    } while (pin > 0);
+
+    // [,]"V<digits>":
+    size_t needed = (isEmpty() ? 0 : 1) + 2 + digitCount + 2;
+    size_t position = used;
+    if (position + needed > ENTRY_LIMIT) {
+        return false;
+    }
+
+    if (!isEmpty()) {
+        buffer[position++] = ',';
+    }
+    buffer[position++] = '"';
+    buffer[position++] = 'V';
+    while (digitCount > 0) {
+        buffer[position++] = digits[--digitCount];
+    }
+    buffer[position++] = '"';
+    buffer[position++] = ':';
+    *cursor = position;
+    return true;
+}
+
+bool BatchFrame::appendQuoted(size_t *cursor, const char *text, size_t length) {
+    static const char HEX[] = "0123456789abcdef";
+    size_t position = *cursor;
+    if (position + 1 > ENTRY_LIMIT) {
+        return false;
+    }
+    buffer[position++] = '"';
+
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c == '"' || c == '\\') {
+            if (position + 2 > ENTRY_LIMIT) {
+                return false;
+            }
+            buffer[position++] = '\\';
+            buffer[position++] = static_cast<char>(c);
+        } else if (c < 0x20) {
+            if (position + 6 > ENTRY_LIMIT) {
+                return false;
+            }
+            memcpy(buffer + position, "\\u00", 4);
+            buffer[position + 4] = HEX[c >> 4];
+            buffer[position + 5] = HEX[c & 0x0f];
+            position += 6;
+        } else {
+            if (position + 1 > ENTRY_LIMIT) {
+                return false;
+            }
+            buffer[position++] = static_cast<char>(c);
+        }
+    }
+
+    if (position + 1 > ENTRY_LIMIT) {
+        return false;
+    }
+    buffer[position++] = '"';
+    *cursor = position;
+    return true;
+}
+
+bool BatchFrame::commit(int pin, size_t cursor) {
+    used = cursor;
+    pinMask |= PinTable::bit(pin);
+    return true;
+}
+
+bool BatchFrame::appendValue(int pin, const char *text, size_t length) {
+    if (!text) {
+        return false;
+    }
+    if (!isJsonNumber(text, length) && !isJsonLiteral(text, length)) {
+        return appendText(pin, text, length);
+    }
+
+    size_t cursor = 0;
+    if (!beginEntry(pin, &cursor) || cursor + length > ENTRY_LIMIT) {
+        return false;
+    }
+    memcpy(buffer + cursor, text, length);
+    return commit(pin, cursor + length);
+}
+
+bool BatchFrame::appendText(int pin, const char *text, size_t length) {
+    if (!text) {
+        return false;
+    }
+
+    size_t cursor = 0;
+    if (!beginEntry(pin, &cursor) || !appendQuoted(&cursor, text, length)) {
+        return false;
+    }
+    return commit(pin, cursor);
+}
+
+const char *BatchFrame::finish(size_t *outLength) {
+    buffer[used] = '}';
+    buffer[used + 1] = '\0';
+    if (outLength) {
+        *outLength = used + 1;
+    }
+    return buffer;
+}
+
+}
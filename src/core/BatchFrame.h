@@ -0,0 +1,54 @@
+#ifndef IOTNET_BATCH_FRAME_H
+#define IOTNET_BATCH_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/PinTable.h"
+
+namespace iotnet::core {
+
+// Coalesces pin writes into one JSON object such as {"V2":5,"V3":"on"}, built
+// in place in a fixed buffer. Each pin appears at most once per frame; the
+// caller flushes before writing a pin that is already present so the order of
+// values on a pin is preserved.
+class BatchFrame {
+  public:
+    static constexpr size_t CAPACITY = 256;
+
+    BatchFrame() { reset(); }
+
+    void reset() {
+        buffer[0] = '{';
+        used = 1;
+        pinMask = 0;
+    }
+
+    bool isEmpty() const { return pinMask == 0; }
+    bool contains(int pin) const { return (pinMask & PinTable::bit(pin)) != 0; }
+    uint64_t pins() const { return pinMask; }
+
+    // Appends "V<pin>":<value>. appendValue() writes JSON numbers and
+    // true/false as is and quotes anything else (e.g. "nan"); appendText()
+    // always quotes. Both return false, leaving the frame untouched, when the
+    // pin is invalid or already present or the entry does not fit.
+    bool appendValue(int pin, const char *text, size_t length);
+    bool appendText(int pin, const char *text, size_t length);
+
+    // Closes the object and returns the NUL-terminated frame; the frame must
+    // be reset() before it is appended to again.
+    const char *finish(size_t *outLength);
+
+  private:
+    bool beginEntry(int pin, size_t *cursor);
+    bool appendQuoted(size_t *cursor, const char *text, size_t length);
+    bool commit(int pin, size_t cursor);
+
+    char buffer[CAPACITY];
+    size_t used;
+    uint64_t pinMask;
+};
+
+}
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef IOTNET_BOUNDED_QUEUE_H
+#define IOTNET_BOUNDED_QUEUE_H
+
+#include <atomic>
+#include <stdint.h>
+
+namespace iotnet::core {
+
+// Bounded lock-free queue of preallocated slots (Vyukov's sequence-per-cell
+// ring). Any number of tasks may push and pop concurrently; values are copied
+// in and out, so T should be small and trivially copyable.
+template <typename T, uint32_t Capacity> class BoundedQueue {
+  public:
+    static constexpr uint32_t CAPACITY = Capacity;
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "capacity must be a power of two");
+
+    BoundedQueue() { reset(); }
+
+    // Not thread-safe; only call while no task is using the queue.
+    void reset() {
+        for (uint32_t i = 0; i < CAPACITY; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        enqueuePos.store(0, std::memory_order_relaxed);
+        dequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    // Returns false when the queue is full.
+    bool tryPush(const T &value) {
+        uint32_t position = enqueuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &cells[position & MASK];
+            uint32_t sequence = cell->sequence.load(std::memory_order_acquire);
+            int32_t distance = static_cast<int32_t>(sequence - position);
+            if (distance == 0) {
+                if (enqueuePos.compare_exchange_weak(position, position + 1,
+                                                     std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (distance < 0) {
+                return false;
+            } else {
+                position = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->value = value;
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Returns false when the queue is empty.
+    bool tryPop(T &out) {
+        uint32_t position = dequeuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &cells[position & MASK];
+            uint32_t sequence = cell->sequence.load(std::memory_order_acquire);
+            int32_t distance = static_cast<int32_t>(sequence - (position + 1));
+            if (distance == 0) {
+                if (dequeuePos.compare_exchange_weak(position, position + 1,
+                                                     std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (distance < 0) {
+                return false;
+            } else {
+                position = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        out = cell->value;
+        cell->sequence.store(position + CAPACITY, std::memory_order_release);
+        return true;
+    }
+
+    using EvictedHandler = void (*)(const T &value, void *context);
+
+    // Pushes, evicting queued entries from the front when full. Another
+    // producer may refill the freed cell first, so this gives up after a few
+    // rounds. Returns the number of evicted entries through outEvicted and
+    // hands each of them to onEvicted, when given.
+    bool pushEvictingOldest(const T &value, uint32_t *outEvicted,
+                            EvictedHandler onEvicted = nullptr, void *context = nullptr) {
+        uint32_t evicted = 0;
+        bool pushed = tryPush(value);
+        T discarded;
+        for (int attempt = 0; !pushed && attempt < EVICT_ATTEMPTS; attempt++) {
+            if (tryPop(discarded)) {
+                evicted++;
+                if (onEvicted) {
+                    onEvicted(discarded, context);
+                }
+            }
+            pushed = tryPush(value);
+        }
+        if (outEvicted) {
+            *outEvicted = evicted;
+        }
+        return pushed;
+    }
+
+  private:
+    static constexpr uint32_t MASK = CAPACITY - 1;
+    static constexpr int EVICT_ATTEMPTS = 4;
+
+    struct Cell {
+        std::atomic<uint32_t> sequence;
+        T value;
+    };
+
+    Cell cells[CAPACITY];
+    std::atomic<uint32_t> enqueuePos;
+    std::atomic<uint32_t> dequeuePos;
+};
+
+}
+
+#endif
@@ -0,0 +1,198 @@
+#include "core/ChunkPipeline.h"
+
+namespace iotnet::core {
+
+namespace {
+
+// Accumulates the length of each run of waits rather than of every single
+// wait, so millisecond clock resolution does not round short waits away.
+class WaitTimer {
+  public:
+    explicit WaitTimer(const PipelineHooks &hooks) : hooks(hooks), waiting(false), since(0) {}
+
+    void wait() {
+        if (!waiting) {
+            waiting = true;
+            since = hooks.nowMs();
+        }
+        hooks.wait();
+    }
+
+    // Returns true when a run of waits just ended.
+    bool resume(PipelinePhaseStats &stats) {
+        if (!waiting) {
+            return false;
+        }
+        waiting = false;
+        stats.waitMs += hooks.nowMs() - since;
+        return true;
+    }
+
+  private:
+    const PipelineHooks &hooks;
+    bool waiting;
+    uint32_t since;
+};
+
+bool finish(bool success, uint32_t startedMs, const PipelineHooks &hooks,
+            PipelinePhaseStats &stats) {
+    stats.elapsedMs = hooks.nowMs() - startedMs;
+    return success;
+}
+
+}
+
+ChunkRing::ChunkRing()
+    : storage(nullptr), chunkBytes(0), chunkCount(0), head(0), tail(0), closed(false),
+      failed(false) {}
+
+bool ChunkRing::attach(uint8_t *buffer, size_t chunkSize, uint8_t count) {
+    if (!buffer || chunkSize == 0 || count < MIN_CHUNKS || count > MAX_CHUNKS) {
+        return false;
+    }
+    storage = buffer;
+    chunkBytes = chunkSize;
+    chunkCount = count;
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+    closed.store(false, std::memory_order_relaxed);
+    failed.store(false, std::memory_order_relaxed);
+    return true;
+}
+
+uint8_t *ChunkRing::writableChunk() {
+    uint32_t position = head.load(std::memory_order_relaxed);
+    if (position - tail.load(std::memory_order_acquire) >= chunkCount) {
+        return nullptr;
+    }
+    return storage + (position % chunkCount) * chunkBytes;
+}
+
+void ChunkRing::commit(size_t length) {
+    uint32_t position = head.load(std::memory_order_relaxed);
+    lengths[position % chunkCount] = length;
+    head.store(position + 1, std::memory_order_release);
+}
+
+void ChunkRing::close() {
+    closed.store(true, std::memory_order_release);
+}
+
+const uint8_t *ChunkRing::readableChunk(size_t *outLength) {
+    uint32_t position = tail.load(std::memory_order_relaxed);
+    if (head.load(std::memory_order_acquire) == position) {
+        return nullptr;
+    }
+    *outLength = lengths[position % chunkCount];
+    return storage + (position % chunkCount) * chunkBytes;
+}
+
+void ChunkRing::release() {
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+bool ChunkRing::drained() const {
+    // close() follows the last commit, so head is final once closed is seen.
+    return closed.load(std::memory_order_acquire) &&
+           head.load(std::memory_order_acquire) == tail.load(std::memory_order_relaxed);
+}
+
+uint32_t PipelinePhaseStats::bytesPerSecond() const {
+    uint32_t busy = busyMs();
+    if (busy == 0) {
+        return 0;
+    }
+    return static_cast<uint32_t>(static_cast<uint64_t>(bytes) * 1000 / busy);
+}
+
+bool fillChunkRing(ChunkRing &ring, ChunkSource &source, size_t totalBytes,
+                   uint32_t idleTimeoutMs, const PipelineHooks &hooks,
+                   PipelinePhaseStats &stats) {
+    stats = PipelinePhaseStats{0, 0, 0};
+    uint32_t startedMs = hooks.nowMs();
+    uint32_t lastDataMs = startedMs;
+    WaitTimer timer(hooks);
+    uint8_t *chunk = nullptr;
+    size_t filled = 0;
+
+    while (stats.bytes < totalBytes) {
+        if (ring.aborted()) {
+            return finish(false, startedMs, hooks, stats);
+        }
+        if (!chunk) {
+            chunk = ring.writableChunk();
+            if (!chunk) {
+                timer.wait();
+                continue;
+            }
+            // Time spent waiting on the writer does not count against the
+            // source's idle timeout.
+            if (timer.resume(stats)) {
+                lastDataMs = hooks.nowMs();
+            }
+            filled = 0;
+        }
+
+        size_t wanted = ring.chunkSize() - filled;
+        if (wanted > totalBytes - stats.bytes) {
+            wanted = totalBytes - stats.bytes;
+        }
+        int received = source.read(chunk + filled, wanted);
+        if (received < 0 || static_cast<size_t>(received) > wanted ||
+            (received == 0 && hooks.nowMs() - lastDataMs >= idleTimeoutMs)) {
+            if (filled > 0) {
+                ring.commit(filled);
+            }
+            ring.close();
+            return finish(false, startedMs, hooks, stats);
+        }
+        if (received == 0) {
+            hooks.wait();
+            continue;
+        }
+
+        lastDataMs = hooks.nowMs();
+        filled += static_cast<size_t>(received);
+        stats.bytes += static_cast<size_t>(received);
+        if (filled == ring.chunkSize() || stats.bytes == totalBytes) {
+            ring.commit(filled);
+            chunk = nullptr;
+        }
+    }
+
+    ring.close();
+    return finish(true, startedMs, hooks, stats);
+}
+
+bool drainChunkRing(ChunkRing &ring, ChunkSink &sink, const PipelineHooks &hooks,
+                    PipelinePhaseStats &stats) {
+    stats = PipelinePhaseStats{0, 0, 0};
+    uint32_t startedMs = hooks.nowMs();
+    WaitTimer timer(hooks);
+
+    for (;;) {
+        if (ring.aborted()) {
+            return finish(false, startedMs, hooks, stats);
+        }
+        size_t length = 0;
+        const uint8_t *chunk = ring.readableChunk(&length);
+        if (!chunk) {
+            if (ring.drained()) {
+                timer.resume(stats);
+                return finish(true, startedMs, hooks, stats);
+            }
+            timer.wait();
+            continue;
+        }
+        timer.resume(stats);
+
+        if (!sink.write(chunk, length)) {
+            ring.abort();
+            return finish(false, startedMs, hooks, stats);
+        }
+        stats.bytes += length;
+        ring.release();
+    }
+}
+
+}
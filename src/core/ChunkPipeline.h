@@ -0,0 +1,105 @@
+#ifndef IOTNET_CHUNK_PIPELINE_H
+#define IOTNET_CHUNK_PIPELINE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace iotnet::core {
+
+// Ring of equally sized chunks over caller-provided storage, shared by one
+// producer task and one consumer task. The producer fills a whole chunk in
+// place and commits it; the consumer reads it in place and releases it, so
+// bytes are never copied between the two stages.
+class ChunkRing {
+  public:
+    static constexpr uint8_t MIN_CHUNKS = 2;
+    static constexpr uint8_t MAX_CHUNKS = 8;
+
+    ChunkRing();
+
+    // Not thread-safe; call before either stage starts. `storage` must hold
+    // chunkSize * chunkCount bytes and outlive both stages.
+    bool attach(uint8_t *storage, size_t chunkSize, uint8_t chunkCount);
+    size_t chunkSize() const { return chunkBytes; }
+
+    // Producer side. writableChunk() is null while every chunk is in use.
+    uint8_t *writableChunk();
+    void commit(size_t length);
+    // No more chunks will follow.
+    void close();
+
+    // Consumer side. readableChunk() is null while no chunk is committed.
+    const uint8_t *readableChunk(size_t *outLength);
+    void release();
+    // Closed and every committed chunk released.
+    bool drained() const;
+
+    // Either side gives up; the other sees aborted() and stops too.
+    void abort() { failed.store(true, std::memory_order_release); }
+    bool aborted() const { return failed.load(std::memory_order_acquire); }
+
+  private:
+    uint8_t *storage;
+    size_t chunkBytes;
+    uint8_t chunkCount;
+    size_t lengths[MAX_CHUNKS];
+    // Chunks committed and released so far. Positions are taken modulo
+    // chunkCount; 2^32 chunks is far beyond any image.
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    std::atomic<bool> closed;
+    std::atomic<bool> failed;
+};
+
+// Where the reader stage gets bytes from, e.g. the HTTP stream.
+class ChunkSource {
+  public:
+    virtual ~ChunkSource() = default;
+    // Bytes read, 0 when nothing has arrived yet, negative when the stream
+    // broke.
+    virtual int read(uint8_t *buffer, size_t size) = 0;
+};
+
+// Where the writer stage puts them, e.g. the OTA partition.
+class ChunkSink {
+  public:
+    virtual ~ChunkSink() = default;
+    virtual bool write(const uint8_t *data, size_t length) = 0;
+};
+
+// Platform pieces the stages need: a millisecond clock and how to wait for
+// the other stage (vTaskDelay on the device, a short sleep on the host).
+struct PipelineHooks {
+    uint32_t (*nowMs)();
+    void (*wait)();
+};
+
+struct PipelinePhaseStats {
+    size_t bytes;
+    uint32_t elapsedMs;
+    // Time spent waiting on the other stage: the reader for a free chunk,
+    // the writer for a filled one.
+    uint32_t waitMs;
+
+    uint32_t busyMs() const { return elapsedMs - waitMs; }
+    // Throughput while not waiting on the other stage.
+    uint32_t bytesPerSecond() const;
+};
+
+// Reader stage: moves totalBytes from source into the ring in full chunks,
+// then closes it. When the source breaks or stays silent for idleTimeoutMs
+// it commits what it has, closes the ring and fails; stats.bytes then tells
+// how far it got, and the writer still drains every byte read.
+bool fillChunkRing(ChunkRing &ring, ChunkSource &source, size_t totalBytes,
+                   uint32_t idleTimeoutMs, const PipelineHooks &hooks,
+                   PipelinePhaseStats &stats);
+
+// Writer stage: hands every chunk to sink until the ring is drained. Fails,
+// aborting the ring, when the sink does.
+bool drainChunkRing(ChunkRing &ring, ChunkSink &sink, const PipelineHooks &hooks,
+                    PipelinePhaseStats &stats);
+
+}
+
+#endif
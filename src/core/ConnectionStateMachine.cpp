@@ -0,0 +1,156 @@
+#include "core/ConnectionStateMachine.h"
+
+namespace iotnet::core {
+
+const char *connectionStateName(ConnectionState state) {
+    switch (state) {
+    case ConnectionState::Disconnected:
+        return "disconnected";
+    case ConnectionState::Resolving:
+        return "resolving";
+    case ConnectionState::TcpConnecting:
+        return "tcp-connecting";
+    case ConnectionState::TlsHandshake:
+        return "tls-handshake";
+    case ConnectionState::MqttConnecting:
+        return "mqtt-connecting";
+    case ConnectionState::Subscribing:
+        return "subscribing";
+    case ConnectionState::Online:
+        return "online";
+    }
+    return "unknown";
+}
+
+ConnectionStateMachine::ConnectionStateMachine(ConnectionDriver &driver,
+                                               const BackoffConfig &config)
+    : driver(driver), config(config), randomSource(nullptr), randomContext(nullptr),
+      randomState(0x9e3779b9u), current(ConnectionState::Disconnected), enteredAtMs(0),
+      attemptStartedMs(0), nextAttemptMs(0), failures(0), lastConnectMs(0), started(false),
+      waiting(false) {}
+
+void ConnectionStateMachine::setRandomSource(RandomSource source, void *context) {
+    randomSource = source;
+    randomContext = context;
+}
+
+void ConnectionStateMachine::seedRandom(uint32_t seed) {
+    // xorshift never leaves zero.
+    randomState = seed != 0 ? seed : 0x9e3779b9u;
+}
+
+void ConnectionStateMachine::start(uint32_t nowMs) {
+    if (current != ConnectionState::Disconnected) {
+        return;
+    }
+    started = true;
+    waiting = false;
+    nextAttemptMs = nowMs;
+}
+
+bool ConnectionStateMachine::poll(uint32_t nowMs) {
+    if (!started) {
+        return false;
+    }
+
+    if (current == ConnectionState::Disconnected) {
+        // Wrap-safe "nowMs >= nextAttemptMs".
+        if (waiting && static_cast<int32_t>(nowMs - nextAttemptMs) < 0) {
+            return false;
+        }
+        attemptStartedMs = nowMs;
+        enter(ConnectionState::Resolving, nowMs);
+        return true;
+    }
+
+    if (current == ConnectionState::Online) {
+        if (driver.isOnline()) {
+            return false;
+        }
+        // Reconnect right away after losing a healthy session.
+        driver.teardown();
+        failures = 0;
+        waiting = false;
+        enter(ConnectionState::Disconnected, nowMs);
+        return true;
+    }
+
+    StepResult result = runStep(current);
+    if (result == StepResult::Pending) {
+        if (config.stepTimeoutMs != 0 && timeInState(nowMs) >= config.stepTimeoutMs) {
+            fail(nowMs);
+            return true;
+        }
+        return false;
+    }
+    if (result == StepResult::Failed) {
+        fail(nowMs);
+        return true;
+    }
+
+    ConnectionState next = static_cast<ConnectionState>(static_cast<int>(current) + 1);
+    if (next == ConnectionState::Online) {
+        failures = 0;
+        lastConnectMs = nowMs - attemptStartedMs;
+    }
+    enter(next, nowMs);
+    return true;
+}
+
+StepResult ConnectionStateMachine::runStep(ConnectionState state) {
+    switch (state) {
+    case ConnectionState::Resolving:
+        return driver.resolve();
+    case ConnectionState::TcpConnecting:
+        return driver.connectTcp();
+    case ConnectionState::TlsHandshake:
+        return driver.handshakeTls();
+    case ConnectionState::MqttConnecting:
+        return driver.connectMqtt();
+    case ConnectionState::Subscribing:
+        return driver.subscribe();
+    default:
+        return StepResult::Failed;
+    }
+}
+
+void ConnectionStateMachine::enter(ConnectionState state, uint32_t nowMs) {
+    current = state;
+    enteredAtMs = nowMs;
+}
+
+void ConnectionStateMachine::fail(uint32_t nowMs) {
+    driver.teardown();
+    uint32_t delayMs = backoffDelay();
+    failures++;
+    waiting = true;
+    nextAttemptMs = nowMs + delayMs;
+    enter(ConnectionState::Disconnected, nowMs);
+}
+
+uint32_t ConnectionStateMachine::backoffDelay() {
+    uint32_t ceiling = config.initialMs;
+    for (uint32_t i = 0; i < failures && ceiling < config.maxMs; i++) {
+        ceiling = ceiling > config.maxMs / 2 ? config.maxMs : ceiling * 2;
+    }
+    if (ceiling > config.maxMs) {
+        ceiling = config.maxMs;
+    }
+
+    uint32_t half = ceiling / 2;
+    uint32_t spread = ceiling - half;
+    return half + (spread == 0 ? 0 : nextRandom() % (spread + 1));
+}
+
+uint32_t ConnectionStateMachine::nextRandom() {
+    if (randomSource) {
+        return randomSource(randomContext);
+    }
+    // xorshift32; only used to spread reconnects of many devices apart.
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+}
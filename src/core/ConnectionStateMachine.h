@@ -0,0 +1,107 @@
+#ifndef IOTNET_CONNECTION_STATE_MACHINE_H
+#define IOTNET_CONNECTION_STATE_MACHINE_H
+
+#include <stdint.h>
+
+namespace iotnet::core {
+
+enum class ConnectionState {
+    Disconnected,
+    Resolving,
+    TcpConnecting,
+    TlsHandshake,
+    MqttConnecting,
+    Subscribing,
+    Online
+};
+
+const char *connectionStateName(ConnectionState state);
+
+enum class StepResult {
+    Pending,
+    Done,
+    Failed
+};
+
+// The transport work behind each state. Every call should do a bounded
+// amount of work and may return Pending to be polled again later.
+class ConnectionDriver {
+  public:
+    virtual ~ConnectionDriver() = default;
+
+    virtual StepResult resolve() = 0;
+    virtual StepResult connectTcp() = 0;
+    virtual StepResult handshakeTls() = 0;
+    virtual StepResult connectMqtt() = 0;
+    virtual StepResult subscribe() = 0;
+    virtual bool isOnline() = 0;
+    // Called whenever an attempt fails or an online session is lost.
+    virtual void teardown() = 0;
+};
+
+struct BackoffConfig {
+    uint32_t initialMs;
+    uint32_t maxMs;
+    // A step still Pending after this long counts as failed (0 disables).
+    uint32_t stepTimeoutMs;
+};
+
+// Drives Disconnected -> Resolving -> TcpConnecting -> TlsHandshake ->
+// MqttConnecting -> Subscribing -> Online, one step per poll(). A failed
+// step returns to Disconnected and waits with "equal jitter" exponential
+// backoff: half of min(maxMs, initialMs * 2^failures) plus a random share of
+// the other half. Time and randomness are injected so the machine can run
+// against a fake clock.
+class ConnectionStateMachine {
+  public:
+    using RandomSource = uint32_t (*)(void *context);
+
+    ConnectionStateMachine(ConnectionDriver &driver, const BackoffConfig &config);
+
+    // Without a source the jitter comes from a xorshift generator. Every
+    // device must draw different delays, so give it a per-device seed or,
+    // better, a hardware source such as esp_random().
+    void setRandomSource(RandomSource source, void *context);
+    void seedRandom(uint32_t seed);
+
+    // Nothing happens until start(); it makes the next poll() begin an
+    // attempt right away, skipping any pending backoff.
+    void start(uint32_t nowMs);
+
+    // Advances at most one step. Returns true when the state changed.
+    bool poll(uint32_t nowMs);
+
+    ConnectionState state() const { return current; }
+    uint32_t timeInState(uint32_t nowMs) const { return nowMs - enteredAtMs; }
+    uint32_t consecutiveFailures() const { return failures; }
+    bool isWaiting() const { return current == ConnectionState::Disconnected && waiting; }
+    uint32_t retryAtMs() const { return nextAttemptMs; }
+    // Duration of the most recent attempt that reached Online.
+    uint32_t lastConnectDurationMs() const { return lastConnectMs; }
+
+  private:
+    void enter(ConnectionState state, uint32_t nowMs);
+    void fail(uint32_t nowMs);
+    uint32_t backoffDelay();
+    uint32_t nextRandom();
+    StepResult runStep(ConnectionState state);
+
+    ConnectionDriver &driver;
+    BackoffConfig config;
+    RandomSource randomSource;
+    void *randomContext;
+    uint32_t randomState;
+
+    ConnectionState current;
+    uint32_t enteredAtMs;
+    uint32_t attemptStartedMs;
+    uint32_t nextAttemptMs;
+    uint32_t failures;
+    uint32_t lastConnectMs;
+    bool started;
+    bool waiting;
+};
+
+}
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef IOTNET_CRC32_H
+#define IOTNET_CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace iotnet::core {
+
+// CRC-32 (IEEE 802.3, as used by zlib). Pass the previous result as `crc` to
+// continue over data that arrives in pieces.
+uint32_t crc32(const void *data, size_t length, uint32_t crc = 0);
+
+}
+
+#endif
@@ -0,0 +1,224 @@
+#include "core/DeltaPatcher.h"
+
+#include <string.h>
+
+#include "core/Crc32.h"
+
+namespace iotnet::core {
+
+namespace {
+
+constexpr uint8_t DELTA_MAGIC[4] = {'I', 'N', 'D', '1'};
+
+uint32_t readLittleEndian32(const uint8_t *bytes) {
+    return static_cast<uint32_t>(bytes[0]) | static_cast<uint32_t>(bytes[1]) << 8 |
+           static_cast<uint32_t>(bytes[2]) << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+}
+
+DeltaPatcher::DeltaPatcher(PatchBase &base, ChunkSink &output) : base(base), output(output) {
+    reset();
+}
+
+void DeltaPatcher::reset() {
+    current = Status::NeedMore;
+    stage = Stage::Header;
+    pendingLength = 0;
+    baseLength = 0;
+    target = 0;
+    targetCrc = 0;
+    basePosition = 0;
+    diffRemaining = 0;
+    extraRemaining = 0;
+    adjustment = 0;
+    consumed = 0;
+    produced = 0;
+    crc = 0;
+}
+
+bool DeltaPatcher::hasMagic(const uint8_t *data, size_t length) {
+    return data && length >= sizeof(DELTA_MAGIC) &&
+           memcmp(data, DELTA_MAGIC, sizeof(DELTA_MAGIC)) == 0;
+}
+
+bool DeltaPatcher::write(const uint8_t *data, size_t length) {
+    if (current != Status::NeedMore) {
+        if (current == Status::Done && length > 0) {
+            return fail(Status::Error);
+        }
+        return current == Status::Done;
+    }
+    consumed += length;
+
+    while (length > 0 && current == Status::NeedMore) {
+        size_t take = 0;
+        switch (stage) {
+        case Stage::Header:
+            if (!gather(&data, &length, HEADER_SIZE)) {
+                return true;
+            }
+            if (!parseHeader()) {
+                return false;
+            }
+            break;
+        case Stage::Record:
+            if (!gather(&data, &length, RECORD_SIZE)) {
+                return true;
+            }
+            if (!parseRecord()) {
+                return false;
+            }
+            break;
+        case Stage::Diff:
+            take = diffRemaining < length ? diffRemaining : length;
+            if (!applyDiff(data, take)) {
+                return false;
+            }
+            diffRemaining -= take;
+            if (diffRemaining == 0 && !endRecord()) {
+                return false;
+            }
+            break;
+        case Stage::Extra:
+            take = extraRemaining < length ? extraRemaining : length;
+            if (!emit(data, take)) {
+                return false;
+            }
+            extraRemaining -= take;
+            if (extraRemaining == 0 && !endRecord()) {
+                return false;
+            }
+            break;
+        case Stage::Finished:
+            return fail(Status::Error);
+        }
+        data += take;
+        length -= take;
+    }
+    return length == 0 || fail(Status::Error);
+}
+
+bool DeltaPatcher::gather(const uint8_t **data, size_t *length, size_t wanted) {
+    size_t take = wanted - pendingLength;
+    if (take > *length) {
+        take = *length;
+    }
+    memcpy(pending + pendingLength, *data, take);
+    pendingLength += take;
+    *data += take;
+    *length -= take;
+    if (pendingLength < wanted) {
+        return false;
+    }
+    pendingLength = 0;
+    return true;
+}
+
+bool DeltaPatcher::parseHeader() {
+    if (!hasMagic(pending, HEADER_SIZE)) {
+        return fail(Status::Error);
+    }
+    baseLength = readLittleEndian32(pending + 4);
+    uint32_t baseCrc = readLittleEndian32(pending + 8);
+    target = readLittleEndian32(pending + 12);
+    targetCrc = readLittleEndian32(pending + 16);
+    if (target == 0) {
+        return fail(Status::Error);
+    }
+    if (baseLength > base.size()) {
+        return fail(Status::BaseMismatch);
+    }
+
+    // Checked up front: a patch applied to the wrong base would only fail at
+    // the target CRC, after the whole download.
+    uint32_t actual = 0;
+    for (size_t offset = 0; offset < baseLength; offset += sizeof(scratch)) {
+        size_t piece = baseLength - offset < sizeof(scratch) ? baseLength - offset
+                                                             : sizeof(scratch);
+        if (!base.read(offset, scratch, piece)) {
+            return fail(Status::BaseMismatch);
+        }
+        actual = crc32(scratch, piece, actual);
+    }
+    if (actual != baseCrc) {
+        return fail(Status::BaseMismatch);
+    }
+    stage = Stage::Record;
+    return true;
+}
+
+bool DeltaPatcher::parseRecord() {
+    diffRemaining = readLittleEndian32(pending);
+    extraRemaining = readLittleEndian32(pending + 4);
+    adjustment = static_cast<int32_t>(readLittleEndian32(pending + 8));
+
+    size_t left = target - produced;
+    if (diffRemaining > left || extraRemaining > left - diffRemaining ||
+        diffRemaining > baseLength - basePosition) {
+        return fail(Status::Error);
+    }
+    if (diffRemaining > 0) {
+        stage = Stage::Diff;
+        return true;
+    }
+    return endRecord();
+}
+
+bool DeltaPatcher::endRecord() {
+    if (extraRemaining > 0) {
+        stage = Stage::Extra;
+        return true;
+    }
+
+    if (adjustment < -static_cast<long>(basePosition) ||
+        (adjustment > 0 && static_cast<size_t>(adjustment) > baseLength - basePosition)) {
+        return fail(Status::Error);
+    }
+    basePosition += adjustment;
+    adjustment = 0;
+
+    if (produced < target) {
+        stage = Stage::Record;
+        return true;
+    }
+    if (crc != targetCrc) {
+        return fail(Status::Error);
+    }
+    stage = Stage::Finished;
+    current = Status::Done;
+    return true;
+}
+
+bool DeltaPatcher::applyDiff(const uint8_t *data, size_t length) {
+    while (length > 0) {
+        size_t piece = length < sizeof(scratch) ? length : sizeof(scratch);
+        if (!base.read(basePosition, scratch, piece)) {
+            return fail(Status::Error);
+        }
+        for (size_t i = 0; i < piece; i++) {
+            scratch[i] = static_cast<uint8_t>(scratch[i] + data[i]);
+        }
+        if (!emit(scratch, piece)) {
+            return false;
+        }
+        basePosition += piece;
+        data += piece;
+        length -= piece;
+    }
+    return true;
+}
+
+bool DeltaPatcher::emit(const uint8_t *data, size_t length) {
+    crc = crc32(data, length, crc);
+    produced += length;
+    return output.write(data, length) || fail(Status::Error);
+}
+
+bool DeltaPatcher::fail(Status status) {
+    current = status;
+    stage = Stage::Finished;
+    return false;
+}
+
+}
@@ -0,0 +1,104 @@
+#ifndef IOTNET_DELTA_PATCHER_H
+#define IOTNET_DELTA_PATCHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/ChunkPipeline.h"
+
+namespace iotnet::core {
+
+// Random access to the image a patch was made against, e.g. the running app
+// partition.
+class PatchBase {
+  public:
+    virtual ~PatchBase() = default;
+    virtual size_t size() const = 0;
+    virtual bool read(size_t offset, uint8_t *buffer, size_t length) = 0;
+};
+
+// Rebuilds an image from a delta patch as the patch streams in, reading the
+// base as needed and handing the result to the output sink. Made by
+// tools/delta_patch.py; all integers are little endian:
+//
+//   "IND1", base length, base CRC-32, target length, target CRC-32
+//   records until the target is complete:
+//     diff length, extra length, base adjustment (signed)
+//     diff bytes:  target byte = base byte + diff byte (mod 256)
+//     extra bytes: copied as they are
+//
+// Diff bytes advance the base position; the adjustment then moves it. This
+// is bsdiff's control layout with its three streams interleaved, so a single
+// pass needs neither seeking in the patch nor buffering the target.
+class DeltaPatcher : public ChunkSink {
+  public:
+    static constexpr size_t HEADER_SIZE = 20;
+    static constexpr size_t RECORD_SIZE = 12;
+
+    enum class Status {
+        NeedMore,
+        // The target is complete and its CRC-32 matched.
+        Done,
+        // The base is shorter than the patch expects or its CRC-32 differs;
+        // nothing was written yet, so a full image can be used instead.
+        BaseMismatch,
+        Error
+    };
+
+    DeltaPatcher(PatchBase &base, ChunkSink &output);
+
+    void reset();
+    // False once the patch failed; bytes after the end are an error.
+    bool write(const uint8_t *data, size_t length) override;
+    Status status() const { return current; }
+
+    // Known once the header has been read.
+    size_t targetLength() const { return target; }
+    size_t patchBytes() const { return consumed; }
+    size_t outputBytes() const { return produced; }
+
+    static bool hasMagic(const uint8_t *data, size_t length);
+
+  private:
+    enum class Stage : uint8_t {
+        Header,
+        Record,
+        Diff,
+        Extra,
+        Finished
+    };
+
+    bool gather(const uint8_t **data, size_t *length, size_t wanted);
+    bool parseHeader();
+    bool parseRecord();
+    bool endRecord();
+    bool applyDiff(const uint8_t *data, size_t length);
+    bool emit(const uint8_t *data, size_t length);
+    bool fail(Status status);
+
+    PatchBase &base;
+    ChunkSink &output;
+
+    Status current;
+    Stage stage;
+    uint8_t pending[HEADER_SIZE];
+    size_t pendingLength;
+
+    size_t baseLength;
+    size_t target;
+    uint32_t targetCrc;
+
+    size_t basePosition;
+    size_t diffRemaining;
+    size_t extraRemaining;
+    long adjustment;
+
+    size_t consumed;
+    size_t produced;
+    uint32_t crc;
+    uint8_t scratch[256];
+};
+
+}
+
+#endif
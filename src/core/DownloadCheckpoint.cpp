@@ -0,0 +1,143 @@
+#include "core/DownloadCheckpoint.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "core/Crc32.h"
+#include "core/ValueCodec.h"
+
+namespace iotnet::core {
+
+namespace {
+
+constexpr int HTTP_OK = 200;
+constexpr int HTTP_PARTIAL_CONTENT = 206;
+constexpr int HTTP_RANGE_NOT_SATISFIABLE = 416;
+
+const char *parseSize(const char *cursor, size_t *outValue) {
+    if (*cursor < '0' || *cursor > '9') {
+        return nullptr;
+    }
+    size_t value = 0;
+    while (*cursor >= '0' && *cursor <= '9') {
+        size_t digit = static_cast<size_t>(*cursor - '0');
+        if (value > (SIZE_MAX - digit) / 10) {
+            return nullptr;
+        }
+        value = value * 10 + digit;
+        cursor++;
+    }
+    *outValue = value;
+    return cursor;
+}
+
+}
+
+DownloadCheckpoint::DownloadCheckpoint() : committed(0), total(0), urlCrc(0) {
+    tag[0] = '\0';
+}
+
+void DownloadCheckpoint::reset() {
+    committed = 0;
+    total = 0;
+    tag[0] = '\0';
+}
+
+void DownloadCheckpoint::prepare(const char *url) {
+    uint32_t crc = url ? crc32(url, strlen(url)) : 0;
+    // Without an ETag nothing ties a checkpoint to its image but the URL.
+    if (crc != urlCrc && tag[0] == '\0') {
+        reset();
+    }
+    urlCrc = crc;
+}
+
+bool DownloadCheckpoint::formatRange(char *outValue, size_t outSize) const {
+    static constexpr char PREFIX[] = "bytes=";
+    static constexpr size_t PREFIX_LENGTH = sizeof(PREFIX) - 1;
+    if (!outValue || !inProgress() || committed == 0 || outSize <= PREFIX_LENGTH + 1) {
+        return false;
+    }
+    memcpy(outValue, PREFIX, PREFIX_LENGTH);
+    size_t digits = formatUnsigned(committed, outValue + PREFIX_LENGTH,
+                                   outSize - PREFIX_LENGTH - 1);
+    if (digits == 0) {
+        return false;
+    }
+    outValue[PREFIX_LENGTH + digits] = '-';
+    outValue[PREFIX_LENGTH + digits + 1] = '\0';
+    return true;
+}
+
+ResumeDecision DownloadCheckpoint::accept(const RangeResponse &response) {
+    bool resuming = inProgress() && committed > 0;
+
+    if (response.status == HTTP_OK) {
+        // Either a fresh download or a server that ignored Range/If-Range.
+        if (response.contentLength <= 0) {
+            reset();
+            return ResumeDecision::Reject;
+        }
+        arm(static_cast<size_t>(response.contentLength), response.etag);
+        return ResumeDecision::Restart;
+    }
+
+    if (response.status == HTTP_PARTIAL_CONTENT && resuming) {
+        size_t first = 0;
+        size_t last = 0;
+        size_t length = 0;
+        bool sameImage =
+            parseContentRange(response.contentRange, &first, &last, &length) &&
+            first == committed && last + 1 == total && length == total &&
+            (response.contentLength < 0 ||
+             static_cast<size_t>(response.contentLength) == total - committed) &&
+            (tag[0] == '\0' || (response.etag && strcmp(response.etag, tag) == 0));
+        if (sameImage) {
+            return ResumeDecision::Resume;
+        }
+        reset();
+        return ResumeDecision::Reject;
+    }
+
+    // A 206 that was not asked for, or a range the server no longer has.
+    if (response.status == HTTP_PARTIAL_CONTENT ||
+        response.status == HTTP_RANGE_NOT_SATISFIABLE) {
+        reset();
+    }
+    // Other errors may be transient; the checkpoint stays for a retry.
+    return ResumeDecision::Reject;
+}
+
+void DownloadCheckpoint::advance(size_t bytes) {
+    committed = bytes > total - committed ? total : committed + bytes;
+}
+
+void DownloadCheckpoint::arm(size_t totalLength, const char *etag) {
+    committed = 0;
+    total = totalLength;
+    tag[0] = '\0';
+    // If-Range needs a strong validator; weak or oversized tags count as none.
+    size_t length = etag ? strlen(etag) : 0;
+    if (length > 0 && length < sizeof(tag) && strncmp(etag, "W/", 2) != 0) {
+        memcpy(tag, etag, length + 1);
+    }
+}
+
+bool parseContentRange(const char *value, size_t *outFirst, size_t *outLast, size_t *outTotal) {
+    static constexpr char UNIT[] = "bytes ";
+    if (!value || strncmp(value, UNIT, sizeof(UNIT) - 1) != 0) {
+        return false;
+    }
+    const char *cursor = parseSize(value + sizeof(UNIT) - 1, outFirst);
+    if (!cursor || *cursor != '-') {
+        return false;
+    }
+    cursor = parseSize(cursor + 1, outLast);
+    if (!cursor || *cursor != '/') {
+        return false;
+    }
+    cursor = parseSize(cursor + 1, outTotal);
+    return cursor && *cursor == '\0' && *outFirst <= *outLast && *outLast < *outTotal;
+}
+
+}
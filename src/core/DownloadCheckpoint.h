@@ -0,0 +1,73 @@
+#ifndef IOTNET_DOWNLOAD_CHECKPOINT_H
+#define IOTNET_DOWNLOAD_CHECKPOINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace iotnet::core {
+
+enum class ResumeDecision {
+    // 206 continuing exactly at the checkpoint: append the body.
+    Resume,
+    // A full image from byte 0: discard what was written and start over.
+    Restart,
+    // Unusable response. The checkpoint is dropped when the response proves
+    // it stale, so the next request asks for the whole image.
+    Reject
+};
+
+// What the HTTP layer saw in a response; header pointers may be null.
+struct RangeResponse {
+    int status;
+    // Length of this response's body, negative when unknown.
+    long contentLength;
+    const char *contentRange;
+    const char *etag;
+};
+
+// How far an image download got, so a broken connection, or the next OTA
+// trigger, can continue with "Range: bytes=<offset>-" instead of byte 0.
+// The offset only moves by bytes that reached flash. A checkpoint is only
+// resumed against a response with the same total length and, when the
+// server sent one, the same strong ETag; without an ETag only the same URL
+// may continue it.
+class DownloadCheckpoint {
+  public:
+    static constexpr size_t ETAG_CAPACITY = 72;
+
+    DownloadCheckpoint();
+
+    void reset();
+    // Call before the first request for url. Keeps the checkpoint only when
+    // it can still be validated for this URL.
+    void prepare(const char *url);
+
+    bool inProgress() const { return total > 0; }
+    bool complete() const { return total > 0 && committed == total; }
+    size_t offset() const { return committed; }
+    size_t totalLength() const { return total; }
+    size_t remaining() const { return total - committed; }
+    // Empty when the server sent none, or only a weak one.
+    const char *etag() const { return tag; }
+
+    // "bytes=<offset>-" for the Range header; false when the next request
+    // should be a plain GET.
+    bool formatRange(char *outValue, size_t outSize) const;
+    ResumeDecision accept(const RangeResponse &response);
+    void advance(size_t bytes);
+
+  private:
+    void arm(size_t totalLength, const char *etag);
+
+    size_t committed;
+    size_t total;
+    uint32_t urlCrc;
+    char tag[ETAG_CAPACITY];
+};
+
+// "bytes <first>-<last>/<total>"; a "*" total is rejected.
+bool parseContentRange(const char *value, size_t *outFirst, size_t *outLast, size_t *outTotal);
+
+}
+
+#endif
@@ -0,0 +1,602 @@
+#include "core/GzipInflater.h"
+
+#include <string.h>
+
+#include "core/Crc32.h"
+
+namespace iotnet::core {
+
+namespace {
+
+constexpr uint8_t GZIP_ID1 = 0x1f;
+constexpr uint8_t GZIP_ID2 = 0x8b;
+constexpr uint8_t GZIP_DEFLATE = 8;
+constexpr size_t GZIP_FIXED_HEADER = 10;
+
+constexpr uint8_t FLAG_HEADER_CRC = 0x02;
+constexpr uint8_t FLAG_EXTRA = 0x04;
+constexpr uint8_t FLAG_NAME = 0x08;
+constexpr uint8_t FLAG_COMMENT = 0x10;
+constexpr uint8_t FLAG_RESERVED = 0xe0;
+
+constexpr int END_OF_BLOCK = 256;
+constexpr int NEED_MORE = -1;
+
+constexpr uint16_t LENGTH_BASE[29] = {3,  4,  5,  6,   7,   8,   9,   10,  11, 13,
+                                      15, 17, 19, 23,  27,  31,  35,  43,  51, 59,
+                                      67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                      2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16_t DISTANCE_BASE[30] = {1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                        33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                        1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385,
+                                        24577};
+constexpr uint8_t DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                        6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+constexpr uint8_t CODE_LENGTH_ORDER[19] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                           11, 4,  12, 3, 13, 2, 14, 1, 15};
+
+uint32_t readLittleEndian32(const uint8_t *bytes) {
+    return static_cast<uint32_t>(bytes[0]) | static_cast<uint32_t>(bytes[1]) << 8 |
+           static_cast<uint32_t>(bytes[2]) << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+}
+
+bool GzipInflater::HuffmanTable::build(const uint8_t *codeLengths, int count) {
+    memset(counts, 0, sizeof(counts));
+    memset(fast, 0, sizeof(fast));
+    for (int symbol = 0; symbol < count; symbol++) {
+        counts[codeLengths[symbol]]++;
+    }
+    counts[0] = 0;
+
+    // Over-subscribed sets cannot be decoded; incomplete ones only fail when
+    // an unassigned code shows up.
+    int left = 1;
+    for (int length = 1; length <= MAX_CODE_BITS; length++) {
+        left = (left << 1) - counts[length];
+        if (left < 0) {
+            return false;
+        }
+    }
+
+    uint16_t offsets[MAX_CODE_BITS + 2];
+    uint16_t nextCode[MAX_CODE_BITS + 1];
+    offsets[1] = 0;
+    nextCode[1] = 0;
+    for (int length = 1; length <= MAX_CODE_BITS; length++) {
+        offsets[length + 1] = offsets[length] + counts[length];
+        if (length > 1) {
+            nextCode[length] = (nextCode[length - 1] + counts[length - 1]) << 1;
+        }
+    }
+
+    for (int symbol = 0; symbol < count; symbol++) {
+        int length = codeLengths[symbol];
+        if (length == 0) {
+            continue;
+        }
+        symbols[offsets[length]++] = static_cast<uint16_t>(symbol);
+
+        uint32_t code = nextCode[length]++;
+        if (length > FAST_BITS) {
+            continue;
+        }
+        // Codes are sent most significant bit first into an LSB-first stream.
+        uint32_t reversed = 0;
+        for (int bit = 0; bit < length; bit++) {
+            reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+        }
+        for (uint32_t index = reversed; index < (1u << FAST_BITS); index += 1u << length) {
+            fast[index] = static_cast<uint16_t>(symbol << 4 | length);
+        }
+    }
+    return true;
+}
+
+GzipInflater::GzipInflater(ChunkSink &output) : window(nullptr), windowMask(0), output(output) {
+    reset();
+}
+
+bool GzipInflater::attach(uint8_t *storage, size_t windowSize) {
+    window = storage;
+    windowMask = windowSize - 1;
+    reset();
+    return current != Status::Error;
+}
+
+void GzipInflater::reset() {
+    size_t windowSize = windowMask + 1;
+    bool usable = window && windowSize >= MIN_WINDOW && windowSize <= MAX_WINDOW &&
+                  (windowSize & windowMask) == 0;
+    current = usable ? Status::NeedMore : Status::Error;
+    stage = Stage::Header;
+    input = nullptr;
+    inputEnd = nullptr;
+    bitBuffer = 0;
+    bitCount = 0;
+    headerStep = HeaderStep::Fixed;
+    flags = 0;
+    headerCounter = 0;
+    extraRemaining = 0;
+    finalBlock = false;
+    storedRemaining = 0;
+    literalCodes = 0;
+    distanceCodes = 0;
+    codeLengthCodes = 0;
+    lengthsRead = 0;
+    matchLength = 0;
+    matchDistance = 0;
+    windowPosition = 0;
+    flushedPosition = 0;
+    consumed = 0;
+    produced = 0;
+    crc = 0;
+    trailerBytes = 0;
+}
+
+bool GzipInflater::hasMagic(const uint8_t *data, size_t length) {
+    return data && length >= 2 && data[0] == GZIP_ID1 && data[1] == GZIP_ID2;
+}
+
+GzipInflater::Status GzipInflater::feed(const uint8_t *data, size_t length) {
+    if (current != Status::NeedMore) {
+        // Anything after the trailer is unexpected.
+        if (current == Status::Done && length > 0) {
+            current = Status::Error;
+        }
+        return current;
+    }
+
+    input = data;
+    inputEnd = data ? data + length : data;
+    bool ok = run() && flush();
+    input = nullptr;
+    inputEnd = nullptr;
+
+    if (!ok) {
+        current = Status::Error;
+    } else if (stage == Stage::Finished) {
+        current = bitCount >= 8 ? Status::Error : Status::Done;
+    }
+    return current;
+}
+
+// Decodes until input runs out or the stream ends. Returns false on a
+// malformed stream or a failed sink.
+bool GzipInflater::run() {
+    for (;;) {
+        uint32_t value = 0;
+        int symbol = 0;
+        int symbolLength = 0;
+
+        switch (stage) {
+        case Stage::Header:
+            if (!parseHeader()) {
+                return current != Status::Error;
+            }
+            stage = Stage::BlockHeader;
+            break;
+
+        case Stage::BlockHeader:
+            if (!takeBits(3, &value)) {
+                return true;
+            }
+            finalBlock = (value & 1) != 0;
+            switch (value >> 1) {
+            case 0:
+                // Stored blocks start on a byte boundary.
+                dropBits(bitCount & 7);
+                stage = Stage::StoredLength;
+                break;
+            case 1: {
+                uint8_t *fixed = lengths;
+                memset(fixed, 8, 144);
+                memset(fixed + 144, 9, 112);
+                memset(fixed + 256, 7, 24);
+                memset(fixed + 280, 8, 8);
+                literalTable.build(fixed, 288);
+                memset(fixed, 5, 30);
+                distanceTable.build(fixed, 30);
+                stage = Stage::Literal;
+                break;
+            }
+            case 2:
+                stage = Stage::TableSizes;
+                break;
+            default:
+                return fail();
+            }
+            break;
+
+        case Stage::StoredLength:
+            if (bitCount < 32) {
+                refill();
+                if (bitCount < 32) {
+                    return true;
+                }
+            }
+            takeBits(16, &value);
+            storedRemaining = static_cast<uint16_t>(value);
+            takeBits(16, &value);
+            if ((value ^ 0xffff) != storedRemaining) {
+                return fail();
+            }
+            stage = Stage::StoredCopy;
+            break;
+
+        case Stage::StoredCopy:
+            while (storedRemaining > 0) {
+                uint8_t byte;
+                if (!takeByte(&byte)) {
+                    return true;
+                }
+                if (!putByte(byte)) {
+                    return false;
+                }
+                storedRemaining--;
+            }
+            stage = finalBlock ? Stage::Trailer : Stage::BlockHeader;
+            break;
+
+        case Stage::TableSizes:
+            if (!takeBits(14, &value)) {
+                return true;
+            }
+            literalCodes = static_cast<uint16_t>((value & 0x1f) + 257);
+            distanceCodes = static_cast<uint16_t>(((value >> 5) & 0x1f) + 1);
+            codeLengthCodes = static_cast<uint16_t>((value >> 10) + 4);
+            if (literalCodes > 286 || distanceCodes > 30) {
+                return fail();
+            }
+            memset(lengths, 0, 19);
+            lengthsRead = 0;
+            stage = Stage::CodeLengthCodes;
+            break;
+
+        case Stage::CodeLengthCodes:
+            while (lengthsRead < codeLengthCodes) {
+                if (!takeBits(3, &value)) {
+                    return true;
+                }
+                lengths[CODE_LENGTH_ORDER[lengthsRead++]] = static_cast<uint8_t>(value);
+            }
+            // The code length code lives in the literal table until the
+            // real tables are built from what it decodes.
+            if (!literalTable.build(lengths, 19)) {
+                return fail();
+            }
+            lengthsRead = 0;
+            stage = Stage::CodeLengths;
+            break;
+
+        case Stage::CodeLengths:
+            while (lengthsRead < literalCodes + distanceCodes) {
+                symbol = peekSymbol(literalTable, &symbolLength);
+                if (symbol == NEED_MORE) {
+                    return true;
+                }
+                if (symbol < 0) {
+                    return fail();
+                }
+                if (symbol < 16) {
+                    dropBits(symbolLength);
+                    lengths[lengthsRead++] = static_cast<uint8_t>(symbol);
+                    continue;
+                }
+
+                int extraBits = symbol == 16 ? 2 : (symbol == 17 ? 3 : 7);
+                refill();
+                if (bitCount < symbolLength + extraBits) {
+                    return true;
+                }
+                dropBits(symbolLength);
+                takeBits(extraBits, &value);
+                int repeat = static_cast<int>(value) + (symbol == 18 ? 11 : 3);
+                uint8_t repeated = 0;
+                if (symbol == 16) {
+                    if (lengthsRead == 0) {
+                        return fail();
+                    }
+                    repeated = lengths[lengthsRead - 1];
+                }
+                if (lengthsRead + repeat > literalCodes + distanceCodes) {
+                    return fail();
+                }
+                memset(lengths + lengthsRead, repeated, static_cast<size_t>(repeat));
+                lengthsRead = static_cast<uint16_t>(lengthsRead + repeat);
+            }
+            if (lengths[END_OF_BLOCK] == 0 || !literalTable.build(lengths, literalCodes) ||
+                !distanceTable.build(lengths + literalCodes, distanceCodes)) {
+                return fail();
+            }
+            stage = Stage::Literal;
+            break;
+
+        case Stage::Literal:
+            for (;;) {
+                symbol = peekSymbol(literalTable, &symbolLength);
+                if (symbol == NEED_MORE) {
+                    return true;
+                }
+                if (symbol < 0) {
+                    return fail();
+                }
+                if (symbol < END_OF_BLOCK) {
+                    dropBits(symbolLength);
+                    if (!putByte(static_cast<uint8_t>(symbol))) {
+                        return false;
+                    }
+                    continue;
+                }
+                break;
+            }
+            if (symbol == END_OF_BLOCK) {
+                dropBits(symbolLength);
+                stage = finalBlock ? Stage::Trailer : Stage::BlockHeader;
+                break;
+            }
+            symbol -= END_OF_BLOCK + 1;
+            if (symbol >= 29) {
+                return fail();
+            }
+            refill();
+            if (bitCount < symbolLength + LENGTH_EXTRA[symbol]) {
+                return true;
+            }
+            dropBits(symbolLength);
+            takeBits(LENGTH_EXTRA[symbol], &value);
+            matchLength = static_cast<uint16_t>(LENGTH_BASE[symbol] + value);
+            stage = Stage::Distance;
+            break;
+
+        case Stage::Distance:
+            symbol = peekSymbol(distanceTable, &symbolLength);
+            if (symbol == NEED_MORE) {
+                return true;
+            }
+            if (symbol < 0 || symbol >= 30) {
+                return fail();
+            }
+            refill();
+            if (bitCount < symbolLength + DISTANCE_EXTRA[symbol]) {
+                return true;
+            }
+            dropBits(symbolLength);
+            takeBits(DISTANCE_EXTRA[symbol], &value);
+            matchDistance = static_cast<uint16_t>(DISTANCE_BASE[symbol] + value);
+            if (matchDistance > produced || matchDistance > windowMask + 1) {
+                return fail();
+            }
+            stage = Stage::Copy;
+            break;
+
+        case Stage::Copy:
+            if (!copyMatch()) {
+                return false;
+            }
+            stage = Stage::Literal;
+            break;
+
+        case Stage::Trailer:
+            if (!parseTrailer()) {
+                return current != Status::Error;
+            }
+            stage = Stage::Finished;
+            break;
+
+        case Stage::Finished:
+            // Input left over after the trailer.
+            return input == inputEnd;
+        }
+    }
+}
+
+// Returns true once the whole header was consumed.
+bool GzipInflater::parseHeader() {
+    uint8_t byte;
+    for (;;) {
+        switch (headerStep) {
+        case HeaderStep::Fixed:
+            while (headerCounter < GZIP_FIXED_HEADER) {
+                if (!takeByte(&byte)) {
+                    return false;
+                }
+                if ((headerCounter == 0 && byte != GZIP_ID1) ||
+                    (headerCounter == 1 && byte != GZIP_ID2) ||
+                    (headerCounter == 2 && byte != GZIP_DEFLATE) ||
+                    (headerCounter == 3 && (byte & FLAG_RESERVED) != 0)) {
+                    return fail();
+                }
+                if (headerCounter == 3) {
+                    flags = byte;
+                }
+                headerCounter++;
+            }
+            headerCounter = 0;
+            headerStep = HeaderStep::ExtraLength;
+            break;
+
+        case HeaderStep::ExtraLength:
+            if (flags & FLAG_EXTRA) {
+                while (headerCounter < 2) {
+                    if (!takeByte(&byte)) {
+                        return false;
+                    }
+                    extraRemaining |= static_cast<uint16_t>(byte << (8 * headerCounter++));
+                }
+            }
+            headerStep = HeaderStep::Extra;
+            break;
+
+        case HeaderStep::Extra:
+            while (extraRemaining > 0) {
+                if (!takeByte(&byte)) {
+                    return false;
+                }
+                extraRemaining--;
+            }
+            headerStep = HeaderStep::Name;
+            break;
+
+        case HeaderStep::Name:
+        case HeaderStep::Comment: {
+            uint8_t flag = headerStep == HeaderStep::Name ? FLAG_NAME : FLAG_COMMENT;
+            if (flags & flag) {
+                // Zero-terminated; the text itself is not kept.
+                do {
+                    if (!takeByte(&byte)) {
+                        return false;
+                    }
+                } while (byte != 0);
+            }
+            headerCounter = 0;
+            headerStep = headerStep == HeaderStep::Name ? HeaderStep::Comment
+                                                        : HeaderStep::HeaderCrc;
+            break;
+        }
+
+        case HeaderStep::HeaderCrc:
+            if (flags & FLAG_HEADER_CRC) {
+                while (headerCounter < 2) {
+                    if (!takeByte(&byte)) {
+                        return false;
+                    }
+                    headerCounter++;
+                }
+            }
+            return true;
+        }
+    }
+}
+
+// Returns true once the trailer was read and matches the output.
+bool GzipInflater::parseTrailer() {
+    if (trailerBytes == 0) {
+        dropBits(bitCount & 7);
+        // The CRC covers everything produced, so the window goes out first.
+        if (!flush()) {
+            return false;
+        }
+    }
+    while (trailerBytes < sizeof(trailer)) {
+        if (!takeByte(&trailer[trailerBytes])) {
+            return false;
+        }
+        trailerBytes++;
+    }
+    if (readLittleEndian32(trailer) != crc ||
+        readLittleEndian32(trailer + 4) != static_cast<uint32_t>(produced)) {
+        return fail();
+    }
+    return true;
+}
+
+void GzipInflater::refill() {
+    while (bitCount <= 24 && input < inputEnd) {
+        bitBuffer |= static_cast<uint32_t>(*input++) << bitCount;
+        bitCount += 8;
+        consumed++;
+    }
+}
+
+bool GzipInflater::takeBits(int count, uint32_t *outValue) {
+    if (bitCount < count) {
+        refill();
+        if (bitCount < count) {
+            return false;
+        }
+    }
+    *outValue = count == 0 ? 0 : bitBuffer & ((1u << count) - 1);
+    dropBits(count);
+    return true;
+}
+
+bool GzipInflater::takeByte(uint8_t *outByte) {
+    uint32_t value;
+    if (!takeBits(8, &value)) {
+        return false;
+    }
+    *outByte = static_cast<uint8_t>(value);
+    return true;
+}
+
+int GzipInflater::peekSymbol(const HuffmanTable &table, int *outLength) {
+    refill();
+
+    uint16_t entry = table.fast[bitBuffer & ((1u << FAST_BITS) - 1)];
+    if (entry != 0 && (entry & 0xf) <= bitCount) {
+        *outLength = entry & 0xf;
+        return entry >> 4;
+    }
+
+    // Canonical decode one bit at a time for long codes and for the last
+    // few bits of the input.
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for (int length = 1; length <= MAX_CODE_BITS; length++) {
+        if (length > bitCount) {
+            return NEED_MORE;
+        }
+        code |= static_cast<int>((bitBuffer >> (length - 1)) & 1);
+        int count = table.counts[length];
+        if (code - count < first) {
+            *outLength = length;
+            return table.symbols[index + (code - first)];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -2;
+}
+
+void GzipInflater::dropBits(int count) {
+    bitBuffer = count >= 32 ? 0 : bitBuffer >> count;
+    bitCount -= count;
+}
+
+bool GzipInflater::putByte(uint8_t value) {
+    window[windowPosition++] = value;
+    produced++;
+    if (windowPosition > windowMask) {
+        if (!flush()) {
+            return false;
+        }
+        windowPosition = 0;
+        flushedPosition = 0;
+    }
+    return true;
+}
+
+bool GzipInflater::copyMatch() {
+    size_t from = (windowPosition - matchDistance) & windowMask;
+    while (matchLength > 0) {
+        if (!putByte(window[from])) {
+            return false;
+        }
+        from = (from + 1) & windowMask;
+        matchLength--;
+    }
+    return true;
+}
+
+bool GzipInflater::flush() {
+    if (windowPosition == flushedPosition) {
+        return true;
+    }
+    const uint8_t *pending = window + flushedPosition;
+    size_t length = windowPosition - flushedPosition;
+    crc = crc32(pending, length, crc);
+    flushedPosition = windowPosition;
+    return output.write(pending, length) || fail();
+}
+
+bool GzipInflater::fail() {
+    current = Status::Error;
+    return false;
+}
+
+}
@@ -0,0 +1,142 @@
+#ifndef IOTNET_GZIP_INFLATER_H
+#define IOTNET_GZIP_INFLATER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/ChunkPipeline.h"
+
+namespace iotnet::core {
+
+// Streaming gzip (RFC 1952) decoder. Compressed bytes may arrive in pieces
+// of any size; decoded bytes are produced into the caller's window buffer,
+// which doubles as the DEFLATE history, and handed to the output sink
+// whenever the window wraps and at the end of every feed() call. Nothing
+// else is buffered, so memory use is the window plus under 4 KB of state.
+//
+// The window must be a power of two; streams referring further back than
+// it are rejected. Compressors producing standard gzip files need 32 KB.
+class GzipInflater {
+  public:
+    static constexpr size_t MIN_WINDOW = 1024;
+    static constexpr size_t MAX_WINDOW = 32768;
+
+    enum class Status {
+        NeedMore,
+        // The trailer checked out: CRC-32 and length match the output.
+        Done,
+        Error
+    };
+
+    explicit GzipInflater(ChunkSink &output);
+
+    // Starts a new stream over the given window, which must outlive it.
+    // Until this succeeds every feed() fails.
+    bool attach(uint8_t *storage, size_t windowSize);
+    // Starts over with a new stream; the window is kept.
+    void reset();
+    // Bytes after the end of the gzip member are an error.
+    Status feed(const uint8_t *data, size_t length);
+    Status status() const { return current; }
+
+    size_t inputBytes() const { return consumed; }
+    size_t outputBytes() const { return produced; }
+
+    static bool hasMagic(const uint8_t *data, size_t length);
+
+  private:
+    static constexpr int MAX_CODE_BITS = 15;
+    static constexpr int FAST_BITS = 9;
+
+    struct HuffmanTable {
+        uint16_t counts[MAX_CODE_BITS + 1];
+        uint16_t symbols[288];
+        // Indexed by the next FAST_BITS input bits: symbol << 4 | code
+        // length, or 0 when the code is longer.
+        uint16_t fast[1 << FAST_BITS];
+
+        bool build(const uint8_t *lengths, int count);
+    };
+
+    enum class Stage : uint8_t {
+        Header,
+        BlockHeader,
+        StoredLength,
+        StoredCopy,
+        TableSizes,
+        CodeLengthCodes,
+        CodeLengths,
+        Literal,
+        Distance,
+        Copy,
+        Trailer,
+        Finished
+    };
+
+    enum class HeaderStep : uint8_t {
+        Fixed,
+        ExtraLength,
+        Extra,
+        Name,
+        Comment,
+        HeaderCrc
+    };
+
+    bool run();
+    bool parseHeader();
+    bool parseTrailer();
+
+    void refill();
+    bool takeBits(int count, uint32_t *outValue);
+    bool takeByte(uint8_t *outByte);
+    // Symbol at the front of the bit buffer without consuming it; -1 when
+    // more input is needed, -2 for an unassigned code.
+    int peekSymbol(const HuffmanTable &table, int *outLength);
+    void dropBits(int count);
+
+    bool putByte(uint8_t value);
+    bool copyMatch();
+    bool flush();
+    bool fail();
+
+    uint8_t *window;
+    size_t windowMask;
+    ChunkSink &output;
+
+    Status current;
+    Stage stage;
+    const uint8_t *input;
+    const uint8_t *inputEnd;
+    uint32_t bitBuffer;
+    int bitCount;
+
+    HeaderStep headerStep;
+    uint8_t flags;
+    uint16_t headerCounter;
+    uint16_t extraRemaining;
+
+    bool finalBlock;
+    uint16_t storedRemaining;
+    uint16_t literalCodes;
+    uint16_t distanceCodes;
+    uint16_t codeLengthCodes;
+    uint16_t lengthsRead;
+    uint8_t lengths[288 + 32];
+    uint16_t matchLength;
+    uint16_t matchDistance;
+
+    HuffmanTable literalTable;
+    HuffmanTable distanceTable;
+
+    size_t windowPosition;
+    size_t flushedPosition;
+    size_t consumed;
+    size_t produced;
+    uint32_t crc;
+    uint8_t trailer[8];
+    uint8_t trailerBytes;
+};
+
+}
+
+#endif
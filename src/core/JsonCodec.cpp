@@ -1,11 +1,471 @@
 #include "core/JsonCodec.h"
 
-#include <ArduinoJson.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
 namespace iotnet::core {
 
+namespace {
+
+// The payloads are small fixed schemas, so instead of building a document the
+// parsers below make one pass over the text, validate all of it, and decode
+// only the wanted members straight into the caller's buffers. Accept/reject
+// rules follow ArduinoJson's defaults, which these functions used before:
+// single quotes and unquoted keys are allowed, comments are not, nesting
+// stops at 10 levels, text after the root object is ignored and the last of
+// duplicate keys wins.
+
+constexpr int NESTING_LIMIT = 10;
+constexpr size_t NUMBER_LIMIT = 63;
+constexpr size_t KEY_CAPACITY = 16;
+
+enum class ValueKind : uint8_t {
+    Missing,
+    String,
+    Integer,
+    Other
+};
+
+// A member the caller asked for, at the root or inside the root's "data"
+// object. String members are decoded into `out`; others only keep their kind
+// and, for integers, their value.
+struct JsonField {
+    const char *key;
+    bool inData;
+    char *out;
+    size_t outSize;
+    ValueKind kind = ValueKind::Missing;
+    size_t length = 0;
+    long long integer = 0;
+
+    bool hasString(size_t minLength) const {
+        return kind == ValueKind::String && length >= minLength && length < outSize;
+    }
+};
+
+// Collects decoded string bytes. Like `const char *` access to an ArduinoJson
+// string, the value ends at an embedded NUL.
+struct StringSink {
+    char *out;
+    size_t size;
+    size_t length;
+    bool ended;
+
+    void append(char c) {
+        if (ended) {
+            return;
+        }
+        if (c == '\0') {
+            ended = true;
+            return;
+        }
+        if (out && length + 1 < size) {
+            out[length] = c;
+        }
+        length++;
+    }
+
+    // Same byte layout as ArduinoJson's Utf8::encodeCodepoint(), including
+    // what it makes of out-of-range values left by unpaired surrogates.
+    void appendCodepoint(uint32_t codepoint) {
+        if (codepoint < 0x80) {
+            append(static_cast<char>(codepoint));
+            return;
+        }
+        char bytes[4];
+        char *first = bytes + sizeof(bytes);
+        *--first = static_cast<char>((codepoint | 0x80) & 0xbf);
+        uint16_t rest = static_cast<uint16_t>(codepoint >> 6);
+        if (rest < 0x20) {
+            *--first = static_cast<char>(rest | 0xc0);
+        } else {
+            *--first = static_cast<char>((rest | 0x80) & 0xbf);
+            rest = static_cast<uint16_t>(rest >> 6);
+            if (rest < 0x10) {
+                *--first = static_cast<char>(rest | 0xe0);
+            } else {
+                *--first = static_cast<char>((rest | 0x80) & 0xbf);
+                *--first = static_cast<char>((rest >> 6) | 0xf0);
+            }
+        }
+        for (; first < bytes + sizeof(bytes); first++) {
+            append(*first);
+        }
+    }
+
+    void finish() {
+        if (out) {
+            out[length < size ? length : size - 1] = '\0';
+        }
+    }
+};
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool canBeInNumber(char c) {
+    return isDigit(c) || c == '+' || c == '-' || c == '.' || c == 'e' || c == 'E';
+}
+
+bool canBeInUnquotedKey(char c) {
+    return isDigit(c) || (c >= '_' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '+' ||
+           c == '-' || c == '.';
+}
+
+char unescape(char c) {
+    switch (c) {
+    case '"':
+    case '\\':
+    case '/':
+        return c;
+    case 'b':
+        return '\b';
+    case 'f':
+        return '\f';
+    case 'n':
+        return '\n';
+    case 'r':
+        return '\r';
+    case 't':
+        return '\t';
+    default:
+        return '\0';
+    }
+}
+
+class JsonScanner {
+  public:
+    JsonScanner(const char *text, JsonField *fields, size_t fieldCount)
+        : cursor(text), fields(fields), fieldCount(fieldCount) {}
+
+    // True when the text is a valid document whose root is an object; a
+    // root of any other type has none of the members anyway.
+    bool scan() {
+        for (size_t i = 0; i < fieldCount; i++) {
+            reset(fields[i]);
+        }
+        skipSpaces();
+        return *cursor == '{' && parseObject(1, Scope::Root);
+    }
+
+  private:
+    enum class Scope {
+        Root,
+        Data,
+        Other
+    };
+
+    static void reset(JsonField &field) {
+        field.kind = ValueKind::Missing;
+        field.length = 0;
+        field.integer = 0;
+    }
+
+    void skipSpaces() {
+        while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r' || *cursor == '\n') {
+            cursor++;
+        }
+    }
+
+    JsonField *find(const char *key, size_t length, bool inData) {
+        for (size_t i = 0; i < fieldCount; i++) {
+            if (fields[i].inData == inData && strlen(fields[i].key) == length &&
+                memcmp(fields[i].key, key, length) == 0) {
+                return &fields[i];
+            }
+        }
+        return nullptr;
+    }
+
+    bool parseObject(int depth, Scope scope) {
+        if (depth > NESTING_LIMIT) {
+            return false;
+        }
+        cursor++;
+        skipSpaces();
+        if (*cursor == '}') {
+            cursor++;
+            return true;
+        }
+
+        for (;;) {
+            char key[KEY_CAPACITY];
+            StringSink keySink = {key, sizeof(key), 0, false};
+            if (!parseKey(keySink)) {
+                return false;
+            }
+            skipSpaces();
+            if (*cursor != ':') {
+                return false;
+            }
+            cursor++;
+
+            JsonField *field = nullptr;
+            Scope child = Scope::Other;
+            // A key holding a NUL cannot equal any of the wanted names.
+            if (scope != Scope::Other && !keySink.ended && keySink.length < sizeof(key)) {
+                field = find(key, keySink.length, scope == Scope::Data);
+                if (scope == Scope::Root && keySink.length == 4 && memcmp(key, "data", 4) == 0) {
+                    // A later "data" replaces the earlier one entirely.
+                    child = Scope::Data;
+                    for (size_t i = 0; i < fieldCount; i++) {
+                        if (fields[i].inData) {
+                            reset(fields[i]);
+                        }
+                    }
+                }
+            }
+            if (field) {
+                reset(*field);
+            }
+            if (!parseValue(depth, child, field)) {
+                return false;
+            }
+
+            skipSpaces();
+            if (*cursor == '}') {
+                cursor++;
+                return true;
+            }
+            if (*cursor != ',') {
+                return false;
+            }
+            cursor++;
+            skipSpaces();
+        }
+    }
+
+    bool parseArray(int depth) {
+        if (depth > NESTING_LIMIT) {
+            return false;
+        }
+        cursor++;
+        skipSpaces();
+        if (*cursor == ']') {
+            cursor++;
+            return true;
+        }
+
+        for (;;) {
+            if (!parseValue(depth, Scope::Other, nullptr)) {
+                return false;
+            }
+            skipSpaces();
+            if (*cursor == ']') {
+                cursor++;
+                return true;
+            }
+            if (*cursor != ',') {
+                return false;
+            }
+            cursor++;
+        }
+    }
+
+    bool parseValue(int depth, Scope childScope, JsonField *field) {
+        skipSpaces();
+        if (field) {
+            field->kind = ValueKind::Other;
+        }
+
+        switch (*cursor) {
+        case '{':
+            return parseObject(depth + 1, childScope);
+        case '[':
+            return parseArray(depth + 1);
+        case '"':
+        case '\'': {
+            bool wanted = field && field->out;
+            StringSink sink = {wanted ? field->out : nullptr, wanted ? field->outSize : 0, 0,
+                               false};
+            if (!parseQuoted(sink)) {
+                return false;
+            }
+            if (wanted) {
+                sink.finish();
+                field->kind = ValueKind::String;
+                field->length = sink.length;
+            }
+            return true;
+        }
+        case 't':
+            return parseKeyword("true");
+        case 'f':
+            return parseKeyword("false");
+        case 'n':
+            return parseKeyword("null");
+        default:
+            return parseNumber(field);
+        }
+    }
+
+    bool parseKey(StringSink &sink) {
+        if (*cursor == '"' || *cursor == '\'') {
+            return parseQuoted(sink);
+        }
+        if (!canBeInUnquotedKey(*cursor)) {
+            return false;
+        }
+        while (canBeInUnquotedKey(*cursor)) {
+            sink.append(*cursor++);
+        }
+        return true;
+    }
+
+    bool parseQuoted(StringSink &sink) {
+        char quote = *cursor++;
+        // As in ArduinoJson, a low surrogate combines with whatever escaped unit
+        // came before it in the string, and a high surrogate produces nothing.
+        uint32_t codepoint = 0;
+        for (;;) {
+            char c = *cursor++;
+            if (c == quote) {
+                return true;
+            }
+            if (c == '\0') {
+                return false;
+            }
+            if (c == '\\') {
+                c = *cursor;
+                if (c == 'u') {
+                    cursor++;
+                    uint32_t unit;
+                    if (!parseHex4(unit)) {
+                        return false;
+                    }
+                    if (unit >= 0xd800 && unit < 0xdc00) {
+                        codepoint = unit & 0x3ff;
+                        continue;
+                    }
+                    if (unit >= 0xdc00 && unit < 0xe000) {
+                        codepoint = 0x10000 + ((codepoint << 10) | (unit & 0x3ff));
+                    } else {
+                        codepoint = unit;
+                    }
+                    sink.appendCodepoint(codepoint);
+                    continue;
+                }
+                c = unescape(c);
+                if (c == '\0') {
+                    return false;
+                }
+                cursor++;
+            }
+            sink.append(c);
+        }
+    }
+
+    bool parseHex4(uint32_t &out) {
+        out = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = *cursor;
+            uint32_t digit;
+            if (isDigit(c)) {
+                digit = static_cast<uint32_t>(c - '0');
+            } else if (c >= 'a' && c <= 'f') {
+                digit = static_cast<uint32_t>(c - 'a' + 10);
+            } else if (c >= 'A' && c <= 'F') {
+                digit = static_cast<uint32_t>(c - 'A' + 10);
+            } else {
+                return false;
+            }
+            out = (out << 4) | digit;
+            cursor++;
+        }
+        return true;
+    }
+
+    bool parseKeyword(const char *word) {
+        for (; *word; word++, cursor++) {
+            if (*cursor != *word) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Same grammar as ArduinoJson's parseNumber(): optional sign, then digits
+    // and/or a fraction, then an optional exponent whose digits may be
+    // missing. Only integers that fit 64 bits count as integers.
+    bool parseNumber(JsonField *field) {
+        const char *start = cursor;
+        while (canBeInNumber(*cursor)) {
+            cursor++;
+        }
+        const char *end = cursor;
+        size_t length = static_cast<size_t>(end - start);
+        if (length == 0 || length > NUMBER_LIMIT) {
+            return false;
+        }
+
+        const char *s = start;
+        bool negative = *s == '-';
+        if (*s == '-' || *s == '+') {
+            s++;
+        }
+        if (s == end || (!isDigit(*s) && *s != '.')) {
+            return false;
+        }
+
+        uint64_t mantissa = 0;
+        bool fits = true;
+        while (s < end && isDigit(*s)) {
+            uint64_t digit = static_cast<uint64_t>(*s - '0');
+            if (mantissa > (UINT64_MAX - digit) / 10) {
+                fits = false;
+                break;
+            }
+            mantissa = mantissa * 10 + digit;
+            s++;
+        }
+
+        if (s == end && fits) {
+            if (negative && mantissa <= static_cast<uint64_t>(LLONG_MAX) + 1) {
+                setInteger(field, mantissa == 0 ? 0 : -static_cast<long long>(mantissa - 1) - 1);
+            } else if (!negative && mantissa <= static_cast<uint64_t>(LLONG_MAX)) {
+                setInteger(field, static_cast<long long>(mantissa));
+            }
+            return true;
+        }
+
+        while (s < end && isDigit(*s)) {
+            s++;
+        }
+        if (s < end && *s == '.') {
+            s++;
+            while (s < end && isDigit(*s)) {
+                s++;
+            }
+        }
+        if (s < end && (*s == 'e' || *s == 'E')) {
+            s++;
+            if (s < end && (*s == '-' || *s == '+')) {
+                s++;
+            }
+            while (s < end && isDigit(*s)) {
+                s++;
+            }
+        }
+        return s == end;
+    }
+
+    static void setInteger(JsonField *field, long long value) {
+        if (field && !field->out) {
+            field->kind = ValueKind::Integer;
+            field->integer = value;
+        }
+    }
+
+    const char *cursor;
+    JsonField *fields;
+    size_t fieldCount;
+};
+
+}
+
 bool parseOtaTriggerPayload(
     const char *payload,
     char *outOtaId,
@@ -19,32 +479,32 @@ bool parseOtaTriggerPayload(
         return false;
     }
 
-    JsonDocument doc;
-    if (deserializeJson(doc, payload)) {
-        return false;
-    }
-
-    if (!doc["ota_id"].is<const char *>() || !doc["version"].is<const char *>() ||
-        !doc["nonce"].is<long>()) {
+    JsonField fields[] = {
+        {"ota_id", false, outOtaId, outOtaIdSize},
+        {"version", false, outVersion, outVersionSize},
+        {"nonce", false, nullptr, 0},
+    };
+    if (!JsonScanner(payload, fields, 3).scan() || !fields[0].hasString(0) ||
+        !fields[1].hasString(0) || fields[2].kind != ValueKind::Integer ||
+        fields[2].integer < LONG_MIN || fields[2].integer > LONG_MAX) {
         return false;
     }
 
-    const char *otaId = doc["ota_id"].as<const char *>();
-    const char *version = doc["version"].as<const char *>();
-    if (!otaId || !version) {
-        return false;
-    }
+    *outNonce = static_cast<long>(fields[2].integer);
+    return true;
+}
 
-    size_t otaIdLength = strlen(otaId);
-    size_t versionLength = strlen(version);
-    if (otaIdLength >= outOtaIdSize || versionLength >= outVersionSize) {
+bool parseOtaTriggerBaseVersion(
+    const char *payload,
+    char *outBaseVersion,
+    size_t outBaseVersionSize
+) {
+    if (!payload || !outBaseVersion || outBaseVersionSize == 0) {
         return false;
     }
 
-    memcpy(outOtaId, otaId, otaIdLength + 1);
-    memcpy(outVersion, version, versionLength + 1);
-    *outNonce = doc["nonce"].as<long>();
-    return true;
+    JsonField baseVersion = {"base_version", false, outBaseVersion, outBaseVersionSize};
+    return JsonScanner(payload, &baseVersion, 1).scan() && baseVersion.hasString(1);
 }
 
 bool buildOtaSessionRequestPayload(
@@ -83,31 +543,20 @@ bool parseOtaSessionResponsePayload(
         return false;
     }
 
-    JsonDocument doc;
-    if (deserializeJson(doc, payload)) {
-        return false;
-    }
-
-    if (!doc["cid"].is<const char *>() || !doc["session_key"].is<const char *>()) {
-        return false;
-    }
-
-    const char *correlationId = doc["cid"].as<const char *>();
-    const char *sessionKey = doc["session_key"].as<const char *>();
-    if (!correlationId || !sessionKey) {
-        return false;
-    }
-
-    size_t cidLength = strlen(correlationId);
-    size_t keyLength = strlen(sessionKey);
-    if (cidLength == 0 || cidLength >= outCorrelationIdSize || keyLength == 0 ||
-        keyLength >= outSessionKeySize) {
+    JsonField fields[] = {
+        {"cid", false, outCorrelationId, outCorrelationIdSize},
+        {"session_key", false, outSessionKey, outSessionKeySize},
+        {"expires_in", false, nullptr, 0},
+    };
+    if (!JsonScanner(payload, fields, 3).scan() || !fields[0].hasString(1) ||
+        !fields[1].hasString(1)) {
         return false;
     }
 
-    memcpy(outCorrelationId, correlationId, cidLength + 1);
-    memcpy(outSessionKey, sessionKey, keyLength + 1);
-    *outExpiresIn = doc["expires_in"] | 0;
+    // Anything but an int-sized integer counts as absent.
+    bool hasExpiry = fields[2].kind == ValueKind::Integer && fields[2].integer >= INT_MIN &&
+                     fields[2].integer <= INT_MAX;
+    *outExpiresIn = hasExpiry ? static_cast<int>(fields[2].integer) : 0;
     return true;
 }
 
@@ -139,22 +588,31 @@ bool parseOtaLinkResponsePayload(const char *payload, char *outOtaUrl, size_t ou
         return false;
     }
 
-    JsonDocument doc;
-    if (deserializeJson(doc, payload)) {
+    JsonField url = {"ota_url", true, outOtaUrl, outOtaUrlSize};
+    return JsonScanner(payload, &url, 1).scan() && url.hasString(1);
+}
+
+bool parseOtaLinkPatchUrl(const char *payload, char *outPatchUrl, size_t outPatchUrlSize) {
+    if (!payload || !outPatchUrl || outPatchUrlSize == 0) {
         return false;
     }
 
-    const char *otaUrl = doc["data"]["ota_url"].as<const char *>();
-    if (!otaUrl) {
+    JsonField url = {"patch_url", true, outPatchUrl, outPatchUrlSize};
+    return JsonScanner(payload, &url, 1).scan() && url.hasString(1);
+}
+
+bool parseOtaLinkSha256(const char *payload, char *outSha256, size_t outSha256Size) {
+    if (!payload || !outSha256 || outSha256Size == 0) {
         return false;
     }
 
-    size_t urlLength = strlen(otaUrl);
-    if (urlLength == 0 || urlLength >= outOtaUrlSize) {
+    JsonField digest = {"sha256", true, outSha256, outSha256Size};
+    if (!JsonScanner(payload, &digest, 1).scan() || digest.kind == ValueKind::Missing) {
         return false;
     }
-
-    memcpy(outOtaUrl, otaUrl, urlLength + 1);
+    if (!digest.hasString(1)) {
+        outSha256[0] = '\0';
+    }
     return true;
 }
 
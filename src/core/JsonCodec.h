@@ -14,6 +14,14 @@ bool parseOtaTriggerPayload(
     long *outNonce
 );
 
+// The trigger's optional "base_version": the firmware a delta patch was
+// made against. False when it is missing or does not fit.
+bool parseOtaTriggerBaseVersion(
+    const char *payload,
+    char *outBaseVersion,
+    size_t outBaseVersionSize
+);
+
 bool buildOtaSessionRequestPayload(
     char *outPayload,
     size_t outPayloadSize,
@@ -45,6 +53,23 @@ bool parseOtaLinkResponsePayload(
     size_t outOtaUrlSize
 );
 
+// The link response's optional "patch_url", next to "ota_url" in "data".
+bool parseOtaLinkPatchUrl(
+    const char *payload,
+    char *outPatchUrl,
+    size_t outPatchUrlSize
+);
+
+// The link response's optional "sha256" in "data": the hex digest of the
+// firmware image as flashed, which a patch must rebuild as well. Returns
+// false only when the member is absent; any other value that is not a string
+// fitting outSha256 comes back empty, so the caller rejects it.
+bool parseOtaLinkSha256(
+    const char *payload,
+    char *outSha256,
+    size_t outSha256Size
+);
+
 }
 
 #endif
@@ -0,0 +1,525 @@
+#include "core/MqttCodec.h"
+
+#include <string.h>
+
+namespace iotnet::core {
+
+namespace {
+
+constexpr uint8_t PROPERTY_SESSION_EXPIRY = 0x11;
+constexpr uint8_t PROPERTY_TOPIC_ALIAS_MAXIMUM = 0x22;
+constexpr uint8_t PROPERTY_TOPIC_ALIAS = 0x23;
+
+size_t varintSize(size_t value) {
+    return value < 128 ? 1 : value < 16384 ? 2 : value < 2097152 ? 3 : 4;
+}
+
+uint8_t *writeVarint(uint8_t *out, size_t value) {
+    do {
+        uint8_t digit = value & 0x7f;
+        value >>= 7;
+        *out++ = value > 0 ? digit | 0x80 : digit;
+    } while (value > 0);
+    return out;
+}
+
+// Returns the size of the variable byte integer at `in`, or 0 when it is
+// malformed or runs past `length`.
+size_t readVarint(const uint8_t *in, size_t length, size_t &value) {
+    value = 0;
+    for (size_t i = 0; i < 4 && i < length; i++) {
+        value |= static_cast<size_t>(in[i] & 0x7f) << (7 * i);
+        if ((in[i] & 0x80) == 0) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// Writes the fixed header and returns its size, or 0 when the packet with a
+// body of `bodyLength` bytes does not fit.
+size_t writeFixedHeader(uint8_t *out, size_t size, uint8_t header, size_t bodyLength) {
+    if (!out || bodyLength > MQTT_MAX_REMAINING_LENGTH) {
+        return 0;
+    }
+    size_t headerLength = 1 + varintSize(bodyLength);
+    if (headerLength + bodyLength > size) {
+        return 0;
+    }
+
+    out[0] = header;
+    writeVarint(out + 1, bodyLength);
+    return headerLength;
+}
+
+uint8_t *writeU16(uint8_t *out, uint16_t value) {
+    out[0] = static_cast<uint8_t>(value >> 8);
+    out[1] = static_cast<uint8_t>(value);
+    return out + 2;
+}
+
+uint8_t *writeField(uint8_t *out, const void *data, size_t length) {
+    out = writeU16(out, static_cast<uint16_t>(length));
+    if (length > 0) {
+        memcpy(out, data, length);
+    }
+    return out + length;
+}
+
+uint8_t *writeU32(uint8_t *out, uint32_t value) {
+    out = writeU16(out, static_cast<uint16_t>(value >> 16));
+    return writeU16(out, static_cast<uint16_t>(value));
+}
+
+uint16_t readU16(const uint8_t *in) {
+    return static_cast<uint16_t>((in[0] << 8) | in[1]);
+}
+
+// Size of one MQTT 5 property value, or 0 for unknown identifiers and values
+// running past `length`.
+size_t propertyValueLength(uint8_t id, const uint8_t *in, size_t length) {
+    size_t size = 0;
+    size_t value;
+    switch (id) {
+    case 0x01:
+    case 0x17:
+    case 0x19:
+    case 0x24:
+    case 0x25:
+    case 0x28:
+    case 0x29:
+    case 0x2a:
+        size = 1;
+        break;
+    case 0x13:
+    case 0x21:
+    case 0x22:
+    case 0x23:
+        size = 2;
+        break;
+    case 0x02:
+    case 0x11:
+    case 0x18:
+    case 0x27:
+        size = 4;
+        break;
+    case 0x0b:
+        size = readVarint(in, length, value);
+        break;
+    case 0x03:
+    case 0x08:
+    case 0x09:
+    case 0x12:
+    case 0x15:
+    case 0x16:
+    case 0x1a:
+    case 0x1c:
+    case 0x1f:
+        size = length >= 2 ? 2 + readU16(in) : 0;
+        break;
+    case 0x26:
+        // User property: a pair of strings.
+        if (length >= 2) {
+            size = 2 + readU16(in);
+            size = size + 2 <= length ? size + 2 + readU16(in + size) : 0;
+        }
+        break;
+    default:
+        return 0;
+    }
+    return size <= length ? size : 0;
+}
+
+// Checks the MQTT 5 property block at `in` and returns its size including the
+// length prefix, or 0 when it is malformed. A Topic Alias Maximum found on
+// the way is stored in `aliasMaximum`.
+size_t readProperties(const uint8_t *in, size_t length, uint16_t *aliasMaximum) {
+    size_t blockLength;
+    size_t prefixLength = readVarint(in, length, blockLength);
+    if (prefixLength == 0 || blockLength > length - prefixLength) {
+        return 0;
+    }
+
+    const uint8_t *cursor = in + prefixLength;
+    const uint8_t *end = cursor + blockLength;
+    while (cursor < end) {
+        uint8_t id = *cursor++;
+        size_t valueLength = propertyValueLength(id, cursor, static_cast<size_t>(end - cursor));
+        if (valueLength == 0) {
+            return 0;
+        }
+        if (id == PROPERTY_TOPIC_ALIAS_MAXIMUM && aliasMaximum) {
+            *aliasMaximum = readU16(cursor);
+        }
+        cursor += valueLength;
+    }
+    return prefixLength + blockLength;
+}
+
+bool fitsField(size_t length) {
+    return length <= 0xffff;
+}
+
+size_t textLength(const char *text) {
+    return text ? strlen(text) : 0;
+}
+
+}
+
+size_t encodeConnect(uint8_t *out, size_t size, const MqttConnectOptions &options) {
+    size_t clientIdLength = textLength(options.clientId);
+    size_t usernameLength = textLength(options.username);
+    size_t passwordLength = textLength(options.password);
+    size_t willTopicLength = textLength(options.willTopic);
+    bool hasWill = options.willTopic != nullptr;
+    bool hasUsername = options.username != nullptr;
+    // A password without a user name is not allowed in 3.1.1.
+    bool hasPassword = hasUsername && options.password != nullptr;
+    bool v5 = options.version == MqttVersion::V5;
+    if ((!v5 && options.version != MqttVersion::V311) || options.willQos > 1 ||
+        !fitsField(clientIdLength) || !fitsField(usernameLength) || !fitsField(passwordLength) ||
+        !fitsField(willTopicLength) || !fitsField(options.willPayloadLength)) {
+        return 0;
+    }
+
+    // The only CONNECT property sent is the session expiry of a kept session.
+    size_t propertiesLength = v5 && !options.cleanSession ? 5 : 0;
+    size_t bodyLength = 10 + 2 + clientIdLength;
+    if (v5) {
+        bodyLength += 1 + propertiesLength;
+    }
+    if (hasWill) {
+        bodyLength += (v5 ? 1 : 0) + 2 + willTopicLength + 2 + options.willPayloadLength;
+    }
+    if (hasUsername) {
+        bodyLength += 2 + usernameLength;
+    }
+    if (hasPassword) {
+        bodyLength += 2 + passwordLength;
+    }
+
+    size_t headerLength = writeFixedHeader(out, size, 0x10, bodyLength);
+    if (headerLength == 0) {
+        return 0;
+    }
+
+    uint8_t flags = options.cleanSession ? 0x02 : 0x00;
+    if (hasWill) {
+        flags |= 0x04 | static_cast<uint8_t>(options.willQos << 3);
+        flags |= options.willRetain ? 0x20 : 0x00;
+    }
+    flags |= hasUsername ? 0x80 : 0x00;
+    flags |= hasPassword ? 0x40 : 0x00;
+
+    uint8_t *cursor = out + headerLength;
+    cursor = writeField(cursor, "MQTT", 4);
+    *cursor++ = static_cast<uint8_t>(options.version);
+    *cursor++ = flags;
+    cursor = writeU16(cursor, options.keepAliveSeconds);
+    if (v5) {
+        *cursor++ = static_cast<uint8_t>(propertiesLength);
+        if (propertiesLength > 0) {
+            *cursor++ = PROPERTY_SESSION_EXPIRY;
+            cursor = writeU32(cursor, 0xffffffff);
+        }
+    }
+    cursor = writeField(cursor, options.clientId, clientIdLength);
+    if (hasWill) {
+        if (v5) {
+            // No will properties.
+            *cursor++ = 0;
+        }
+        cursor = writeField(cursor, options.willTopic, willTopicLength);
+        cursor = writeField(cursor, options.willPayload, options.willPayloadLength);
+    }
+    if (hasUsername) {
+        cursor = writeField(cursor, options.username, usernameLength);
+    }
+    if (hasPassword) {
+        cursor = writeField(cursor, options.password, passwordLength);
+    }
+    return static_cast<size_t>(cursor - out);
+}
+
+size_t encodePublishHeader(uint8_t *out, size_t size, const char *topic, size_t payloadLength,
+                           uint8_t qos, bool retain, uint16_t packetId, MqttVersion version,
+                           uint16_t topicAlias) {
+    bool v5 = version == MqttVersion::V5;
+    size_t topicLength = textLength(topic);
+    if ((topicLength == 0 && topicAlias == 0) || (topicAlias != 0 && !v5) ||
+        !fitsField(topicLength) || qos > 1 || (qos > 0 && packetId == 0)) {
+        return 0;
+    }
+
+    size_t propertiesLength = topicAlias != 0 ? 3 : 0;
+    size_t variableLength =
+        2 + topicLength + (qos > 0 ? 2 : 0) + (v5 ? 1 + propertiesLength : 0);
+    uint8_t header = static_cast<uint8_t>(0x30 | (qos << 1) | (retain ? 0x01 : 0x00));
+    size_t bodyLength = variableLength + payloadLength;
+    if (bodyLength > MQTT_MAX_REMAINING_LENGTH) {
+        return 0;
+    }
+
+    // Only the header has to fit here; the payload follows separately.
+    size_t headerLength = 1 + varintSize(bodyLength);
+    if (!out || headerLength + variableLength > size) {
+        return 0;
+    }
+    writeFixedHeader(out, headerLength + bodyLength, header, bodyLength);
+
+    uint8_t *cursor = writeField(out + headerLength, topic, topicLength);
+    if (qos > 0) {
+        cursor = writeU16(cursor, packetId);
+    }
+    if (v5) {
+        *cursor++ = static_cast<uint8_t>(propertiesLength);
+        if (topicAlias != 0) {
+            *cursor++ = PROPERTY_TOPIC_ALIAS;
+            cursor = writeU16(cursor, topicAlias);
+        }
+    }
+    return static_cast<size_t>(cursor - out);
+}
+
+size_t encodePublish(uint8_t *out, size_t size, const char *topic, const uint8_t *payload,
+                     size_t payloadLength, uint8_t qos, bool retain, uint16_t packetId,
+                     MqttVersion version, uint16_t topicAlias) {
+    size_t headerLength = encodePublishHeader(out, size, topic, payloadLength, qos, retain,
+                                              packetId, version, topicAlias);
+    if (headerLength == 0 || headerLength + payloadLength > size ||
+        (payloadLength > 0 && !payload)) {
+        return 0;
+    }
+    if (payloadLength > 0) {
+        memcpy(out + headerLength, payload, payloadLength);
+    }
+    return headerLength + payloadLength;
+}
+
+size_t encodeSubscribe(uint8_t *out, size_t size, uint16_t packetId,
+                       const MqttSubscription *subscriptions, size_t count,
+                       MqttVersion version) {
+    if (packetId == 0 || !subscriptions || count == 0) {
+        return 0;
+    }
+
+    bool v5 = version == MqttVersion::V5;
+    size_t bodyLength = v5 ? 3 : 2;
+    for (size_t i = 0; i < count; i++) {
+        size_t topicLength = textLength(subscriptions[i].topic);
+        if (topicLength == 0 || !fitsField(topicLength) || subscriptions[i].qos > 2) {
+            return 0;
+        }
+        bodyLength += 2 + topicLength + 1;
+    }
+
+    size_t headerLength = writeFixedHeader(out, size, 0x82, bodyLength);
+    if (headerLength == 0) {
+        return 0;
+    }
+
+    uint8_t *cursor = writeU16(out + headerLength, packetId);
+    if (v5) {
+        *cursor++ = 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        cursor = writeField(cursor, subscriptions[i].topic, strlen(subscriptions[i].topic));
+        *cursor++ = subscriptions[i].qos;
+    }
+    return static_cast<size_t>(cursor - out);
+}
+
+size_t encodePuback(uint8_t *out, size_t size, uint16_t packetId) {
+    size_t headerLength = writeFixedHeader(out, size, 0x40, 2);
+    if (headerLength == 0) {
+        return 0;
+    }
+    writeU16(out + headerLength, packetId);
+    return headerLength + 2;
+}
+
+size_t encodePingreq(uint8_t *out, size_t size) {
+    return writeFixedHeader(out, size, 0xc0, 0);
+}
+
+size_t encodeDisconnect(uint8_t *out, size_t size) {
+    return writeFixedHeader(out, size, 0xe0, 0);
+}
+
+bool decodeConnack(const MqttPacket &packet, MqttConnack &out, MqttVersion version) {
+    size_t expected = version == MqttVersion::V5 ? packet.length : 2;
+    if (packet.type() != MqttPacketType::Connack || packet.truncated() || packet.length < 2 ||
+        packet.length != expected || (packet.body[0] & 0xfe) != 0) {
+        return false;
+    }
+
+    out.topicAliasMaximum = 0;
+    if (packet.length > 2 &&
+        readProperties(packet.body + 2, packet.length - 2, &out.topicAliasMaximum) !=
+            packet.length - 2) {
+        return false;
+    }
+    out.sessionPresent = (packet.body[0] & 0x01) != 0;
+    out.returnCode = packet.body[1];
+    // A refused connection never has a session.
+    if (out.returnCode != 0) {
+        out.sessionPresent = false;
+    }
+    return true;
+}
+
+bool decodePublish(const MqttPacket &packet, MqttPublish &out, MqttVersion version) {
+    if (packet.type() != MqttPacketType::Publish || packet.length < 2) {
+        return false;
+    }
+
+    uint8_t qos = (packet.flags() >> 1) & 0x03;
+    if (qos == 3) {
+        return false;
+    }
+
+    size_t topicLength = readU16(packet.body);
+    size_t headerLength = 2 + topicLength + (qos > 0 ? 2 : 0);
+    if (topicLength == 0 || headerLength > packet.length) {
+        return false;
+    }
+    if (version == MqttVersion::V5) {
+        size_t propertiesLength =
+            readProperties(packet.body + headerLength, packet.length - headerLength, nullptr);
+        if (propertiesLength == 0) {
+            return false;
+        }
+        headerLength += propertiesLength;
+    }
+
+    out.topic = reinterpret_cast<const char *>(packet.body + 2);
+    out.topicLength = topicLength;
+    out.packetId = qos > 0 ? readU16(packet.body + 2 + topicLength) : 0;
+    out.payload = packet.body + headerLength;
+    out.payloadLength = packet.length - headerLength;
+    out.qos = qos;
+    out.retain = (packet.flags() & 0x01) != 0;
+    out.duplicate = (packet.flags() & 0x08) != 0;
+    out.truncated = packet.truncated();
+    return true;
+}
+
+bool decodeSuback(const MqttPacket &packet, MqttSuback &out, MqttVersion version) {
+    if (packet.type() != MqttPacketType::Suback || packet.length < 3 || packet.truncated()) {
+        return false;
+    }
+
+    size_t headerLength = 2;
+    if (version == MqttVersion::V5) {
+        size_t propertiesLength = readProperties(packet.body + 2, packet.length - 2, nullptr);
+        if (propertiesLength == 0) {
+            return false;
+        }
+        headerLength += propertiesLength;
+    }
+    if (headerLength >= packet.length) {
+        return false;
+    }
+    out.packetId = readU16(packet.body);
+    out.returnCodes = packet.body + headerLength;
+    out.count = packet.length - headerLength;
+    return true;
+}
+
+bool decodePacketId(const MqttPacket &packet, uint16_t &out, MqttVersion version) {
+    switch (packet.type()) {
+    case MqttPacketType::Puback:
+    case MqttPacketType::Pubrec:
+    case MqttPacketType::Pubrel:
+    case MqttPacketType::Pubcomp:
+    case MqttPacketType::Unsuback:
+        break;
+    default:
+        return false;
+    }
+    size_t expected = version == MqttVersion::V5 ? packet.fullLength : 2;
+    if (packet.length < 2 || packet.fullLength != expected) {
+        return false;
+    }
+    out = readU16(packet.body);
+    return true;
+}
+
+MqttPacketReader::MqttPacketReader(uint8_t *buffer, size_t capacity)
+    : buffer(buffer), capacity(buffer ? capacity : 0) {
+    reset();
+}
+
+void MqttPacketReader::reset() {
+    stage = Stage::Header;
+    header = 0;
+    lengthBytes = 0;
+    remaining = 0;
+    bodyLength = 0;
+    stored = 0;
+    current = MqttPacket{0, nullptr, 0, 0};
+}
+
+size_t MqttPacketReader::feed(const uint8_t *data, size_t length, Status &status) {
+    status = Status::NeedMore;
+    size_t used = 0;
+
+    while (used < length) {
+        if (stage == Stage::Header) {
+            header = data[used++];
+            if ((header >> 4) == 0) {
+                status = Status::Malformed;
+                return used;
+            }
+            lengthBytes = 0;
+            bodyLength = 0;
+            stage = Stage::Length;
+            continue;
+        }
+
+        if (stage == Stage::Length) {
+            uint8_t digit = data[used++];
+            bodyLength |= static_cast<size_t>(digit & 0x7f) << (7 * lengthBytes);
+            lengthBytes++;
+            if (digit & 0x80) {
+                if (lengthBytes == 4) {
+                    status = Status::Malformed;
+                    return used;
+                }
+                continue;
+            }
+
+            remaining = bodyLength;
+            stored = 0;
+            // Fast path: the whole body is already in this chunk.
+            if (remaining <= length - used) {
+                current = MqttPacket{header, data + used, bodyLength, bodyLength};
+                used += remaining;
+                stage = Stage::Header;
+                status = Status::Packet;
+                return used;
+            }
+            stage = Stage::Body;
+            continue;
+        }
+
+        size_t take = length - used < remaining ? length - used : remaining;
+        size_t room = capacity - stored;
+        size_t keep = take < room ? take : room;
+        if (keep > 0) {
+            memcpy(buffer + stored, data + used, keep);
+            stored += keep;
+        }
+        used += take;
+        remaining -= take;
+        if (remaining == 0) {
+            current = MqttPacket{header, buffer, stored, bodyLength};
+            stage = Stage::Header;
+            status = Status::Packet;
+            return used;
+        }
+    }
+    return used;
+}
+
+}
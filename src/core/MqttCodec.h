@@ -0,0 +1,221 @@
+#ifndef IOTNET_MQTT_CODEC_H
+#define IOTNET_MQTT_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace iotnet::core {
+
+// MQTT 3.1.1 and 5 packets as the client uses them. Encoders write complete
+// packets into a caller buffer and return the length, or 0 when it does not
+// fit. Decoders return views into the packet: nothing is copied or
+// terminated. MQTT 5 properties are skipped except for the few the client
+// acts on.
+
+enum class MqttPacketType : uint8_t {
+    Reserved = 0,
+    Connect = 1,
+    Connack = 2,
+    Publish = 3,
+    Puback = 4,
+    Pubrec = 5,
+    Pubrel = 6,
+    Pubcomp = 7,
+    Subscribe = 8,
+    Suback = 9,
+    Unsubscribe = 10,
+    Unsuback = 11,
+    Pingreq = 12,
+    Pingresp = 13,
+    Disconnect = 14
+};
+
+enum class MqttVersion : uint8_t {
+    V311 = 4,
+    V5 = 5
+};
+
+// Largest "remaining length" the 4-byte varint can express.
+constexpr size_t MQTT_MAX_REMAINING_LENGTH = 268435455;
+
+struct MqttConnectOptions {
+    const char *clientId = nullptr;
+    const char *username = nullptr;
+    const char *password = nullptr;
+    const char *willTopic = nullptr;
+    const uint8_t *willPayload = nullptr;
+    size_t willPayloadLength = 0;
+    uint8_t willQos = 0;
+    bool willRetain = false;
+    // With MQTT 5 a kept session is requested to never expire, matching 3.1.1.
+    bool cleanSession = true;
+    uint16_t keepAliveSeconds = 60;
+    MqttVersion version = MqttVersion::V311;
+};
+
+struct MqttSubscription {
+    const char *topic;
+    uint8_t qos;
+};
+
+size_t encodeConnect(uint8_t *out, size_t size, const MqttConnectOptions &options);
+// A non-zero topicAlias (MQTT 5 only) is sent as a property; with an empty
+// or null topic the packet refers to an alias the broker already knows.
+size_t encodePublish(uint8_t *out, size_t size, const char *topic, const uint8_t *payload,
+                     size_t payloadLength, uint8_t qos, bool retain, uint16_t packetId,
+                     MqttVersion version = MqttVersion::V311, uint16_t topicAlias = 0);
+// Everything but the payload, for payloads sent straight from caller memory.
+size_t encodePublishHeader(uint8_t *out, size_t size, const char *topic, size_t payloadLength,
+                           uint8_t qos, bool retain, uint16_t packetId,
+                           MqttVersion version = MqttVersion::V311, uint16_t topicAlias = 0);
+// Several filters in one packet, answered by a single SUBACK.
+size_t encodeSubscribe(uint8_t *out, size_t size, uint16_t packetId,
+                       const MqttSubscription *subscriptions, size_t count,
+                       MqttVersion version = MqttVersion::V311);
+size_t encodePuback(uint8_t *out, size_t size, uint16_t packetId);
+size_t encodePingreq(uint8_t *out, size_t size);
+size_t encodeDisconnect(uint8_t *out, size_t size);
+
+// One received packet. `body` points either into the chunk passed to
+// MqttPacketReader::feed() or into the reader's buffer, and stays valid until
+// the next feed() call. For truncated packets only the first `length` of
+// `fullLength` body bytes were kept.
+struct MqttPacket {
+    uint8_t header;
+    const uint8_t *body;
+    size_t length;
+    size_t fullLength;
+
+    MqttPacketType type() const { return static_cast<MqttPacketType>(header >> 4); }
+    uint8_t flags() const { return header & 0x0f; }
+    bool truncated() const { return length < fullLength; }
+};
+
+struct MqttConnack {
+    bool sessionPresent;
+    // The MQTT 5 reason code has the same meaning: 0 is success.
+    uint8_t returnCode;
+    // Highest alias the broker accepts from us; always 0 for 3.1.1.
+    uint16_t topicAliasMaximum;
+};
+
+struct MqttPublish {
+    const char *topic;
+    size_t topicLength;
+    const uint8_t *payload;
+    size_t payloadLength;
+    uint16_t packetId;
+    uint8_t qos;
+    bool retain;
+    bool duplicate;
+    // Part of the payload was dropped by MqttPacketReader.
+    bool truncated;
+};
+
+struct MqttSuback {
+    uint16_t packetId;
+    const uint8_t *returnCodes;
+    size_t count;
+};
+
+// 3.1.1 refuses a filter with 0x80; every MQTT 5 reason code from 0x80 up is
+// a failure. Anything lower is the granted QoS, which may be below the one
+// requested.
+inline bool subackRefused(uint8_t returnCode) {
+    return returnCode >= 0x80;
+}
+
+// Waits for the SUBACK of one SUBSCRIBE whose outcome matters, such as a
+// wildcard filter that has to be replaced when the broker refuses it.
+class SubackWatch {
+  public:
+    enum class Outcome {
+        Unrelated,
+        Granted,
+        Refused
+    };
+
+    SubackWatch() : packetId(0) {}
+
+    // Packet id 0 is never used, so it marks "nothing expected".
+    void expect(uint16_t id) { packetId = id; }
+    void clear() { packetId = 0; }
+    bool isPending() const { return packetId != 0; }
+
+    // A single-filter SUBSCRIBE is answered with one return code; any
+    // refused code counts.
+    Outcome check(const MqttSuback &ack) {
+        if (packetId == 0 || ack.packetId != packetId) {
+            return Outcome::Unrelated;
+        }
+        packetId = 0;
+        for (size_t i = 0; i < ack.count; i++) {
+            if (subackRefused(ack.returnCodes[i])) {
+                return Outcome::Refused;
+            }
+        }
+        return Outcome::Granted;
+    }
+
+  private:
+    uint16_t packetId;
+};
+
+bool decodeConnack(const MqttPacket &packet, MqttConnack &out,
+                   MqttVersion version = MqttVersion::V311);
+// Also works on a truncated packet as long as the topic and packet id were
+// kept, so a QoS 1 message that was too large can still be acknowledged.
+bool decodePublish(const MqttPacket &packet, MqttPublish &out,
+                   MqttVersion version = MqttVersion::V311);
+bool decodeSuback(const MqttPacket &packet, MqttSuback &out,
+                  MqttVersion version = MqttVersion::V311);
+// PUBACK, PUBREC, PUBREL, PUBCOMP and UNSUBACK start with a packet id; MQTT 5
+// may follow it with a reason code and properties.
+bool decodePacketId(const MqttPacket &packet, uint16_t &out,
+                    MqttVersion version = MqttVersion::V311);
+
+// Splits a byte stream into packets, however the reads are chunked. A packet
+// that arrives whole inside one chunk is returned in place; only packets that
+// straddle chunks are assembled in the buffer given to the constructor. Bodies
+// larger than that buffer are truncated to it and the rest is skipped.
+class MqttPacketReader {
+  public:
+    enum class Status {
+        NeedMore,
+        Packet,
+        Malformed
+    };
+
+    MqttPacketReader(uint8_t *buffer, size_t capacity);
+
+    void reset();
+
+    // Consumes bytes up to and including the end of the next packet and
+    // returns how many were used. When status is Packet, packet() describes
+    // it; call feed() again with the rest of the chunk. Malformed means the
+    // stream cannot be trusted any more and the connection should be closed.
+    size_t feed(const uint8_t *data, size_t length, Status &status);
+
+    const MqttPacket &packet() const { return current; }
+
+  private:
+    enum class Stage {
+        Header,
+        Length,
+        Body
+    };
+
+    uint8_t *buffer;
+    size_t capacity;
+    Stage stage;
+    uint8_t header;
+    uint8_t lengthBytes;
+    size_t remaining;
+    size_t bodyLength;
+    size_t stored;
+    MqttPacket current;
+};
+
+}
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef IOTNET_NETWORK_MAILBOX_H
+#define IOTNET_NETWORK_MAILBOX_H
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+
+#include "core/BoundedQueue.h"
+#include "core/PinTable.h"
+
+namespace iotnet::core {
+
+// A pin value received by the network task, waiting for run() to store it.
+struct InboundValue {
+    int8_t pin;
+    char payload[PinTable::VALUE_SIZE];
+
+    void assign(int pinIndex, const char *text) {
+        pin = static_cast<int8_t>(pinIndex);
+        size_t length = strnlen(text, sizeof(payload) - 1);
+        memcpy(payload, text, length);
+        payload[length] = '\0';
+    }
+};
+
+using InboundQueue = BoundedQueue<InboundValue, 32>;
+
+// Set of pins that any task can add to and one task drains. Kept as two
+// 32-bit words because 64-bit atomics are not lock-free on 32-bit targets.
+class AtomicPinSet {
+  public:
+    static_assert(PinTable::CAPACITY <= 64, "pin sets are 64 bits wide");
+
+    AtomicPinSet() { clear(); }
+
+    void clear() {
+        words[0].store(0, std::memory_order_relaxed);
+        words[1].store(0, std::memory_order_relaxed);
+    }
+
+    void add(int pin) {
+        if (PinTable::isValidPin(pin)) {
+            words[pin >> 5].fetch_or(uint32_t(1) << (pin & 31), std::memory_order_release);
+        }
+    }
+
+    void addAll(uint64_t pins) {
+        words[0].fetch_or(static_cast<uint32_t>(pins), std::memory_order_release);
+        words[1].fetch_or(static_cast<uint32_t>(pins >> 32), std::memory_order_release);
+    }
+
+    // Returns every pin added since the previous call and empties the set.
+    uint64_t takeAll() {
+        uint64_t low = words[0].exchange(0, std::memory_order_acquire);
+        uint64_t high = words[1].exchange(0, std::memory_order_acquire);
+        return low | (high << 32);
+    }
+
+  private:
+    std::atomic<uint32_t> words[2];
+};
+
+}
+
+#endif
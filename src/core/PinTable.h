@@ -0,0 +1,151 @@
+#ifndef IOTNET_PIN_TABLE_H
+#define IOTNET_PIN_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace iotnet::core {
+
+inline int lowestSetBit(uint64_t mask) {
+    return __builtin_ctzll(mask);
+}
+
+// Last inbound value of every virtual pin. Topics are not stored per pin; they
+// are rebuilt on demand from the shared device prefix (see TopicRouter).
+// Initialized/updated flags are kept as bitmasks so consumers can find the
+// pins that changed without scanning the table.
+class PinTable {
+  public:
+    static constexpr int CAPACITY = 50;
+    static constexpr size_t VALUE_SIZE = 32;
+    static_assert(CAPACITY <= 64, "pin masks are 64 bits wide");
+
+    PinTable() { reset(); }
+
+    void reset() {
+        for (int i = 0; i < CAPACITY; i++) {
+            values[i][0] = '\0';
+            lengths[i] = 0;
+        }
+        initializedMask = 0;
+        dirtyMask = 0;
+    }
+
+    static bool isValidPin(int pin) { return pin >= 0 && pin < CAPACITY; }
+    static uint64_t bit(int pin) { return uint64_t(1) << pin; }
+
+    bool isInitialized(int pin) const { return (initializedMask & bit(pin)) != 0; }
+    uint64_t initializedPins() const { return initializedMask; }
+
+    void markInitialized(int pin) {
+        initializedMask |= bit(pin);
+        dirtyMask &= ~bit(pin);
+        values[pin][0] = '\0';
+        lengths[pin] = 0;
+    }
+
+    bool isUpdated(int pin) const { return (dirtyMask & bit(pin)) != 0; }
+    uint64_t updatedPins() const { return dirtyMask; }
+    void clearUpdated(int pin) { dirtyMask &= ~bit(pin); }
+    void clearUpdatedPins(uint64_t pins) { dirtyMask &= ~pins; }
+
+    // Returns false when the value is identical to the stored one, in which
+    // case the pin is not flagged as updated.
+    bool storeValue(int pin, const char *value) {
+        char *stored = values[pin];
+        if (strcmp(stored, value) == 0) {
+            return false;
+        }
+
+        size_t length = strnlen(value, VALUE_SIZE - 1);
+        memcpy(stored, value, length);
+        stored[length] = '\0';
+        lengths[pin] = static_cast<uint8_t>(length);
+        dirtyMask |= bit(pin);
+        return true;
+    }
+
+    // NUL-terminated view of the stored value, valid until the next store.
+    const char *value(int pin) const { return values[pin]; }
+    size_t valueLength(int pin) const { return lengths[pin]; }
+
+  private:
+    char values[CAPACITY][VALUE_SIZE];
+    uint8_t lengths[CAPACITY];
+    uint64_t initializedMask;
+    uint64_t dirtyMask;
+};
+
+// Callback slots grouped per pin. Slots are handed out in registration order
+// and chained per pin, so several callbacks can share one pin and dispatch
+// only visits pins that are both dirty and watched.
+class PinCallbackIndex {
+  public:
+    static constexpr int CAPACITY = PinTable::CAPACITY;
+    static constexpr int NONE = -1;
+
+    PinCallbackIndex() { reset(); }
+
+    void reset() {
+        for (int i = 0; i < CAPACITY; i++) {
+            heads[i] = NONE;
+            tails[i] = NONE;
+            nextSlots[i] = NONE;
+        }
+        count = 0;
+        watchedMask = 0;
+    }
+
+    // Returns the new slot, or NONE when the pin is invalid or all slots are used.
+    int add(int pin) {
+        if (!PinTable::isValidPin(pin) || count >= CAPACITY) {
+            return NONE;
+        }
+
+        int slot = count++;
+        if (tails[pin] == NONE) {
+            heads[pin] = static_cast<int8_t>(slot);
+        } else {
+            nextSlots[tails[pin]] = static_cast<int8_t>(slot);
+        }
+        tails[pin] = static_cast<int8_t>(slot);
+        watchedMask |= PinTable::bit(pin);
+        return slot;
+    }
+
+    int size() const { return count; }
+    uint64_t watchedPins() const { return watchedMask; }
+    int first(int pin) const { return heads[pin]; }
+    int next(int slot) const { return nextSlots[slot]; }
+
+    // Calls visit(slot, pin) for every callback of every updated, watched pin.
+    // Those pins are marked consumed before the first call; unwatched pins keep
+    // their flag for hasNewValue()/virtualRead(). Returns the number of calls.
+    template <typename Visitor> int dispatch(PinTable &table, Visitor &&visit) const {
+        uint64_t pending = table.updatedPins() & watchedMask;
+        table.clearUpdatedPins(pending);
+
+        int calls = 0;
+        while (pending != 0) {
+            int pin = lowestSetBit(pending);
+            pending &= pending - 1;
+            for (int slot = heads[pin]; slot != NONE; slot = nextSlots[slot]) {
+                visit(slot, pin);
+                calls++;
+            }
+        }
+        return calls;
+    }
+
+  private:
+    int8_t heads[CAPACITY];
+    int8_t tails[CAPACITY];
+    int8_t nextSlots[CAPACITY];
+    int count;
+    uint64_t watchedMask;
+};
+
+}
+
+#endif
@@ -0,0 +1,143 @@
+#include "core/PublishGate.h"
+
+#include <math.h>
+
+namespace iotnet::core {
+
+namespace {
+
+constexpr int8_t NO_SLOT = -1;
+constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+}
+
+PublishSample numericSample(double value) {
+    return PublishSample{true, value, 0};
+}
+
+PublishSample textSample(const char *text, size_t length) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= static_cast<uint8_t>(text[i]);
+        hash *= FNV_PRIME;
+    }
+    return PublishSample{false, 0.0, hash};
+}
+
+PublishGate::PublishGate() {
+    reset();
+}
+
+void PublishGate::reset() {
+    for (int i = 0; i < PIN_CAPACITY; i++) {
+        slotOfPin[i] = NO_SLOT;
+    }
+    for (int i = 0; i < POLICY_CAPACITY; i++) {
+        slots[i].hasLast = false;
+        slots[i].lastSentMs = 0;
+    }
+    usedSlots = 0;
+    policyMask = 0;
+    sentCount.store(0, std::memory_order_relaxed);
+    suppressedCount.store(0, std::memory_order_relaxed);
+}
+
+bool PublishGate::setPolicy(int pin, const PublishPolicy &policy) {
+    if (!PinTable::isValidPin(pin)) {
+        return false;
+    }
+
+    int slot = slotOfPin[pin];
+    if (slot == NO_SLOT) {
+        uint32_t freeSlots = ~usedSlots & ((uint32_t(1) << POLICY_CAPACITY) - 1);
+        if (freeSlots == 0) {
+            return false;
+        }
+        slot = __builtin_ctz(freeSlots);
+        usedSlots |= uint32_t(1) << slot;
+        slotOfPin[pin] = static_cast<int8_t>(slot);
+        slots[slot].hasLast = false;
+    }
+
+    slots[slot].policy = policy;
+    policyMask |= PinTable::bit(pin);
+    return true;
+}
+
+void PublishGate::clearPolicy(int pin) {
+    if (!PinTable::isValidPin(pin)) {
+        return;
+    }
+    if (slotOfPin[pin] != NO_SLOT) {
+        usedSlots &= ~(uint32_t(1) << slotOfPin[pin]);
+    }
+    slotOfPin[pin] = NO_SLOT;
+    policyMask &= ~PinTable::bit(pin);
+}
+
+bool PublishGate::isUnchanged(const Slot &slot, const PublishSample &sample) const {
+    if (!slot.hasLast || slot.last.numeric != sample.numeric) {
+        return false;
+    }
+    if (!sample.numeric) {
+        return slot.last.textHash == sample.textHash;
+    }
+
+    double threshold = slot.policy.absoluteDeadband;
+    double relative = slot.policy.relativeDeadband * fabs(slot.last.number);
+    if (relative > threshold) {
+        threshold = relative;
+    }
+    return fabs(sample.number - slot.last.number) <= threshold;
+}
+
+bool PublishGate::admit(int pin, const PublishSample &sample, uint32_t nowMs) {
+    if (!hasPolicy(pin)) {
+        return true;
+    }
+
+    const Slot &slot = slots[slotOfPin[pin]];
+    if (slot.hasLast) {
+        uint32_t elapsed = nowMs - slot.lastSentMs;
+        bool tooSoon = elapsed < slot.policy.minIntervalMs;
+        bool heartbeatDue = slot.policy.heartbeatMs != 0 && elapsed >= slot.policy.heartbeatMs;
+        if (tooSoon || (!heartbeatDue && isUnchanged(slot, sample))) {
+            suppressedCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+    return true;
+}
+
+void PublishGate::recordSent(int pin, const PublishSample &sample, uint32_t nowMs) {
+    countSent();
+    remember(pin, sample, nowMs);
+}
+
+bool PublishGate::claim(int pin, const PublishSample &sample, uint32_t nowMs) {
+    if (!admit(pin, sample, nowMs)) {
+        return false;
+    }
+    remember(pin, sample, nowMs);
+    return true;
+}
+
+void PublishGate::forget(int pin) {
+    if (hasPolicy(pin)) {
+        slots[slotOfPin[pin]].hasLast = false;
+    }
+}
+
+void PublishGate::remember(int pin, const PublishSample &sample, uint32_t nowMs) {
+    if (!hasPolicy(pin)) {
+        return;
+    }
+
+    Slot &slot = slots[slotOfPin[pin]];
+    slot.last = sample;
+    slot.lastSentMs = nowMs;
+    slot.hasLast = true;
+}
+
+}
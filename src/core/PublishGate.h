@@ -0,0 +1,101 @@
+#ifndef IOTNET_PUBLISH_GATE_H
+#define IOTNET_PUBLISH_GATE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/PinTable.h"
+
+namespace iotnet::core {
+
+// Rules applied to outbound writes of one pin. A value is "unchanged" when it
+// is within max(absoluteDeadband, relativeDeadband * |last sent|) of the last
+// published number (exact equality when both are zero), or identical to the
+// last published text.
+struct PublishPolicy {
+    double absoluteDeadband = 0.0;
+    double relativeDeadband = 0.0;
+    // Writes closer than this to the previous publish are dropped, changed or not.
+    uint32_t minIntervalMs = 0;
+    // An unchanged value is still published once this much time has passed
+    // since the previous publish (0 disables). Checked on the next write.
+    uint32_t heartbeatMs = 0;
+};
+
+// Comparable form of an outbound value: numbers are kept as is, text as a
+// 64-bit FNV-1a hash so no per-pin copy of the last payload is needed.
+struct PublishSample {
+    bool numeric;
+    double number;
+    uint64_t textHash;
+};
+
+PublishSample numericSample(double value);
+PublishSample textSample(const char *text, size_t length);
+
+struct PublishStats {
+    uint32_t sent;
+    uint32_t suppressed;
+};
+
+// Decides which writes reach the broker. Pins without a policy always pass
+// after a single mask test; policies live in a few shared slots so unused
+// pins cost one byte each.
+class PublishGate {
+  public:
+    static constexpr int PIN_CAPACITY = PinTable::CAPACITY;
+    static constexpr int POLICY_CAPACITY = 16;
+    static_assert(POLICY_CAPACITY < 32, "free slots are tracked in a 32-bit mask");
+
+    PublishGate();
+
+    void reset();
+
+    // Returns false when the pin is invalid or every policy slot is taken.
+    bool setPolicy(int pin, const PublishPolicy &policy);
+    void clearPolicy(int pin);
+    bool hasPolicy(int pin) const { return (policyMask & PinTable::bit(pin)) != 0; }
+
+    // True when the write should be published; otherwise it is counted as
+    // suppressed. Call recordSent() once the publish actually succeeded.
+    bool admit(int pin, const PublishSample &sample, uint32_t nowMs);
+    void recordSent(int pin, const PublishSample &sample, uint32_t nowMs);
+
+    // admit() for writes that are queued before they are published: an
+    // admitted value becomes the one later writes are compared with right
+    // away. Count the publish with countSent(); if it never happens,
+    // forget() lets the next write through.
+    bool claim(int pin, const PublishSample &sample, uint32_t nowMs);
+    void countSent() { sentCount.fetch_add(1, std::memory_order_relaxed); }
+    void forget(int pin);
+
+    // The counters are atomic, so the queue drain may count publishes while
+    // other tasks write.
+    PublishStats stats() const {
+        return PublishStats{sentCount.load(std::memory_order_relaxed),
+                            suppressedCount.load(std::memory_order_relaxed)};
+    }
+
+  private:
+    struct Slot {
+        PublishPolicy policy;
+        PublishSample last;
+        uint32_t lastSentMs;
+        bool hasLast;
+    };
+
+    bool isUnchanged(const Slot &slot, const PublishSample &sample) const;
+    void remember(int pin, const PublishSample &sample, uint32_t nowMs);
+
+    Slot slots[POLICY_CAPACITY];
+    int8_t slotOfPin[PIN_CAPACITY];
+    uint32_t usedSlots;
+    uint64_t policyMask;
+    std::atomic<uint32_t> sentCount;
+    std::atomic<uint32_t> suppressedCount;
+};
+
+}
+
+#endif
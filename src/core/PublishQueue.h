@@ -0,0 +1,112 @@
+#ifndef IOTNET_PUBLISH_QUEUE_H
+#define IOTNET_PUBLISH_QUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/BoundedQueue.h"
+#include "core/PinTable.h"
+#include "core/PublishGate.h"
+
+namespace iotnet::core {
+
+// A formatted pin write waiting to be published.
+struct OutboundValue {
+    PublishSample sample;
+    int8_t pin;
+    uint8_t length;
+    char payload[PinTable::VALUE_SIZE];
+};
+
+enum class OverflowPolicy {
+    DropNewest,
+    DropOldest,
+    Block
+};
+
+struct PublishQueueStats {
+    uint32_t enqueued;
+    uint32_t sent;
+    uint32_t dropped;
+};
+
+// Outbound pin writes on a BoundedQueue, plus the overflow policy and the
+// counters the facade reports. Blocking on a full queue is left to the
+// caller, which owns the clock.
+class PublishQueue {
+  public:
+    static constexpr uint32_t CAPACITY = 32;
+
+    PublishQueue() { reset(); }
+
+    // Not thread-safe; only call while no task is using the queue.
+    void reset() {
+        ring.reset();
+        enqueuedCount.store(0, std::memory_order_relaxed);
+        sentCount.store(0, std::memory_order_relaxed);
+        droppedCount.store(0, std::memory_order_relaxed);
+    }
+
+    // Returns false when the queue is full; the value is not counted as dropped
+    // so the caller can retry.
+    bool tryPush(const OutboundValue &value) {
+        if (!ring.tryPush(value)) {
+            return false;
+        }
+        enqueuedCount.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool tryPop(OutboundValue &out) { return ring.tryPop(out); }
+
+    // Applies DropNewest or DropOldest; Block behaves like DropNewest here.
+    // outEvictedPins, when given, receives the PinTable::bit() mask of the
+    // pins whose queued values DropOldest discarded.
+    bool push(const OutboundValue &value, OverflowPolicy policy,
+              uint64_t *outEvictedPins = nullptr) {
+        if (outEvictedPins) {
+            *outEvictedPins = 0;
+        }
+        if (tryPush(value)) {
+            return true;
+        }
+        if (policy == OverflowPolicy::DropOldest) {
+            uint32_t evicted = 0;
+            bool pushed = ring.pushEvictingOldest(
+                value, &evicted, outEvictedPins ? notePin : nullptr, outEvictedPins);
+            droppedCount.fetch_add(evicted, std::memory_order_relaxed);
+            if (pushed) {
+                enqueuedCount.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        recordDropped();
+        return false;
+    }
+
+    void recordSent() { sentCount.fetch_add(1, std::memory_order_relaxed); }
+    void recordDropped() { droppedCount.fetch_add(1, std::memory_order_relaxed); }
+
+    PublishQueueStats stats() const {
+        return PublishQueueStats{
+            enqueuedCount.load(std::memory_order_relaxed),
+            sentCount.load(std::memory_order_relaxed),
+            droppedCount.load(std::memory_order_relaxed),
+        };
+    }
+
+  private:
+    static void notePin(const OutboundValue &value, void *context) {
+        *static_cast<uint64_t *>(context) |= PinTable::bit(value.pin);
+    }
+
+    BoundedQueue<OutboundValue, CAPACITY> ring;
+    std::atomic<uint32_t> enqueuedCount;
+    std::atomic<uint32_t> sentCount;
+    std::atomic<uint32_t> droppedCount;
+};
+
+}
+
+#endif
@@ -0,0 +1,88 @@
+#include "core/ResumeSnapshot.h"
+
+#include <string.h>
+
+#include "core/Crc32.h"
+
+namespace iotnet::core {
+
+namespace {
+
+// Everything after the crc field.
+uint32_t snapshotCrc(const ResumeSnapshot &snapshot) {
+    const uint8_t *start = reinterpret_cast<const uint8_t *>(&snapshot.identity);
+    const uint8_t *end = reinterpret_cast<const uint8_t *>(&snapshot + 1);
+    return crc32(start, static_cast<size_t>(end - start));
+}
+
+uint32_t appendText(uint32_t crc, const char *text) {
+    // The terminator keeps ("ab", "c") and ("a", "bc") apart.
+    return text ? crc32(text, strlen(text) + 1, crc) : crc32("", 1, crc);
+}
+
+}
+
+void ResumeSnapshot::clear() {
+    memset(this, 0, sizeof(*this));
+}
+
+void ResumeSnapshot::capture(const PinTable &table, const uint8_t *pinPrecision,
+                             uint64_t subscribed) {
+    initializedPins = table.initializedPins();
+    updatedPins = table.updatedPins();
+    subscribedPins = subscribed;
+    memcpy(precision, pinPrecision, sizeof(precision));
+    memset(lengths, 0, sizeof(lengths));
+    memset(values, 0, sizeof(values));
+
+    uint64_t pins = initializedPins;
+    while (pins != 0) {
+        int pin = lowestSetBit(pins);
+        pins &= pins - 1;
+        lengths[pin] = static_cast<uint8_t>(table.valueLength(pin));
+        memcpy(values[pin], table.value(pin), lengths[pin]);
+    }
+}
+
+void ResumeSnapshot::restore(PinTable &table, uint8_t *pinPrecision) const {
+    table.reset();
+    memcpy(pinPrecision, precision, sizeof(precision));
+
+    uint64_t pins = initializedPins;
+    while (pins != 0) {
+        int pin = lowestSetBit(pins);
+        pins &= pins - 1;
+        table.markInitialized(pin);
+
+        char value[PinTable::VALUE_SIZE];
+        size_t length = lengths[pin] < PinTable::VALUE_SIZE ? lengths[pin] : 0;
+        memcpy(value, values[pin], length);
+        value[length] = '\0';
+        table.storeValue(pin, value);
+    }
+    table.clearUpdatedPins(~updatedPins);
+}
+
+void ResumeSnapshot::seal(uint32_t ownerIdentity) {
+    magic = MAGIC;
+    version = VERSION;
+    size = static_cast<uint16_t>(sizeof(ResumeSnapshot));
+    identity = ownerIdentity;
+    crc = snapshotCrc(*this);
+}
+
+bool ResumeSnapshot::isValid(uint32_t ownerIdentity) const {
+    return magic == MAGIC && version == VERSION && size == sizeof(ResumeSnapshot) &&
+           identity == ownerIdentity && crc == snapshotCrc(*this);
+}
+
+uint32_t resumeIdentity(const char *user, const char *board, const char *server, int port,
+                        const char *firmwareVersion) {
+    uint32_t crc = appendText(0, user);
+    crc = appendText(crc, board);
+    crc = appendText(crc, server);
+    crc = crc32(&port, sizeof(port), crc);
+    return appendText(crc, firmwareVersion);
+}
+
+}
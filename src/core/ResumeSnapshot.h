@@ -0,0 +1,56 @@
+#ifndef IOTNET_RESUME_SNAPSHOT_H
+#define IOTNET_RESUME_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/PinTable.h"
+
+namespace iotnet::core {
+
+// Client state carried across deep sleep in RTC memory. Plain data: the magic,
+// version, size and CRC reject garbage after power-up or a layout change, and
+// the identity ties it to one account, board, broker and firmware version.
+struct ResumeSnapshot {
+    static constexpr uint32_t MAGIC = 0x53524e49; // "INRS"
+    static constexpr uint16_t VERSION = 1;
+
+    enum Flags : uint32_t {
+        // Registration was published during this firmware version.
+        BoardRegistered = 1u << 0,
+        // The connection was closed with DISCONNECT, so the last will never
+        // fired and the retained "online" status is still current.
+        OnlineRetained = 1u << 1,
+        // The broker's stored session holds the device wildcard filter.
+        WildcardSession = 1u << 2,
+    };
+
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    uint32_t crc;
+    uint32_t identity;
+    uint32_t flags;
+    uint32_t brokerAddress;
+    uint64_t initializedPins;
+    uint64_t updatedPins;
+    uint64_t subscribedPins;
+    uint8_t precision[PinTable::CAPACITY];
+    uint8_t lengths[PinTable::CAPACITY];
+    char values[PinTable::CAPACITY][PinTable::VALUE_SIZE];
+
+    void clear();
+    void capture(const PinTable &table, const uint8_t *pinPrecision, uint64_t subscribed);
+    // Rebuilds the table exactly as captured, including pending updates.
+    void restore(PinTable &table, uint8_t *pinPrecision) const;
+    void seal(uint32_t ownerIdentity);
+    bool isValid(uint32_t ownerIdentity) const;
+};
+
+// Identity of the running configuration; any null argument counts as empty.
+uint32_t resumeIdentity(const char *user, const char *board, const char *server, int port,
+                        const char *firmwareVersion);
+
+}
+
+#endif
@@ -0,0 +1,213 @@
+#include "core/Sha256.h"
+
+#include <string.h>
+
+#ifdef ARDUINO
+#include <mbedtls/version.h>
+#endif
+
+namespace iotnet::core {
+
+namespace {
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+#ifndef ARDUINO
+
+constexpr uint32_t ROUND_CONSTANTS[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4,
+    0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe,
+    0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f,
+    0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+    0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116,
+    0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7,
+    0xc67178f2,
+};
+
+constexpr uint32_t INITIAL_STATE[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+uint32_t rotateRight(uint32_t value, int bits) {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+#endif
+
+}
+
+#ifdef ARDUINO
+
+// mbedtls 3 dropped the _ret suffix that 2.x uses for the checked calls.
+#if MBEDTLS_VERSION_MAJOR >= 3
+#define IOTNET_SHA256_STARTS mbedtls_sha256_starts
+#define IOTNET_SHA256_UPDATE mbedtls_sha256_update
+#define IOTNET_SHA256_FINISH mbedtls_sha256_finish
+#else
+#define IOTNET_SHA256_STARTS mbedtls_sha256_starts_ret
+#define IOTNET_SHA256_UPDATE mbedtls_sha256_update_ret
+#define IOTNET_SHA256_FINISH mbedtls_sha256_finish_ret
+#endif
+
+Sha256::Sha256() : total(0) {
+    mbedtls_sha256_init(&context);
+    IOTNET_SHA256_STARTS(&context, 0);
+}
+
+Sha256::~Sha256() {
+    mbedtls_sha256_free(&context);
+}
+
+void Sha256::reset() {
+    // Freeing releases the accelerator if this context held it.
+    mbedtls_sha256_free(&context);
+    mbedtls_sha256_init(&context);
+    IOTNET_SHA256_STARTS(&context, 0);
+    total = 0;
+}
+
+void Sha256::update(const void *data, size_t length) {
+    IOTNET_SHA256_UPDATE(&context, static_cast<const unsigned char *>(data), length);
+    total += length;
+}
+
+void Sha256::finish(uint8_t *outDigest) {
+    IOTNET_SHA256_FINISH(&context, outDigest);
+}
+
+#else
+
+Sha256::Sha256() {
+    reset();
+}
+
+Sha256::~Sha256() = default;
+
+void Sha256::reset() {
+    memcpy(state, INITIAL_STATE, sizeof(state));
+    buffered = 0;
+    total = 0;
+}
+
+void Sha256::update(const void *data, size_t length) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    total += length;
+    if (buffered > 0) {
+        size_t take = sizeof(buffer) - buffered < length ? sizeof(buffer) - buffered : length;
+        memcpy(buffer + buffered, bytes, take);
+        buffered += take;
+        bytes += take;
+        length -= take;
+        if (buffered < sizeof(buffer)) {
+            return;
+        }
+        compress(buffer);
+        buffered = 0;
+    }
+    for (; length >= sizeof(buffer); bytes += sizeof(buffer), length -= sizeof(buffer)) {
+        compress(bytes);
+    }
+    memcpy(buffer, bytes, length);
+    buffered = length;
+}
+
+void Sha256::finish(uint8_t *outDigest) {
+    uint64_t bits = static_cast<uint64_t>(total) * 8;
+    buffer[buffered++] = 0x80;
+    if (buffered > sizeof(buffer) - 8) {
+        memset(buffer + buffered, 0, sizeof(buffer) - buffered);
+        compress(buffer);
+        buffered = 0;
+    }
+    memset(buffer + buffered, 0, sizeof(buffer) - 8 - buffered);
+    for (int i = 0; i < 8; i++) {
+        buffer[sizeof(buffer) - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+    compress(buffer);
+    buffered = 0;
+
+    for (int i = 0; i < 8; i++) {
+        outDigest[4 * i] = static_cast<uint8_t>(state[i] >> 24);
+        outDigest[4 * i + 1] = static_cast<uint8_t>(state[i] >> 16);
+        outDigest[4 * i + 2] = static_cast<uint8_t>(state[i] >> 8);
+        outDigest[4 * i + 3] = static_cast<uint8_t>(state[i]);
+    }
+}
+
+void Sha256::compress(const uint8_t *block) {
+    uint32_t schedule[64];
+    for (int i = 0; i < 16; i++) {
+        schedule[i] = static_cast<uint32_t>(block[4 * i]) << 24 |
+                      static_cast<uint32_t>(block[4 * i + 1]) << 16 |
+                      static_cast<uint32_t>(block[4 * i + 2]) << 8 |
+                      static_cast<uint32_t>(block[4 * i + 3]);
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotateRight(schedule[i - 15], 7) ^ rotateRight(schedule[i - 15], 18) ^
+                      (schedule[i - 15] >> 3);
+        uint32_t s1 = rotateRight(schedule[i - 2], 17) ^ rotateRight(schedule[i - 2], 19) ^
+                      (schedule[i - 2] >> 10);
+        schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+        uint32_t choice = (e & f) ^ (~e & g);
+        uint32_t t1 = h + s1 + choice + ROUND_CONSTANTS[i] + schedule[i];
+        uint32_t s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+        uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + majority;
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+#endif
+
+bool parseSha256Hex(const char *hex, uint8_t *outDigest) {
+    if (!hex || !outDigest || strlen(hex) != Sha256::HEX_SIZE) {
+        return false;
+    }
+    for (size_t i = 0; i < Sha256::DIGEST_SIZE; i++) {
+        int high = hexValue(hex[2 * i]);
+        int low = hexValue(hex[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        outDigest[i] = static_cast<uint8_t>(high << 4 | low);
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,51 @@
+#ifndef IOTNET_SHA256_H
+#define IOTNET_SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ARDUINO
+#include <mbedtls/sha256.h>
+#endif
+
+namespace iotnet::core {
+
+// Incremental SHA-256 (FIPS 180-4). On the device this goes through mbedtls,
+// which uses the ESP32's SHA accelerator when it is free; the host build
+// computes it in software.
+class Sha256 {
+  public:
+    static constexpr size_t DIGEST_SIZE = 32;
+    static constexpr size_t HEX_SIZE = 2 * DIGEST_SIZE;
+
+    Sha256();
+    ~Sha256();
+    Sha256(const Sha256 &) = delete;
+    Sha256 &operator=(const Sha256 &) = delete;
+
+    void reset();
+    void update(const void *data, size_t length);
+    // Writes DIGEST_SIZE bytes; reset() before hashing anything else.
+    void finish(uint8_t *outDigest);
+
+    size_t length() const { return total; }
+
+  private:
+    size_t total;
+#ifdef ARDUINO
+    mbedtls_sha256_context context;
+#else
+    void compress(const uint8_t *block);
+
+    uint32_t state[8];
+    uint8_t buffer[64];
+    size_t buffered;
+#endif
+};
+
+// Decodes exactly HEX_SIZE hex digits, either case, into DIGEST_SIZE bytes.
+bool parseSha256Hex(const char *hex, uint8_t *outDigest);
+
+}
+
+#endif
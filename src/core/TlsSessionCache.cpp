@@ -0,0 +1,72 @@
+#include "core/TlsSessionCache.h"
+
+#include <string.h>
+
+#include "core/Crc32.h"
+
+namespace iotnet::core {
+
+namespace {
+
+uint32_t sessionCrc(const TlsSessionRecord &record) {
+    uint32_t crc = crc32(&record.endpoint, sizeof(record.endpoint));
+    return crc32(record.data, record.length, crc);
+}
+
+}
+
+void TlsSessionRecord::clear() {
+    magic = 0;
+    version = 0;
+    length = 0;
+    endpoint = 0;
+    crc = 0;
+}
+
+bool TlsSessionRecord::seal(uint32_t endpointHash, size_t sessionLength) {
+    if (sessionLength == 0 || sessionLength > CAPACITY) {
+        clear();
+        return false;
+    }
+    magic = MAGIC;
+    version = VERSION;
+    length = static_cast<uint16_t>(sessionLength);
+    endpoint = endpointHash;
+    crc = sessionCrc(*this);
+    return true;
+}
+
+size_t TlsSessionRecord::validLength(uint32_t endpointHash) const {
+    if (magic != MAGIC || version != VERSION || endpoint != endpointHash || length == 0 ||
+        length > CAPACITY) {
+        return 0;
+    }
+    return sessionCrc(*this) == crc ? length : 0;
+}
+
+uint32_t tlsEndpointHash(const char *host, uint16_t port) {
+    uint32_t crc = host ? crc32(host, strlen(host)) : 0;
+    return crc32(&port, sizeof(port), crc);
+}
+
+void TlsHandshakeStats::record(bool resumed, uint32_t elapsedMs) {
+    if (resumed) {
+        resumedHandshakes++;
+        lastResumedMs = elapsedMs;
+        totalResumedMs += elapsedMs;
+    } else {
+        fullHandshakes++;
+        lastFullMs = elapsedMs;
+        totalFullMs += elapsedMs;
+    }
+}
+
+uint32_t TlsHandshakeStats::averageFullMs() const {
+    return fullHandshakes ? totalFullMs / fullHandshakes : 0;
+}
+
+uint32_t TlsHandshakeStats::averageResumedMs() const {
+    return resumedHandshakes ? totalResumedMs / resumedHandshakes : 0;
+}
+
+}
@@ -0,0 +1,53 @@
+#ifndef IOTNET_TLS_SESSION_CACHE_H
+#define IOTNET_TLS_SESSION_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace iotnet::core {
+
+// A serialized TLS session (ticket or session ID, as written by
+// mbedtls_ssl_session_save) for one broker endpoint. Plain data so it can be
+// placed in RTC memory: after deep sleep or a reset the magic, endpoint and
+// CRC decide whether the bytes can still be trusted.
+struct TlsSessionRecord {
+    // Room for a ticket plus the peer certificate mbedTLS keeps by default.
+    static constexpr size_t CAPACITY = 2048;
+    static constexpr uint32_t MAGIC = 0x534c5449; // "ITLS"
+    static constexpr uint16_t VERSION = 1;
+
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length;
+    uint32_t endpoint;
+    uint32_t crc;
+    uint8_t data[CAPACITY];
+
+    void clear();
+    // Marks the first `sessionLength` bytes of data as the session for
+    // `endpointHash`. Returns false (and clears) when the length is invalid.
+    bool seal(uint32_t endpointHash, size_t sessionLength);
+    // Length of the stored session when it is intact and belongs to
+    // `endpointHash`, otherwise 0.
+    size_t validLength(uint32_t endpointHash) const;
+};
+
+uint32_t tlsEndpointHash(const char *host, uint16_t port);
+
+// Handshake timings, split by whether the server accepted the cached session.
+struct TlsHandshakeStats {
+    uint32_t fullHandshakes = 0;
+    uint32_t resumedHandshakes = 0;
+    uint32_t lastFullMs = 0;
+    uint32_t lastResumedMs = 0;
+    uint32_t totalFullMs = 0;
+    uint32_t totalResumedMs = 0;
+
+    void record(bool resumed, uint32_t elapsedMs);
+    uint32_t averageFullMs() const;
+    uint32_t averageResumedMs() const;
+};
+
+}
+
+#endif
@@ -0,0 +1,39 @@
+#include "core/TopicAliasTable.h"
+
+#include <string.h>
+
+namespace iotnet::core {
+
+TopicAliasTable::TopicAliasTable() {
+    reset(0);
+}
+
+void TopicAliasTable::reset(uint16_t brokerMaximum) {
+    maximum = brokerMaximum < CAPACITY ? brokerMaximum : CAPACITY;
+    assigned = 0;
+    memset(aliases, 0, sizeof(aliases));
+    establishedKeys = 0;
+}
+
+uint16_t TopicAliasTable::aliasFor(int key, bool &established) {
+    established = false;
+    if (key < 0 || key >= CAPACITY) {
+        return 0;
+    }
+    if (aliases[key] == 0) {
+        if (assigned >= maximum) {
+            return 0;
+        }
+        aliases[key] = static_cast<uint8_t>(++assigned);
+    }
+    established = (establishedKeys & (1ULL << key)) != 0;
+    return aliases[key];
+}
+
+void TopicAliasTable::markEstablished(int key) {
+    if (key >= 0 && key < CAPACITY && aliases[key] != 0) {
+        establishedKeys |= 1ULL << key;
+    }
+}
+
+}
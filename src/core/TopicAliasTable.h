@@ -0,0 +1,41 @@
+#ifndef IOTNET_TOPIC_ALIAS_TABLE_H
+#define IOTNET_TOPIC_ALIAS_TABLE_H
+
+#include <stdint.h>
+
+namespace iotnet::core {
+
+// MQTT 5 topic aliases for the outbound topics of one connection, keyed by a
+// small caller-chosen number such as the pin. The first publish on a key
+// carries the full topic together with its alias; once that went out, later
+// publishes send only the 2-byte alias. Aliases are handed out first come,
+// first served up to the broker's Topic Alias Maximum; keys past it keep
+// sending full topics.
+class TopicAliasTable {
+  public:
+    static constexpr int CAPACITY = 64;
+
+    TopicAliasTable();
+
+    // Call with the CONNACK's Topic Alias Maximum on every new connection
+    // (0 for 3.1.1 or a broker without aliases); aliases never outlive one.
+    void reset(uint16_t brokerMaximum);
+
+    // Returns the key's alias, assigning one if possible, or 0 when it has
+    // none. `established` tells whether the broker already maps the alias.
+    uint16_t aliasFor(int key, bool &established);
+    // The publish that introduced the key's alias was sent.
+    void markEstablished(int key);
+
+    uint16_t assignedCount() const { return assigned; }
+
+  private:
+    uint16_t maximum;
+    uint16_t assigned;
+    uint8_t aliases[CAPACITY];
+    uint64_t establishedKeys;
+};
+
+}
+
+#endif
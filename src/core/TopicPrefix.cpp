@@ -0,0 +1,80 @@
+#include "core/TopicPrefix.h"
+
+#include "core/ValueCodec.h"
+
+namespace iotnet::core {
+
+namespace {
+
+constexpr char ROOT[] = "devices/";
+constexpr size_t ROOT_LENGTH = sizeof(ROOT) - 1;
+
+}
+
+TopicPrefix::TopicPrefix() : prefixLength(0) {
+    prefix[0] = '\0';
+}
+
+bool TopicPrefix::configure(const char *deviceId, const char *boardIdentifier) {
+    reset();
+    if (!deviceId || !boardIdentifier) {
+        return false;
+    }
+
+    size_t deviceLength = strlen(deviceId);
+    size_t boardLength = strlen(boardIdentifier);
+    size_t length = ROOT_LENGTH + deviceLength + 1 + boardLength + 1;
+    if (length > MAX_LENGTH) {
+        return false;
+    }
+
+    char *cursor = prefix;
+    memcpy(cursor, ROOT, ROOT_LENGTH);
+    cursor += ROOT_LENGTH;
+    memcpy(cursor, deviceId, deviceLength);
+    cursor += deviceLength;
+    *cursor++ = '/';
+    memcpy(cursor, boardIdentifier, boardLength);
+    cursor += boardLength;
+    *cursor++ = '/';
+    *cursor = '\0';
+    prefixLength = length;
+    return true;
+}
+
+void TopicPrefix::reset() {
+    prefixLength = 0;
+    prefix[0] = '\0';
+}
+
+bool TopicPrefix::buildTopic(const char *channel, size_t channelLength, char *outTopic,
+                             size_t outSize) const {
+    if (!channel || !outTopic || prefixLength == 0 || prefixLength + channelLength >= outSize) {
+        return false;
+    }
+
+    memcpy(outTopic, prefix, prefixLength);
+    memcpy(outTopic + prefixLength, channel, channelLength);
+    outTopic[prefixLength + channelLength] = '\0';
+    return true;
+}
+
+bool TopicPrefix::buildPinTopic(int pin, char *outTopic, size_t outSize) const {
+    if (!outTopic || prefixLength == 0 || pin < 0 || pin > MAX_PIN ||
+        prefixLength + 2 >= outSize) {
+        return false;
+    }
+
+    memcpy(outTopic, prefix, prefixLength);
+    outTopic[prefixLength] = 'V';
+    // formatUnsigned() NUL-terminates, or leaves an empty string and returns
+    // 0 when the digits do not fit.
+    return formatUnsigned(static_cast<unsigned>(pin), outTopic + prefixLength + 1,
+                          outSize - prefixLength - 1) > 0;
+}
+
+bool TopicPrefix::buildWildcardFilter(char *outFilter, size_t outSize) const {
+    return buildTopic("#", 1, outFilter, outSize);
+}
+
+}
@@ -0,0 +1,64 @@
+#ifndef IOTNET_TOPIC_PREFIX_H
+#define IOTNET_TOPIC_PREFIX_H
+
+#include <stddef.h>
+#include <string.h>
+
+namespace iotnet::core {
+
+// "devices/<deviceId>/<boardIdentifier>/", formatted once when credentials are
+// applied. Topics are then the prefix plus a channel or "V<pin>", appended
+// with memcpy and the ValueCodec integer writer instead of snprintf.
+//
+// The prefix length is capped at MAX_LENGTH, so for a channel known at
+// compile time the array overloads can check with static_assert that every
+// topic fits the buffer; at run time they only fail while unconfigured.
+class TopicPrefix {
+  public:
+    // The same bound OTA topics had: "ota/session/response" still fits a
+    // 120-byte topic buffer.
+    static constexpr size_t MAX_LENGTH = 99;
+    static constexpr int MAX_PIN_DIGITS = 3;
+    static constexpr int MAX_PIN = 999;
+    static constexpr size_t MAX_PIN_TOPIC_LENGTH = MAX_LENGTH + 1 + MAX_PIN_DIGITS;
+
+    TopicPrefix();
+
+    bool configure(const char *deviceId, const char *boardIdentifier);
+    void reset();
+    bool isConfigured() const { return prefixLength > 0; }
+    const char *data() const { return prefix; }
+    size_t length() const { return prefixLength; }
+    bool matches(const char *topic, size_t topicLength) const {
+        return prefixLength > 0 && topicLength > prefixLength &&
+               memcmp(topic, prefix, prefixLength) == 0;
+    }
+
+    // Writes "<prefix><channel>".
+    bool buildTopic(const char *channel, size_t channelLength, char *outTopic,
+                    size_t outSize) const;
+    // Writes "<prefix>V<pin>" for pins 0 to MAX_PIN.
+    bool buildPinTopic(int pin, char *outTopic, size_t outSize) const;
+    // Writes "<prefix>#", one filter covering every pin and channel.
+    bool buildWildcardFilter(char *outFilter, size_t outSize) const;
+
+    template <size_t ChannelSize, size_t TopicSize>
+    bool buildTopic(const char (&channel)[ChannelSize], char (&outTopic)[TopicSize]) const {
+        static_assert(MAX_LENGTH + ChannelSize <= TopicSize,
+                      "topic buffer too small for this channel");
+        return buildTopic(channel, strlen(channel), outTopic, TopicSize);
+    }
+
+    template <size_t TopicSize> bool buildPinTopic(int pin, char (&outTopic)[TopicSize]) const {
+        static_assert(MAX_PIN_TOPIC_LENGTH < TopicSize, "topic buffer too small for pin topics");
+        return buildPinTopic(pin, outTopic, TopicSize);
+    }
+
+  private:
+    char prefix[MAX_LENGTH + 1];
+    size_t prefixLength;
+};
+
+}
+
+#endif
@@ -0,0 +1,75 @@
+#include "core/TopicRouter.h"
+
+#include <string.h>
+
+namespace iotnet::core {
+
+namespace {
+
+constexpr TopicRoute UNKNOWN_ROUTE = {TopicKind::Unknown, -1};
+
+bool decodePinChannel(const char *channel, size_t length, int *outPin) {
+    if (length < 2 || length > 1 + TopicRouter::MAX_PIN_DIGITS || channel[0] != 'V') {
+        return false;
+    }
+
+    // Pin topics are built with "V%d", so "V07" never names a subscribed pin.
+    if (channel[1] == '0' && length > 2) {
+        return false;
+    }
+
+    int pin = 0;
+    for (size_t i = 1; i < length; i++) {
+        char c = channel[i];
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        pin = pin * 10 + (c - '0');
+    }
+
+    *outPin = pin;
+    return true;
+}
+
+// The fixed OTA channels have distinct lengths, so the length alone selects
+// the single candidate that needs a memcmp.
+TopicKind decodeFixedChannel(const char *channel, size_t length) {
+    switch (length) {
+    case sizeof("ota/update") - 1:
+        return memcmp(channel, "ota/update", length) == 0 ? TopicKind::OtaTrigger
+                                                           : TopicKind::Unknown;
+    case sizeof("ota/session/response") - 1:
+        return memcmp(channel, "ota/session/response", length) == 0
+                   ? TopicKind::OtaSessionResponse
+                   : TopicKind::Unknown;
+    default:
+        return TopicKind::Unknown;
+    }
+}
+
+}
+
+TopicRoute TopicRouter::route(const char *topic) const {
+    if (!topic) {
+        return UNKNOWN_ROUTE;
+    }
+    return route(topic, strlen(topic));
+}
+
+TopicRoute TopicRouter::route(const char *topic, size_t topicLength) const {
+    if (!topic || !topicPrefix.matches(topic, topicLength)) {
+        return UNKNOWN_ROUTE;
+    }
+
+    const char *channel = topic + topicPrefix.length();
+    size_t channelLength = topicLength - topicPrefix.length();
+
+    int pin = 0;
+    if (decodePinChannel(channel, channelLength, &pin)) {
+        return TopicRoute{TopicKind::Pin, pin};
+    }
+
+    return TopicRoute{decodeFixedChannel(channel, channelLength), -1};
+}
+
+}
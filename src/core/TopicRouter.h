@@ -0,0 +1,53 @@
+#ifndef IOTNET_TOPIC_ROUTER_H
+#define IOTNET_TOPIC_ROUTER_H
+
+#include <stddef.h>
+
+#include "core/TopicPrefix.h"
+
+namespace iotnet::core {
+
+enum class TopicKind {
+    Unknown,
+    Pin,
+    OtaTrigger,
+    OtaSessionResponse
+};
+
+struct TopicRoute {
+    TopicKind kind;
+    int pin;
+};
+
+// Maps inbound topics of one device/board pair to their handler. The shared
+// "devices/<deviceId>/<boardIdentifier>/" prefix is compared once and the
+// remaining channel is decoded directly, so routing cost does not grow with
+// the number of subscribed pins. The same prefix is the only copy of it kept
+// in memory; outbound topics are built from it when needed.
+class TopicRouter {
+  public:
+    static constexpr int MAX_PIN_DIGITS = TopicPrefix::MAX_PIN_DIGITS;
+
+    bool configure(const char *deviceId, const char *boardIdentifier) {
+        return topicPrefix.configure(deviceId, boardIdentifier);
+    }
+    bool isConfigured() const { return topicPrefix.isConfigured(); }
+    const TopicPrefix &prefix() const { return topicPrefix; }
+
+    TopicRoute route(const char *topic) const;
+    TopicRoute route(const char *topic, size_t topicLength) const;
+
+    bool buildPinTopic(int pin, char *outTopic, size_t outSize) const {
+        return topicPrefix.buildPinTopic(pin, outTopic, outSize);
+    }
+    bool buildWildcardFilter(char *outFilter, size_t outSize) const {
+        return topicPrefix.buildWildcardFilter(outFilter, outSize);
+    }
+
+  private:
+    TopicPrefix topicPrefix;
+};
+
+}
+
+#endif
@@ -0,0 +1,351 @@
+#include "core/ValueCodec.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+namespace iotnet::core {
+
+namespace {
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+void trim(const char *&text, size_t &length) {
+    while (length > 0 && isSpace(text[0])) {
+        text++;
+        length--;
+    }
+    while (length > 0 && isSpace(text[length - 1])) {
+        length--;
+    }
+}
+
+// Accumulates the integral digits of [cursor, end) into a magnitude capped at
+// limit, then skips an optional ".digits" tail. Returns false on any other
+// character, a missing integral part, or overflow past limit.
+bool parseMagnitude(const char *cursor, const char *end, unsigned long long limit,
+                    unsigned long long *outMagnitude) {
+    if (cursor == end || !isDigit(*cursor)) {
+        return false;
+    }
+
+    unsigned long long magnitude = 0;
+    while (cursor != end && isDigit(*cursor)) {
+        unsigned digit = static_cast<unsigned>(*cursor - '0');
+        if (digit > limit || magnitude > (limit - digit) / 10) {
+            return false;
+        }
+        magnitude = magnitude * 10 + digit;
+        cursor++;
+    }
+
+    if (cursor != end && *cursor == '.') {
+        cursor++;
+        while (cursor != end && isDigit(*cursor)) {
+            cursor++;
+        }
+    }
+
+    if (cursor != end) {
+        return false;
+    }
+
+    *outMagnitude = magnitude;
+    return true;
+}
+
+const char DIGIT_PAIRS[] = "00010203040506070809"
+                           "10111213141516171819"
+                           "20212223242526272829"
+                           "30313233343536373839"
+                           "40414243444546474849"
+                           "50515253545556575859"
+                           "60616263646566676869"
+                           "70717273747576777879"
+                           "80818283848586878889"
+                           "90919293949596979899";
+
+// 2^52: below it a double has at most half a unit in the last place, so the
+// error of magnitude * 10^precision stays within 0.25.
+constexpr double FIXED_POINT_LIMIT = 4503599627370496.0;
+
+const double POWERS_OF_TEN[MAX_FIXED_PRECISION + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+};
+
+// Writes the digits of value right-aligned so that they end at `end`;
+// returns the first digit. Narrower types keep division cheap on targets
+// without a 64-bit divider.
+char *writeDigits32(uint32_t value, char *end) {
+    while (value >= 100) {
+        uint32_t pair = (value % 100) * 2;
+        value /= 100;
+        *--end = DIGIT_PAIRS[pair + 1];
+        *--end = DIGIT_PAIRS[pair];
+    }
+    if (value >= 10) {
+        *--end = DIGIT_PAIRS[value * 2 + 1];
+        *--end = DIGIT_PAIRS[value * 2];
+    } else {
+        *--end = static_cast<char>('0' + value);
+    }
+    return end;
+}
+
+char *writeDigits(unsigned long long value, char *end) {
+    while (value > UINT32_MAX) {
+        // Peel off eight digits at a time so the rest stays 32-bit.
+        uint32_t low = static_cast<uint32_t>(value % 100000000ULL);
+        value /= 100000000ULL;
+        char *start = writeDigits32(low, end);
+        while (end - start < 8) {
+            *--start = '0';
+        }
+        end = start;
+    }
+    return writeDigits32(static_cast<uint32_t>(value), end);
+}
+
+size_t copyOut(const char *text, size_t length, char *outBuffer, size_t outSize) {
+    if (length >= outSize) {
+        outBuffer[0] = '\0';
+        return 0;
+    }
+    memcpy(outBuffer, text, length);
+    outBuffer[length] = '\0';
+    return length;
+}
+
+}
+
+bool parseInteger(const char *text, size_t length, long long minValue, long long maxValue,
+                  long long *outValue) {
+    if (!text || !outValue || minValue > maxValue) {
+        return false;
+    }
+
+    trim(text, length);
+    const char *end = text + length;
+    bool negative = false;
+    if (text != end && (*text == '-' || *text == '+')) {
+        negative = *text == '-';
+        text++;
+    }
+
+    // Magnitudes are bounded by the range on the chosen side of zero; the most
+    // negative value needs one more than maxValue can hold.
+    unsigned long long limit =
+        negative ? (minValue < 0 ? 0ULL - static_cast<unsigned long long>(minValue) : 0ULL)
+                 : (maxValue > 0 ? static_cast<unsigned long long>(maxValue) : 0ULL);
+
+    unsigned long long magnitude = 0;
+    if (!parseMagnitude(text, end, limit, &magnitude)) {
+        return false;
+    }
+
+    long long value = negative ? static_cast<long long>(0ULL - magnitude)
+                               : static_cast<long long>(magnitude);
+    if (value < minValue || value > maxValue) {
+        return false;
+    }
+
+    *outValue = value;
+    return true;
+}
+
+bool parseUnsigned(const char *text, size_t length, unsigned long long maxValue,
+                   unsigned long long *outValue) {
+    if (!text || !outValue) {
+        return false;
+    }
+
+    trim(text, length);
+    const char *end = text + length;
+    if (text != end && *text == '+') {
+        text++;
+    }
+
+    return parseMagnitude(text, end, maxValue, outValue);
+}
+
+bool parseDouble(const char *text, size_t length, double *outValue) {
+    if (!text || !outValue || text[length] != '\0') {
+        return false;
+    }
+
+    trim(text, length);
+    if (length == 0) {
+        return false;
+    }
+
+    char *parsedEnd = nullptr;
+    errno = 0;
+    double value = strtod(text, &parsedEnd);
+    if (parsedEnd != text + length) {
+        return false;
+    }
+
+    // Underflow still yields the closest representable value; overflow does not.
+    if (errno == ERANGE && isinf(value)) {
+        return false;
+    }
+
+    *outValue = value;
+    return true;
+}
+
+bool parseFloat(const char *text, size_t length, float *outValue) {
+    if (!text || !outValue || text[length] != '\0') {
+        return false;
+    }
+
+    trim(text, length);
+    if (length == 0) {
+        return false;
+    }
+
+    char *parsedEnd = nullptr;
+    errno = 0;
+    float value = strtof(text, &parsedEnd);
+    if (parsedEnd != text + length) {
+        return false;
+    }
+
+    if (errno == ERANGE && isinf(value)) {
+        return false;
+    }
+
+    *outValue = value;
+    return true;
+}
+
+bool parseBool(const char *text, size_t length, bool *outValue) {
+    if (!text || !outValue) {
+        return false;
+    }
+
+    trim(text, length);
+    if (length == 4 && strncasecmp(text, "true", 4) == 0) {
+        *outValue = true;
+        return true;
+    }
+    if (length == 5 && strncasecmp(text, "false", 5) == 0) {
+        *outValue = false;
+        return true;
+    }
+
+    long long number = 0;
+    if (!parseInteger(text, length, LLONG_MIN, LLONG_MAX, &number)) {
+        return false;
+    }
+
+    *outValue = number > 0;
+    return true;
+}
+
+size_t formatUnsigned(unsigned long long value, char *outBuffer, size_t outSize) {
+    if (!outBuffer || outSize == 0) {
+        return 0;
+    }
+
+    char digits[20];
+    char *end = digits + sizeof(digits);
+    char *start = writeDigits(value, end);
+    return copyOut(start, static_cast<size_t>(end - start), outBuffer, outSize);
+}
+
+size_t formatInteger(long long value, char *outBuffer, size_t outSize) {
+    if (!outBuffer || outSize == 0) {
+        return 0;
+    }
+
+    char digits[21];
+    char *end = digits + sizeof(digits);
+    unsigned long long magnitude = value < 0 ? 0ULL - static_cast<unsigned long long>(value)
+                                             : static_cast<unsigned long long>(value);
+    char *start = writeDigits(magnitude, end);
+    if (value < 0) {
+        *--start = '-';
+    }
+    return copyOut(start, static_cast<size_t>(end - start), outBuffer, outSize);
+}
+
+size_t formatFixed(double value, unsigned precision, char *outBuffer, size_t outSize) {
+    if (!outBuffer || outSize == 0) {
+        return 0;
+    }
+    if (precision > MAX_FIXED_PRECISION) {
+        precision = MAX_FIXED_PRECISION;
+    }
+
+    bool negative = signbit(value);
+    if (isnan(value)) {
+        return copyOut(negative ? "-nan" : "nan", negative ? 4 : 3, outBuffer, outSize);
+    }
+    if (isinf(value)) {
+        return copyOut(negative ? "-inf" : "inf", negative ? 4 : 3, outBuffer, outSize);
+    }
+
+    double magnitude = fabs(value);
+    double scaled = magnitude * POWERS_OF_TEN[precision];
+    if (scaled >= FIXED_POINT_LIMIT) {
+        int written = snprintf(outBuffer, outSize, "%.*f", static_cast<int>(precision), value);
+        if (written > 0 && static_cast<size_t>(written) < outSize) {
+            return static_cast<size_t>(written);
+        }
+        // Too wide for fixed notation; exponent form still round-trips.
+        written = snprintf(outBuffer, outSize, "%.17g", value);
+        if (written <= 0 || static_cast<size_t>(written) >= outSize) {
+            outBuffer[0] = '\0';
+            return 0;
+        }
+        return static_cast<size_t>(written);
+    }
+
+    // printf rounds the exact decimal value of `value`, not the rounded
+    // product. Below FIXED_POINT_LIMIT the product's rounding error is exact
+    // in a double and at most 0.25, so the fraction plus that error decides.
+    double whole = floor(scaled);
+    double fraction = scaled - whole;
+    unsigned long long rounded = static_cast<unsigned long long>(whole);
+    if (fraction >= 0.25) {
+        double error = fma(magnitude, POWERS_OF_TEN[precision], -scaled);
+        double aboveHalf = (fraction - 0.5) + error;
+        if (aboveHalf > 0 || (aboveHalf == 0 && (rounded & 1) != 0)) {
+            rounded++;
+        }
+    }
+
+    unsigned long long divisor = static_cast<unsigned long long>(POWERS_OF_TEN[precision]);
+    unsigned long long integral = rounded / divisor;
+    unsigned long long decimals = rounded % divisor;
+
+    char text[32];
+    char *end = text + sizeof(text);
+    char *start = end;
+    if (precision > 0) {
+        start = writeDigits(decimals, end);
+        while (static_cast<unsigned>(end - start) < precision) {
+            *--start = '0';
+        }
+        *--start = '.';
+    }
+    start = writeDigits(integral, start);
+    if (negative) {
+        *--start = '-';
+    }
+    return copyOut(start, static_cast<size_t>(end - start), outBuffer, outSize);
+}
+
+}
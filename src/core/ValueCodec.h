@@ -0,0 +1,46 @@
+#ifndef IOTNET_VALUE_CODEC_H
+#define IOTNET_VALUE_CODEC_H
+
+#include <stddef.h>
+
+namespace iotnet::core {
+
+// Parsers for virtual pin payloads. They read straight from the caller's
+// buffer, never allocate, and return false instead of a silent zero when the
+// text is not a value of the requested type or does not fit its range.
+// Leading and trailing whitespace is ignored.
+
+// Integers accept an optional sign and a fractional part, which is truncated
+// ("12.9" -> 12) as the dashboard may send integral values with decimals.
+bool parseInteger(const char *text, size_t length, long long minValue, long long maxValue,
+                  long long *outValue);
+bool parseUnsigned(const char *text, size_t length, unsigned long long maxValue,
+                   unsigned long long *outValue);
+
+// Floating point parsers require a NUL-terminated buffer whose terminator
+// sits at text[length].
+bool parseDouble(const char *text, size_t length, double *outValue);
+bool parseFloat(const char *text, size_t length, float *outValue);
+
+// "true"/"false" in any case, or a number that is true when greater than zero.
+bool parseBool(const char *text, size_t length, bool *outValue);
+
+// Formatters write a NUL-terminated value and return its length, or 0 when
+// the buffer is too small (the buffer then holds an empty string). They
+// avoid printf: integers use a two-digits-per-step table and stay in 32-bit
+// arithmetic whenever the value allows it.
+constexpr unsigned MAX_FIXED_PRECISION = 9;
+
+size_t formatUnsigned(unsigned long long value, char *outBuffer, size_t outSize);
+size_t formatInteger(long long value, char *outBuffer, size_t outSize);
+
+// Fixed-point output with `precision` decimals (clamped to
+// MAX_FIXED_PRECISION), matching printf("%.*f") including "nan"/"inf" and
+// round-half-to-even on exact ties of the binary value. Scaled magnitudes of
+// 2^52 and up go through snprintf, switching to "%.17g" when the fixed form
+// does not fit the buffer.
+size_t formatFixed(double value, unsigned precision, char *outBuffer, size_t outSize);
+
+}
+
+#endif
@@ -1,7 +1,5 @@
 #include "IotNetESP32.h"
 
-#include "core/TopicBuilder.h"
-
 void IotNetESP32::updateBoardStatusInternal(const char *status) {
     if (!status || !credentials.mqttUsername || !credentials.boardIdentifier || !credentials.mqttPassword) {
         Serial.printf("Error: Missing parameters for updateBoardStatus (Current version: %s)\n",
@@ -15,18 +13,13 @@ void IotNetESP32::updateBoardStatusInternal(const char *status) {
     } else if ((strcmp(status, "success") == 0 || strcmp(status, "failed") == 0) && timingActive) {
         endTimestamp = millis();
         timingActive = false;
-        String formattedTime = getFormattedExecutionTime();
-        Serial.printf("Execution time: %s\n", formattedTime.c_str());
+        char formattedTime[48];
+        formatExecutionTime(formattedTime, sizeof(formattedTime));
+        Serial.printf("Execution time: %s\n", formattedTime);
     }
 
     char topic[MAX_TOPIC_LENGTH];
-    if (!iotnet::core::buildDeviceTopic(
-            topic,
-            sizeof(topic),
-            credentials.mqttUsername,
-            credentials.boardIdentifier,
-            "status"
-        )) {
+    if (!topicRouter.prefix().buildTopic("status", topic)) {
         Serial.println("Failed to build board status topic");
         return;
     }
@@ -57,13 +50,7 @@ void IotNetESP32::registerBoardInternal() {
     }
 
     char topic[MAX_TOPIC_LENGTH];
-    if (!iotnet::core::buildDeviceTopic(
-            topic,
-            sizeof(topic),
-            credentials.mqttUsername,
-            credentials.boardIdentifier,
-            "board"
-        )) {
+    if (!topicRouter.prefix().buildTopic("board", topic)) {
         Serial.println("Failed to build board registration topic");
         return;
     }
@@ -72,14 +59,9 @@ void IotNetESP32::registerBoardInternal() {
     snprintf(payload, sizeof(payload), "{\"version\":\"%s\"}", currentFirmwareVersion);
 
     if (!mqttClient.connected()) {
+        // The connection state machine registers the board once it is back online.
         Serial.println("Cannot register board: MQTT not connected");
-
-        if (reconnectMQTT()) {
-            Serial.println("MQTT reconnected successfully in registerBoardInternal");
-        } else {
-            Serial.println("Failed to reconnect MQTT in registerBoardInternal");
-            return;
-        }
+        return;
     }
 
     bool success = mqttClient.publish(topic, (const uint8_t *)payload, strlen(payload), false);
@@ -91,6 +73,7 @@ void IotNetESP32::registerBoardInternal() {
             Serial.println("Second attempt to publish board registration failed");
         }
     }
+    boardRegistered = success;
 }
 
 void IotNetESP32::publishBoardStatus(const char *status) {
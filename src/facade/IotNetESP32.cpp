@@ -1,31 +1,48 @@
 #include "IotNetESP32.h"
+
+#include <stdarg.h>
+
 #include "i-ot.net.h"
 #include "mqtt/MqttConnectionManager.h"
 #include "core/ClientConfig.h"
 
-static IotNetESP32 *currentInstance = nullptr;
+// Not cleared on reset or wake-up; the record's magic and CRC tell whether it
+// still holds a session.
+RTC_NOINIT_ATTR static iotnet::core::TlsSessionRecord rtcTlsSession;
+RTC_NOINIT_ATTR static iotnet::core::ResumeSnapshot rtcResume;
 
 //=======================================================================================
 // Constructor
 //=======================================================================================
 
 IotNetESP32::IotNetESP32()
-    : mqttClient(espClient), credentials{nullptr, nullptr, nullptr}, mqttConfig{nullptr, 0, 0},
-      certificates{nullptr}, numCallbacks(0), startTimestamp(0), endTimestamp(0), timingActive(false),
-      timeConfigured(false), otaUpdatesEnabled(false), otaInProgress(false) {
-    currentInstance = this;
+    : mqttClient(espClient), credentials{nullptr, nullptr, nullptr},
+      mqttConfig{nullptr, 0, 0}, certificates{nullptr}, startTimestamp(0), endTimestamp(0),
+      timingActive(false), timeConfigured(false), overflowPolicy(OverflowPolicy::DropOldest),
+      overflowBlockTimeoutMs(0), batchingEnabled(false), batchWindowMs(0), batchOpenedAt(0),
+      networkTask(nullptr), subscribedPins(0), subscriptionMode(SubscriptionMode::PerPin),
+      wildcardSubscribed(false), sessionHoldsWildcard(false), persistentSession(false),
+      brokerSessionPresent(false), mqtt5(false), reportedHotPathAllocations(0),
+      connectionSteps(*this),
+      connection(connectionSteps,
+                 iotnet::core::BackoffConfig{RECONNECT_BACKOFF_MIN_MS, RECONNECT_BACKOFF_MAX_MS,
+                                             CONNECT_STEP_TIMEOUT_MS}),
+      resumingFromSleep(false), resumeFlags(0), boardRegistered(false), otaUpdatesEnabled(false),
+      otaInProgress(false), verifiedOtaRequired(false) {
     strcpy(currentFirmwareVersion, "1.0.0");
     strcpy(timeZone, "UTC");
     otaTopic[0] = '\0';
     otaSessionRequestTopic[0] = '\0';
     otaSessionResponseTopic[0] = '\0';
     otaSession.reset();
-    for (int i = 0; i < MAX_PINS; i++) {
-        pins[i].initialized = false;
-        pins[i].updated = false;
-        pins[i].value[0] = '\0';
-    }
+    memset(pinPrecision, DEFAULT_FLOAT_PRECISION, sizeof(pinPrecision));
+    // Backoff jitter from the hardware RNG, so a fleet that lost the broker
+    // together does not reconnect in lockstep.
+    connection.setRandomSource(hardwareRandom, nullptr);
+}
 
+uint32_t IotNetESP32::hardwareRandom(void *) {
+    return esp_random();
 }
 
 //=======================================================================================
@@ -67,23 +84,109 @@ void IotNetESP32::connect() {
 
     printLogo();
 
-    unsigned long startAttemptTime = millis();
-    bool connected = false;
+    if (!connectOnce()) {
+        return;
+    }
+
+    this->preferences.begin("iotnet", false);
+    this->preferences.end();
+}
 
-    while (!connected && millis() - startAttemptTime < MQTT_TIMEOUT_MS) {
-        connected = reconnectMQTT();
-        if (!connected) {
-            delay(RECONNECT_DELAY_MS);
+// Gives the first attempt a short head start so writes from setup() usually
+// go out promptly. An attempt still in progress after the budget is left to
+// run(), like any retry.
+bool IotNetESP32::connectOnce() {
+    unsigned long startedMs = millis();
+    connection.start(startedMs);
+    checkConnections();
+    while (connection.state() != ConnectionState::Online &&
+           connection.state() != ConnectionState::Disconnected) {
+        if (millis() - startedMs >= INITIAL_CONNECT_BUDGET_MS) {
+            Serial.printf("[MQTT] Still %s after %lu ms, continuing from run()\n",
+                          iotnet::core::connectionStateName(connection.state()),
+                          static_cast<unsigned long>(INITIAL_CONNECT_BUDGET_MS));
+            return false;
+        }
+        if (!checkConnections()) {
+            delay(1);
         }
     }
 
-    if (!connected) {
-        Serial.println("Failed to connect to MQTT broker within timeout");
-        return;
+    if (connection.state() != ConnectionState::Online) {
+        Serial.println("Failed to connect to MQTT broker, retrying from run()");
+        return false;
     }
+    return true;
+}
 
-    this->preferences.begin("iotnet", false);
-    this->preferences.end();
+bool IotNetESP32::resume(const ClientConfig &config) {
+    if (!applyRuntimeConfig(config)) {
+        Serial.println("Error: Invalid runtime client config");
+        return false;
+    }
+
+    setCertificates();
+    setMQTTServer();
+    setupCertificates();
+
+    // Consumed once: a wake-up that crashes before sleeping again starts cold.
+    bool usable = rtcResume.isValid(configurationIdentity());
+    if (usable) {
+        rtcResume.restore(pinTable, pinPrecision);
+        subscribedPins = rtcResume.subscribedPins;
+        brokerAddress = IPAddress(rtcResume.brokerAddress);
+        resumeFlags = rtcResume.flags;
+        boardRegistered = (resumeFlags & iotnet::core::ResumeSnapshot::BoardRegistered) != 0;
+        sessionHoldsWildcard = (resumeFlags & iotnet::core::ResumeSnapshot::WildcardSession) != 0;
+        resumingFromSleep = true;
+    }
+    rtcResume.clear();
+    persistTlsSession(true);
+
+    if (!usable) {
+        printLogo();
+    }
+    connectOnce();
+    return usable;
+}
+
+bool IotNetESP32::prepareForSleep() {
+    if (networkTask) {
+        Serial.println("Error: prepareForSleep() is not supported with the network task");
+        return false;
+    }
+
+    flushOutbound();
+    bool online = mqttClient.connected();
+
+    rtcResume.clear();
+    rtcResume.capture(pinTable, pinPrecision, subscribedPins);
+    rtcResume.brokerAddress = static_cast<uint32_t>(brokerAddress);
+    rtcResume.flags = 0;
+    if (boardRegistered) {
+        rtcResume.flags |= iotnet::core::ResumeSnapshot::BoardRegistered;
+    }
+    if (online) {
+        rtcResume.flags |= iotnet::core::ResumeSnapshot::OnlineRetained;
+    }
+    if (sessionHoldsWildcard) {
+        rtcResume.flags |= iotnet::core::ResumeSnapshot::WildcardSession;
+    }
+    // Copies the current TLS session into RTC memory as well.
+    persistTlsSession(true);
+    rtcResume.seal(configurationIdentity());
+
+    if (online) {
+        mqttClient.disconnect();
+    }
+    espClient.stop();
+    return true;
+}
+
+uint32_t IotNetESP32::configurationIdentity() const {
+    return iotnet::core::resumeIdentity(credentials.mqttUsername, credentials.boardIdentifier,
+                                        mqttConfig.server, mqttConfig.port,
+                                        currentFirmwareVersion);
 }
 
 void IotNetESP32::setCertificates() {
@@ -107,10 +210,10 @@ void IotNetESP32::setMQTTServer() {
         mqttConfig.server,
         mqttConfig.port,
         60,
-        30,
-        static_cast<uint16_t>(MAX_MESSAGE_BUFFER_SIZE)
+        30
     );
-    mqttClient.setCallback(staticMqttCallback);
+    mqttClient.setMessageHandler(staticMqttCallback, this);
+    mqttClient.setSubackHandler(staticSubackCallback, this);
 }
 
 bool IotNetESP32::applyRuntimeConfig(const ClientConfig &config) {
@@ -131,6 +234,10 @@ bool IotNetESP32::applyRuntimeConfig(const ClientConfig &config) {
     this->credentials.mqttPassword = runtimeMqttPassword;
     this->credentials.boardIdentifier = runtimeBoardName;
 
+    if (!topicRouter.configure(runtimeMqttUsername, runtimeBoardName)) {
+        return false;
+    }
+
     if (config.firmwareVersion) {
         version(config.firmwareVersion);
     }
@@ -185,8 +292,72 @@ void IotNetESP32::printLogo() {
 //=======================================================================================
 
 void IotNetESP32::run() {
+    if (networkTask) {
+        // The network task owns the connection; only exchange pin data here.
+        {
+            iotnet::core::AllocationGuard::HotPath hotPath;
+            applyInboundValues();
+            dispatchCallbacks();
+        }
+        reportHotPathAllocations();
+        return;
+    }
+
+    serviceNetwork();
+    {
+        iotnet::core::AllocationGuard::HotPath hotPath;
+        dispatchCallbacks();
+        flushOutbound();
+    }
+    reportHotPathAllocations();
+}
+
+bool IotNetESP32::startNetworkTask(uint32_t stackBytes, UBaseType_t priority, BaseType_t core) {
+    if (networkTask) {
+        return true;
+    }
+
+    BaseType_t created = xTaskCreatePinnedToCore(
+        networkTaskEntry,
+        "iotnet-net",
+        stackBytes,
+        this,
+        priority,
+        &networkTask,
+        core
+    );
+    if (created != pdPASS) {
+        networkTask = nullptr;
+        Serial.println("Error: Failed to start network task");
+        return false;
+    }
+    return true;
+}
+
+bool IotNetESP32::isNetworkTaskRunning() const {
+    return networkTask != nullptr;
+}
+
+void IotNetESP32::networkTaskEntry(void *instance) {
+    IotNetESP32 *self = static_cast<IotNetESP32 *>(instance);
+    for (;;) {
+        self->serviceNetwork();
+        {
+            iotnet::core::AllocationGuard::HotPath hotPath;
+            self->flushOutbound();
+        }
+        vTaskDelay(pdMS_TO_TICKS(NETWORK_TASK_INTERVAL_MS));
+    }
+}
+
+void IotNetESP32::serviceNetwork() {
     checkConnections();
-    mqttClient.loop();
+    {
+        // Reconnects may allocate (TLS); the steady-state loop may not.
+        iotnet::core::AllocationGuard::HotPath hotPath;
+        mqttClient.loop();
+    }
+    subscribePendingPins();
 
     // Check for session key timeout (30 seconds)
     if (otaSession.isTimedOut(millis(), OTA_SESSION_TIMEOUT_MS)) {
@@ -194,87 +365,320 @@ void IotNetESP32::run() {
         otaSession.setWaiting(false);
         updateBoardStatusInternal("failed");
     }
+}
 
-    for (int i = 0; i < numCallbacks; i++) {
-        int pinIndex = callbacks[i].pinIndex;
-        if (pinIndex < 0 || pinIndex >= MAX_PINS) {
-            continue;
-        }
+uint32_t IotNetESP32::hotPathAllocations() const {
+    return iotnet::core::AllocationGuard::hotPathAllocations();
+}
 
-        if (!pins[pinIndex].updated) {
-            continue;
-        }
+// Allocations are only counted with IOTNET_STATIC_MEMORY, so without it this
+// is one load and compare.
+void IotNetESP32::reportHotPathAllocations() {
+    uint32_t count = iotnet::core::AllocationGuard::hotPathAllocations();
+    if (count == reportedHotPathAllocations) {
+        return;
+    }
+    size_t lastSize = iotnet::core::AllocationGuard::lastHotPathAllocationSize();
+    Serial.printf("[MEMORY] FAIL: %lu heap allocation(s) on the hot path (last: %u bytes)\n",
+                  static_cast<unsigned long>(count - reportedHotPathAllocations),
+                  static_cast<unsigned>(lastSize));
+    reportedHotPathAllocations = count;
+}
+
+void IotNetESP32::logLine(const char *format, ...) {
+    // Only used with integer and string conversions, which newlib formats
+    // without touching the heap.
+    char line[MAX_LOG_LINE_LENGTH];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length <= 0) {
+        return;
+    }
+    if (static_cast<size_t>(length) >= sizeof(line)) {
+        length = sizeof(line) - 1;
+        line[length - 1] = '\n';
+    }
+    Serial.write(reinterpret_cast<const uint8_t *>(line), static_cast<size_t>(length));
+}
+
+void IotNetESP32::flushOutbound() {
+    // One snapshot per pass, so a queue drain never mixes batched and direct
+    // publishes. A frame left by disableBatching() goes out before anything
+    // newer.
+    bool batching = batchingEnabled.load(std::memory_order_acquire);
+    if (!batching && !batchFrame.isEmpty()) {
+        flushBatch();
+    }
+    drainPublishQueue(batching);
 
-        callbacks[i].callback(String(pins[pinIndex].value));
-        pins[pinIndex].updated = false;
+    if (batching && !batchFrame.isEmpty() && millis() - batchOpenedAt >= batchWindowMs) {
+        flushBatch();
     }
 }
 
-void IotNetESP32::checkConnections() {
-    if (!mqttClient.connected()) {
-        Serial.println("MQTT connection lost. Reconnecting...");
-        if (reconnectMQTT()) {
-            Serial.println("MQTT reconnected successfully");
-        } else {
-            delay(RECONNECT_DELAY_MS);
+void IotNetESP32::dispatchCallbacks() {
+    callbackIndex.dispatch(pinTable, [this](int slot, int pin) {
+        callbacks[slot].handler(pinTable.value(pin), pinTable.valueLength(pin),
+                                callbacks[slot].context);
+    });
+}
+
+void IotNetESP32::applyInboundValues() {
+    iotnet::core::InboundValue inbound;
+    for (uint32_t i = 0; i < iotnet::core::InboundQueue::CAPACITY; i++) {
+        if (!inboundQueue.tryPop(inbound)) {
+            break;
+        }
+        if (pinTable.isInitialized(inbound.pin)) {
+            pinTable.storeValue(inbound.pin, inbound.payload);
         }
     }
 }
 
-bool IotNetESP32::reconnectMQTT() {
-    if (mqttClient.connected()) {
-        return true;
+bool IotNetESP32::checkConnections() {
+    iotnet::core::ConnectionState before = connection.state();
+    unsigned long now = millis();
+    if (!connection.poll(now)) {
+        return false;
+    }
+
+    iotnet::core::ConnectionState after = connection.state();
+    if (after == ConnectionState::Online) {
+        Serial.printf("[MQTT] Online (connected in %lu ms)\n",
+                      static_cast<unsigned long>(connection.lastConnectDurationMs()));
+    } else if (after == ConnectionState::Disconnected && before == ConnectionState::Online) {
+        Serial.println("MQTT connection lost. Reconnecting...");
+    } else if (after == ConnectionState::Disconnected) {
+        Serial.printf("[MQTT] %s failed, retrying in %lu ms\n",
+                      iotnet::core::connectionStateName(before),
+                      static_cast<unsigned long>(connection.retryAtMs() - now));
     }
+    return true;
+}
+
+void IotNetESP32::persistTlsSession(bool enable) {
+    espClient.setSessionRecord(enable ? &rtcTlsSession : nullptr);
+}
+
+IotNetESP32::TlsHandshakeStats IotNetESP32::tlsHandshakeStats() const {
+    return espClient.handshakeStats();
+}
+
+IotNetESP32::ConnectionState IotNetESP32::connectionState() const {
+    return connection.state();
+}
+
+unsigned long IotNetESP32::timeInConnectionState() const {
+    return connection.timeInState(millis());
+}
 
-    if (!credentials.mqttUsername || !credentials.mqttPassword || !credentials.boardIdentifier) {
+// Each step below is one bounded blocking call at most; nothing waits between
+// attempts, the state machine schedules the next one.
+
+iotnet::core::StepResult IotNetESP32::ConnectionSteps::resolve() {
+    if (WiFi.status() != WL_CONNECTED || !owner.mqttConfig.server) {
+        return iotnet::core::StepResult::Failed;
+    }
+    if (!owner.credentials.mqttUsername || !owner.credentials.mqttPassword ||
+        !owner.credentials.boardIdentifier) {
         Serial.println("Error: MQTT credentials or board name not set");
-        return false;
+        return iotnet::core::StepResult::Failed;
     }
+    if (owner.resumingFromSleep && static_cast<uint32_t>(owner.brokerAddress) != 0) {
+        return iotnet::core::StepResult::Done;
+    }
+    return WiFi.hostByName(owner.mqttConfig.server, owner.brokerAddress) == 1
+               ? iotnet::core::StepResult::Done
+               : iotnet::core::StepResult::Failed;
+}
 
-    if (!pins[mqttConfig.statusPin].initialized) {
-        initPinTopic(mqttConfig.statusPin);
+iotnet::core::StepResult IotNetESP32::ConnectionSteps::connectTcp() {
+    // The host name is kept for SNI, certificate checks and the session cache.
+    return owner.espClient.connectStep(owner.brokerAddress, owner.mqttConfig.port,
+                                       owner.mqttConfig.server);
+}
+
+iotnet::core::StepResult IotNetESP32::ConnectionSteps::handshakeTls() {
+    iotnet::core::StepResult result = owner.espClient.handshakeStep();
+    if (result == iotnet::core::StepResult::Done) {
+        const TlsHandshakeStats &stats = owner.espClient.handshakeStats();
+        bool resumed = owner.espClient.lastHandshakeResumed();
+        Serial.printf("[TLS] %s handshake in %lu ms\n", resumed ? "Resumed" : "Full",
+                      static_cast<unsigned long>(resumed ? stats.lastResumedMs
+                                                         : stats.lastFullMs));
     }
+    return result;
+}
 
-    bool connected = iotnetesp32::mqtt::MqttConnectionManager::connectWithLwt(
-        mqttClient,
-        credentials.boardIdentifier,
-        credentials.mqttUsername,
-        credentials.mqttPassword,
-        pins[mqttConfig.statusPin].topic,
-        "offline",
-        1,
-        true
-    );
+iotnet::core::StepResult IotNetESP32::ConnectionSteps::connectMqtt() {
+    // The first call sends CONNECT, later ones wait for the CONNACK.
+    if (owner.mqttClient.state() == iotnetesp32::mqtt::MqttClient::State::Disconnected) {
+        char statusTopic[MAX_TOPIC_LENGTH];
+        if (!iotnet::core::PinTable::isValidPin(owner.mqttConfig.statusPin) ||
+            !owner.buildPinTopic(owner.mqttConfig.statusPin, statusTopic,
+                                 sizeof(statusTopic))) {
+            return iotnet::core::StepResult::Failed;
+        }
 
-    if (!connected) {
-        return false;
+        if (!iotnetesp32::mqtt::MqttConnectionManager::beginConnectWithLwt(
+                owner.mqttClient,
+                owner.credentials.boardIdentifier,
+                owner.credentials.mqttUsername,
+                owner.credentials.mqttPassword,
+                statusTopic,
+                "offline",
+                1,
+                true,
+                !owner.persistentSession,
+                owner.mqtt5 ? iotnet::core::MqttVersion::V5 : iotnet::core::MqttVersion::V311
+            )) {
+            return iotnet::core::StepResult::Failed;
+        }
     }
 
-    Serial.println("[MQTT] Connected");
-    publishToPin("V0", "online");
-    for (int i = 0; i < MAX_PINS; i++) {
-        if (pins[i].initialized) {
-            mqttClient.subscribe(pins[i].topic);
+    iotnet::core::StepResult result = owner.mqttClient.pollConnect();
+    owner.brokerSessionPresent = result == iotnet::core::StepResult::Done &&
+                                 owner.persistentSession && owner.mqttClient.sessionPresent();
+    if (result == iotnet::core::StepResult::Done) {
+        owner.topicAliases.reset(owner.mqttClient.topicAliasMaximum());
+    }
+    return result;
+}
+
+iotnet::core::StepResult IotNetESP32::ConnectionSteps::subscribe() {
+    owner.restoreSession();
+    return owner.mqttClient.connected() ? iotnet::core::StepResult::Done
+                                        : iotnet::core::StepResult::Failed;
+}
+
+bool IotNetESP32::ConnectionSteps::isOnline() {
+    return owner.mqttClient.connected();
+}
+
+void IotNetESP32::ConnectionSteps::teardown() {
+    // Whatever failed may be stale resume state; the next attempt starts cold.
+    owner.resumingFromSleep = false;
+    owner.wildcardSubscribed = false;
+    owner.wildcardAck.clear();
+    owner.brokerSessionPresent = false;
+    owner.mqttClient.disconnect();
+    owner.espClient.stop();
+}
+
+void IotNetESP32::restoreSession() {
+    // Only the first session after resume() may skip the announcements; a
+    // later reconnect follows a dropped connection and its last will.
+    uint32_t skip = resumingFromSleep ? resumeFlags : 0;
+    resumingFromSleep = false;
+
+    if (!(skip & iotnet::core::ResumeSnapshot::OnlineRetained)) {
+        publishToPin("V0", "online");
+    }
+
+    // Pins requested while offline are still pending and get subscribed by
+    // subscribePendingPins(); only restore the ones the broker already knew.
+    // A resumed persistent session still holds all of them.
+    subscribedPins |= iotnet::core::PinTable::bit(mqttConfig.statusPin);
+    // The stored session is only trusted when it was set up in the current
+    // mode; a PerPin session or a refused wildcard does not cover a Wildcard
+    // run, and vice versa.
+    if (!brokerSessionPresent) {
+        sessionHoldsWildcard = false;
+    }
+    bool sessionCovers = brokerSessionPresent &&
+                         sessionHoldsWildcard == (subscriptionMode == SubscriptionMode::Wildcard);
+    if (sessionCovers) {
+        // The OTA channels then need no SUBSCRIBE of their own.
+        wildcardSubscribed = sessionHoldsWildcard;
+    }
+    char pinTopic[MAX_TOPIC_LENGTH];
+    uint64_t pins = sessionCovers || subscribeWildcard() ? 0 : subscribedPins;
+    while (pins != 0) {
+        int pin = iotnet::core::lowestSetBit(pins);
+        pins &= pins - 1;
+        if (buildPinTopic(pin, pinTopic, sizeof(pinTopic))) {
+            mqttClient.subscribe(pinTopic, subscriptionQos());
         }
     }
 
     // Auto-register board after successful MQTT connection
-    registerBoardInternal();
+    if (!(skip & iotnet::core::ResumeSnapshot::BoardRegistered)) {
+        registerBoardInternal();
+    }
 
     // Subscribe to OTA updates if enabled
     if (otaUpdatesEnabled) {
-        subscribeToOtaUpdates();
+        if (sessionCovers) {
+            buildOtaTopics();
+        } else {
+            subscribeToOtaUpdates();
+        }
     }
+}
 
-    return true;
+// Covers every subscribed pin and the OTA channels with one SUBSCRIBE. Falls
+// back to per-pin subscriptions when the mode is off or the SUBSCRIBE cannot
+// be sent; subackCallback() does the same when the broker refuses it.
+bool IotNetESP32::subscribeWildcard() {
+    wildcardSubscribed = false;
+    if (subscriptionMode != SubscriptionMode::Wildcard) {
+        return false;
+    }
+
+    char filter[MAX_TOPIC_LENGTH];
+    if (!topicRouter.buildWildcardFilter(filter, sizeof(filter))) {
+        return false;
+    }
+    uint16_t packetId = 0;
+    wildcardSubscribed = mqttClient.subscribe(filter, subscriptionQos(), &packetId);
+    if (wildcardSubscribed) {
+        wildcardAck.expect(packetId);
+        sessionHoldsWildcard = true;
+    } else {
+        Serial.printf("Warning: Wildcard subscribe to %s failed, subscribing per pin\n", filter);
+    }
+    return wildcardSubscribed;
+}
+
+void IotNetESP32::setSubscriptionMode(SubscriptionMode mode) {
+    subscriptionMode = mode;
+}
+
+void IotNetESP32::setPersistentSession(bool enable) {
+    persistentSession = enable;
+}
+
+void IotNetESP32::setMqtt5(bool enable) {
+    mqtt5 = enable;
 }
 
 //=======================================================================================
 // MQTT Communication Methods
 //=======================================================================================
 
-void IotNetESP32::staticMqttCallback(char *topic, byte *payload, unsigned int length) {
-    if (currentInstance) {
-        currentInstance->mqttCallback(topic, payload, length);
+void IotNetESP32::staticMqttCallback(const iotnet::core::MqttPublish &message, void *context) {
+    static_cast<IotNetESP32 *>(context)->mqttCallback(message);
+}
+
+void IotNetESP32::staticSubackCallback(const iotnet::core::MqttSuback &ack, void *context) {
+    static_cast<IotNetESP32 *>(context)->subackCallback(ack);
+}
+
+// An ACL may refuse devices/<user>/<board>/# while allowing the topics below
+// it. The pins go back to subscribePendingPins(), which runs right after the
+// network loop, and the OTA channels are subscribed one by one.
+void IotNetESP32::subackCallback(const iotnet::core::MqttSuback &ack) {
+    if (wildcardAck.check(ack) != iotnet::core::SubackWatch::Outcome::Refused) {
+        return;
+    }
+
+    Serial.println("[MQTT] FAIL: Broker refused the wildcard subscription, subscribing per pin");
+    wildcardSubscribed = false;
+    sessionHoldsWildcard = false;
+    pendingSubscriptions.addAll(subscribedPins);
+    if (otaUpdatesEnabled) {
+        subscribeToOtaUpdates();
     }
 }
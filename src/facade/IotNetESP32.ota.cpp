@@ -1,6 +1,6 @@
 #include "IotNetESP32.h"
 
-#include "core/TopicBuilder.h"
+#include "core/ChunkPipeline.h"
 #include "i-ot.net.h"
 #include "ota/FirmwareFlasher.h"
 #include "ota/OtaUpdateService.h"
@@ -18,47 +18,57 @@ bool IotNetESP32::isOtaInProgress() const {
     return otaInProgress;
 }
 
-void IotNetESP32::subscribeToOtaUpdates() {
+void IotNetESP32::requireVerifiedOta(bool require) {
+    verifiedOtaRequired = require;
+}
+
+bool IotNetESP32::setOtaChunking(size_t chunkBytes, uint8_t chunkCount) {
+    if (chunkBytes == 0 || chunkCount < iotnet::core::ChunkRing::MIN_CHUNKS ||
+        chunkCount > iotnet::core::ChunkRing::MAX_CHUNKS) {
+        Serial.println("[OTA] FAIL: Invalid chunk configuration");
+        return false;
+    }
+    otaPipeline.chunkBytes = chunkBytes;
+    otaPipeline.chunkCount = chunkCount;
+    return true;
+}
+
+bool IotNetESP32::buildOtaTopics() {
     if (!credentials.mqttUsername || !credentials.boardIdentifier) {
-        Serial.println("[OTA] FAIL: Cannot subscribe - credentials not set");
-        return;
+        Serial.println("[OTA] FAIL: Cannot build topics - credentials not set");
+        return false;
     }
 
-    if (!iotnet::core::buildDeviceTopic(
-            otaTopic,
-            sizeof(otaTopic),
-            credentials.mqttUsername,
-            credentials.boardIdentifier,
-            "ota/update"
-        ) ||
-        !iotnet::core::buildDeviceTopic(
-            otaSessionRequestTopic,
-            sizeof(otaSessionRequestTopic),
-            credentials.mqttUsername,
-            credentials.boardIdentifier,
-            "ota/session/request"
-        ) ||
-        !iotnet::core::buildDeviceTopic(
-            otaSessionResponseTopic,
-            sizeof(otaSessionResponseTopic),
-            credentials.mqttUsername,
-            credentials.boardIdentifier,
-            "ota/session/response"
-        )) {
+    const iotnet::core::TopicPrefix &prefix = topicRouter.prefix();
+    if (!prefix.buildTopic("ota/update", otaTopic) ||
+        !prefix.buildTopic("ota/session/request", otaSessionRequestTopic) ||
+        !prefix.buildTopic("ota/session/response", otaSessionResponseTopic)) {
         Serial.println("[OTA] FAIL: Unable to build OTA topics");
+        return false;
+    }
+    return true;
+}
+
+void IotNetESP32::subscribeToOtaUpdates() {
+    if (!buildOtaTopics()) {
+        return;
+    }
+
+    if (wildcardSubscribed) {
+        Serial.println("[OTA] Covered by the device wildcard subscription");
         return;
     }
 
-    if (mqttClient.subscribe(otaTopic)) {
-        Serial.printf("[OTA] Subscribed to trigger: %s\n", otaTopic);
+    if (mqttClient.subscribe(otaTopic, subscriptionQos())) {
+        logLine("[OTA] Subscribed to trigger: %s\n", otaTopic);
     } else {
-        Serial.printf("[OTA] FAIL: Subscribe to trigger topic failed: %s\n", otaTopic);
+        logLine("[OTA] FAIL: Subscribe to trigger topic failed: %s\n", otaTopic);
     }
 
-    if (mqttClient.subscribe(otaSessionResponseTopic)) {
-        Serial.printf("[OTA] Subscribed to session response: %s\n", otaSessionResponseTopic);
+    if (mqttClient.subscribe(otaSessionResponseTopic, subscriptionQos())) {
+        logLine("[OTA] Subscribed to session response: %s\n", otaSessionResponseTopic);
     } else {
-        Serial.printf("[OTA] FAIL: Subscribe to response topic failed: %s\n", otaSessionResponseTopic);
+        logLine("[OTA] FAIL: Subscribe to response topic failed: %s\n", otaSessionResponseTopic);
     }
 }
 
@@ -82,6 +92,9 @@ void IotNetESP32::handleOtaMessage(const char *payload) {
         trigger.otaId,
         trigger.nonce
     );
+    if (trigger.baseVersion[0] != '\0') {
+        Serial.printf("[OTA-TRIGGER] Delta patch offered against %s\n", trigger.baseVersion);
+    }
 
     if (!iotnetesp32::ota::OtaUpdateService::storePendingSession(otaSession, trigger, millis())) {
         Serial.println("[OTA-TRIGGER] FAIL: Cannot store pending OTA state");
@@ -173,7 +186,8 @@ void IotNetESP32::handleOtaSessionResponse(const char *payload) {
         otaSession.currentSessionKey(),
         otaSession.otaId(),
         otaSession.nonce(),
-        otaSession.version()
+        otaSession.version(),
+        otaSession.baseVersion()
     );
     otaSession.clearSessionKey();
     if (!success) {
@@ -186,27 +200,53 @@ bool IotNetESP32::fetchOtaLinkWithSessionKey(
     const char *sessionKey,
     const char *otaId,
     long nonce,
-    const char *version
+    const char *version,
+    const char *baseVersion
 ) {
     Serial.println("[OTA-LINK] Fetching OTA link with session key...");
 
-    char otaUrl[256];
+    iotnetesp32::ota::OtaLinkData link;
     if (!iotnetesp32::ota::OtaUpdateService::fetchOtaUrl(
             var_3,
             sessionKey,
             otaId,
             nonce,
             version,
-            otaUrl,
-            sizeof(otaUrl)
+            &link
         )) {
         Serial.println("[OTA-LINK] FAIL: Invalid response payload");
         return false;
     }
 
-    Serial.printf("[OTA-LINK] OK: URL obtained (%zu bytes)\n", strlen(otaUrl));
+    Serial.printf("[OTA-LINK] OK: URL obtained (%zu bytes)\n", strlen(link.otaUrl));
+    const uint8_t *sha256 = link.hasSha256 ? link.sha256 : nullptr;
+    if (!sha256) {
+        if (verifiedOtaRequired) {
+            Serial.println("[OTA-LINK] FAIL: No sha256 in response, update refused");
+            return false;
+        }
+        Serial.println("[OTA-LINK] Warning: No sha256 in response, image will not be verified");
+    }
 
-    bool success = downloadAndFlashFirmware(otaUrl);
+    // The patch only applies to the firmware it was made against; the patcher
+    // also checks the running partition's CRC before writing anything.
+    bool success = false;
+    bool patchable = link.patchUrl[0] != '\0' && baseVersion && baseVersion[0] != '\0' &&
+                     strcmp(baseVersion, currentFirmwareVersion) == 0;
+    if (patchable) {
+        Serial.printf("[OTA-LINK] Applying delta patch against %s\n", baseVersion);
+        success = downloadAndPatchFirmware(link.patchUrl, sha256);
+        if (!success) {
+            Serial.println("[OTA-LINK] Patch not applied, falling back to the full image");
+        }
+    } else if (link.patchUrl[0] != '\0') {
+        Serial.printf("[OTA-LINK] Patch is for %s, running %s: using the full image\n",
+                      baseVersion && baseVersion[0] != '\0' ? baseVersion : "(unknown)",
+                      currentFirmwareVersion);
+    }
+    if (!success) {
+        success = downloadAndFlashFirmware(link.otaUrl, sha256);
+    }
     if (success) {
         Serial.println("[OTA-LINK] Update successful! Rebooting...");
         updateBoardStatusInternal("success");
@@ -219,9 +259,16 @@ bool IotNetESP32::fetchOtaLinkWithSessionKey(
     return success;
 }
 
-bool IotNetESP32::downloadAndFlashFirmware(const char *url) {
+bool IotNetESP32::downloadAndFlashFirmware(const char *url, const uint8_t *sha256) {
+    otaInProgress = true;
+    bool success = iotnetesp32::ota::FirmwareFlasher::downloadAndFlash(url, sha256, otaPipeline);
+    otaInProgress = false;
+    return success;
+}
+
+bool IotNetESP32::downloadAndPatchFirmware(const char *url, const uint8_t *sha256) {
     otaInProgress = true;
-    bool success = iotnetesp32::ota::FirmwareFlasher::downloadAndFlash(url);
+    bool success = iotnetesp32::ota::FirmwareFlasher::downloadAndPatch(url, sha256, otaPipeline);
     otaInProgress = false;
     return success;
 }
@@ -1,6 +1,14 @@
 #include "IotNetESP32.h"
 
-#include "core/TopicBuilder.h"
+#include "core/ValueCodec.h"
+
+namespace {
+
+// Serializes policy changes and admissions: virtualWrite() may run on any
+// task while run() publishes on another.
+portMUX_TYPE publishGateLock = portMUX_INITIALIZER_UNLOCKED;
+
+}
 
 bool IotNetESP32::shouldUpdate(unsigned long &lastUpdate, unsigned long interval) {
     unsigned long currentMillis = millis();
@@ -22,39 +30,261 @@ bool IotNetESP32::hasNewValue(const char *pin) {
         return false;
     }
 
-    if (!pins[pinIndex].initialized) {
-        initPinTopic(pinIndex);
-        if (mqttClient.connected()) {
-            mqttClient.subscribe(pins[pinIndex].topic);
-        }
-    }
+    ensurePinSubscribed(pinIndex);
+    return pinTable.isUpdated(pinIndex);
+}
 
-    return pins[pinIndex].updated;
+void IotNetESP32::registerCallback(const char *pin, PinDataCallback callback, void *context) {
+    addCallback(pin, callback, context);
 }
 
-void IotNetESP32::registerCallback(const char *pin, void (*callback)(String)) {
-    if (!pin || !callback) {
+#ifndef IOTNET_STATIC_MEMORY
+void IotNetESP32::registerCallback(const char *pin, StringCallback callback) {
+    if (!callback) {
         Serial.println("Error: Invalid callback registration parameters");
         return;
     }
 
+    int slot = addCallback(pin, deliverStringCallback, nullptr);
+    if (slot == iotnet::core::PinCallbackIndex::NONE) {
+        return;
+    }
+
+    stringCallbacks[slot] = callback;
+    callbacks[slot].context = &stringCallbacks[slot];
+}
+#endif
+
+void IotNetESP32::setPinPrecision(const char *pin, uint8_t decimals) {
+    int pinIndex = pin ? convertPinToIndex(pin) : -1;
+    if (pinIndex < 0 || pinIndex >= MAX_PINS) {
+        Serial.println("Error: Invalid pin for precision setting");
+        return;
+    }
+
+    if (decimals > iotnet::core::MAX_FIXED_PRECISION) {
+        decimals = iotnet::core::MAX_FIXED_PRECISION;
+    }
+    pinPrecision[pinIndex] = decimals;
+}
+
+bool IotNetESP32::setPublishPolicy(const char *pin, const PublishPolicy &policy) {
+    int pinIndex = pin ? convertPinToIndex(pin) : -1;
+    portENTER_CRITICAL(&publishGateLock);
+    bool set = publishGate.setPolicy(pinIndex, policy);
+    portEXIT_CRITICAL(&publishGateLock);
+    if (!set) {
+        Serial.println("Error: Unable to set publish policy");
+        return false;
+    }
+    return true;
+}
+
+void IotNetESP32::clearPublishPolicy(const char *pin) {
+    if (!pin) {
+        return;
+    }
     int pinIndex = convertPinToIndex(pin);
-    if (pinIndex < 0 || pinIndex >= MAX_PINS || numCallbacks >= MAX_PINS) {
+    portENTER_CRITICAL(&publishGateLock);
+    publishGate.clearPolicy(pinIndex);
+    portEXIT_CRITICAL(&publishGateLock);
+}
+
+IotNetESP32::PublishStats IotNetESP32::publishStats() const {
+    return publishGate.stats();
+}
+
+bool IotNetESP32::admitWrite(int pin, const iotnet::core::PublishSample &sample) {
+    // Pins without a policy pass on a single mask test.
+    if (!publishGate.hasPolicy(pin)) {
+        return true;
+    }
+
+    uint32_t nowMs = millis();
+    portENTER_CRITICAL(&publishGateLock);
+    bool admitted = publishGate.claim(pin, sample, nowMs);
+    portEXIT_CRITICAL(&publishGateLock);
+    return admitted;
+}
+
+void IotNetESP32::forgetWrite(int pin) {
+    if (!publishGate.hasPolicy(pin)) {
         return;
     }
 
-    callbacks[numCallbacks].pinIndex = pinIndex;
-    callbacks[numCallbacks].callback = callback;
-    numCallbacks++;
+    portENTER_CRITICAL(&publishGateLock);
+    publishGate.forget(pin);
+    portEXIT_CRITICAL(&publishGateLock);
+}
+
+void IotNetESP32::forgetWrites(uint64_t pins) {
+    while (pins != 0) {
+        forgetWrite(iotnet::core::lowestSetBit(pins));
+        pins &= pins - 1;
+    }
+}
+
+bool IotNetESP32::publishOutbound(const iotnet::core::OutboundValue &outbound, bool batching) {
+    int pinIndex = outbound.pin;
+    char topic[MAX_TOPIC_LENGTH];
+    if (!mqttClient.connected() || !buildPinTopic(pinIndex, topic, sizeof(topic))) {
+        forgetWrite(pinIndex);
+        return false;
+    }
+
+    bool published;
+    if (batching && pinIndex != 0 &&
+        appendToBatch(pinIndex, outbound.payload, outbound.length, !outbound.sample.numeric)) {
+        published = true;
+    } else {
+        published = publishAliased(pinIndex, topic, (const uint8_t *)outbound.payload,
+                                   outbound.length, pinIndex == 0);
+    }
+
+    if (published) {
+        publishGate.countSent();
+    } else {
+        forgetWrite(pinIndex);
+    }
+    return published;
+}
+
+void IotNetESP32::drainPublishQueue(bool batching) {
+    iotnet::core::OutboundValue outbound;
+    // Bounded so producers that never stop writing cannot starve the rest of run().
+    for (uint32_t i = 0; i < iotnet::core::PublishQueue::CAPACITY; i++) {
+        if (!mqttClient.connected()) {
+            break;
+        }
+        if (!publishQueue.tryPop(outbound)) {
+            break;
+        }
+        if (publishOutbound(outbound, batching)) {
+            publishQueue.recordSent();
+        } else {
+            publishQueue.recordDropped();
+        }
+    }
+}
+
+void IotNetESP32::setOverflowPolicy(OverflowPolicy policy, unsigned long blockTimeoutMs) {
+    overflowPolicy = policy;
+    overflowBlockTimeoutMs = blockTimeoutMs;
+}
+
+IotNetESP32::PublishQueueStats IotNetESP32::publishQueueStats() const {
+    return publishQueue.stats();
+}
+
+void IotNetESP32::enableBatching(unsigned long windowMs) {
+    batchWindowMs = windowMs;
+    batchingEnabled.store(true, std::memory_order_release);
+}
+
+void IotNetESP32::disableBatching() {
+    batchingEnabled.store(false, std::memory_order_release);
+    // The network task flushes what is left on its next pass.
+    if (!networkTask) {
+        flushBatch();
+    }
+}
+
+bool IotNetESP32::appendToBatch(int pin, const char *value, size_t length, bool quoted) {
+    if (batchFrame.contains(pin)) {
+        flushBatch();
+    }
 
-    if (!pins[pinIndex].initialized) {
-        initPinTopic(pinIndex);
-        if (mqttClient.connected()) {
-            mqttClient.subscribe(pins[pinIndex].topic);
+    // A second attempt only helps when the first one failed for lack of room.
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool wasEmpty = batchFrame.isEmpty();
+        bool appended = quoted ? batchFrame.appendText(pin, value, length)
+                               : batchFrame.appendValue(pin, value, length);
+        if (appended) {
+            if (wasEmpty) {
+                batchOpenedAt = millis();
+            }
+            return true;
         }
+        if (wasEmpty) {
+            break;
+        }
+        flushBatch();
     }
+    return false;
 }
 
+bool IotNetESP32::flushBatch() {
+    if (batchFrame.isEmpty()) {
+        return true;
+    }
+
+    char topic[MAX_TOPIC_LENGTH];
+    bool topicBuilt = topicRouter.prefix().buildTopic("batch", topic);
+
+    size_t frameLength = 0;
+    const char *frame = batchFrame.finish(&frameLength);
+    bool published = topicBuilt && mqttClient.connected() &&
+                     publishAliased(BATCH_ALIAS_KEY, topic, (const uint8_t *)frame,
+                                    frameLength, false);
+    if (!published) {
+        Serial.println("[MQTT] FAIL: Could not publish batched pin values");
+        // The values are lost; let the publish gates admit them again.
+        forgetWrites(batchFrame.pins());
+    }
+
+    batchFrame.reset();
+    return published;
+}
+
+// Sends the full topic until the broker has seen it with its alias, then only
+// the alias. Without MQTT 5 aliases this is a plain publish.
+bool IotNetESP32::publishAliased(
+    int aliasKey,
+    const char *topic,
+    const uint8_t *payload,
+    size_t length,
+    bool retain
+) {
+    bool established = false;
+    uint16_t alias = topicAliases.aliasFor(aliasKey, established);
+    if (!mqttClient.publish(established ? nullptr : topic, payload, length, retain, 0, alias)) {
+        return false;
+    }
+    if (alias != 0) {
+        topicAliases.markEstablished(aliasKey);
+    }
+    return true;
+}
+
+int IotNetESP32::addCallback(const char *pin, PinDataCallback callback, void *context) {
+    if (!pin || !callback) {
+        Serial.println("Error: Invalid callback registration parameters");
+        return iotnet::core::PinCallbackIndex::NONE;
+    }
+
+    int pinIndex = convertPinToIndex(pin);
+    int slot = callbackIndex.add(pinIndex);
+    if (slot == iotnet::core::PinCallbackIndex::NONE) {
+        return slot;
+    }
+
+    callbacks[slot].handler = callback;
+    callbacks[slot].context = context;
+
+    ensurePinSubscribed(pinIndex);
+    return slot;
+}
+
+#ifndef IOTNET_STATIC_MEMORY
+// Adapter for the String overload: builds the String the legacy signature
+// expects on top of the allocation-free view.
+void IotNetESP32::deliverStringCallback(const char *data, size_t length, void *context) {
+    (void)length;
+    StringCallback callback = *static_cast<StringCallback *>(context);
+    callback(String(data));
+}
+#endif
+
 int IotNetESP32::convertPinToIndex(const char *pin) {
     if (!pin || pin[0] != 'V') {
         return -1;
@@ -62,72 +292,115 @@ int IotNetESP32::convertPinToIndex(const char *pin) {
     return atoi(pin + 1);
 }
 
-void IotNetESP32::initPinTopic(int pin) {
-    if (pin < 0 || pin >= MAX_PINS || pins[pin].initialized) {
-        return;
+bool IotNetESP32::initPin(int pin) {
+    if (!iotnet::core::PinTable::isValidPin(pin)) {
+        return false;
     }
 
-    if (!credentials.mqttUsername || !credentials.boardIdentifier) {
-        Serial.println("Error: Cannot initialize pin topic - MQTT username or board name is not set");
-        return;
+    if (pinTable.isInitialized(pin)) {
+        return true;
     }
 
-    if (!iotnet::core::buildPinTopic(
-            pins[pin].topic,
-            sizeof(pins[pin].topic),
-            credentials.mqttUsername,
-            credentials.boardIdentifier,
-            pin
-        )) {
-        Serial.println("Error: Failed to build pin topic");
-        return;
+    if (!topicRouter.isConfigured()) {
+        Serial.println("Error: Cannot initialize pin - MQTT username or board name is not set");
+        return false;
     }
 
-    pins[pin].initialized = true;
-    pins[pin].value[0] = '\0';
-    pins[pin].updated = false;
+    pinTable.markInitialized(pin);
+    return true;
+}
+
+bool IotNetESP32::buildPinTopic(int pin, char *outTopic, size_t outSize) {
+    if (!topicRouter.buildPinTopic(pin, outTopic, outSize)) {
+        Serial.println("Error: Failed to build pin topic");
+        return false;
+    }
+    return true;
 }
 
-void IotNetESP32::mqttCallback(char *topic, byte *payload, unsigned int length) {
-    if (!topic || !payload || length == 0) {
+// Runs on the application side: records the request for whichever task owns
+// the connection instead of touching the client.
+void IotNetESP32::ensurePinSubscribed(int pin) {
+    if (pinTable.isInitialized(pin) || !initPin(pin)) {
         return;
     }
+    pendingSubscriptions.add(pin);
+}
 
-    char message[MAX_MESSAGE_BUFFER_SIZE];
-    if (!copyPayloadToBuffer(payload, length, message, sizeof(message))) {
-        Serial.printf("Warning: Dropping oversized MQTT message on topic %s (len=%u)\n", topic, length);
+void IotNetESP32::subscribePendingPins() {
+    if (!mqttClient.connected()) {
         return;
     }
 
-    if (otaUpdatesEnabled && strlen(otaSessionResponseTopic) > 0 &&
-        strcmp(topic, otaSessionResponseTopic) == 0) {
-        handleOtaSessionResponse(message);
+    // Also used under the wildcard: a pin first needed while online gets its
+    // own SUBSCRIBE so the broker sends its retained value. Reconnects only
+    // renew the wildcard.
+    uint64_t pending = pendingSubscriptions.takeAll();
+    char topic[MAX_TOPIC_LENGTH];
+    while (pending != 0) {
+        int pin = iotnet::core::lowestSetBit(pending);
+        pending &= pending - 1;
+        if (buildPinTopic(pin, topic, sizeof(topic)) &&
+            mqttClient.subscribe(topic, subscriptionQos())) {
+            subscribedPins |= iotnet::core::PinTable::bit(pin);
+        } else {
+            pendingSubscriptions.add(pin);
+        }
+    }
+}
+
+void IotNetESP32::mqttCallback(const iotnet::core::MqttPublish &publish) {
+    if (publish.payloadLength == 0) {
         return;
     }
 
-    if (otaUpdatesEnabled && strlen(otaTopic) > 0 && strcmp(topic, otaTopic) == 0) {
-        handleOtaMessage(message);
+    // Topic and payload are views into the receive buffer; only the payload
+    // is copied, as handlers expect a NUL-terminated string.
+    char message[MAX_MESSAGE_BUFFER_SIZE];
+    if (publish.truncated ||
+        !copyPayloadToBuffer(publish.payload, publish.payloadLength, message, sizeof(message))) {
+        logLine("Warning: Dropping oversized MQTT message on topic %.*s\n",
+                static_cast<int>(publish.topicLength), publish.topic);
         return;
     }
 
-    for (int i = 0; i < MAX_PINS; i++) {
-        if (!pins[i].initialized) {
-            continue;
+    iotnet::core::TopicRoute route = topicRouter.route(publish.topic, publish.topicLength);
+    switch (route.kind) {
+    case iotnet::core::TopicKind::OtaSessionResponse:
+        if (otaUpdatesEnabled && otaSessionResponseTopic[0] != '\0') {
+            // OTA goes through HTTPClient and Update, which allocate.
+            iotnet::core::AllocationGuard::Exempt exempt;
+            handleOtaSessionResponse(message);
         }
-
-        if (strcmp(topic, pins[i].topic) != 0) {
-            continue;
+        return;
+    case iotnet::core::TopicKind::OtaTrigger:
+        if (otaUpdatesEnabled && otaTopic[0] != '\0') {
+            iotnet::core::AllocationGuard::Exempt exempt;
+            handleOtaMessage(message);
         }
+        return;
+    case iotnet::core::TopicKind::Pin:
+        break;
+    default:
+        return;
+    }
 
-        if (strcmp(pins[i].value, message) == 0) {
-            break;
-        }
+    if (route.pin >= MAX_PINS) {
+        return;
+    }
+    if ((subscribedPins & iotnet::core::PinTable::bit(route.pin)) == 0) {
+        return;
+    }
 
-        strncpy(pins[i].value, message, sizeof(pins[i].value) - 1);
-        pins[i].value[sizeof(pins[i].value) - 1] = '\0';
-        pins[i].updated = true;
-        break;
+    if (!networkTask) {
+        pinTable.storeValue(route.pin, message);
+        return;
     }
+
+    // Newer values matter more than older ones when the app falls behind.
+    iotnet::core::InboundValue inbound;
+    inbound.assign(route.pin, message);
+    inboundQueue.pushEvictingOldest(inbound, nullptr);
 }
 
 bool IotNetESP32::copyPayloadToBuffer(
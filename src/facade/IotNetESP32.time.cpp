@@ -9,35 +9,44 @@ unsigned long IotNetESP32::getExecutionTime() {
     return 0;
 }
 
-String IotNetESP32::getFormattedExecutionTime() {
-    unsigned long totalTime = getExecutionTime();
-    if (totalTime == 0) {
-        return "0ms";
+size_t IotNetESP32::formatExecutionTime(char *buffer, size_t bufferSize) {
+    if (!buffer || bufferSize == 0) {
+        return 0;
     }
 
-    String formattedTime;
-
+    unsigned long totalTime = getExecutionTime();
     unsigned long hours = totalTime / 3600000;
     unsigned long minutes = (totalTime % 3600000) / 60000;
     unsigned long seconds = (totalTime % 60000) / 1000;
     unsigned long milliseconds = totalTime % 1000;
 
+    int written;
     if (hours > 0) {
-        formattedTime += String(hours) + "h ";
-    }
-
-    if (minutes > 0 || hours > 0) {
-        formattedTime += String(minutes) + "m ";
+        written = snprintf(buffer, bufferSize, "%luh %lum %lus %lums", hours, minutes, seconds,
+                           milliseconds);
+    } else if (minutes > 0) {
+        written = snprintf(buffer, bufferSize, "%lum %lus %lums", minutes, seconds,
+                           milliseconds);
+    } else if (seconds > 0) {
+        written = snprintf(buffer, bufferSize, "%lus %lums", seconds, milliseconds);
+    } else {
+        written = snprintf(buffer, bufferSize, "%lums", milliseconds);
     }
 
-    if (seconds > 0 || minutes > 0 || hours > 0) {
-        formattedTime += String(seconds) + "s ";
+    if (written < 0 || static_cast<size_t>(written) >= bufferSize) {
+        buffer[0] = '\0';
+        return 0;
     }
+    return static_cast<size_t>(written);
+}
 
-    formattedTime += String(milliseconds) + "ms";
-
-    return formattedTime;
+#ifndef IOTNET_STATIC_MEMORY
+String IotNetESP32::getFormattedExecutionTime() {
+    char buffer[48];
+    formatExecutionTime(buffer, sizeof(buffer));
+    return String(buffer);
 }
+#endif
 
 void IotNetESP32::configureTime(
     const char *timezone,
@@ -68,7 +77,9 @@ void IotNetESP32::configureTime(
     if (isTimeSet()) {
         timeConfigured = true;
         Serial.println("Time synchronized with NTP server");
-        Serial.printf("Current time: %s\n", getFormattedTime().c_str());
+        char now[80];
+        formatTime(now, sizeof(now));
+        Serial.printf("Current time: %s\n", now);
     } else {
         Serial.println("Failed to synchronize time with NTP server");
     }
@@ -79,17 +90,33 @@ bool IotNetESP32::isTimeSet() {
     return now > 1600000000;
 }
 
-String IotNetESP32::getFormattedTime(const char *format) {
-    if (!isTimeSet()) {
-        return "Time not synchronized";
+size_t IotNetESP32::formatTime(char *buffer, size_t bufferSize, const char *format) {
+    if (!buffer || bufferSize == 0 || !format) {
+        return 0;
     }
 
-    time_t now = time(nullptr);
-    struct tm timeinfo;
-    char buffer[80];
-
-    localtime_r(&now, &timeinfo);
-    strftime(buffer, sizeof(buffer), format, &timeinfo);
+    size_t written;
+    if (isTimeSet()) {
+        time_t now = time(nullptr);
+        struct tm timeinfo;
+        localtime_r(&now, &timeinfo);
+        written = strftime(buffer, bufferSize, format, &timeinfo);
+    } else {
+        const char *notSet = "Time not synchronized";
+        written = strlen(notSet) < bufferSize ? strlen(notSet) : 0;
+        memcpy(buffer, notSet, written);
+        buffer[written] = '\0';
+    }
+    if (written == 0) {
+        buffer[0] = '\0';
+    }
+    return written;
+}
 
+#ifndef IOTNET_STATIC_MEMORY
+String IotNetESP32::getFormattedTime(const char *format) {
+    char buffer[80];
+    formatTime(buffer, sizeof(buffer), format);
     return String(buffer);
 }
+#endif
@@ -1,190 +1,265 @@
 #include "IotNetESP32.h"
 
+#include <limits.h>
+
+#include "core/ValueCodec.h"
+
+namespace {
+
+size_t copyText(const char *text, char *buffer, size_t bufferSize) {
+    if (!buffer || bufferSize == 0) {
+        return 0;
+    }
+    if (!text) {
+        buffer[0] = '\0';
+        return 0;
+    }
+    size_t length = strnlen(text, bufferSize - 1);
+    memcpy(buffer, text, length);
+    buffer[length] = '\0';
+    return length;
+}
+
+}
+
 // toString specializations
-template <> const char *IotNetESP32::toString<float>(float value, char *buffer, size_t bufferSize) {
-    if (!buffer || bufferSize == 0)
-        return "";
-    snprintf(buffer, bufferSize, "%.2f", value);
-    return buffer;
+template <>
+size_t IotNetESP32::toString<float>(float value, uint8_t precision, char *buffer,
+                                    size_t bufferSize) {
+    return iotnet::core::formatFixed(value, precision, buffer, bufferSize);
 }
 
 template <>
-const char *IotNetESP32::toString<double>(double value, char *buffer, size_t bufferSize) {
-    if (!buffer || bufferSize == 0)
-        return "";
-    snprintf(buffer, bufferSize, "%.2f", value);
-    return buffer;
+size_t IotNetESP32::toString<double>(double value, uint8_t precision, char *buffer,
+                                     size_t bufferSize) {
+    return iotnet::core::formatFixed(value, precision, buffer, bufferSize);
 }
 
-template <> const char *IotNetESP32::toString<int>(int value, char *buffer, size_t bufferSize) {
-    if (!buffer || bufferSize == 0)
-        return "";
-    snprintf(buffer, bufferSize, "%d", value);
-    return buffer;
+template <>
+size_t IotNetESP32::toString<int>(int value, uint8_t, char *buffer, size_t bufferSize) {
+    return iotnet::core::formatInteger(value, buffer, bufferSize);
 }
 
 template <>
-const char *IotNetESP32::toString<unsigned int>(unsigned int value, char *buffer,
-                                                size_t bufferSize) {
-    if (!buffer || bufferSize == 0)
-        return "";
-    snprintf(buffer, bufferSize, "%u", value);
-    return buffer;
+size_t IotNetESP32::toString<unsigned int>(unsigned int value, uint8_t, char *buffer,
+                                           size_t bufferSize) {
+    return iotnet::core::formatUnsigned(value, buffer, bufferSize);
 }
 
-template <> const char *IotNetESP32::toString<long>(long value, char *buffer, size_t bufferSize) {
-    if (!buffer || bufferSize == 0)
-        return "";
-    snprintf(buffer, bufferSize, "%ld", value);
-    return buffer;
+template <>
+size_t IotNetESP32::toString<long>(long value, uint8_t, char *buffer, size_t bufferSize) {
+    return iotnet::core::formatInteger(value, buffer, bufferSize);
 }
 
 template <>
-const char *IotNetESP32::toString<unsigned long>(unsigned long value, char *buffer,
-                                                 size_t bufferSize) {
-    if (!buffer || bufferSize == 0)
-        return "";
-    snprintf(buffer, bufferSize, "%lu", value);
-    return buffer;
+size_t IotNetESP32::toString<unsigned long>(unsigned long value, uint8_t, char *buffer,
+                                            size_t bufferSize) {
+    return iotnet::core::formatUnsigned(value, buffer, bufferSize);
 }
 
 template <>
-const char *IotNetESP32::toString<const char *>(const char *value, char *buffer,
-                                                size_t bufferSize) {
-    if (!buffer || bufferSize == 0)
-        return "";
-    if (!value) {
-        buffer[0] = '\0';
-        return buffer;
-    }
-    strncpy(buffer, value, bufferSize - 1);
-    buffer[bufferSize - 1] = '\0';
-    return buffer;
+size_t IotNetESP32::toString<long long>(long long value, uint8_t, char *buffer,
+                                        size_t bufferSize) {
+    return iotnet::core::formatInteger(value, buffer, bufferSize);
 }
 
-template <> const char *IotNetESP32::toString<bool>(bool value, char *buffer, size_t bufferSize) {
-    if (!buffer || bufferSize == 0)
-        return "";
-    strncpy(buffer, value ? "true" : "false", bufferSize - 1);
-    buffer[bufferSize - 1] = '\0';
-    return buffer;
+template <>
+size_t IotNetESP32::toString<unsigned long long>(unsigned long long value, uint8_t,
+                                                 char *buffer, size_t bufferSize) {
+    return iotnet::core::formatUnsigned(value, buffer, bufferSize);
 }
 
 template <>
-const char *IotNetESP32::toString<String>(String value, char *buffer, size_t bufferSize) {
-    if (!buffer || bufferSize == 0)
-        return "";
-    strncpy(buffer, value.c_str(), bufferSize - 1);
-    buffer[bufferSize - 1] = '\0';
-    return buffer;
+size_t IotNetESP32::toString<const char *>(const char *value, uint8_t, char *buffer,
+                                           size_t bufferSize) {
+    return copyText(value, buffer, bufferSize);
 }
 
-template <> int IotNetESP32::fromString<int>(const String &str) {
-    return str.toInt();
+template <>
+size_t IotNetESP32::toString<bool>(bool value, uint8_t, char *buffer, size_t bufferSize) {
+    return copyText(value ? "true" : "false", buffer, bufferSize);
 }
 
-template <> unsigned int IotNetESP32::fromString<unsigned int>(const String &str) {
-    return (unsigned int)str.toInt();
+#ifndef IOTNET_STATIC_MEMORY
+template <>
+size_t IotNetESP32::toString<String>(String value, uint8_t, char *buffer, size_t bufferSize) {
+    return copyText(value.c_str(), buffer, bufferSize);
 }
+#endif
 
-template <> long IotNetESP32::fromString<long>(const String &str) {
-    return str.toInt();
+template <> bool IotNetESP32::fromChars<int>(const char *text, size_t length, int &out) {
+    long long value = 0;
+    if (!iotnet::core::parseInteger(text, length, INT_MIN, INT_MAX, &value)) {
+        return false;
+    }
+    out = static_cast<int>(value);
+    return true;
 }
 
-template <> unsigned long IotNetESP32::fromString<unsigned long>(const String &str) {
-    return (unsigned long)str.toInt();
+template <>
+bool IotNetESP32::fromChars<unsigned int>(const char *text, size_t length, unsigned int &out) {
+    unsigned long long value = 0;
+    if (!iotnet::core::parseUnsigned(text, length, UINT_MAX, &value)) {
+        return false;
+    }
+    out = static_cast<unsigned int>(value);
+    return true;
 }
 
-template <> float IotNetESP32::fromString<float>(const String &str) {
-    return str.toFloat();
+template <> bool IotNetESP32::fromChars<long>(const char *text, size_t length, long &out) {
+    long long value = 0;
+    if (!iotnet::core::parseInteger(text, length, LONG_MIN, LONG_MAX, &value)) {
+        return false;
+    }
+    out = static_cast<long>(value);
+    return true;
 }
 
-template <> double IotNetESP32::fromString<double>(const String &str) {
-    return str.toDouble();
+template <>
+bool IotNetESP32::fromChars<unsigned long>(const char *text, size_t length, unsigned long &out) {
+    unsigned long long value = 0;
+    if (!iotnet::core::parseUnsigned(text, length, ULONG_MAX, &value)) {
+        return false;
+    }
+    out = static_cast<unsigned long>(value);
+    return true;
 }
 
-template <> bool IotNetESP32::fromString<bool>(const String &str) {
-    return str.equalsIgnoreCase("true") || str == "1" || str.toInt() > 0;
+template <> bool IotNetESP32::fromChars<float>(const char *text, size_t length, float &out) {
+    return iotnet::core::parseFloat(text, length, &out);
 }
 
-template <> String IotNetESP32::fromString<String>(const String &str) {
-    return str;
+template <> bool IotNetESP32::fromChars<double>(const char *text, size_t length, double &out) {
+    return iotnet::core::parseDouble(text, length, &out);
 }
 
-template <> char *IotNetESP32::fromString<char *>(const String &str) {
-    return const_cast<char *>(str.c_str());
+template <> bool IotNetESP32::fromChars<bool>(const char *text, size_t length, bool &out) {
+    return iotnet::core::parseBool(text, length, &out);
 }
 
-template <typename T> bool IotNetESP32::virtualWrite(const char *pin, T value) {
-    return publishToPin(pin, value);
+#ifndef IOTNET_STATIC_MEMORY
+template <> bool IotNetESP32::fromChars<String>(const char *text, size_t length, String &out) {
+    (void)length;
+    out = String(text);
+    return true;
 }
+#endif
 
-template <typename T> T IotNetESP32::virtualRead(const char *pin) {
-    if (!pin) {
-        return T();
+template <typename T> bool IotNetESP32::virtualWrite(const char *pin, T value) {
+    int pinIndex = pin ? convertPinToIndex(pin) : -1;
+    if (pinIndex < 0 || pinIndex >= MAX_PINS) {
+        return false;
     }
 
-    int pinIndex = convertPinToIndex(pin);
-    if (pinIndex < 0 || pinIndex >= MAX_PINS) {
-        return T();
+    // Suppressed writes stop here: nothing is formatted or queued.
+    iotnet::core::PublishSample sample = publishSample(value);
+    if (!admitWrite(pinIndex, sample)) {
+        return true;
     }
 
-    if (!pins[pinIndex].initialized) {
-        initPinTopic(pinIndex);
-        if (mqttClient.connected()) {
-            mqttClient.subscribe(pins[pinIndex].topic);
+    iotnet::core::OutboundValue outbound;
+    makeOutbound(pinIndex, value, sample, outbound);
+
+    if (overflowPolicy != OverflowPolicy::Block) {
+        uint64_t evictedPins = 0;
+        bool pushed = publishQueue.push(outbound, overflowPolicy, &evictedPins);
+        // Values DropOldest discarded were never published. This pin's gate
+        // already holds the newer value.
+        forgetWrites(evictedPins & ~iotnet::core::PinTable::bit(pinIndex));
+        if (!pushed) {
+            forgetWrite(pinIndex);
+            return false;
         }
+        return true;
     }
 
-    if (!pins[pinIndex].updated) {
-        return T();
+    unsigned long start = millis();
+    while (!publishQueue.tryPush(outbound)) {
+        if (millis() - start >= overflowBlockTimeoutMs) {
+            publishQueue.recordDropped();
+            forgetWrite(pinIndex);
+            return false;
+        }
+        vTaskDelay(1);
     }
+    return true;
+}
 
-    pins[pinIndex].updated = false;
-    String value = String(pins[pinIndex].value);
-
-    if (value.isEmpty()) {
+template <typename T> T IotNetESP32::virtualRead(const char *pin) {
+    T value = T();
+    if (tryRead(pin, value) != ReadStatus::Ok) {
         return T();
     }
-    return fromString<T>(value);
+    return value;
 }
 
-template <typename T> bool IotNetESP32::publishToPin(const char *pin, T value) {
-    if (!pin || !mqttClient.connected()) {
-        return false;
+template <typename T> IotNetESP32::ReadStatus IotNetESP32::tryRead(const char *pin, T &out) {
+    if (!pin) {
+        return ReadStatus::NoUpdate;
     }
 
     int pinIndex = convertPinToIndex(pin);
+    if (!iotnet::core::PinTable::isValidPin(pinIndex)) {
+        return ReadStatus::NoUpdate;
+    }
+
+    ensurePinSubscribed(pinIndex);
+
+    if (!pinTable.isUpdated(pinIndex)) {
+        return ReadStatus::NoUpdate;
+    }
+
+    pinTable.clearUpdated(pinIndex);
+    if (!fromChars(pinTable.value(pinIndex), pinTable.valueLength(pinIndex), out)) {
+        return ReadStatus::ParseError;
+    }
+    return ReadStatus::Ok;
+}
+
+template <typename T> bool IotNetESP32::publishToPin(const char *pin, T value) {
+    int pinIndex = pin ? convertPinToIndex(pin) : -1;
     if (pinIndex < 0 || pinIndex >= MAX_PINS) {
         return false;
     }
 
-    if (!pins[pinIndex].initialized) {
-        initPinTopic(pinIndex);
+    iotnet::core::PublishSample sample = publishSample(value);
+    if (!admitWrite(pinIndex, sample)) {
+        return true;
     }
+    iotnet::core::OutboundValue outbound;
+    makeOutbound(pinIndex, value, sample, outbound);
+    return publishOutbound(outbound, batchingEnabled.load(std::memory_order_acquire));
+}
 
-    char valueStr[32];
-    toString(value, valueStr, sizeof(valueStr));
+// Only formats; safe to call from any task.
+template <typename T>
+void IotNetESP32::makeOutbound(int pin, T value, const iotnet::core::PublishSample &sample,
+                               iotnet::core::OutboundValue &out) {
+    out.pin = static_cast<int8_t>(pin);
+    out.length =
+        static_cast<uint8_t>(toString(value, pinPrecision[pin], out.payload, sizeof(out.payload)));
+    out.sample = sample;
+}
 
-    if (pinIndex == 0) {
-        return mqttClient.publish(pins[pinIndex].topic, (const uint8_t *)valueStr, strlen(valueStr),
-                                  true);
-    } else {
-        return mqttClient.publish(pins[pinIndex].topic, (const uint8_t *)valueStr, strlen(valueStr),
-                                  false);
-    }
+template <typename T> iotnet::core::PublishSample IotNetESP32::publishSample(T value) {
+    return iotnet::core::numericSample(static_cast<double>(value));
 }
 
-template <typename T> const char *IotNetESP32::toString(T value, char *buffer, size_t bufferSize) {
-    if (!buffer || bufferSize == 0) {
-        return "";
-    }
-    snprintf(buffer, bufferSize, "%d", static_cast<int>(value));
-    return buffer;
+template <>
+iotnet::core::PublishSample IotNetESP32::publishSample<const char *>(const char *value) {
+    return value ? iotnet::core::textSample(value, strlen(value))
+                 : iotnet::core::textSample("", 0);
+}
+
+#ifndef IOTNET_STATIC_MEMORY
+template <> iotnet::core::PublishSample IotNetESP32::publishSample<String>(String value) {
+    return iotnet::core::textSample(value.c_str(), value.length());
 }
+#endif
 
-template <typename T> T IotNetESP32::fromString(const String &str) {
-    return static_cast<T>(str.toInt());
+template <typename T>
+size_t IotNetESP32::toString(T value, uint8_t, char *buffer, size_t bufferSize) {
+    return iotnet::core::formatInteger(static_cast<long long>(value), buffer, bufferSize);
 }
 
 template bool IotNetESP32::publishToPin<int>(const char *pin, int value);
@@ -194,8 +269,12 @@ template bool IotNetESP32::publishToPin<bool>(const char *pin, bool value);
 template bool IotNetESP32::publishToPin<unsigned int>(const char *pin, unsigned int value);
 template bool IotNetESP32::publishToPin<long>(const char *pin, long value);
 template bool IotNetESP32::publishToPin<unsigned long>(const char *pin, unsigned long value);
+template bool IotNetESP32::publishToPin<long long>(const char *pin, long long value);
+template bool IotNetESP32::publishToPin<unsigned long long>(const char *pin, unsigned long long value);
 template bool IotNetESP32::publishToPin<const char *>(const char *pin, const char *value);
+#ifndef IOTNET_STATIC_MEMORY
 template bool IotNetESP32::publishToPin<String>(const char *pin, String value);
+#endif
 
 template bool IotNetESP32::virtualWrite<int>(const char *pin, int value);
 template bool IotNetESP32::virtualWrite<float>(const char *pin, float value);
@@ -204,8 +283,12 @@ template bool IotNetESP32::virtualWrite<bool>(const char *pin, bool value);
 template bool IotNetESP32::virtualWrite<unsigned int>(const char *pin, unsigned int value);
 template bool IotNetESP32::virtualWrite<long>(const char *pin, long value);
 template bool IotNetESP32::virtualWrite<unsigned long>(const char *pin, unsigned long value);
+template bool IotNetESP32::virtualWrite<long long>(const char *pin, long long value);
+template bool IotNetESP32::virtualWrite<unsigned long long>(const char *pin, unsigned long long value);
 template bool IotNetESP32::virtualWrite<const char *>(const char *pin, const char *value);
+#ifndef IOTNET_STATIC_MEMORY
 template bool IotNetESP32::virtualWrite<String>(const char *pin, String value);
+#endif
 
 template int IotNetESP32::virtualRead<int>(const char *pin);
 template float IotNetESP32::virtualRead<float>(const char *pin);
@@ -214,4 +297,19 @@ template bool IotNetESP32::virtualRead<bool>(const char *pin);
 template unsigned int IotNetESP32::virtualRead<unsigned int>(const char *pin);
 template long IotNetESP32::virtualRead<long>(const char *pin);
 template unsigned long IotNetESP32::virtualRead<unsigned long>(const char *pin);
+#ifndef IOTNET_STATIC_MEMORY
 template String IotNetESP32::virtualRead<String>(const char *pin);
+#endif
+
+template IotNetESP32::ReadStatus IotNetESP32::tryRead<int>(const char *pin, int &out);
+template IotNetESP32::ReadStatus IotNetESP32::tryRead<float>(const char *pin, float &out);
+template IotNetESP32::ReadStatus IotNetESP32::tryRead<double>(const char *pin, double &out);
+template IotNetESP32::ReadStatus IotNetESP32::tryRead<bool>(const char *pin, bool &out);
+template IotNetESP32::ReadStatus IotNetESP32::tryRead<unsigned int>(const char *pin,
+                                                                    unsigned int &out);
+template IotNetESP32::ReadStatus IotNetESP32::tryRead<long>(const char *pin, long &out);
+template IotNetESP32::ReadStatus IotNetESP32::tryRead<unsigned long>(const char *pin,
+                                                                     unsigned long &out);
+#ifndef IOTNET_STATIC_MEMORY
+template IotNetESP32::ReadStatus IotNetESP32::tryRead<String>(const char *pin, String &out);
+#endif
@@ -0,0 +1,329 @@
+#include "mqtt/MqttClient.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+namespace iotnetesp32::mqtt {
+
+using iotnet::core::MqttPacket;
+using iotnet::core::MqttPacketReader;
+using iotnet::core::MqttPacketType;
+using iotnet::core::StepResult;
+
+MqttClient::MqttClient(Client &transport)
+    : transport(transport), host(nullptr), port(0), keepAliveSeconds(60), timeoutMs(15000),
+      handler(nullptr), handlerContext(nullptr), subackHandler(nullptr), subackContext(nullptr),
+      reader(rxBuffer, sizeof(rxBuffer)),
+      current(State::Disconnected), connectStartedMs(0), lastSentMs(0), lastReceivedMs(0),
+      pingOutstanding(false), session(false), returnCode(0xff),
+      version(iotnet::core::MqttVersion::V311), aliasMaximum(0), lastPacketId(0),
+      unacknowledged(0) {}
+
+void MqttClient::setServer(const char *serverHost, uint16_t serverPort) {
+    host = serverHost;
+    port = serverPort;
+}
+
+void MqttClient::setKeepAlive(uint16_t seconds) {
+    keepAliveSeconds = seconds;
+}
+
+void MqttClient::setTimeout(uint16_t seconds) {
+    timeoutMs = static_cast<uint32_t>(seconds) * 1000;
+}
+
+void MqttClient::setMessageHandler(MessageHandler messageHandler, void *context) {
+    handler = messageHandler;
+    handlerContext = context;
+}
+
+void MqttClient::setSubackHandler(SubackHandler ackHandler, void *context) {
+    subackHandler = ackHandler;
+    subackContext = context;
+}
+
+bool MqttClient::startConnect(const iotnet::core::MqttConnectOptions &options) {
+    if (!transport.connected()) {
+        return false;
+    }
+
+    // The keep-alive set on the client is the one loop() enforces.
+    iotnet::core::MqttConnectOptions packet = options;
+    packet.keepAliveSeconds = keepAliveSeconds;
+    size_t length = iotnet::core::encodeConnect(txBuffer, sizeof(txBuffer), packet);
+    if (length == 0) {
+        return false;
+    }
+
+    reader.reset();
+    session = false;
+    returnCode = 0xff;
+    version = options.version;
+    aliasMaximum = 0;
+    pingOutstanding = false;
+    unacknowledged = 0;
+    current = State::Connecting;
+    connectStartedMs = millis();
+    lastReceivedMs = connectStartedMs;
+    return send(txBuffer, length);
+}
+
+StepResult MqttClient::pollConnect() {
+    if (current == State::Connected) {
+        return StepResult::Done;
+    }
+    if (current != State::Connecting || !receive()) {
+        return StepResult::Failed;
+    }
+    if (current == State::Connected) {
+        return StepResult::Done;
+    }
+    if (current == State::Disconnected) {
+        return StepResult::Failed;
+    }
+    if (!transport.connected() || millis() - connectStartedMs >= timeoutMs) {
+        close();
+        return StepResult::Failed;
+    }
+    return StepResult::Pending;
+}
+
+bool MqttClient::connect(const iotnet::core::MqttConnectOptions &options) {
+    if (!transport.connected() && (!host || !transport.connect(host, port))) {
+        return false;
+    }
+    if (!startConnect(options)) {
+        return false;
+    }
+
+    StepResult result = pollConnect();
+    while (result == StepResult::Pending) {
+        delay(1);
+        result = pollConnect();
+    }
+    return result == StepResult::Done;
+}
+
+bool MqttClient::publish(const char *topic, const uint8_t *payload, size_t length, bool retain,
+                         uint8_t qos, uint16_t topicAlias) {
+    if (!connected() || qos > 1 || (length > 0 && !payload)) {
+        return false;
+    }
+
+    uint16_t packetId = qos > 0 ? nextPacketId() : 0;
+    size_t headerLength = iotnet::core::encodePublishHeader(
+        txBuffer, sizeof(txBuffer), topic, length, qos, retain, packetId, version, topicAlias);
+    if (headerLength == 0) {
+        return false;
+    }
+
+    // One write, and with TLS one record, whenever the packet fits the buffer.
+    bool sent;
+    if (headerLength + length <= sizeof(txBuffer)) {
+        if (length > 0) {
+            memcpy(txBuffer + headerLength, payload, length);
+        }
+        sent = send(txBuffer, headerLength + length);
+    } else {
+        sent = send(txBuffer, headerLength) && send(payload, length);
+    }
+
+    if (sent && qos > 0) {
+        unacknowledged++;
+    }
+    return sent;
+}
+
+bool MqttClient::subscribe(const char *topic, uint8_t qos, uint16_t *outPacketId) {
+    iotnet::core::MqttSubscription subscription = {topic, qos};
+    return subscribe(&subscription, 1, outPacketId);
+}
+
+bool MqttClient::subscribe(const iotnet::core::MqttSubscription *subscriptions, size_t count,
+                           uint16_t *outPacketId) {
+    if (!connected()) {
+        return false;
+    }
+    uint16_t packetId = nextPacketId();
+    size_t length = iotnet::core::encodeSubscribe(txBuffer, sizeof(txBuffer), packetId,
+                                                  subscriptions, count, version);
+    if (length == 0 || !send(txBuffer, length)) {
+        return false;
+    }
+    if (outPacketId) {
+        *outPacketId = packetId;
+    }
+    return true;
+}
+
+bool MqttClient::loop() {
+    if (!connected() || !receive()) {
+        return false;
+    }
+
+    uint32_t keepAliveMs = static_cast<uint32_t>(keepAliveSeconds) * 1000;
+    uint32_t now = millis();
+    if (keepAliveMs != 0 &&
+        (now - lastReceivedMs >= keepAliveMs || now - lastSentMs >= keepAliveMs)) {
+        if (pingOutstanding) {
+            // The broker missed a whole keep-alive period.
+            close();
+            return false;
+        }
+        uint8_t ping[2];
+        if (!send(ping, iotnet::core::encodePingreq(ping, sizeof(ping)))) {
+            return false;
+        }
+        pingOutstanding = true;
+        lastReceivedMs = now;
+    }
+    return true;
+}
+
+void MqttClient::disconnect() {
+    if (current != State::Disconnected && transport.connected()) {
+        uint8_t packet[2];
+        transport.write(packet, iotnet::core::encodeDisconnect(packet, sizeof(packet)));
+    }
+    close();
+}
+
+bool MqttClient::connected() {
+    if (current != State::Disconnected && !transport.connected()) {
+        close();
+    }
+    return current == State::Connected;
+}
+
+bool MqttClient::send(const uint8_t *data, size_t length) {
+    if (transport.write(data, length) != length) {
+        close();
+        return false;
+    }
+    lastSentMs = millis();
+    return true;
+}
+
+// Reads what the transport already holds and handles every complete packet.
+// Returns false, with the connection closed, when the stream broke.
+bool MqttClient::receive() {
+    for (uint8_t reads = 0; reads < MAX_READS_PER_LOOP; reads++) {
+        int available = transport.available();
+        if (available <= 0) {
+            return true;
+        }
+
+        size_t wanted = static_cast<size_t>(available) < sizeof(readChunk)
+                            ? static_cast<size_t>(available)
+                            : sizeof(readChunk);
+        int received = transport.read(readChunk, wanted);
+        if (received <= 0) {
+            return true;
+        }
+        lastReceivedMs = millis();
+
+        size_t offset = 0;
+        while (offset < static_cast<size_t>(received)) {
+            MqttPacketReader::Status status;
+            offset += reader.feed(readChunk + offset, static_cast<size_t>(received) - offset,
+                                  status);
+            if (status == MqttPacketReader::Status::Malformed) {
+                close();
+                return false;
+            }
+            if (status == MqttPacketReader::Status::Packet &&
+                !handlePacket(reader.packet())) {
+                close();
+                return false;
+            }
+            // The handler may have disconnected.
+            if (current == State::Disconnected) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool MqttClient::handlePacket(const MqttPacket &packet) {
+    if (current == State::Connecting) {
+        iotnet::core::MqttConnack connack;
+        if (!iotnet::core::decodeConnack(packet, connack, version)) {
+            return false;
+        }
+        session = connack.sessionPresent;
+        returnCode = connack.returnCode;
+        aliasMaximum = connack.topicAliasMaximum;
+        if (returnCode != 0) {
+            return false;
+        }
+        current = State::Connected;
+        return true;
+    }
+
+    uint16_t packetId;
+    switch (packet.type()) {
+    case MqttPacketType::Publish:
+        return handlePublish(packet);
+    case MqttPacketType::Puback:
+        if (iotnet::core::decodePacketId(packet, packetId, version) && unacknowledged > 0) {
+            unacknowledged--;
+        }
+        return true;
+    case MqttPacketType::Suback: {
+        iotnet::core::MqttSuback ack;
+        if (!iotnet::core::decodeSuback(packet, ack, version)) {
+            return false;
+        }
+        if (subackHandler) {
+            subackHandler(ack, subackContext);
+        }
+        return true;
+    }
+    case MqttPacketType::Pingresp:
+        pingOutstanding = false;
+        return true;
+    case MqttPacketType::Connack:
+    case MqttPacketType::Disconnect:
+        // A second CONNACK is a protocol error; DISCONNECT is MQTT 5 only.
+        return false;
+    default:
+        // UNSUBACK and the rest need no answer.
+        return true;
+    }
+}
+
+bool MqttClient::handlePublish(const MqttPacket &packet) {
+    iotnet::core::MqttPublish message;
+    // Subscriptions are made at QoS 0 or 1, so QoS 2 is a broker error.
+    if (!iotnet::core::decodePublish(packet, message, version) || message.qos > 1) {
+        return false;
+    }
+
+    if (handler) {
+        handler(message, handlerContext);
+    }
+    if (message.qos == 0 || current == State::Disconnected) {
+        return true;
+    }
+
+    uint8_t puback[4];
+    return send(puback, iotnet::core::encodePuback(puback, sizeof(puback), message.packetId));
+}
+
+uint16_t MqttClient::nextPacketId() {
+    if (++lastPacketId == 0) {
+        lastPacketId = 1;
+    }
+    return lastPacketId;
+}
+
+void MqttClient::close() {
+    current = State::Disconnected;
+    pingOutstanding = false;
+    unacknowledged = 0;
+    reader.reset();
+    transport.stop();
+}
+
+}
@@ -0,0 +1,110 @@
+#ifndef IOTNET_MQTT_CLIENT_H
+#define IOTNET_MQTT_CLIENT_H
+
+#include <Client.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/ConnectionStateMachine.h"
+#include "core/MqttCodec.h"
+
+namespace iotnetesp32::mqtt {
+
+// MQTT 3.1.1 or 5 client on top of core/MqttCodec. It never waits on the network
+// except in the blocking connect(): loop() handles whatever bytes have
+// arrived and hands PUBLISH topics and payloads to the handler as views.
+// QoS 1 publishes are counted until their PUBACK but not retransmitted.
+class MqttClient {
+  public:
+    // Largest inbound packet body kept when it arrives over several reads;
+    // also the largest outbound packet written with a single transport write.
+    static constexpr size_t BUFFER_SIZE = 384;
+    static constexpr size_t READ_CHUNK_SIZE = 256;
+    static constexpr uint8_t MAX_READS_PER_LOOP = 8;
+
+    enum class State {
+        Disconnected,
+        Connecting,
+        Connected
+    };
+
+    // The message and its views are only valid for the duration of the call.
+    using MessageHandler = void (*)(const iotnet::core::MqttPublish &message, void *context);
+    // One return code per filter, in SUBSCRIBE order; see subackRefused().
+    using SubackHandler = void (*)(const iotnet::core::MqttSuback &ack, void *context);
+
+    explicit MqttClient(Client &transport);
+
+    // Only used by connect() when the transport is not connected yet.
+    void setServer(const char *host, uint16_t port);
+    void setKeepAlive(uint16_t seconds);
+    // How long connect() and pollConnect() wait for the CONNACK.
+    void setTimeout(uint16_t seconds);
+    void setMessageHandler(MessageHandler handler, void *context);
+    void setSubackHandler(SubackHandler handler, void *context);
+
+    // Sends CONNECT over an already connected transport; pollConnect() then
+    // reports progress until the CONNACK arrives.
+    bool startConnect(const iotnet::core::MqttConnectOptions &options);
+    iotnet::core::StepResult pollConnect();
+    bool connect(const iotnet::core::MqttConnectOptions &options);
+
+    // With MQTT 5 a non-zero topicAlias is sent along; pass a null topic once
+    // the broker knows the alias. See iotnet::core::TopicAliasTable.
+    bool publish(const char *topic, const uint8_t *payload, size_t length, bool retain,
+                 uint8_t qos = 0, uint16_t topicAlias = 0);
+    // outPacketId, when given, receives the id the matching SUBACK will carry.
+    bool subscribe(const char *topic, uint8_t qos = 0, uint16_t *outPacketId = nullptr);
+    // All filters in one SUBSCRIBE packet.
+    bool subscribe(const iotnet::core::MqttSubscription *subscriptions, size_t count,
+                   uint16_t *outPacketId = nullptr);
+    bool loop();
+    void disconnect();
+
+    bool connected();
+    State state() const { return current; }
+    // Valid once connected: the broker still held a session for this client.
+    bool sessionPresent() const { return session; }
+    uint8_t connackReturnCode() const { return returnCode; }
+    iotnet::core::MqttVersion protocolVersion() const { return version; }
+    // Valid once connected: highest topic alias the broker accepts.
+    uint16_t topicAliasMaximum() const { return aliasMaximum; }
+    uint16_t unacknowledgedPublishes() const { return unacknowledged; }
+
+  private:
+    bool send(const uint8_t *data, size_t length);
+    bool receive();
+    bool handlePacket(const iotnet::core::MqttPacket &packet);
+    bool handlePublish(const iotnet::core::MqttPacket &packet);
+    uint16_t nextPacketId();
+    void close();
+
+    Client &transport;
+    const char *host;
+    uint16_t port;
+    uint16_t keepAliveSeconds;
+    uint32_t timeoutMs;
+    MessageHandler handler;
+    void *handlerContext;
+    SubackHandler subackHandler;
+    void *subackContext;
+    iotnet::core::MqttPacketReader reader;
+    State current;
+    uint32_t connectStartedMs;
+    uint32_t lastSentMs;
+    uint32_t lastReceivedMs;
+    bool pingOutstanding;
+    bool session;
+    uint8_t returnCode;
+    iotnet::core::MqttVersion version;
+    uint16_t aliasMaximum;
+    uint16_t lastPacketId;
+    uint16_t unacknowledged;
+    uint8_t txBuffer[BUFFER_SIZE];
+    uint8_t rxBuffer[BUFFER_SIZE];
+    uint8_t readChunk[READ_CHUNK_SIZE];
+};
+
+}
+
+#endif
@@ -1,40 +1,92 @@
 #include "mqtt/MqttConnectionManager.h"
 
+#include <string.h>
+
 namespace iotnetesp32::mqtt {
 
+namespace {
+
+bool buildLwtOptions(
+    iotnet::core::MqttConnectOptions &options,
+    const char *clientId,
+    const char *username,
+    const char *password,
+    const char *lwtTopic,
+    const char *lwtPayload,
+    uint8_t lwtQos,
+    bool lwtRetained,
+    bool cleanSession,
+    iotnet::core::MqttVersion version
+) {
+    if (!clientId || !username || !password || !lwtTopic || !lwtPayload) {
+        return false;
+    }
+
+    options.clientId = clientId;
+    options.username = username;
+    options.password = password;
+    options.willTopic = lwtTopic;
+    options.willPayload = reinterpret_cast<const uint8_t *>(lwtPayload);
+    options.willPayloadLength = strlen(lwtPayload);
+    options.willQos = lwtQos;
+    options.willRetain = lwtRetained;
+    options.cleanSession = cleanSession;
+    options.version = version;
+    return true;
+}
+
+}
+
 bool MqttConnectionManager::isServerConfigValid(const char *server, int port) {
     return server && port > 0;
 }
 
 void MqttConnectionManager::configureTransport(
-    PubSubClient &client,
+    MqttClient &client,
     const char *server,
     int port,
     uint16_t keepAliveSeconds,
-    uint16_t socketTimeoutSeconds,
-    uint16_t bufferSizeBytes
+    uint16_t socketTimeoutSeconds
 ) {
-    client.setServer(server, port);
+    client.setServer(server, static_cast<uint16_t>(port));
     client.setKeepAlive(keepAliveSeconds);
-    client.setSocketTimeout(socketTimeoutSeconds);
-    client.setBufferSize(bufferSizeBytes);
+    client.setTimeout(socketTimeoutSeconds);
 }
 
-bool MqttConnectionManager::connectWithLwt(
-    PubSubClient &client,
+bool MqttConnectionManager::beginConnectWithLwt(
+    MqttClient &client,
     const char *clientId,
     const char *username,
     const char *password,
     const char *lwtTopic,
     const char *lwtPayload,
     uint8_t lwtQos,
-    bool lwtRetained
+    bool lwtRetained,
+    bool cleanSession,
+    iotnet::core::MqttVersion version
 ) {
-    if (!clientId || !username || !password || !lwtTopic || !lwtPayload) {
-        return false;
-    }
+    iotnet::core::MqttConnectOptions options;
+    return buildLwtOptions(options, clientId, username, password, lwtTopic, lwtPayload, lwtQos,
+                           lwtRetained, cleanSession, version) &&
+           client.startConnect(options);
+}
 
-    return client.connect(clientId, username, password, lwtTopic, lwtQos, lwtRetained, lwtPayload);
+bool MqttConnectionManager::connectWithLwt(
+    MqttClient &client,
+    const char *clientId,
+    const char *username,
+    const char *password,
+    const char *lwtTopic,
+    const char *lwtPayload,
+    uint8_t lwtQos,
+    bool lwtRetained,
+    bool cleanSession,
+    iotnet::core::MqttVersion version
+) {
+    iotnet::core::MqttConnectOptions options;
+    return buildLwtOptions(options, clientId, username, password, lwtTopic, lwtPayload, lwtQos,
+                           lwtRetained, cleanSession, version) &&
+           client.connect(options);
 }
 
 }
@@ -1,9 +1,10 @@
 #ifndef IOTNET_MQTT_CONNECTION_MANAGER_H
 #define IOTNET_MQTT_CONNECTION_MANAGER_H
 
-#include <PubSubClient.h>
 #include <stdint.h>
 
+#include "mqtt/MqttClient.h"
+
 namespace iotnetesp32::mqtt {
 
 class MqttConnectionManager {
@@ -11,23 +12,38 @@ class MqttConnectionManager {
     static bool isServerConfigValid(const char *server, int port);
 
     static void configureTransport(
-        PubSubClient &client,
+        MqttClient &client,
         const char *server,
         int port,
         uint16_t keepAliveSeconds,
-        uint16_t socketTimeoutSeconds,
-        uint16_t bufferSizeBytes
+        uint16_t socketTimeoutSeconds
+    );
+
+    // Sends CONNECT without waiting; poll the client with pollConnect().
+    static bool beginConnectWithLwt(
+        MqttClient &client,
+        const char *clientId,
+        const char *username,
+        const char *password,
+        const char *lwtTopic,
+        const char *lwtPayload,
+        uint8_t lwtQos,
+        bool lwtRetained,
+        bool cleanSession = true,
+        iotnet::core::MqttVersion version = iotnet::core::MqttVersion::V311
     );
 
     static bool connectWithLwt(
-        PubSubClient &client,
+        MqttClient &client,
         const char *clientId,
         const char *username,
         const char *password,
         const char *lwtTopic,
         const char *lwtPayload,
         uint8_t lwtQos,
-        bool lwtRetained
+        bool lwtRetained,
+        bool cleanSession = true,
+        iotnet::core::MqttVersion version = iotnet::core::MqttVersion::V311
     );
 };
 
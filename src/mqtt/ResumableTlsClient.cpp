@@ -0,0 +1,288 @@
+#include "mqtt/ResumableTlsClient.h"
+
+#include <WiFi.h>
+#include <string.h>
+
+// The non-blocking steps reach into arduino-esp32 2.x's sslclient and mbedTLS
+// 2 internals, which 3.x no longer has; see the fallback at the end.
+#if ESP_ARDUINO_VERSION_MAJOR < 3
+#define IOTNET_TLS_STEPS 1
+#include <errno.h>
+#include <lwip/sockets.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/ssl_internal.h>
+#endif
+
+namespace iotnetesp32::mqtt {
+
+using iotnet::core::StepResult;
+
+ResumableTlsClient::ResumableTlsClient()
+    : record(&ownRecord), hostName(nullptr), endpoint(0), handshakeStartedMs(0),
+      phase(Phase::Idle), offered(false), resumed(false) {
+    ownRecord.clear();
+}
+
+void ResumableTlsClient::setSessionRecord(iotnet::core::TlsSessionRecord *sessionRecord) {
+    iotnet::core::TlsSessionRecord *next = sessionRecord ? sessionRecord : &ownRecord;
+    if (next != record && record->validLength(endpoint) > 0) {
+        *next = *record;
+    }
+    record = next;
+}
+
+void ResumableTlsClient::forgetSession() {
+    record->clear();
+}
+
+#ifdef IOTNET_TLS_STEPS
+
+StepResult ResumableTlsClient::connectStep(const IPAddress &address, uint16_t port,
+                                           const char *host) {
+    if (phase == Phase::Idle) {
+        hostName = host;
+        endpoint = iotnet::core::tlsEndpointHash(host, port);
+        return beginTcp(address, port);
+    }
+    if (phase == Phase::TcpConnecting) {
+        return pollTcp();
+    }
+    return phase == Phase::Handshaking ? StepResult::Done : StepResult::Failed;
+}
+
+StepResult ResumableTlsClient::beginTcp(const IPAddress &address, uint16_t port) {
+    // stop_ssl_socket() zeroes the context, so start from a clean one.
+    WiFiClientSecure::stop();
+    ssl_init(sslclient);
+
+    int fd = lwip_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) {
+        return StepResult::Failed;
+    }
+    sslclient->socket = fd;
+    lwip_fcntl(fd, F_SETFL, lwip_fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    struct sockaddr_in server;
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_addr.s_addr = static_cast<uint32_t>(address);
+    server.sin_port = htons(port);
+
+    if (lwip_connect(fd, reinterpret_cast<struct sockaddr *>(&server), sizeof(server)) < 0 &&
+        errno != EINPROGRESS) {
+        stop();
+        return StepResult::Failed;
+    }
+    phase = Phase::TcpConnecting;
+    return pollTcp();
+}
+
+StepResult ResumableTlsClient::pollTcp() {
+    int fd = sslclient->socket;
+    fd_set writable;
+    FD_ZERO(&writable);
+    FD_SET(fd, &writable);
+    struct timeval noWait = {0, 0};
+
+    int ready = lwip_select(fd + 1, nullptr, &writable, nullptr, &noWait);
+    if (ready == 0) {
+        return StepResult::Pending;
+    }
+
+    int error = 0;
+    socklen_t errorLength = sizeof(error);
+    if (ready < 0 || lwip_getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &errorLength) < 0 ||
+        error != 0 || !beginTls()) {
+        stop();
+        return StepResult::Failed;
+    }
+    phase = Phase::Handshaking;
+    return StepResult::Done;
+}
+
+bool ResumableTlsClient::beginTls() {
+    mbedtls_entropy_init(&sslclient->entropy_ctx);
+    if (mbedtls_ctr_drbg_seed(&sslclient->drbg_ctx, mbedtls_entropy_func,
+                              &sslclient->entropy_ctx, nullptr, 0) != 0) {
+        return false;
+    }
+    if (mbedtls_ssl_config_defaults(&sslclient->ssl_conf, MBEDTLS_SSL_IS_CLIENT,
+                                    MBEDTLS_SSL_TRANSPORT_STREAM,
+                                    MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+        return false;
+    }
+
+    if (_CA_cert) {
+        mbedtls_x509_crt_init(&sslclient->ca_cert);
+        if (mbedtls_x509_crt_parse(&sslclient->ca_cert,
+                                   reinterpret_cast<const unsigned char *>(_CA_cert),
+                                   strlen(_CA_cert) + 1) != 0) {
+            return false;
+        }
+        mbedtls_ssl_conf_ca_chain(&sslclient->ssl_conf, &sslclient->ca_cert, nullptr);
+        mbedtls_ssl_conf_authmode(&sslclient->ssl_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    } else if (_use_insecure) {
+        mbedtls_ssl_conf_authmode(&sslclient->ssl_conf, MBEDTLS_SSL_VERIFY_NONE);
+    } else {
+        return false;
+    }
+
+    mbedtls_ssl_conf_rng(&sslclient->ssl_conf, mbedtls_ctr_drbg_random, &sslclient->drbg_ctx);
+    mbedtls_ssl_conf_session_tickets(&sslclient->ssl_conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+    if (mbedtls_ssl_setup(&sslclient->ssl_ctx, &sslclient->ssl_conf) != 0 ||
+        mbedtls_ssl_set_hostname(&sslclient->ssl_ctx, hostName) != 0) {
+        return false;
+    }
+
+    offerSession();
+    mbedtls_ssl_set_bio(&sslclient->ssl_ctx, &sslclient->socket, mbedtls_net_send,
+                        mbedtls_net_recv, nullptr);
+    handshakeStartedMs = millis();
+    resumed = false;
+    return true;
+}
+
+void ResumableTlsClient::offerSession() {
+    offered = false;
+    size_t length = record->validLength(endpoint);
+    if (length == 0) {
+        return;
+    }
+
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    if (mbedtls_ssl_session_load(&session, record->data, length) == 0 &&
+        mbedtls_ssl_set_session(&sslclient->ssl_ctx, &session) == 0) {
+        offered = true;
+    } else {
+        // Saved by a differently configured mbedTLS; start over.
+        record->clear();
+    }
+    mbedtls_ssl_session_free(&session);
+}
+
+StepResult ResumableTlsClient::handshakeStep() {
+    if (phase == Phase::Connected) {
+        return StepResult::Done;
+    }
+    if (phase != Phase::Handshaking) {
+        return StepResult::Failed;
+    }
+
+    mbedtls_ssl_context *ssl = &sslclient->ssl_ctx;
+    while (ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+        int ret = mbedtls_ssl_handshake_step(ssl);
+        // The handshake parameters, and with them the "resumed" flag set
+        // while parsing ServerHello, are freed once the handshake completes.
+        if (ssl->handshake && ssl->state > MBEDTLS_SSL_SERVER_HELLO) {
+            resumed = ssl->handshake->resume != 0;
+        }
+        if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            return StepResult::Pending;
+        }
+        if (ret != 0) {
+            if (offered) {
+                // Do not offer the same session to a server that choked on it.
+                record->clear();
+            }
+            stop();
+            return StepResult::Failed;
+        }
+    }
+
+    stats.record(resumed, millis() - handshakeStartedMs);
+    saveSession();
+    phase = Phase::Connected;
+    _connected = true;
+    return StepResult::Done;
+}
+
+void ResumableTlsClient::saveSession() {
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    size_t length = 0;
+    if (mbedtls_ssl_get_session(&sslclient->ssl_ctx, &session) == 0 &&
+        mbedtls_ssl_session_save(&session, record->data, sizeof(record->data), &length) == 0) {
+        record->seal(endpoint, length);
+    } else {
+        record->clear();
+    }
+    mbedtls_ssl_session_free(&session);
+}
+
+#else
+
+// arduino-esp32 3.x: WiFiClientSecure connects and handshakes in one
+// blocking call, always in full. The steps keep their contract so the state
+// machine still works; sessions are simply never offered.
+StepResult ResumableTlsClient::connectStep(const IPAddress &address, uint16_t port,
+                                           const char *host) {
+    if (phase == Phase::Connected) {
+        return StepResult::Done;
+    }
+    hostName = host;
+    endpoint = iotnet::core::tlsEndpointHash(host, port);
+    handshakeStartedMs = millis();
+    resumed = false;
+    int connected = host ? WiFiClientSecure::connect(host, port)
+                         : WiFiClientSecure::connect(address, port);
+    if (!connected) {
+        stop();
+        return StepResult::Failed;
+    }
+    stats.record(false, millis() - handshakeStartedMs);
+    phase = Phase::Connected;
+    return StepResult::Done;
+}
+
+StepResult ResumableTlsClient::handshakeStep() {
+    return phase == Phase::Connected ? StepResult::Done : StepResult::Failed;
+}
+
+#endif
+
+int ResumableTlsClient::connectBlocking(const IPAddress &address, uint16_t port,
+                                        const char *host) {
+    stop();
+    uint32_t startedMs = millis();
+    StepResult result = connectStep(address, port, host);
+    while (result == StepResult::Pending && millis() - startedMs < CONNECT_TIMEOUT_MS) {
+        delay(1);
+        result = connectStep(address, port, host);
+    }
+    if (result == StepResult::Done) {
+        result = handshakeStep();
+        while (result == StepResult::Pending && millis() - startedMs < CONNECT_TIMEOUT_MS) {
+            delay(1);
+            result = handshakeStep();
+        }
+    }
+    if (result != StepResult::Done) {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+int ResumableTlsClient::connect(IPAddress ip, uint16_t port) {
+    // Without a host name there is no SNI or name check, as in WiFiClientSecure.
+    return connectBlocking(ip, port, nullptr);
+}
+
+int ResumableTlsClient::connect(const char *host, uint16_t port) {
+    IPAddress address;
+    if (!host || WiFi.hostByName(host, address) != 1) {
+        return 0;
+    }
+    return connectBlocking(address, port, host);
+}
+
+void ResumableTlsClient::stop() {
+    WiFiClientSecure::stop();
+    phase = Phase::Idle;
+}
+
+}
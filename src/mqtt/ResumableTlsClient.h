@@ -0,0 +1,74 @@
+#ifndef IOTNET_RESUMABLE_TLS_CLIENT_H
+#define IOTNET_RESUMABLE_TLS_CLIENT_H
+
+#include <WiFiClientSecure.h>
+#include <stdint.h>
+
+#include "core/ConnectionStateMachine.h"
+#include "core/TlsSessionCache.h"
+
+namespace iotnetesp32::mqtt {
+
+// WiFiClientSecure that runs its own non-blocking connect and handshake so
+// the last session can be offered again (RFC 5077 ticket or session ID).
+// A server that declines it simply falls back to a full handshake. Only CA
+// verification (setCACert) or setInsecure() are supported; client
+// certificates, PSK and ALPN are not.
+class ResumableTlsClient : public WiFiClientSecure {
+  public:
+    static constexpr uint32_t CONNECT_TIMEOUT_MS = 15000;
+
+    ResumableTlsClient();
+
+    // Where the session is kept between connections; defaults to a record
+    // inside this object. Point it at RTC memory to resume after deep sleep;
+    // a session held by the previous record is carried over.
+    void setSessionRecord(iotnet::core::TlsSessionRecord *record);
+    void forgetSession();
+
+    // Non-blocking connect for a state machine: the first call opens the
+    // socket, later calls report progress. `host` is used for SNI and
+    // certificate checks and must outlive the connection.
+    iotnet::core::StepResult connectStep(const IPAddress &address, uint16_t port,
+                                         const char *host);
+    iotnet::core::StepResult handshakeStep();
+
+    bool lastHandshakeResumed() const { return resumed; }
+    const iotnet::core::TlsHandshakeStats &handshakeStats() const { return stats; }
+
+    // Blocking connects built on the steps above, for callers such as
+    // MqttClient::connect() that connect the transport themselves.
+    using WiFiClientSecure::connect;
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(const char *host, uint16_t port) override;
+    void stop() override;
+
+  private:
+    enum class Phase {
+        Idle,
+        TcpConnecting,
+        Handshaking,
+        Connected
+    };
+
+    iotnet::core::StepResult beginTcp(const IPAddress &address, uint16_t port);
+    iotnet::core::StepResult pollTcp();
+    bool beginTls();
+    void offerSession();
+    void saveSession();
+    int connectBlocking(const IPAddress &address, uint16_t port, const char *host);
+
+    iotnet::core::TlsSessionRecord ownRecord;
+    iotnet::core::TlsSessionRecord *record;
+    iotnet::core::TlsHandshakeStats stats;
+    const char *hostName;
+    uint32_t endpoint;
+    uint32_t handshakeStartedMs;
+    Phase phase;
+    bool offered;
+    bool resumed;
+};
+
+}
+
+#endif
@@ -2,10 +2,284 @@
 
 #include <HTTPClient.h>
 #include <Update.h>
+#include <esp_ota_ops.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <memory>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/ChunkPipeline.h"
+#include "core/DeltaPatcher.h"
+#include "core/DownloadCheckpoint.h"
+#include "core/GzipInflater.h"
+#include "core/Sha256.h"
 
 namespace iotnetesp32::ota {
 
-bool FirmwareFlasher::downloadAndFlash(const char *url) {
+namespace {
+
+constexpr uint32_t FLASH_WRITER_STACK_BYTES = 4096;
+constexpr uint32_t STREAM_IDLE_TIMEOUT_MS = 30000;
+constexpr uint8_t MAX_DOWNLOAD_ATTEMPTS = 5;
+constexpr uint32_t RETRY_DELAY_MS = 1000;
+
+const char *RESPONSE_HEADERS[] = {"Content-Range", "ETag", "Content-Encoding"};
+
+// Outlives a failed download together with the still running Update, so
+// the next OTA trigger continues where this one stopped.
+iotnet::core::DownloadCheckpoint checkpoint;
+// Every byte written to the open Update so far; kept with the checkpoint so
+// a resumed image is still checked whole.
+iotnet::core::Sha256 imageHash;
+
+uint32_t pipelineNowMs() {
+    return millis();
+}
+
+void pipelineWait() {
+    vTaskDelay(1);
+}
+
+constexpr iotnet::core::PipelineHooks PIPELINE_HOOKS = {pipelineNowMs, pipelineWait};
+
+class StreamSource : public iotnet::core::ChunkSource {
+  public:
+    explicit StreamSource(WiFiClient &stream) : stream(stream) {}
+
+    int read(uint8_t *buffer, size_t size) override {
+        int available = stream.available();
+        if (available <= 0) {
+            return stream.connected() ? 0 : -1;
+        }
+        if (static_cast<size_t>(available) < size) {
+            size = static_cast<size_t>(available);
+        }
+        return stream.read(buffer, size);
+    }
+
+  private:
+    WiFiClient &stream;
+};
+
+// Runs on the flash writer task, so hashing overlaps with the network
+// reads instead of adding to them.
+class UpdateSink : public iotnet::core::ChunkSink {
+  public:
+    bool write(const uint8_t *data, size_t length) override {
+        if (Update.write(const_cast<uint8_t *>(data), length) != length) {
+            return false;
+        }
+        imageHash.update(data, length);
+        return true;
+    }
+};
+
+// The partition the device booted from, which delta patches apply to.
+class RunningPartition : public iotnet::core::PatchBase {
+  public:
+    RunningPartition() : partition(esp_ota_get_running_partition()) {}
+
+    size_t size() const override { return partition ? partition->size : 0; }
+
+    bool read(size_t offset, uint8_t *buffer, size_t length) override {
+        return partition && esp_partition_read(partition, offset, buffer, length) == ESP_OK;
+    }
+
+  private:
+    const esp_partition_t *partition;
+};
+
+// Hands the image to Update, inflating it first when it arrives gzipped:
+// announced by Content-Encoding or recognised by its magic bytes, as raw
+// ESP32 images start with 0xE9. A patch is then applied against the running
+// partition. The Update is begun on the first byte, once the format is
+// known. Lives for a whole download() call, so a resumed connection
+// continues the inflater and patcher where the last one stopped.
+class ImageSink : public iotnet::core::ChunkSink {
+  public:
+    // resuming: an Update left open by an earlier call is continued as is.
+    ImageSink(bool resuming, bool patch)
+        : patcher(running, update),
+          decoded(patch ? static_cast<iotnet::core::ChunkSink &>(patcher) : update),
+          inflater(decoded), window(nullptr), imageLength(0), patching(patch),
+          gzipEncoded(false), compressed(false), started(resuming) {}
+    ~ImageSink() { free(window); }
+
+    // The download starts over from byte 0, after any running Update was
+    // aborted.
+    void restart(size_t length, bool encoded) {
+        imageLength = length;
+        gzipEncoded = encoded;
+        compressed = false;
+        started = false;
+        patcher.reset();
+        imageHash.reset();
+    }
+
+    bool write(const uint8_t *data, size_t length) override {
+        if (!started && !begin(data, length)) {
+            return false;
+        }
+        if (!compressed) {
+            return decoded.write(data, length);
+        }
+        return inflater.feed(data, length) != iotnet::core::GzipInflater::Status::Error;
+    }
+
+    bool isCompressed() const { return compressed; }
+    // Written as downloaded: the size is known up front, and since no
+    // inflater or patcher state dies with the call, the next one can
+    // continue it.
+    bool isPlain() const { return !compressed && !patching; }
+    bool baseMismatch() const {
+        return patching && patcher.status() == iotnet::core::DeltaPatcher::Status::BaseMismatch;
+    }
+    // A compressed image or a patch may still be short of its end when
+    // every byte the server announced has arrived.
+    bool finished() const {
+        return (!compressed || inflater.status() == iotnet::core::GzipInflater::Status::Done) &&
+               (!patching || patcher.status() == iotnet::core::DeltaPatcher::Status::Done);
+    }
+    size_t inflatedBytes() const { return inflater.outputBytes(); }
+    size_t imageBytes(size_t received) const {
+        if (patching) {
+            return patcher.outputBytes();
+        }
+        return compressed ? inflater.outputBytes() : received;
+    }
+
+  private:
+    bool begin(const uint8_t *data, size_t length) {
+        compressed = gzipEncoded || iotnet::core::GzipInflater::hasMagic(data, length);
+        if (compressed) {
+            static constexpr size_t WINDOW = iotnet::core::GzipInflater::MAX_WINDOW;
+            if (!window) {
+                window = static_cast<uint8_t *>(malloc(WINDOW));
+            }
+            if (!window || !inflater.attach(window, WINDOW)) {
+                Serial.printf("[OTA-DOWNLOAD] FAIL: Cannot allocate %zu byte inflate window\n",
+                              WINDOW);
+                return false;
+            }
+        }
+        // The final size is only known once the gzip trailer or the patch
+        // header is reached.
+        started = Update.begin(isPlain() ? imageLength : UPDATE_SIZE_UNKNOWN);
+        return started;
+    }
+
+    UpdateSink update;
+    RunningPartition running;
+    iotnet::core::DeltaPatcher patcher;
+    iotnet::core::ChunkSink &decoded;
+    iotnet::core::GzipInflater inflater;
+    uint8_t *window;
+    size_t imageLength;
+    bool patching;
+    bool gzipEncoded;
+    bool compressed;
+    bool started;
+};
+
+struct FlashWriterJob {
+    iotnet::core::ChunkRing *ring;
+    iotnet::core::ChunkSink *sink;
+    iotnet::core::PipelinePhaseStats stats;
+    bool success;
+    TaskHandle_t waiter;
+};
+
+void flashWriterEntry(void *argument) {
+    FlashWriterJob *job = static_cast<FlashWriterJob *>(argument);
+    job->success =
+        iotnet::core::drainChunkRing(*job->ring, *job->sink, PIPELINE_HOOKS, job->stats);
+    xTaskNotifyGive(job->waiter);
+    vTaskDelete(nullptr);
+}
+
+void reportPhase(const char *name, const iotnet::core::PipelinePhaseStats &stats) {
+    Serial.printf(
+        "[OTA-DOWNLOAD] %s: %zu bytes in %lu ms, %lu ms waiting, %lu B/s while busy\n",
+        name,
+        stats.bytes,
+        static_cast<unsigned long>(stats.elapsedMs),
+        static_cast<unsigned long>(stats.waitMs),
+        static_cast<unsigned long>(stats.bytesPerSecond())
+    );
+}
+
+enum class TransferResult {
+    Complete,
+    // The stream broke; everything read before that was written.
+    Interrupted,
+    FlashFailed
+};
+
+// Streams length bytes of the response body to flash through the chunk
+// ring: this task reads the network while a writer task erases and writes
+// filled chunks. outWritten is what reached sink.
+TransferResult transferToFlash(WiFiClient &stream, size_t length, iotnet::core::ChunkSink &sink,
+                               uint8_t *storage, const FlashPipelineConfig &config,
+                               size_t *outWritten) {
+    *outWritten = 0;
+    iotnet::core::ChunkRing ring;
+    ring.attach(storage, config.chunkBytes, config.chunkCount);
+
+    FlashWriterJob job = {&ring, &sink, {0, 0, 0}, false, xTaskGetCurrentTaskHandle()};
+    TaskHandle_t writer = nullptr;
+    BaseType_t created = xTaskCreatePinnedToCore(
+        flashWriterEntry,
+        "iotnet-flash",
+        FLASH_WRITER_STACK_BYTES,
+        &job,
+        uxTaskPriorityGet(nullptr),
+        &writer,
+        tskNO_AFFINITY
+    );
+    if (created != pdPASS) {
+        Serial.println("[OTA-DOWNLOAD] FAIL: Cannot start flash writer task");
+        return TransferResult::FlashFailed;
+    }
+
+    StreamSource source(stream);
+    iotnet::core::PipelinePhaseStats networkStats;
+    bool received = iotnet::core::fillChunkRing(ring, source, length, STREAM_IDLE_TIMEOUT_MS,
+                                                PIPELINE_HOOKS, networkStats);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    reportPhase("Network", networkStats);
+    reportPhase("Flash", job.stats);
+
+    *outWritten = job.stats.bytes;
+    if (!job.success) {
+        Serial.printf("[OTA-DOWNLOAD] FAIL: Flash write: %s\n", Update.errorString());
+        return TransferResult::FlashFailed;
+    }
+    return received ? TransferResult::Complete : TransferResult::Interrupted;
+}
+
+// Connection errors, server errors and a dropped checkpoint are worth
+// another request; other statuses will not change.
+bool isRetryable(int httpCode) {
+    return httpCode <= 0 || httpCode >= 500 || httpCode == 206 || httpCode == 416;
+}
+
+}
+
+bool FirmwareFlasher::downloadAndFlash(const char *url, const uint8_t *sha256,
+                                       const FlashPipelineConfig &config) {
+    return download(url, sha256, config, false);
+}
+
+bool FirmwareFlasher::downloadAndPatch(const char *url, const uint8_t *sha256,
+                                       const FlashPipelineConfig &config) {
+    return download(url, sha256, config, true);
+}
+
+bool FirmwareFlasher::download(const char *url, const uint8_t *sha256,
+                               const FlashPipelineConfig &config, bool patch) {
     if (!url || strlen(url) == 0) {
         Serial.println("[OTA-DOWNLOAD] FAIL: Invalid download URL");
         return false;
@@ -13,70 +287,183 @@ bool FirmwareFlasher::downloadAndFlash(const char *url) {
 
     Serial.printf("[OTA-DOWNLOAD] Starting download: %s\n", url);
 
-    HTTPClient http;
-    http.setReuse(false);
-    http.setConnectTimeout(10000);
-    http.setTimeout(30000);
-
-    int httpCode = http.begin(url);
-    if (httpCode <= 0) {
-        Serial.printf("[OTA-DOWNLOAD] FAIL: HTTP begin error: %d\n", httpCode);
-        http.end();
+    uint8_t *storage = static_cast<uint8_t *>(malloc(config.chunkBytes * config.chunkCount));
+    if (!storage) {
+        Serial.printf("[OTA-DOWNLOAD] FAIL: Cannot allocate %u x %zu byte chunks\n",
+                      config.chunkCount, config.chunkBytes);
         return false;
     }
 
-    httpCode = http.GET();
-    if (httpCode != HTTP_CODE_OK) {
-        Serial.printf("[OTA-DOWNLOAD] FAIL: HTTP GET returned %d\n", httpCode);
-        http.end();
+    uint32_t startedMs = millis();
+    checkpoint.prepare(url);
+    if (checkpoint.inProgress() && !Update.isRunning()) {
+        checkpoint.reset();
+    }
+    // A checkpoint kept from an earlier call always belongs to a full, plain
+    // image; a patch does not continue it.
+    if (patch && checkpoint.inProgress()) {
+        Update.abort();
+        checkpoint.reset();
+    }
+    // Inflater and patcher state, about 4 KB, would crowd the calling task's
+    // stack next to HTTPClient and TLS.
+    std::unique_ptr<ImageSink> image(new (std::nothrow) ImageSink(checkpoint.inProgress(), patch));
+    if (!image) {
+        Serial.println("[OTA-DOWNLOAD] FAIL: Cannot allocate image decoder");
+        free(storage);
         return false;
     }
 
-    WiFiClient *stream = http.getStreamPtr();
-    int contentLength = http.getSize();
+    bool downloaded = false;
+    for (uint8_t attempt = 0; attempt < MAX_DOWNLOAD_ATTEMPTS && !downloaded; attempt++) {
+        if (attempt > 0) {
+            delay(RETRY_DELAY_MS);
+        }
+
+        HTTPClient http;
+        http.setReuse(false);
+        http.setConnectTimeout(10000);
+        http.setTimeout(30000);
+
+        int httpCode = http.begin(url);
+        if (httpCode <= 0) {
+            Serial.printf("[OTA-DOWNLOAD] FAIL: HTTP begin error: %d\n", httpCode);
+            http.end();
+            continue;
+        }
+
+        char range[32];
+        if (checkpoint.formatRange(range, sizeof(range))) {
+            http.addHeader("Range", range);
+            // A changed image then comes back whole with 200 instead of 206.
+            if (checkpoint.etag()[0] != '\0') {
+                http.addHeader("If-Range", checkpoint.etag());
+            }
+            Serial.printf("[OTA-DOWNLOAD] Resuming at %zu of %zu bytes\n", checkpoint.offset(),
+                          checkpoint.totalLength());
+        }
+        http.collectHeaders(RESPONSE_HEADERS, 3);
+
+        httpCode = http.GET();
+        String contentRange = http.header("Content-Range");
+        String etag = http.header("ETag");
+        iotnet::core::RangeResponse response = {httpCode, http.getSize(), contentRange.c_str(),
+                                                etag.c_str()};
+        iotnet::core::ResumeDecision decision = checkpoint.accept(response);
 
-    if (contentLength <= 0) {
-        Serial.println("[OTA-DOWNLOAD] FAIL: Invalid content length");
+        if (decision == iotnet::core::ResumeDecision::Reject) {
+            Serial.printf("[OTA-DOWNLOAD] FAIL: HTTP GET returned %d\n", httpCode);
+            http.end();
+            if (!checkpoint.inProgress() && Update.isRunning()) {
+                Update.abort();
+            }
+            if (!isRetryable(httpCode)) {
+                break;
+            }
+            continue;
+        }
+
+        if (decision == iotnet::core::ResumeDecision::Restart) {
+            if (Update.isRunning()) {
+                Serial.println("[OTA-DOWNLOAD] Image changed or range ignored, restarting");
+                Update.abort();
+            }
+            bool gzipEncoded = http.header("Content-Encoding").equalsIgnoreCase("gzip");
+            Serial.printf("[OTA-DOWNLOAD] Size: %zu bytes%s, heap: %d\n",
+                          checkpoint.totalLength(), gzipEncoded ? " gzip" : "",
+                          ESP.getFreeHeap());
+            image->restart(checkpoint.totalLength(), gzipEncoded);
+        }
+
+        size_t written = 0;
+        TransferResult result = transferToFlash(*http.getStreamPtr(), checkpoint.remaining(),
+                                                *image, storage, config, &written);
+        checkpoint.advance(written);
         http.end();
-        return false;
+
+        if (result == TransferResult::FlashFailed) {
+            if (image->baseMismatch()) {
+                Serial.println("[OTA-DOWNLOAD] FAIL: Patch was made for another firmware");
+            }
+            Update.abort();
+            checkpoint.reset();
+            break;
+        }
+        downloaded = checkpoint.complete();
+        if (!downloaded) {
+            Serial.printf("[OTA-DOWNLOAD] Interrupted at %zu of %zu bytes\n", checkpoint.offset(),
+                          checkpoint.totalLength());
+        }
     }
+    free(storage);
 
-    Serial.printf("[OTA-DOWNLOAD] Size: %d bytes, heap: %d\n", contentLength, ESP.getFreeHeap());
+    if (!downloaded) {
+        if (checkpoint.inProgress() && !image->isPlain()) {
+            Serial.printf("[OTA-DOWNLOAD] FAIL: Stopped at %zu of %zu bytes\n",
+                          checkpoint.offset(), checkpoint.totalLength());
+            Update.abort();
+            checkpoint.reset();
+        } else if (checkpoint.inProgress()) {
+            Serial.printf("[OTA-DOWNLOAD] FAIL: Stopped at %zu of %zu bytes, kept for resume\n",
+                          checkpoint.offset(), checkpoint.totalLength());
+        }
+        if (!checkpoint.inProgress()) {
+            // Releases the SHA accelerator if the hash was holding it.
+            imageHash.reset();
+        }
+        return false;
+    }
 
-    if (!Update.begin(contentLength)) {
-        Serial.printf("[OTA-DOWNLOAD] FAIL: Update.begin: %s\n", Update.errorString());
-        http.end();
+    size_t received = checkpoint.totalLength();
+    checkpoint.reset();
+    if (!image->finished()) {
+        Serial.println("[OTA-DOWNLOAD] FAIL: Image ended early or is corrupt");
+        Update.abort();
+        imageHash.reset();
         return false;
     }
 
-    size_t written = Update.writeStream(*stream);
-    if (written != contentLength) {
-        Serial.printf(
-            "[OTA-DOWNLOAD] FAIL: Write mismatch: expected %d, got %zu\n",
-            contentLength,
-            written
-        );
+    uint8_t digest[iotnet::core::Sha256::DIGEST_SIZE];
+    imageHash.finish(digest);
+    imageHash.reset();
+    if (sha256 && memcmp(digest, sha256, sizeof(digest)) != 0) {
+        Serial.println("[OTA-DOWNLOAD] FAIL: SHA-256 mismatch, image discarded");
         Update.abort();
-        http.end();
         return false;
     }
 
-    Serial.printf("[OTA-DOWNLOAD] Written: %zu bytes\n", written);
+    uint32_t elapsedMs = millis() - startedMs;
+    size_t flashed = image->imageBytes(received);
+    if (image->isCompressed()) {
+        size_t inflated = image->inflatedBytes();
+        Serial.printf("[OTA-DOWNLOAD] Inflated %zu bytes from %zu (%u%% of original)\n", inflated,
+                      received,
+                      static_cast<unsigned>(inflated > 0 ? received * 100 / inflated : 0));
+    }
+    if (patch) {
+        Serial.printf("[OTA-DOWNLOAD] Patched %zu byte image from %zu downloaded bytes\n",
+                      flashed, received);
+    }
+    // Image bytes flashed per second of the whole download, retries included.
+    Serial.printf("[OTA-DOWNLOAD] Written: %zu bytes in %lu ms, %lu B/s effective\n", flashed,
+                  static_cast<unsigned long>(elapsedMs),
+                  static_cast<unsigned long>(elapsedMs > 0 ? flashed * 1000ULL / elapsedMs : 0));
+
+    if (sha256) {
+        Serial.println("[OTA-DOWNLOAD] OK: SHA-256 verified");
+    }
 
-    if (!Update.end()) {
+    if (!Update.end(!image->isPlain())) {
         Serial.printf("[OTA-DOWNLOAD] FAIL: Update.end: %s\n", Update.errorString());
-        http.end();
         return false;
     }
 
     if (!Update.isFinished()) {
         Serial.println("[OTA-DOWNLOAD] FAIL: Update verification failed");
-        http.end();
         return false;
     }
 
     Serial.println("[OTA-DOWNLOAD] OK: Firmware flashed successfully");
-    http.end();
     return true;
 }
 
@@ -1,11 +1,46 @@
 #ifndef IOTNET_FIRMWARE_FLASHER_H
 #define IOTNET_FIRMWARE_FLASHER_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 namespace iotnetesp32::ota {
 
+// The download is read into a ring of chunkCount buffers of chunkBytes each
+// while a separate task writes filled chunks to flash, so the network keeps
+// receiving during sector erases. 4 KB matches the flash sector size.
+struct FlashPipelineConfig {
+    size_t chunkBytes = 4096;
+    uint8_t chunkCount = 4;
+};
+
+// A download that breaks is continued with "Range: bytes=<offset>-" after a
+// short delay. If every attempt fails, the offset and the open Update are
+// kept, so the next call resumes as long as the server reports the same
+// ETag and length.
+//
+// gzip-compressed images (Content-Encoding: gzip, or a .gz file served as
+// is) are inflated on the way to flash through a 32 KB window. They resume
+// within a call, but a failed call starts them over.
+//
+// A delta patch (tools/delta_patch.py) is applied against the running
+// partition while it downloads, and resumes like a compressed image. It
+// fails before anything is written when it was made for another firmware;
+// the caller then falls back to the full image.
+//
+// Every byte handed to Update is hashed by the flash writer task as it goes.
+// With an expected SHA-256 of the image as flashed, a mismatch aborts the
+// Update before it is made bootable; nullptr skips the check.
 class FirmwareFlasher {
   public:
-    static bool downloadAndFlash(const char *url);
+    static bool downloadAndFlash(const char *url, const uint8_t *sha256,
+                                 const FlashPipelineConfig &config = FlashPipelineConfig());
+    static bool downloadAndPatch(const char *url, const uint8_t *sha256,
+                                 const FlashPipelineConfig &config = FlashPipelineConfig());
+
+  private:
+    static bool download(const char *url, const uint8_t *sha256,
+                         const FlashPipelineConfig &config, bool patch);
 };
 
 }
@@ -21,6 +21,7 @@ class OtaSessionState {
     void reset() {
         pendingOtaId[0] = '\0';
         pendingVersion[0] = '\0';
+        pendingBaseVersion[0] = '\0';
         pendingCorrelationId[0] = '\0';
         sessionKey[0] = '\0';
         pendingNonce = 0;
@@ -47,6 +48,19 @@ class OtaSessionState {
         return true;
     }
 
+    // Empty when the trigger offered no delta patch.
+    bool setBaseVersion(const char *baseVersion) {
+        if (!baseVersion) {
+            return false;
+        }
+        size_t baseVersionLength = strlen(baseVersion);
+        if (baseVersionLength >= sizeof(pendingBaseVersion)) {
+            return false;
+        }
+        memcpy(pendingBaseVersion, baseVersion, baseVersionLength + 1);
+        return true;
+    }
+
     bool setCorrelationId(const char *cid) {
         if (!cid) {
             return false;
@@ -86,6 +100,7 @@ class OtaSessionState {
 
     const char *otaId() const { return pendingOtaId; }
     const char *version() const { return pendingVersion; }
+    const char *baseVersion() const { return pendingBaseVersion; }
     long nonce() const { return pendingNonce; }
     const char *correlationId() const { return pendingCorrelationId; }
     const char *currentSessionKey() const { return sessionKey; }
@@ -93,6 +108,7 @@ class OtaSessionState {
   private:
     char pendingOtaId[OTA_ID_SIZE];
     char pendingVersion[VERSION_SIZE];
+    char pendingBaseVersion[VERSION_SIZE];
     long pendingNonce;
     char pendingCorrelationId[CORRELATION_ID_SIZE];
     char sessionKey[SESSION_KEY_SIZE];
@@ -18,15 +18,27 @@ bool OtaUpdateService::parseTriggerPayload(const char *payload, OtaTriggerData *
     outTrigger->nonce = 0;
     outTrigger->otaId[0] = '\0';
     outTrigger->version[0] = '\0';
+    outTrigger->baseVersion[0] = '\0';
 
-    return iotnet::core::parseOtaTriggerPayload(
-        payload,
-        outTrigger->otaId,
-        sizeof(outTrigger->otaId),
-        outTrigger->version,
-        sizeof(outTrigger->version),
-        &outTrigger->nonce
-    );
+    if (!iotnet::core::parseOtaTriggerPayload(
+            payload,
+            outTrigger->otaId,
+            sizeof(outTrigger->otaId),
+            outTrigger->version,
+            sizeof(outTrigger->version),
+            &outTrigger->nonce
+        )) {
+        return false;
+    }
+
+    if (!iotnet::core::parseOtaTriggerBaseVersion(
+            payload,
+            outTrigger->baseVersion,
+            sizeof(outTrigger->baseVersion)
+        )) {
+        outTrigger->baseVersion[0] = '\0';
+    }
+    return true;
 }
 
 bool OtaUpdateService::storePendingSession(
@@ -34,7 +46,8 @@ bool OtaUpdateService::storePendingSession(
     const OtaTriggerData &trigger,
     unsigned long requestTimeMs
 ) {
-    return session.setPending(trigger.otaId, trigger.version, trigger.nonce, requestTimeMs);
+    return session.setPending(trigger.otaId, trigger.version, trigger.nonce, requestTimeMs) &&
+           session.setBaseVersion(trigger.baseVersion);
 }
 
 bool OtaUpdateService::buildSessionRequestPayload(
@@ -113,10 +126,9 @@ bool OtaUpdateService::fetchOtaUrl(
     const char *otaId,
     long nonce,
     const char *version,
-    char *outOtaUrl,
-    size_t outOtaUrlSize
+    OtaLinkData *outLink
 ) {
-    if (!backendBaseUrl || !sessionKey || !otaId || !version || !outOtaUrl || outOtaUrlSize == 0) {
+    if (!backendBaseUrl || !sessionKey || !otaId || !version || !outLink) {
         return false;
     }
 
@@ -126,8 +138,6 @@ bool OtaUpdateService::fetchOtaUrl(
     (void)otaId;
     (void)nonce;
     (void)version;
-    (void)outOtaUrl;
-    (void)outOtaUrlSize;
     return false;
 #else
     char requestBody[512];
@@ -153,18 +163,58 @@ bool OtaUpdateService::fetchOtaUrl(
     }
     http.addHeader("Content-Type", "application/json");
     http.addHeader("x-session-key", sessionKey);
+    // HTTP/1.0 rules out a chunked body, so the response can be read straight
+    // into a fixed buffer instead of growing a String.
+    http.useHTTP10(true);
 
     int httpCode = http.POST(requestBody);
-    if (httpCode != 200) {
+    WiFiClient *stream = http.getStreamPtr();
+    if (httpCode != 200 || !stream) {
         http.end();
         return false;
     }
 
-    String response = http.getString();
+    char response[1024];
+    int expected = http.getSize();
+    if (expected >= static_cast<int>(sizeof(response))) {
+        http.end();
+        return false;
+    }
+    size_t wanted = expected >= 0 ? static_cast<size_t>(expected) : sizeof(response) - 1;
+    size_t length = stream->readBytes(response, wanted);
+    response[length] = '\0';
     http.end();
 
-    return iotnet::core::parseOtaLinkResponsePayload(response.c_str(), outOtaUrl, outOtaUrlSize);
+    return parseLinkResponse(response, outLink);
 #endif
 }
 
+bool OtaUpdateService::parseLinkResponse(const char *payload, OtaLinkData *outLink) {
+    if (!payload || !outLink) {
+        return false;
+    }
+    outLink->patchUrl[0] = '\0';
+    outLink->hasSha256 = false;
+
+    if (!iotnet::core::parseOtaLinkResponsePayload(payload, outLink->otaUrl,
+                                                   sizeof(outLink->otaUrl))) {
+        return false;
+    }
+    if (!iotnet::core::parseOtaLinkPatchUrl(payload, outLink->patchUrl,
+                                            sizeof(outLink->patchUrl))) {
+        outLink->patchUrl[0] = '\0';
+    }
+
+    // A digest that is there but unreadable rejects the link; only a missing
+    // one leaves the choice to the caller.
+    char digest[iotnet::core::Sha256::HEX_SIZE + 2];
+    if (iotnet::core::parseOtaLinkSha256(payload, digest, sizeof(digest))) {
+        if (!iotnet::core::parseSha256Hex(digest, outLink->sha256)) {
+            return false;
+        }
+        outLink->hasSha256 = true;
+    }
+    return true;
+}
+
 }
@@ -4,6 +4,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "core/Sha256.h"
 #include "ota/OtaSessionState.h"
 
 namespace iotnetesp32::ota {
@@ -11,9 +12,22 @@ namespace iotnetesp32::ota {
 struct OtaTriggerData {
     char otaId[OtaSessionState::OTA_ID_SIZE];
     char version[OtaSessionState::VERSION_SIZE];
+    // Empty unless the update is offered as a delta patch against it.
+    char baseVersion[OtaSessionState::VERSION_SIZE];
     long nonce;
 };
 
+struct OtaLinkData {
+    static constexpr size_t URL_SIZE = 256;
+
+    char otaUrl[URL_SIZE];
+    // Empty when the response offers no delta patch.
+    char patchUrl[URL_SIZE];
+    // SHA-256 of the image as flashed, checked before it is made bootable.
+    uint8_t sha256[iotnet::core::Sha256::DIGEST_SIZE];
+    bool hasSha256;
+};
+
 enum class SessionResponseStatus {
     InvalidPayload,
     CidMismatch,
@@ -50,9 +64,12 @@ class OtaUpdateService {
         const char *otaId,
         long nonce,
         const char *version,
-        char *outOtaUrl,
-        size_t outOtaUrlSize
+        OtaLinkData *outLink
     );
+
+    // A digest that is present but not 64 hex digits rejects the response
+    // rather than skipping the check.
+    static bool parseLinkResponse(const char *payload, OtaLinkData *outLink);
 };
 
 }
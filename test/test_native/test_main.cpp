@@ -1,12 +1,59 @@
 #include <unity.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include <chrono>
+#include <limits.h>
+#include <math.h>
+#include <new>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <thread>
 
+#include "core/AllocationGuard.h"
+#include "core/BatchFrame.h"
+#include "core/ChunkPipeline.h"
+#include "core/ConnectionStateMachine.h"
+#include "core/Crc32.h"
+#include "core/DeltaPatcher.h"
+#include "core/DownloadCheckpoint.h"
+#include "core/GzipInflater.h"
 #include "core/JsonCodec.h"
+#include "core/MqttCodec.h"
+#include "core/NetworkMailbox.h"
+#include "core/PinTable.h"
+#include "core/PublishGate.h"
+#include "core/PublishQueue.h"
+#include "core/ResumeSnapshot.h"
+#include "core/Sha256.h"
+#include "core/TlsSessionCache.h"
+#include "core/TopicAliasTable.h"
+#include "core/TopicPrefix.h"
+#include "core/TopicRouter.h"
+#include "core/ValueCodec.h"
 #include "core/ClientConfig.h"
 #include "ota/OtaSessionState.h"
 #include "ota/OtaUpdateService.h"
 
+// The host's libstdc++ calls malloc from inside the shared library, out of
+// reach of the --wrap hooks; routing new through here makes C++ allocations
+// visible to AllocationGuard as they are on the device.
+void *operator new(size_t size) {
+    void *memory = malloc(size > 0 ? size : 1);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void *memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+    free(memory);
+}
+
 void test_client_config_struct_initialization() {
     ClientConfig config = {
         .mqttUsername = "test_user",
@@ -298,6 +345,2843 @@ void test_ota_session_reconnect_flow() {
     TEST_ASSERT_EQUAL_INT(120, expiresIn);
 }
 
+void test_topic_router_routes_pins_and_ota_channels() {
+    iotnet::core::TopicRouter router;
+    TEST_ASSERT_TRUE(router.configure("user-1", "board-1"));
+
+    iotnet::core::TopicRoute route = router.route("devices/user-1/board-1/V0");
+    TEST_ASSERT_EQUAL(static_cast<int>(iotnet::core::TopicKind::Pin), static_cast<int>(route.kind));
+    TEST_ASSERT_EQUAL_INT(0, route.pin);
+
+    route = router.route("devices/user-1/board-1/V49");
+    TEST_ASSERT_EQUAL(static_cast<int>(iotnet::core::TopicKind::Pin), static_cast<int>(route.kind));
+    TEST_ASSERT_EQUAL_INT(49, route.pin);
+
+    route = router.route("devices/user-1/board-1/ota/update");
+    TEST_ASSERT_EQUAL(
+        static_cast<int>(iotnet::core::TopicKind::OtaTrigger),
+        static_cast<int>(route.kind)
+    );
+
+    route = router.route("devices/user-1/board-1/ota/session/response");
+    TEST_ASSERT_EQUAL(
+        static_cast<int>(iotnet::core::TopicKind::OtaSessionResponse),
+        static_cast<int>(route.kind)
+    );
+}
+
+void test_topic_router_rejects_foreign_and_malformed_topics() {
+    iotnet::core::TopicRouter router;
+    TEST_ASSERT_TRUE(router.configure("user-1", "board-1"));
+
+    const char *rejected[] = {
+        "devices/user-2/board-1/V1",
+        "devices/user-1/board-1/",
+        "devices/user-1/board-1/V",
+        "devices/user-1/board-1/V07",
+        "devices/user-1/board-1/V1a",
+        "devices/user-1/board-1/V1234",
+        "devices/user-1/board-1/ota/session/request",
+        "devices/user-1/board-1/status",
+        "devices/user-1/board",
+    };
+
+    for (size_t i = 0; i < sizeof(rejected) / sizeof(rejected[0]); i++) {
+        iotnet::core::TopicRoute route = router.route(rejected[i]);
+        TEST_ASSERT_EQUAL(
+            static_cast<int>(iotnet::core::TopicKind::Unknown),
+            static_cast<int>(route.kind)
+        );
+    }
+
+    iotnet::core::TopicRouter unconfigured;
+    TEST_ASSERT_FALSE(unconfigured.isConfigured());
+    TEST_ASSERT_EQUAL(
+        static_cast<int>(iotnet::core::TopicKind::Unknown),
+        static_cast<int>(unconfigured.route("devices/user-1/board-1/V1").kind)
+    );
+    TEST_ASSERT_FALSE(unconfigured.configure(nullptr, "board-1"));
+}
+
+void test_topic_router_builds_pin_topics_from_prefix() {
+    iotnet::core::TopicRouter router;
+    TEST_ASSERT_TRUE(router.configure("user-1", "board-1"));
+
+    char topic[64];
+    TEST_ASSERT_TRUE(router.buildPinTopic(0, topic, sizeof(topic)));
+    TEST_ASSERT_EQUAL_STRING("devices/user-1/board-1/V0", topic);
+    TEST_ASSERT_TRUE(router.buildPinTopic(49, topic, sizeof(topic)));
+    TEST_ASSERT_EQUAL_STRING("devices/user-1/board-1/V49", topic);
+    TEST_ASSERT_EQUAL_INT(49, router.route(topic).pin);
+
+    char tooSmall[26];
+    TEST_ASSERT_FALSE(router.buildPinTopic(10, tooSmall, sizeof(tooSmall)));
+    TEST_ASSERT_FALSE(router.buildPinTopic(-1, topic, sizeof(topic)));
+}
+
+void test_topic_router_builds_wildcard_filter() {
+    iotnet::core::TopicRouter router;
+    char filter[64];
+    TEST_ASSERT_FALSE(router.buildWildcardFilter(filter, sizeof(filter)));
+
+    TEST_ASSERT_TRUE(router.configure("user-1", "board-1"));
+    TEST_ASSERT_TRUE(router.buildWildcardFilter(filter, sizeof(filter)));
+    TEST_ASSERT_EQUAL_STRING("devices/user-1/board-1/#", filter);
+
+    // Everything the filter delivers still goes through the router, which
+    // keeps only known channels.
+    TEST_ASSERT_EQUAL_INT(7, router.route("devices/user-1/board-1/V7").pin);
+    TEST_ASSERT_TRUE(router.route("devices/user-1/board-1/ota/update").kind ==
+                     iotnet::core::TopicKind::OtaTrigger);
+    TEST_ASSERT_TRUE(router.route("devices/user-1/board-1/batch").kind ==
+                     iotnet::core::TopicKind::Unknown);
+    TEST_ASSERT_TRUE(router.route("devices/user-1/board-1/ota/session/request").kind ==
+                     iotnet::core::TopicKind::Unknown);
+
+    char exact[25];
+    TEST_ASSERT_TRUE(router.buildWildcardFilter(exact, sizeof(exact)));
+    char tooSmall[24];
+    TEST_ASSERT_FALSE(router.buildWildcardFilter(tooSmall, sizeof(tooSmall)));
+}
+
+void test_topic_prefix_appends_channels_and_pins() {
+    iotnet::core::TopicPrefix prefix;
+    char otaTopic[120];
+    char topic[iotnet::core::TopicPrefix::MAX_PIN_TOPIC_LENGTH + 1];
+    TEST_ASSERT_FALSE(prefix.buildTopic("status", otaTopic));
+    TEST_ASSERT_FALSE(prefix.buildPinTopic(1, topic));
+
+    TEST_ASSERT_TRUE(prefix.configure("user-1", "board-1"));
+    TEST_ASSERT_EQUAL_STRING("devices/user-1/board-1/", prefix.data());
+    TEST_ASSERT_EQUAL(23, prefix.length());
+
+    TEST_ASSERT_TRUE(prefix.buildTopic("ota/session/response", otaTopic));
+    TEST_ASSERT_EQUAL_STRING("devices/user-1/board-1/ota/session/response", otaTopic);
+    TEST_ASSERT_TRUE(prefix.buildPinTopic(0, topic));
+    TEST_ASSERT_EQUAL_STRING("devices/user-1/board-1/V0", topic);
+    TEST_ASSERT_TRUE(prefix.buildPinTopic(iotnet::core::TopicPrefix::MAX_PIN, topic));
+    TEST_ASSERT_EQUAL_STRING("devices/user-1/board-1/V999", topic);
+    TEST_ASSERT_FALSE(prefix.buildPinTopic(iotnet::core::TopicPrefix::MAX_PIN + 1, topic));
+
+    // Runtime lengths are still checked for buffers without a static bound.
+    char exact[30];
+    TEST_ASSERT_TRUE(prefix.buildTopic("status", 6, exact, sizeof(exact)));
+    TEST_ASSERT_FALSE(prefix.buildTopic("status", 6, exact, sizeof(exact) - 1));
+    TEST_ASSERT_FALSE(prefix.buildPinTopic(100, exact, 27));
+    TEST_ASSERT_TRUE(prefix.buildPinTopic(100, exact, 28));
+
+    // A prefix over MAX_LENGTH is refused rather than truncated later.
+    char longBoard[96];
+    memset(longBoard, 'b', sizeof(longBoard) - 1);
+    longBoard[sizeof(longBoard) - 1] = '\0';
+    TEST_ASSERT_FALSE(prefix.configure("user-1", longBoard));
+    TEST_ASSERT_FALSE(prefix.isConfigured());
+    longBoard[iotnet::core::TopicPrefix::MAX_LENGTH - 16] = '\0';
+    TEST_ASSERT_TRUE(prefix.configure("user-1", longBoard));
+    TEST_ASSERT_EQUAL(iotnet::core::TopicPrefix::MAX_LENGTH, prefix.length());
+    TEST_ASSERT_TRUE(prefix.buildTopic("ota/session/response", otaTopic));
+    TEST_ASSERT_TRUE(prefix.buildPinTopic(iotnet::core::TopicPrefix::MAX_PIN, topic));
+}
+
+void test_pin_table_store_and_update_flags() {
+    iotnet::core::PinTable table;
+    TEST_ASSERT_FALSE(table.isInitialized(3));
+
+    table.markInitialized(3);
+    TEST_ASSERT_TRUE(table.isInitialized(3));
+    TEST_ASSERT_FALSE(table.isUpdated(3));
+
+    TEST_ASSERT_TRUE(table.storeValue(3, "42"));
+    TEST_ASSERT_TRUE(table.isUpdated(3));
+    TEST_ASSERT_EQUAL_STRING("42", table.value(3));
+    TEST_ASSERT_EQUAL(2, table.valueLength(3));
+
+    table.clearUpdated(3);
+    TEST_ASSERT_FALSE(table.storeValue(3, "42"));
+    TEST_ASSERT_FALSE(table.isUpdated(3));
+
+    char oversized[64];
+    memset(oversized, '7', sizeof(oversized) - 1);
+    oversized[sizeof(oversized) - 1] = '\0';
+    TEST_ASSERT_TRUE(table.storeValue(3, oversized));
+    TEST_ASSERT_EQUAL(iotnet::core::PinTable::VALUE_SIZE - 1, strlen(table.value(3)));
+    TEST_ASSERT_EQUAL(iotnet::core::PinTable::VALUE_SIZE - 1, table.valueLength(3));
+
+    TEST_ASSERT_FALSE(iotnet::core::PinTable::isValidPin(-1));
+    TEST_ASSERT_FALSE(iotnet::core::PinTable::isValidPin(iotnet::core::PinTable::CAPACITY));
+}
+
+void test_pin_table_footprint() {
+    // Layout of IotNetESP32::PinState before topics moved to the shared prefix.
+    struct LegacyPinState {
+        char topic[120];
+        char value[iotnet::core::PinTable::VALUE_SIZE];
+        bool updated;
+        bool initialized;
+    };
+
+    size_t legacyBytes = sizeof(LegacyPinState) * iotnet::core::PinTable::CAPACITY;
+    size_t currentBytes = sizeof(iotnet::core::PinTable) + sizeof(iotnet::core::TopicRouter);
+
+    char message[128];
+    snprintf(
+        message,
+        sizeof(message),
+        "IotNetESP32 pin storage: before %zu bytes, after %zu bytes (saves %zu)",
+        legacyBytes,
+        currentBytes,
+        legacyBytes - currentBytes
+    );
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_LESS_OR_EQUAL(2048, currentBytes);
+    TEST_ASSERT_GREATER_OR_EQUAL(5000, legacyBytes - currentBytes);
+}
+
+void test_pin_callback_index_dispatches_dirty_watched_pins() {
+    iotnet::core::PinTable table;
+    iotnet::core::PinCallbackIndex index;
+
+    int first = index.add(5);
+    int second = index.add(5);
+    int other = index.add(7);
+    TEST_ASSERT_EQUAL_INT(0, first);
+    TEST_ASSERT_EQUAL_INT(1, second);
+    TEST_ASSERT_EQUAL_INT(2, other);
+    TEST_ASSERT_EQUAL_INT(iotnet::core::PinCallbackIndex::NONE, index.add(-1));
+
+    table.markInitialized(5);
+    table.markInitialized(7);
+    table.markInitialized(9);
+
+    int calls[3] = {0, 0, 0};
+    auto visit = [&](int slot, int pin) {
+        TEST_ASSERT_TRUE(slot >= 0 && slot < 3);
+        calls[slot]++;
+        TEST_ASSERT_EQUAL_STRING(pin == 5 ? "on" : "x", table.value(pin));
+    };
+
+    TEST_ASSERT_EQUAL_INT(0, index.dispatch(table, visit));
+
+    table.storeValue(5, "on");
+    table.storeValue(9, "unwatched");
+    TEST_ASSERT_EQUAL_INT(2, index.dispatch(table, visit));
+    TEST_ASSERT_EQUAL_INT(1, calls[0]);
+    TEST_ASSERT_EQUAL_INT(1, calls[1]);
+    TEST_ASSERT_EQUAL_INT(0, calls[2]);
+    TEST_ASSERT_FALSE(table.isUpdated(5));
+    TEST_ASSERT_TRUE(table.isUpdated(9));
+
+    TEST_ASSERT_EQUAL_INT(0, index.dispatch(table, visit));
+}
+
+void test_pin_callback_index_capacity() {
+    iotnet::core::PinCallbackIndex index;
+    for (int i = 0; i < iotnet::core::PinCallbackIndex::CAPACITY; i++) {
+        TEST_ASSERT_EQUAL_INT(i, index.add(i % 3));
+    }
+    TEST_ASSERT_EQUAL_INT(iotnet::core::PinCallbackIndex::NONE, index.add(0));
+    TEST_ASSERT_EQUAL(0x7, index.watchedPins());
+}
+
+void test_value_codec_parse_integers_with_range_checks() {
+    long long value = 0;
+    TEST_ASSERT_TRUE(iotnet::core::parseInteger("42", 2, -100, 100, &value));
+    TEST_ASSERT_EQUAL_INT(42, value);
+    TEST_ASSERT_TRUE(iotnet::core::parseInteger(" -17 ", 5, -100, 100, &value));
+    TEST_ASSERT_EQUAL_INT(-17, value);
+    TEST_ASSERT_TRUE(iotnet::core::parseInteger("12.9", 4, -100, 100, &value));
+    TEST_ASSERT_EQUAL_INT(12, value);
+    TEST_ASSERT_TRUE(iotnet::core::parseInteger("-128", 4, -128, 127, &value));
+    TEST_ASSERT_EQUAL_INT(-128, value);
+
+    TEST_ASSERT_FALSE(iotnet::core::parseInteger("128", 3, -128, 127, &value));
+    TEST_ASSERT_FALSE(iotnet::core::parseInteger("-129", 4, -128, 127, &value));
+    TEST_ASSERT_FALSE(iotnet::core::parseInteger("99999999999999999999", 20, -128, 127, &value));
+    TEST_ASSERT_FALSE(iotnet::core::parseInteger("", 0, -128, 127, &value));
+    TEST_ASSERT_FALSE(iotnet::core::parseInteger("-", 1, -128, 127, &value));
+    TEST_ASSERT_FALSE(iotnet::core::parseInteger("abc", 3, -128, 127, &value));
+    TEST_ASSERT_FALSE(iotnet::core::parseInteger("12x", 3, -128, 127, &value));
+    TEST_ASSERT_FALSE(iotnet::core::parseInteger(".5", 2, -128, 127, &value));
+    TEST_ASSERT_FALSE(iotnet::core::parseInteger("5", 1, 0, 4, &value));
+
+    unsigned long long unsignedValue = 0;
+    TEST_ASSERT_TRUE(iotnet::core::parseUnsigned("4294967295", 10, 4294967295ULL, &unsignedValue));
+    TEST_ASSERT_EQUAL_UINT32(4294967295UL, unsignedValue);
+    TEST_ASSERT_FALSE(iotnet::core::parseUnsigned("4294967296", 10, 4294967295ULL, &unsignedValue));
+    TEST_ASSERT_FALSE(iotnet::core::parseUnsigned("-1", 2, 4294967295ULL, &unsignedValue));
+}
+
+void test_value_codec_parse_floats_and_bools() {
+    double doubleValue = 0;
+    TEST_ASSERT_TRUE(iotnet::core::parseDouble("3.25", 4, &doubleValue));
+    TEST_ASSERT_EQUAL_DOUBLE(3.25, doubleValue);
+    TEST_ASSERT_TRUE(iotnet::core::parseDouble(" -1e-3 ", 7, &doubleValue));
+    TEST_ASSERT_EQUAL_DOUBLE(-0.001, doubleValue);
+    TEST_ASSERT_FALSE(iotnet::core::parseDouble("1e999", 5, &doubleValue));
+    TEST_ASSERT_FALSE(iotnet::core::parseDouble("1.5kg", 5, &doubleValue));
+    TEST_ASSERT_FALSE(iotnet::core::parseDouble("", 0, &doubleValue));
+
+    float floatValue = 0;
+    TEST_ASSERT_TRUE(iotnet::core::parseFloat("27.5", 4, &floatValue));
+    TEST_ASSERT_EQUAL_FLOAT(27.5f, floatValue);
+    TEST_ASSERT_FALSE(iotnet::core::parseFloat("1e60", 4, &floatValue));
+
+    bool boolValue = false;
+    TEST_ASSERT_TRUE(iotnet::core::parseBool("TRUE", 4, &boolValue));
+    TEST_ASSERT_TRUE(boolValue);
+    TEST_ASSERT_TRUE(iotnet::core::parseBool("false", 5, &boolValue));
+    TEST_ASSERT_FALSE(boolValue);
+    TEST_ASSERT_TRUE(iotnet::core::parseBool("1", 1, &boolValue));
+    TEST_ASSERT_TRUE(boolValue);
+    TEST_ASSERT_TRUE(iotnet::core::parseBool("0", 1, &boolValue));
+    TEST_ASSERT_FALSE(boolValue);
+    TEST_ASSERT_TRUE(iotnet::core::parseBool("-3", 2, &boolValue));
+    TEST_ASSERT_FALSE(boolValue);
+    TEST_ASSERT_FALSE(iotnet::core::parseBool("yes", 3, &boolValue));
+}
+
+void test_value_codec_format_integers() {
+    char buffer[24];
+    TEST_ASSERT_EQUAL_UINT(1, iotnet::core::formatInteger(0, buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_STRING("0", buffer);
+    TEST_ASSERT_EQUAL_UINT(4, iotnet::core::formatInteger(-705, buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_STRING("-705", buffer);
+    iotnet::core::formatInteger(LLONG_MIN, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("-9223372036854775808", buffer);
+    iotnet::core::formatUnsigned(ULLONG_MAX, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("18446744073709551615", buffer);
+    // Crosses the 32-bit boundary with zeros inside the low eight digits.
+    iotnet::core::formatUnsigned(100000000005ULL, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("100000000005", buffer);
+
+    char expected[24];
+    long long samples[] = {1, 9, 10, 99, 100, 12345, -2147483648LL, 4294967295LL, 4294967296LL};
+    for (long long sample : samples) {
+        snprintf(expected, sizeof(expected), "%lld", sample);
+        iotnet::core::formatInteger(sample, buffer, sizeof(buffer));
+        TEST_ASSERT_EQUAL_STRING(expected, buffer);
+    }
+
+    char small[4];
+    TEST_ASSERT_EQUAL_UINT(0, iotnet::core::formatInteger(1234, small, sizeof(small)));
+    TEST_ASSERT_EQUAL_STRING("", small);
+    TEST_ASSERT_EQUAL_UINT(3, iotnet::core::formatInteger(-12, small, sizeof(small)));
+}
+
+void test_value_codec_format_fixed_matches_printf() {
+    char buffer[32];
+    TEST_ASSERT_EQUAL_UINT(5, iotnet::core::formatFixed(27.3, 2, buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_STRING("27.30", buffer);
+    iotnet::core::formatFixed(-0.004, 2, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("-0.00", buffer);
+    iotnet::core::formatFixed(2.5, 0, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("2", buffer);
+    iotnet::core::formatFixed(0.125, 2, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("0.12", buffer);
+    iotnet::core::formatFixed(NAN, 2, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("nan", buffer);
+    iotnet::core::formatFixed(-INFINITY, 2, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("-inf", buffer);
+    iotnet::core::formatFixed(1e20, 1, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("100000000000000000000.0", buffer);
+
+    // Sweep sensor-like values at every precision against the printf path
+    // the formatter replaces.
+    char expected[32];
+    unsigned long seed = 12345;
+    for (int i = 0; i < 20000; i++) {
+        seed = seed * 1103515245UL + 12345UL;
+        double value = static_cast<double>((seed >> 8) % 2000000) / 997.0 - 1000.0;
+        unsigned precision = static_cast<unsigned>(i % 7);
+        snprintf(expected, sizeof(expected), "%.*f", static_cast<int>(precision), value);
+        iotnet::core::formatFixed(value, precision, buffer, sizeof(buffer));
+        TEST_ASSERT_EQUAL_STRING(expected, buffer);
+    }
+
+    float reading = 23.45f;
+    snprintf(expected, sizeof(expected), "%.2f", reading);
+    iotnet::core::formatFixed(reading, 2, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING(expected, buffer);
+
+    // Decimal inputs sit next to ties; printf rounds their exact binary value.
+    iotnet::core::formatFixed(2.675, 2, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("2.67", buffer);
+    iotnet::core::formatFixed(874.85000000000002, 1, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("874.9", buffer);
+    iotnet::core::formatFixed(347.94999999999999, 1, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("347.9", buffer);
+    for (int divisor = 100; divisor <= 1000; divisor *= 10) {
+        for (int k = -200000; k <= 200000; k++) {
+            double value = static_cast<double>(k) / divisor;
+            for (int precision = 1; precision <= 3; precision++) {
+                snprintf(expected, sizeof(expected), "%.*f", precision, value);
+                iotnet::core::formatFixed(value, static_cast<unsigned>(precision), buffer,
+                                          sizeof(buffer));
+                TEST_ASSERT_EQUAL_STRING(expected, buffer);
+            }
+        }
+    }
+
+    // Fixed notation that does not fit the payload switches to exponent form.
+    TEST_ASSERT_EQUAL_UINT(6, iotnet::core::formatFixed(-1e30, 2, buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_STRING("-1e+30", buffer);
+}
+
+void test_publish_gate_numeric_policy() {
+    iotnet::core::PublishGate gate;
+    iotnet::core::PublishPolicy policy;
+    policy.absoluteDeadband = 0.5;
+    policy.minIntervalMs = 100;
+    policy.heartbeatMs = 10000;
+    TEST_ASSERT_TRUE(gate.setPolicy(2, policy));
+
+    auto send = [&](double value, uint32_t nowMs) {
+        iotnet::core::PublishSample sample = iotnet::core::numericSample(value);
+        if (!gate.admit(2, sample, nowMs)) {
+            return false;
+        }
+        gate.recordSent(2, sample, nowMs);
+        return true;
+    };
+
+    TEST_ASSERT_TRUE(send(20.0, 0));
+    TEST_ASSERT_FALSE(send(25.0, 50));    // changed, but inside the minimum interval
+    TEST_ASSERT_FALSE(send(20.4, 200));   // inside the deadband
+    TEST_ASSERT_TRUE(send(20.6, 300));
+    TEST_ASSERT_FALSE(send(20.6, 9000));
+    TEST_ASSERT_TRUE(send(20.6, 10300));  // heartbeat forces the unchanged value out
+
+    // Relative deadband scales with the last published value.
+    policy.absoluteDeadband = 0.0;
+    policy.relativeDeadband = 0.1;
+    policy.heartbeatMs = 0;
+    TEST_ASSERT_TRUE(gate.setPolicy(2, policy));
+    TEST_ASSERT_TRUE(send(100.0, 20000));
+    TEST_ASSERT_FALSE(send(109.0, 20200));
+    TEST_ASSERT_TRUE(send(111.0, 20400));
+
+    // Pins without a policy are never held back and only count as sent.
+    iotnet::core::PublishSample sample = iotnet::core::numericSample(1.0);
+    TEST_ASSERT_TRUE(gate.admit(3, sample, 20400));
+    gate.recordSent(3, sample, 20400);
+
+    iotnet::core::PublishStats stats = gate.stats();
+    TEST_ASSERT_EQUAL_UINT32(6, stats.sent);
+    TEST_ASSERT_EQUAL_UINT32(4, stats.suppressed);
+}
+
+void test_publish_gate_text_policy_and_slots() {
+    iotnet::core::PublishGate gate;
+    iotnet::core::PublishPolicy policy;
+    TEST_ASSERT_TRUE(gate.setPolicy(1, policy));
+
+    iotnet::core::PublishSample ready = iotnet::core::textSample("ready", 5);
+    TEST_ASSERT_TRUE(gate.admit(1, ready, 0));
+    gate.recordSent(1, ready, 0);
+    TEST_ASSERT_FALSE(gate.admit(1, iotnet::core::textSample("ready", 5), 10));
+    TEST_ASSERT_TRUE(gate.admit(1, iotnet::core::textSample("ready!", 6), 20));
+
+    // A zero deadband still suppresses exact repeats of a number.
+    TEST_ASSERT_TRUE(gate.setPolicy(4, policy));
+    gate.recordSent(4, iotnet::core::numericSample(7), 0);
+    TEST_ASSERT_FALSE(gate.admit(4, iotnet::core::numericSample(7), 10));
+    TEST_ASSERT_TRUE(gate.admit(4, iotnet::core::numericSample(8), 10));
+
+    for (int pin = 10; pin < 10 + iotnet::core::PublishGate::POLICY_CAPACITY - 2; pin++) {
+        TEST_ASSERT_TRUE(gate.setPolicy(pin, policy));
+    }
+    TEST_ASSERT_FALSE(gate.setPolicy(40, policy));
+    gate.clearPolicy(1);
+    TEST_ASSERT_FALSE(gate.hasPolicy(1));
+    TEST_ASSERT_TRUE(gate.admit(1, ready, 30));
+    TEST_ASSERT_TRUE(gate.setPolicy(40, policy));
+    TEST_ASSERT_FALSE(gate.setPolicy(-1, policy));
+}
+
+void test_publish_gate_claims_writes_before_they_are_queued() {
+    iotnet::core::PublishGate gate;
+    iotnet::core::PublishPolicy policy;
+    policy.absoluteDeadband = 0.5;
+    TEST_ASSERT_TRUE(gate.setPolicy(2, policy));
+
+    // A queued value is compared against right away, so repeats written
+    // before run() sends it never take a queue slot.
+    TEST_ASSERT_TRUE(gate.claim(2, iotnet::core::numericSample(20.0), 0));
+    TEST_ASSERT_FALSE(gate.claim(2, iotnet::core::numericSample(20.2), 10));
+    TEST_ASSERT_FALSE(gate.claim(2, iotnet::core::numericSample(20.4), 20));
+    TEST_ASSERT_TRUE(gate.claim(2, iotnet::core::numericSample(21.0), 30));
+
+    // The claimed value was dropped: the next write goes out even unchanged.
+    gate.forget(2);
+    TEST_ASSERT_TRUE(gate.claim(2, iotnet::core::numericSample(21.0), 40));
+    TEST_ASSERT_TRUE(gate.claim(3, iotnet::core::numericSample(1.0), 40));
+    gate.forget(3);
+
+    // Only publishes that happened count as sent.
+    gate.countSent();
+    iotnet::core::PublishStats stats = gate.stats();
+    TEST_ASSERT_EQUAL_UINT32(1, stats.sent);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.suppressed);
+}
+
+void test_batch_frame_builds_compact_object() {
+    iotnet::core::BatchFrame frame;
+    TEST_ASSERT_TRUE(frame.isEmpty());
+
+    TEST_ASSERT_TRUE(frame.appendValue(2, "5", 1));
+    TEST_ASSERT_TRUE(frame.appendValue(3, "-96.25", 6));
+    TEST_ASSERT_TRUE(frame.appendValue(4, "true", 4));
+    TEST_ASSERT_TRUE(frame.appendValue(5, "nan", 3));
+    TEST_ASSERT_TRUE(frame.appendText(12, "say \"hi\"\n", 9));
+    TEST_ASSERT_TRUE(frame.contains(12));
+    TEST_ASSERT_FALSE(frame.appendValue(2, "6", 1));
+    TEST_ASSERT_FALSE(frame.appendValue(64, "6", 1));
+    TEST_ASSERT_TRUE(frame.pins() == 0x103cULL);
+
+    size_t length = 0;
+    const char *json = frame.finish(&length);
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"V2\":5,\"V3\":-96.25,\"V4\":true,\"V5\":\"nan\",\"V12\":\"say \\\"hi\\\"\\u000a\"}",
+        json
+    );
+    TEST_ASSERT_EQUAL_UINT(strlen(json), length);
+
+    frame.reset();
+    TEST_ASSERT_TRUE(frame.isEmpty());
+    TEST_ASSERT_EQUAL_STRING("{}", frame.finish(&length));
+}
+
+void test_batch_frame_rejects_entries_that_do_not_fit() {
+    iotnet::core::BatchFrame frame;
+    char value[31];
+    memset(value, 'x', sizeof(value));
+
+    int pin = 0;
+    while (frame.appendText(pin, value, sizeof(value))) {
+        pin++;
+    }
+    TEST_ASSERT_GREATER_THAN(0, pin);
+    TEST_ASSERT_FALSE(frame.contains(pin));
+
+    size_t length = 0;
+    const char *json = frame.finish(&length);
+    TEST_ASSERT_LESS_THAN(iotnet::core::BatchFrame::CAPACITY, length + 1);
+    TEST_ASSERT_EQUAL_INT('}', json[length - 1]);
+
+    // Bytes on the wire for ten pins: one PUBLISH per pin versus one frame.
+    const char *prefix = "devices/019cc382-0dac-70b1-98dc-1b81b3ab2c00/"
+                         "espressif_fb2d6ad26fdf7b867baf41b8559a1c/";
+    size_t prefixLength = strlen(prefix);
+    size_t perPinBytes = 0;
+    iotnet::core::BatchFrame batch;
+    for (int i = 2; i < 12; i++) {
+        // Fixed header (2) + topic length (2) + topic + "V<n>" + 2-digit value.
+        perPinBytes += 2 + 2 + prefixLength + (i < 10 ? 2 : 3) + 2;
+        batch.appendValue(i, "42", 2);
+    }
+    size_t batchLength = 0;
+    batch.finish(&batchLength);
+    size_t batchBytes = 2 + 2 + prefixLength + strlen("batch") + batchLength;
+
+    char message[128];
+    snprintf(message, sizeof(message), "10 pin writes: %zu bytes unbatched, %zu bytes batched",
+             perPinBytes, batchBytes);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_LESS_THAN(perPinBytes / 5, batchBytes);
+}
+
+iotnet::core::OutboundValue makeQueuedValue(int pin, int sequence) {
+    iotnet::core::OutboundValue value = {};
+    value.pin = static_cast<int8_t>(pin);
+    value.length = static_cast<uint8_t>(
+        iotnet::core::formatInteger(sequence, value.payload, sizeof(value.payload))
+    );
+    value.sample = iotnet::core::numericSample(sequence);
+    return value;
+}
+
+void test_publish_queue_overflow_policies() {
+    using iotnet::core::OverflowPolicy;
+    const int capacity = static_cast<int>(iotnet::core::PublishQueue::CAPACITY);
+
+    static iotnet::core::PublishQueue queue;
+    queue.reset();
+    for (int i = 0; i < capacity; i++) {
+        TEST_ASSERT_TRUE(queue.push(makeQueuedValue(1, i), OverflowPolicy::DropNewest));
+    }
+    TEST_ASSERT_FALSE(queue.tryPush(makeQueuedValue(1, 999)));
+    TEST_ASSERT_FALSE(queue.push(makeQueuedValue(1, 999), OverflowPolicy::DropNewest));
+    TEST_ASSERT_TRUE(queue.push(makeQueuedValue(1, capacity), OverflowPolicy::DropOldest));
+
+    // The oldest value made room; order is otherwise preserved.
+    iotnet::core::OutboundValue out;
+    for (int expected = 1; expected <= capacity; expected++) {
+        TEST_ASSERT_TRUE(queue.tryPop(out));
+        TEST_ASSERT_EQUAL_DOUBLE(expected, out.sample.number);
+        queue.recordSent();
+    }
+    TEST_ASSERT_FALSE(queue.tryPop(out));
+
+    iotnet::core::PublishQueueStats stats = queue.stats();
+    TEST_ASSERT_EQUAL_UINT32(capacity + 1, stats.enqueued);
+    TEST_ASSERT_EQUAL_UINT32(capacity, stats.sent);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.dropped);
+}
+
+void test_publish_queue_drop_oldest_releases_evicted_claims() {
+    using iotnet::core::OverflowPolicy;
+    static iotnet::core::PublishQueue queue;
+    queue.reset();
+    iotnet::core::PublishGate gate;
+    iotnet::core::PublishPolicy policy;
+    policy.absoluteDeadband = 0.5;
+    TEST_ASSERT_TRUE(gate.setPolicy(3, policy));
+
+    // V3's claimed value is the oldest queued; V4 fills the rest.
+    TEST_ASSERT_TRUE(gate.claim(3, iotnet::core::numericSample(7), 0));
+    uint64_t evicted = 0;
+    TEST_ASSERT_TRUE(queue.push(makeQueuedValue(3, 7), OverflowPolicy::DropOldest, &evicted));
+    TEST_ASSERT_TRUE(evicted == 0);
+    for (uint32_t i = 1; i < iotnet::core::PublishQueue::CAPACITY; i++) {
+        TEST_ASSERT_TRUE(queue.push(makeQueuedValue(4, i), OverflowPolicy::DropOldest));
+    }
+    TEST_ASSERT_TRUE(queue.push(makeQueuedValue(4, 99), OverflowPolicy::DropOldest, &evicted));
+    TEST_ASSERT_TRUE(evicted == iotnet::core::PinTable::bit(3));
+
+    // Without releasing the claim the same value would stay suppressed.
+    TEST_ASSERT_FALSE(gate.claim(3, iotnet::core::numericSample(7), 10));
+    gate.forget(3);
+    TEST_ASSERT_TRUE(gate.claim(3, iotnet::core::numericSample(7), 20));
+}
+
+void test_publish_queue_concurrent_producers() {
+    static iotnet::core::PublishQueue queue;
+    queue.reset();
+
+    const int producers = 4;
+    const int perProducer = 20000;
+    std::atomic<bool> done(false);
+
+    // One consumer checks that every producer's values arrive in order.
+    int lastSeen[producers];
+    int received = 0;
+    bool ordered = true;
+    std::thread consumer([&]() {
+        for (int i = 0; i < producers; i++) {
+            lastSeen[i] = -1;
+        }
+        iotnet::core::OutboundValue out;
+        for (;;) {
+            if (!queue.tryPop(out)) {
+                // Producers have joined before done is set, so empty means finished.
+                if (done.load()) {
+                    break;
+                }
+                std::this_thread::yield();
+                continue;
+            }
+            int producer = out.pin;
+            int sequence = static_cast<int>(out.sample.number);
+            ordered = ordered && sequence > lastSeen[producer];
+            lastSeen[producer] = sequence;
+            received++;
+        }
+    });
+
+    std::thread workers[producers];
+    for (int p = 0; p < producers; p++) {
+        workers[p] = std::thread([&, p]() {
+            for (int i = 0; i < perProducer; i++) {
+                while (!queue.tryPush(makeQueuedValue(p, i))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    done.store(true);
+    consumer.join();
+
+    TEST_ASSERT_TRUE(ordered);
+    TEST_ASSERT_EQUAL_INT(producers * perProducer, received);
+    TEST_ASSERT_EQUAL_UINT32(producers * perProducer, queue.stats().enqueued);
+}
+
+void test_network_mailbox_pin_set_and_inbound_values() {
+    iotnet::core::AtomicPinSet pending;
+    pending.add(3);
+    pending.add(49);
+    pending.add(-1);
+    pending.add(64);
+    TEST_ASSERT_TRUE(pending.takeAll() == ((uint64_t(1) << 3) | (uint64_t(1) << 49)));
+    TEST_ASSERT_TRUE(pending.takeAll() == 0);
+
+    // Requests from several tasks are never lost between two drains.
+    const int threads = 4;
+    std::thread adders[threads];
+    for (int t = 0; t < threads; t++) {
+        adders[t] = std::thread([&pending, t]() {
+            for (int pin = t; pin < iotnet::core::PinTable::CAPACITY; pin += threads) {
+                pending.add(pin);
+            }
+        });
+    }
+    for (std::thread &adder : adders) {
+        adder.join();
+    }
+    uint64_t collected = pending.takeAll();
+    TEST_ASSERT_TRUE(collected == (uint64_t(1) << iotnet::core::PinTable::CAPACITY) - 1);
+
+    iotnet::core::InboundValue inbound;
+    inbound.assign(7, "0123456789012345678901234567890123456789");
+    TEST_ASSERT_EQUAL_INT(7, inbound.pin);
+    TEST_ASSERT_EQUAL_UINT(iotnet::core::PinTable::VALUE_SIZE - 1, strlen(inbound.payload));
+
+    iotnet::core::InboundQueue queue;
+    for (uint32_t i = 0; i < iotnet::core::InboundQueue::CAPACITY; i++) {
+        inbound.assign(static_cast<int>(i % 50), "1");
+        TEST_ASSERT_TRUE(queue.tryPush(inbound));
+    }
+    uint32_t evicted = 0;
+    inbound.assign(9, "latest");
+    TEST_ASSERT_TRUE(queue.pushEvictingOldest(inbound, &evicted));
+    TEST_ASSERT_EQUAL_UINT32(1, evicted);
+
+    iotnet::core::InboundValue out;
+    uint32_t count = 0;
+    while (queue.tryPop(out)) {
+        count++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(iotnet::core::InboundQueue::CAPACITY, count);
+    TEST_ASSERT_EQUAL_STRING("latest", out.payload);
+}
+
+namespace {
+
+struct FakeConnectionDriver : iotnet::core::ConnectionDriver {
+    iotnet::core::StepResult results[5] = {
+        iotnet::core::StepResult::Done, iotnet::core::StepResult::Done,
+        iotnet::core::StepResult::Done, iotnet::core::StepResult::Done,
+        iotnet::core::StepResult::Done,
+    };
+    int calls[5] = {};
+    bool online = true;
+    int teardowns = 0;
+
+    iotnet::core::StepResult step(int index) {
+        calls[index]++;
+        return results[index];
+    }
+    iotnet::core::StepResult resolve() override { return step(0); }
+    iotnet::core::StepResult connectTcp() override { return step(1); }
+    iotnet::core::StepResult handshakeTls() override { return step(2); }
+    iotnet::core::StepResult connectMqtt() override { return step(3); }
+    iotnet::core::StepResult subscribe() override { return step(4); }
+    bool isOnline() override { return online; }
+    void teardown() override { teardowns++; }
+};
+
+uint32_t fixedRandom(void *context) {
+    return *static_cast<uint32_t *>(context);
+}
+
+}
+
+void test_connection_state_machine_walks_every_state() {
+    using iotnet::core::ConnectionState;
+    FakeConnectionDriver driver;
+    iotnet::core::ConnectionStateMachine machine(driver, iotnet::core::BackoffConfig{1000, 8000, 0});
+
+    TEST_ASSERT_FALSE(machine.poll(0));
+    machine.start(100);
+
+    const ConnectionState expected[] = {
+        ConnectionState::Resolving,      ConnectionState::TcpConnecting,
+        ConnectionState::TlsHandshake,   ConnectionState::MqttConnecting,
+        ConnectionState::Subscribing,    ConnectionState::Online,
+    };
+    uint32_t now = 100;
+    for (ConnectionState state : expected) {
+        TEST_ASSERT_TRUE(machine.poll(now));
+        TEST_ASSERT_EQUAL_INT(static_cast<int>(state), static_cast<int>(machine.state()));
+        now += 10;
+    }
+    TEST_ASSERT_EQUAL_UINT32(50, machine.lastConnectDurationMs());
+    TEST_ASSERT_EQUAL_UINT32(40, machine.timeInState(now + 30));
+    TEST_ASSERT_FALSE(machine.poll(now));
+
+    // Losing the session reconnects immediately, without backoff.
+    driver.online = false;
+    TEST_ASSERT_TRUE(machine.poll(now));
+    TEST_ASSERT_EQUAL_INT(static_cast<int>(ConnectionState::Disconnected),
+                          static_cast<int>(machine.state()));
+    TEST_ASSERT_EQUAL_INT(1, driver.teardowns);
+    TEST_ASSERT_TRUE(machine.poll(now));
+    TEST_ASSERT_EQUAL_INT(static_cast<int>(ConnectionState::Resolving),
+                          static_cast<int>(machine.state()));
+}
+
+void test_connection_state_machine_backs_off_with_jitter() {
+    using iotnet::core::ConnectionState;
+    FakeConnectionDriver driver;
+    driver.results[1] = iotnet::core::StepResult::Failed;
+    iotnet::core::ConnectionStateMachine machine(driver, iotnet::core::BackoffConfig{1000, 8000, 0});
+    uint32_t randomValue = 0xffffffffu;
+    machine.setRandomSource(fixedRandom, &randomValue);
+
+    // Ceilings grow 1000, 2000, 4000, 8000 and then stay capped; each delay
+    // is half the ceiling plus a random share of the other half.
+    uint32_t now = 0;
+    machine.start(now);
+    const uint32_t ceilings[] = {1000, 2000, 4000, 8000, 8000};
+    for (uint32_t ceiling : ceilings) {
+        TEST_ASSERT_TRUE(machine.poll(now));   // Disconnected -> Resolving
+        TEST_ASSERT_TRUE(machine.poll(now));   // Resolving -> TcpConnecting
+        TEST_ASSERT_TRUE(machine.poll(now));   // TcpConnecting fails
+        TEST_ASSERT_TRUE(machine.isWaiting());
+
+        uint32_t delay = machine.retryAtMs() - now;
+        TEST_ASSERT_GREATER_OR_EQUAL(ceiling / 2, delay);
+        TEST_ASSERT_LESS_OR_EQUAL(ceiling, delay);
+        TEST_ASSERT_EQUAL_UINT32(ceiling / 2 + 0xffffffffu % (ceiling / 2 + 1), delay);
+
+        // Nothing happens before the retry time, so run() stays cheap.
+        TEST_ASSERT_FALSE(machine.poll(now + delay - 1));
+        TEST_ASSERT_EQUAL_UINT32(delay - 1, machine.timeInState(now + delay - 1));
+        now += delay;
+    }
+    TEST_ASSERT_EQUAL_UINT32(5, machine.consecutiveFailures());
+    TEST_ASSERT_EQUAL_INT(5, driver.teardowns);
+
+    // A successful attempt resets the backoff.
+    driver.results[1] = iotnet::core::StepResult::Done;
+    for (int i = 0; i < 6; i++) {
+        machine.poll(now);
+    }
+    TEST_ASSERT_EQUAL_INT(static_cast<int>(ConnectionState::Online),
+                          static_cast<int>(machine.state()));
+    TEST_ASSERT_EQUAL_UINT32(0, machine.consecutiveFailures());
+}
+
+void test_connection_state_machine_seeds_spread_reconnects() {
+    // Two devices failing at the same moment must not retry in lockstep.
+    FakeConnectionDriver driver;
+    driver.results[0] = iotnet::core::StepResult::Failed;
+    iotnet::core::BackoffConfig config{1000, 64000, 0};
+    iotnet::core::ConnectionStateMachine first(driver, config);
+    iotnet::core::ConnectionStateMachine second(driver, config);
+    first.seedRandom(0x1234u);
+    second.seedRandom(0xbeefu);
+    first.start(0);
+    second.start(0);
+
+    int differing = 0;
+    for (int attempt = 0; attempt < 6; attempt++) {
+        uint32_t now = attempt * 100000u;
+        first.poll(now);
+        first.poll(now);
+        second.poll(now);
+        second.poll(now);
+        TEST_ASSERT_TRUE(first.isWaiting() && second.isWaiting());
+        differing += first.retryAtMs() != second.retryAtMs() ? 1 : 0;
+        first.start(now + 50000);
+        second.start(now + 50000);
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL(5, differing);
+}
+
+void test_connection_state_machine_times_out_pending_steps() {
+    using iotnet::core::ConnectionState;
+    FakeConnectionDriver driver;
+    driver.results[2] = iotnet::core::StepResult::Pending;
+    iotnet::core::ConnectionStateMachine machine(driver, iotnet::core::BackoffConfig{1000, 8000, 500});
+
+    machine.start(0);
+    machine.poll(0);
+    machine.poll(0);
+    machine.poll(0);
+    TEST_ASSERT_EQUAL_INT(static_cast<int>(ConnectionState::TlsHandshake),
+                          static_cast<int>(machine.state()));
+    TEST_ASSERT_FALSE(machine.poll(499));
+    TEST_ASSERT_TRUE(machine.poll(500));
+    TEST_ASSERT_EQUAL_INT(static_cast<int>(ConnectionState::Disconnected),
+                          static_cast<int>(machine.state()));
+    TEST_ASSERT_EQUAL_STRING("disconnected", iotnet::core::connectionStateName(machine.state()));
+}
+
+void test_crc32_matches_reference_and_chains() {
+    const char *text = "123456789";
+    TEST_ASSERT_EQUAL_HEX32(0xcbf43926, iotnet::core::crc32(text, 9));
+    uint32_t head = iotnet::core::crc32(text, 4);
+    TEST_ASSERT_EQUAL_HEX32(0xcbf43926, iotnet::core::crc32(text + 4, 5, head));
+    TEST_ASSERT_EQUAL_HEX32(0, iotnet::core::crc32(text, 0));
+}
+
+void test_tls_session_record_validates_endpoint_and_contents() {
+    static iotnet::core::TlsSessionRecord record;
+    uint32_t broker = iotnet::core::tlsEndpointHash("broker.example.com", 8883);
+    uint32_t otherPort = iotnet::core::tlsEndpointHash("broker.example.com", 8884);
+    uint32_t otherHost = iotnet::core::tlsEndpointHash("other.example.com", 8883);
+    TEST_ASSERT_TRUE(broker != otherPort && broker != otherHost);
+
+    // Garbage left in RTC memory after power-up must not pass as a session.
+    memset(&record, 0xa5, sizeof(record));
+    TEST_ASSERT_EQUAL_UINT32(0, record.validLength(broker));
+
+    for (size_t i = 0; i < 300; i++) {
+        record.data[i] = static_cast<uint8_t>(i * 7);
+    }
+    TEST_ASSERT_TRUE(record.seal(broker, 300));
+    TEST_ASSERT_EQUAL_UINT32(300, record.validLength(broker));
+    TEST_ASSERT_EQUAL_UINT32(0, record.validLength(otherPort));
+    TEST_ASSERT_EQUAL_UINT32(0, record.validLength(otherHost));
+
+    iotnet::core::TlsSessionRecord copy = record;
+    TEST_ASSERT_EQUAL_UINT32(300, copy.validLength(broker));
+    copy.data[123] ^= 0x01;
+    TEST_ASSERT_EQUAL_UINT32(0, copy.validLength(broker));
+
+    TEST_ASSERT_FALSE(record.seal(broker, iotnet::core::TlsSessionRecord::CAPACITY + 1));
+    TEST_ASSERT_EQUAL_UINT32(0, record.validLength(broker));
+    TEST_ASSERT_FALSE(record.seal(broker, 0));
+
+    TEST_ASSERT_TRUE(record.seal(broker, 16));
+    record.clear();
+    TEST_ASSERT_EQUAL_UINT32(0, record.validLength(broker));
+}
+
+void test_tls_handshake_stats_split_full_and_resumed() {
+    iotnet::core::TlsHandshakeStats stats;
+    TEST_ASSERT_EQUAL_UINT32(0, stats.averageFullMs());
+    TEST_ASSERT_EQUAL_UINT32(0, stats.averageResumedMs());
+
+    stats.record(false, 1200);
+    stats.record(true, 150);
+    stats.record(true, 250);
+    stats.record(false, 900);
+
+    TEST_ASSERT_EQUAL_UINT32(2, stats.fullHandshakes);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.resumedHandshakes);
+    TEST_ASSERT_EQUAL_UINT32(900, stats.lastFullMs);
+    TEST_ASSERT_EQUAL_UINT32(250, stats.lastResumedMs);
+    TEST_ASSERT_EQUAL_UINT32(1050, stats.averageFullMs());
+    TEST_ASSERT_EQUAL_UINT32(200, stats.averageResumedMs());
+}
+
+void test_resume_snapshot_round_trips_client_state() {
+    static iotnet::core::PinTable table;
+    static iotnet::core::ResumeSnapshot snapshot;
+    static iotnet::core::ResumeSnapshot rtcCopy;
+    table.reset();
+    table.markInitialized(0);
+    table.markInitialized(3);
+    table.markInitialized(49);
+    table.storeValue(3, "21.50");
+    table.storeValue(49, "0123456789012345678901234567890");
+    table.clearUpdated(3);
+    uint8_t precision[iotnet::core::PinTable::CAPACITY];
+    memset(precision, 2, sizeof(precision));
+    precision[3] = 4;
+
+    uint32_t identity = iotnet::core::resumeIdentity("user", "board", "broker", 8883, "1.2.0");
+    snapshot.clear();
+    snapshot.capture(table, precision, iotnet::core::PinTable::bit(0) | iotnet::core::PinTable::bit(3));
+    snapshot.brokerAddress = 0x0a00000au;
+    using Snapshot = iotnet::core::ResumeSnapshot;
+    const uint32_t flags = Snapshot::BoardRegistered | Snapshot::WildcardSession;
+    snapshot.flags = flags;
+    snapshot.seal(identity);
+
+    // RTC memory keeps the raw bytes; nothing but the bytes may matter.
+    memset(&rtcCopy, 0xcc, sizeof(rtcCopy));
+    memcpy(&rtcCopy, &snapshot, sizeof(snapshot));
+    TEST_ASSERT_TRUE(rtcCopy.isValid(identity));
+
+    static iotnet::core::PinTable restored;
+    restored.storeValue(7, "stale");
+    uint8_t restoredPrecision[iotnet::core::PinTable::CAPACITY] = {};
+    rtcCopy.restore(restored, restoredPrecision);
+
+    TEST_ASSERT_EQUAL_UINT64(table.initializedPins(), restored.initializedPins());
+    TEST_ASSERT_EQUAL_UINT64(table.updatedPins(), restored.updatedPins());
+    TEST_ASSERT_EQUAL_UINT64(iotnet::core::PinTable::bit(49), restored.updatedPins());
+    TEST_ASSERT_EQUAL_STRING("", restored.value(0));
+    TEST_ASSERT_EQUAL_STRING("21.50", restored.value(3));
+    TEST_ASSERT_EQUAL_UINT32(5, restored.valueLength(3));
+    TEST_ASSERT_EQUAL_STRING(table.value(49), restored.value(49));
+    TEST_ASSERT_EQUAL_STRING("", restored.value(7));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(precision, restoredPrecision, sizeof(precision));
+    TEST_ASSERT_EQUAL_UINT64(iotnet::core::PinTable::bit(0) | iotnet::core::PinTable::bit(3),
+                             rtcCopy.subscribedPins);
+    TEST_ASSERT_EQUAL_HEX32(0x0a00000au, rtcCopy.brokerAddress);
+    TEST_ASSERT_EQUAL_UINT32(flags, rtcCopy.flags);
+}
+
+void test_resume_snapshot_rejects_foreign_or_damaged_state() {
+    static iotnet::core::ResumeSnapshot snapshot;
+    static iotnet::core::PinTable table;
+    uint8_t precision[iotnet::core::PinTable::CAPACITY] = {};
+    uint32_t identity = iotnet::core::resumeIdentity("user", "board", "broker", 8883, "1.2.0");
+
+    memset(&snapshot, 0x5a, sizeof(snapshot));
+    TEST_ASSERT_FALSE(snapshot.isValid(identity));
+
+    table.reset();
+    table.markInitialized(1);
+    table.storeValue(1, "on");
+    snapshot.clear();
+    snapshot.capture(table, precision, 0);
+    snapshot.seal(identity);
+    TEST_ASSERT_TRUE(snapshot.isValid(identity));
+
+    // New firmware, another board or another broker must start cold.
+    TEST_ASSERT_FALSE(snapshot.isValid(
+        iotnet::core::resumeIdentity("user", "board", "broker", 8883, "1.3.0")));
+    TEST_ASSERT_FALSE(snapshot.isValid(
+        iotnet::core::resumeIdentity("user", "board2", "broker", 8883, "1.2.0")));
+    TEST_ASSERT_FALSE(snapshot.isValid(
+        iotnet::core::resumeIdentity("user", "board", "broker", 1883, "1.2.0")));
+    TEST_ASSERT_TRUE(iotnet::core::resumeIdentity("ab", "c", "s", 1, nullptr) !=
+                     iotnet::core::resumeIdentity("a", "bc", "s", 1, nullptr));
+
+    snapshot.values[1][0] = 'O';
+    TEST_ASSERT_FALSE(snapshot.isValid(identity));
+    snapshot.values[1][0] = 'o';
+    TEST_ASSERT_TRUE(snapshot.isValid(identity));
+    snapshot.version++;
+    TEST_ASSERT_FALSE(snapshot.isValid(identity));
+
+    snapshot.clear();
+    TEST_ASSERT_FALSE(snapshot.isValid(identity));
+}
+
+namespace {
+
+// Feeds a whole stream and returns the first packet, like MqttClient does.
+bool readFirstPacket(iotnet::core::MqttPacketReader &reader, const uint8_t *data, size_t length,
+                     iotnet::core::MqttPacket &out) {
+    size_t offset = 0;
+    while (offset < length) {
+        iotnet::core::MqttPacketReader::Status status;
+        offset += reader.feed(data + offset, length - offset, status);
+        if (status == iotnet::core::MqttPacketReader::Status::Packet) {
+            out = reader.packet();
+            return true;
+        }
+        if (status == iotnet::core::MqttPacketReader::Status::Malformed) {
+            return false;
+        }
+    }
+    return false;
+}
+
+}
+
+void test_mqtt_codec_connack_reads_session_present() {
+    uint8_t buffer[16];
+    iotnet::core::MqttPacketReader reader(buffer, sizeof(buffer));
+    iotnet::core::MqttPacket packet;
+    iotnet::core::MqttConnack connack;
+
+    const uint8_t resumed[] = {0x20, 0x02, 0x01, 0x00};
+    TEST_ASSERT_TRUE(readFirstPacket(reader, resumed, sizeof(resumed), packet));
+    TEST_ASSERT_TRUE(iotnet::core::decodeConnack(packet, connack));
+    TEST_ASSERT_TRUE(connack.sessionPresent);
+    TEST_ASSERT_EQUAL_UINT8(0, connack.returnCode);
+
+    const uint8_t fresh[] = {0x20, 0x02, 0x00, 0x00};
+    TEST_ASSERT_TRUE(readFirstPacket(reader, fresh, sizeof(fresh), packet));
+    TEST_ASSERT_TRUE(iotnet::core::decodeConnack(packet, connack));
+    TEST_ASSERT_FALSE(connack.sessionPresent);
+
+    // A refused connection never reports a session.
+    const uint8_t refused[] = {0x20, 0x02, 0x01, 0x05};
+    TEST_ASSERT_TRUE(readFirstPacket(reader, refused, sizeof(refused), packet));
+    TEST_ASSERT_TRUE(iotnet::core::decodeConnack(packet, connack));
+    TEST_ASSERT_FALSE(connack.sessionPresent);
+    TEST_ASSERT_EQUAL_UINT8(5, connack.returnCode);
+
+    const uint8_t publish[] = {0x30, 0x02, 0x00, 0x00};
+    TEST_ASSERT_TRUE(readFirstPacket(reader, publish, sizeof(publish), packet));
+    TEST_ASSERT_FALSE(iotnet::core::decodeConnack(packet, connack));
+
+    const uint8_t reservedFlags[] = {0x20, 0x02, 0x03, 0x00};
+    TEST_ASSERT_TRUE(readFirstPacket(reader, reservedFlags, sizeof(reservedFlags), packet));
+    TEST_ASSERT_FALSE(iotnet::core::decodeConnack(packet, connack));
+
+    const uint8_t longer[] = {0x20, 0x03, 0x01, 0x00, 0x00};
+    TEST_ASSERT_TRUE(readFirstPacket(reader, longer, sizeof(longer), packet));
+    TEST_ASSERT_FALSE(iotnet::core::decodeConnack(packet, connack));
+}
+
+void test_mqtt_codec_encodes_connect_with_will() {
+    iotnet::core::MqttConnectOptions options;
+    options.clientId = "b";
+    options.username = "u";
+    options.password = "p";
+    options.willTopic = "t";
+    options.willPayload = reinterpret_cast<const uint8_t *>("off");
+    options.willPayloadLength = 3;
+    options.willQos = 1;
+    options.willRetain = true;
+    options.cleanSession = false;
+    options.keepAliveSeconds = 60;
+
+    const uint8_t expected[] = {0x10, 0x1b, 0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04, 0xec,
+                                0x00, 0x3c, 0x00, 0x01, 'b', 0x00, 0x01, 't', 0x00, 0x03,
+                                'o',  'f',  'f',  0x00, 0x01, 'u', 0x00, 0x01, 'p'};
+    uint8_t out[64];
+    TEST_ASSERT_EQUAL_UINT32(sizeof(expected),
+                             iotnet::core::encodeConnect(out, sizeof(out), options));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, out, sizeof(expected));
+
+    TEST_ASSERT_EQUAL_UINT32(0, iotnet::core::encodeConnect(out, sizeof(expected) - 1, options));
+    options.willQos = 2;
+    TEST_ASSERT_EQUAL_UINT32(0, iotnet::core::encodeConnect(out, sizeof(out), options));
+}
+
+void test_mqtt_codec_encodes_control_packets() {
+    uint8_t out[64];
+    const iotnet::core::MqttSubscription subscriptions[] = {{"a/#", 1}, {"b", 0}};
+    const uint8_t subscribe[] = {0x82, 0x0c, 0x12, 0x34, 0x00, 0x03, 'a', '/', '#', 0x01,
+                                 0x00, 0x01, 'b',  0x00};
+    TEST_ASSERT_EQUAL_UINT32(sizeof(subscribe),
+                             iotnet::core::encodeSubscribe(out, sizeof(out), 0x1234,
+                                                           subscriptions, 2));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(subscribe, out, sizeof(subscribe));
+    TEST_ASSERT_EQUAL_UINT32(0, iotnet::core::encodeSubscribe(out, sizeof(out), 0,
+                                                              subscriptions, 2));
+
+    const uint8_t puback[] = {0x40, 0x02, 0xab, 0xcd};
+    TEST_ASSERT_EQUAL_UINT32(4, iotnet::core::encodePuback(out, sizeof(out), 0xabcd));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(puback, out, sizeof(puback));
+    TEST_ASSERT_EQUAL_UINT32(2, iotnet::core::encodePingreq(out, sizeof(out)));
+    TEST_ASSERT_EQUAL_UINT8(0xc0, out[0]);
+    TEST_ASSERT_EQUAL_UINT32(2, iotnet::core::encodeDisconnect(out, sizeof(out)));
+    TEST_ASSERT_EQUAL_UINT8(0xe0, out[0]);
+    TEST_ASSERT_EQUAL_UINT32(0, iotnet::core::encodePingreq(out, 1));
+}
+
+void test_mqtt_codec_publish_round_trip_is_zero_copy() {
+    uint8_t stream[64];
+    const uint8_t payload[] = {'4', '2'};
+    size_t length = iotnet::core::encodePublish(stream, sizeof(stream), "devices/d/b/V1", payload,
+                                                sizeof(payload), 1, true, 7);
+    TEST_ASSERT_EQUAL_UINT32(2 + 2 + 14 + 2 + 2, length);
+    TEST_ASSERT_EQUAL_UINT8(0x33, stream[0]);
+
+    uint8_t buffer[8];
+    iotnet::core::MqttPacketReader reader(buffer, sizeof(buffer));
+    iotnet::core::MqttPacket packet;
+    TEST_ASSERT_TRUE(readFirstPacket(reader, stream, length, packet));
+    // Whole packets are not copied into the (too small) reader buffer.
+    TEST_ASSERT_TRUE(packet.body == stream + 2);
+    TEST_ASSERT_FALSE(packet.truncated());
+
+    iotnet::core::MqttPublish message;
+    TEST_ASSERT_TRUE(iotnet::core::decodePublish(packet, message));
+    TEST_ASSERT_EQUAL_UINT32(14, message.topicLength);
+    TEST_ASSERT_EQUAL_MEMORY("devices/d/b/V1", message.topic, 14);
+    TEST_ASSERT_TRUE(message.topic == reinterpret_cast<const char *>(stream + 4));
+    TEST_ASSERT_EQUAL_UINT32(2, message.payloadLength);
+    TEST_ASSERT_EQUAL_MEMORY("42", message.payload, 2);
+    TEST_ASSERT_EQUAL_UINT16(7, message.packetId);
+    TEST_ASSERT_EQUAL_UINT8(1, message.qos);
+    TEST_ASSERT_TRUE(message.retain);
+    TEST_ASSERT_FALSE(message.truncated);
+
+    // The payload can also follow the header in a separate write.
+    uint8_t header[32];
+    TEST_ASSERT_EQUAL_UINT32(length - sizeof(payload),
+                             iotnet::core::encodePublishHeader(header, sizeof(header),
+                                                               "devices/d/b/V1", sizeof(payload),
+                                                               1, true, 7));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(stream, header, length - sizeof(payload));
+
+    TEST_ASSERT_EQUAL_UINT32(0, iotnet::core::encodePublish(stream, sizeof(stream), "t", payload,
+                                                            sizeof(payload), 1, false, 0));
+    TEST_ASSERT_EQUAL_UINT32(0, iotnet::core::encodePublish(stream, length - 1, "devices/d/b/V1",
+                                                            payload, sizeof(payload), 1, true,
+                                                            7));
+}
+
+void test_mqtt_reader_assembles_packets_fed_byte_by_byte() {
+    uint8_t stream[96];
+    size_t first = iotnet::core::encodePublish(stream, sizeof(stream), "a/V3",
+                                               reinterpret_cast<const uint8_t *>("on"), 2, 0,
+                                               false, 0);
+    const uint8_t suback[] = {0x90, 0x04, 0x00, 0x09, 0x01, 0x80};
+    memcpy(stream + first, suback, sizeof(suback));
+    size_t total = first + sizeof(suback);
+
+    uint8_t buffer[32];
+    iotnet::core::MqttPacketReader reader(buffer, sizeof(buffer));
+    int packets = 0;
+    for (size_t i = 0; i < total; i++) {
+        iotnet::core::MqttPacketReader::Status status;
+        TEST_ASSERT_EQUAL_UINT32(1, reader.feed(stream + i, 1, status));
+        if (status != iotnet::core::MqttPacketReader::Status::Packet) {
+            TEST_ASSERT_TRUE(status == iotnet::core::MqttPacketReader::Status::NeedMore);
+            continue;
+        }
+
+        packets++;
+        const iotnet::core::MqttPacket &packet = reader.packet();
+        if (packets == 1) {
+            TEST_ASSERT_TRUE(packet.body == buffer);
+            iotnet::core::MqttPublish message;
+            TEST_ASSERT_TRUE(iotnet::core::decodePublish(packet, message));
+            TEST_ASSERT_EQUAL_MEMORY("a/V3", message.topic, 4);
+            TEST_ASSERT_EQUAL_MEMORY("on", message.payload, 2);
+            TEST_ASSERT_EQUAL_UINT8(0, message.qos);
+        } else {
+            iotnet::core::MqttSuback ack;
+            TEST_ASSERT_TRUE(iotnet::core::decodeSuback(packet, ack));
+            TEST_ASSERT_EQUAL_UINT16(9, ack.packetId);
+            TEST_ASSERT_EQUAL_UINT32(2, ack.count);
+            TEST_ASSERT_EQUAL_UINT8(0x80, ack.returnCodes[1]);
+            TEST_ASSERT_FALSE(iotnet::core::subackRefused(ack.returnCodes[0]));
+            TEST_ASSERT_TRUE(iotnet::core::subackRefused(ack.returnCodes[1]));
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(2, packets);
+}
+
+void test_mqtt_suback_watch_reports_refused_wildcard() {
+    uint8_t buffer[16];
+    iotnet::core::MqttPacketReader reader(buffer, sizeof(buffer));
+    iotnet::core::MqttPacket packet;
+    iotnet::core::MqttSuback ack;
+    iotnet::core::SubackWatch watch;
+    using Outcome = iotnet::core::SubackWatch::Outcome;
+
+    // The wildcard went out as packet 5; a per-pin SUBACK does not settle it.
+    watch.expect(5);
+    const uint8_t otherPin[] = {0x90, 0x03, 0x00, 0x04, 0x80};
+    TEST_ASSERT_TRUE(readFirstPacket(reader, otherPin, sizeof(otherPin), packet));
+    TEST_ASSERT_TRUE(iotnet::core::decodeSuback(packet, ack));
+    TEST_ASSERT_TRUE(watch.check(ack) == Outcome::Unrelated);
+    TEST_ASSERT_TRUE(watch.isPending());
+
+    // An ACL refusing devices/<user>/<board>/#.
+    const uint8_t refused[] = {0x90, 0x03, 0x00, 0x05, 0x80};
+    TEST_ASSERT_TRUE(readFirstPacket(reader, refused, sizeof(refused), packet));
+    TEST_ASSERT_TRUE(iotnet::core::decodeSuback(packet, ack));
+    TEST_ASSERT_TRUE(watch.check(ack) == Outcome::Refused);
+    TEST_ASSERT_FALSE(watch.isPending());
+    TEST_ASSERT_TRUE(watch.check(ack) == Outcome::Unrelated);
+
+    // A downgraded QoS is still a subscription.
+    watch.expect(6);
+    const uint8_t downgraded[] = {0x90, 0x03, 0x00, 0x06, 0x00};
+    TEST_ASSERT_TRUE(readFirstPacket(reader, downgraded, sizeof(downgraded), packet));
+    TEST_ASSERT_TRUE(iotnet::core::decodeSuback(packet, ack));
+    TEST_ASSERT_TRUE(watch.check(ack) == Outcome::Granted);
+
+    // The next connection starts without an outstanding SUBSCRIBE.
+    watch.expect(7);
+    watch.clear();
+    TEST_ASSERT_FALSE(watch.isPending());
+}
+
+void test_mqtt_reader_truncates_oversized_publish() {
+    uint8_t payload[200];
+    memset(payload, 'x', sizeof(payload));
+    uint8_t stream[256];
+    size_t length = iotnet::core::encodePublish(stream, sizeof(stream), "big", payload,
+                                                sizeof(payload), 1, false, 42);
+    const uint8_t ping[] = {0xd0, 0x00};
+    memcpy(stream + length, ping, sizeof(ping));
+
+    // Split so the packet straddles reads and must go through the buffer.
+    uint8_t buffer[16];
+    iotnet::core::MqttPacketReader reader(buffer, sizeof(buffer));
+    iotnet::core::MqttPacketReader::Status status;
+    TEST_ASSERT_EQUAL_UINT32(10, reader.feed(stream, 10, status));
+    TEST_ASSERT_TRUE(status == iotnet::core::MqttPacketReader::Status::NeedMore);
+    size_t used = reader.feed(stream + 10, length + sizeof(ping) - 10, status);
+    TEST_ASSERT_EQUAL_UINT32(length - 10, used);
+    TEST_ASSERT_TRUE(status == iotnet::core::MqttPacketReader::Status::Packet);
+
+    const iotnet::core::MqttPacket &packet = reader.packet();
+    TEST_ASSERT_TRUE(packet.truncated());
+    TEST_ASSERT_EQUAL_UINT32(sizeof(buffer), packet.length);
+    iotnet::core::MqttPublish message;
+    TEST_ASSERT_TRUE(iotnet::core::decodePublish(packet, message));
+    TEST_ASSERT_TRUE(message.truncated);
+    TEST_ASSERT_EQUAL_UINT16(42, message.packetId);
+    TEST_ASSERT_EQUAL_MEMORY("big", message.topic, 3);
+
+    // The stream stays in sync after the skipped bytes.
+    reader.feed(stream + 10 + used, sizeof(ping), status);
+    TEST_ASSERT_TRUE(status == iotnet::core::MqttPacketReader::Status::Packet);
+    TEST_ASSERT_TRUE(reader.packet().type() == iotnet::core::MqttPacketType::Pingresp);
+}
+
+void test_mqtt_reader_rejects_malformed_streams() {
+    uint8_t buffer[16];
+    iotnet::core::MqttPacketReader reader(buffer, sizeof(buffer));
+    iotnet::core::MqttPacketReader::Status status;
+
+    const uint8_t longLength[] = {0x30, 0xff, 0xff, 0xff, 0xff, 0x01};
+    TEST_ASSERT_EQUAL_UINT32(5, reader.feed(longLength, sizeof(longLength), status));
+    TEST_ASSERT_TRUE(status == iotnet::core::MqttPacketReader::Status::Malformed);
+
+    reader.reset();
+    const uint8_t reservedType[] = {0x00, 0x00};
+    reader.feed(reservedType, sizeof(reservedType), status);
+    TEST_ASSERT_TRUE(status == iotnet::core::MqttPacketReader::Status::Malformed);
+
+    // Decoders refuse bodies that do not match their packet type.
+    reader.reset();
+    iotnet::core::MqttPacket packet;
+    const uint8_t shortTopic[] = {0x30, 0x03, 0x00, 0x05, 'a'};
+    TEST_ASSERT_TRUE(readFirstPacket(reader, shortTopic, sizeof(shortTopic), packet));
+    iotnet::core::MqttPublish message;
+    TEST_ASSERT_FALSE(iotnet::core::decodePublish(packet, message));
+    const uint8_t qos3[] = {0x36, 0x03, 0x00, 0x01, 'a'};
+    TEST_ASSERT_TRUE(readFirstPacket(reader, qos3, sizeof(qos3), packet));
+    TEST_ASSERT_FALSE(iotnet::core::decodePublish(packet, message));
+    uint16_t packetId;
+    const uint8_t puback[] = {0x40, 0x02, 0x00, 0x05};
+    TEST_ASSERT_TRUE(readFirstPacket(reader, puback, sizeof(puback), packet));
+    TEST_ASSERT_TRUE(iotnet::core::decodePacketId(packet, packetId));
+    TEST_ASSERT_EQUAL_UINT16(5, packetId);
+}
+
+void test_mqtt5_codec_connect_and_connack_properties() {
+    iotnet::core::MqttConnectOptions options;
+    options.clientId = "b";
+    options.cleanSession = false;
+    options.keepAliveSeconds = 30;
+    options.version = iotnet::core::MqttVersion::V5;
+
+    // A kept session asks for a Session Expiry Interval that never ends.
+    const uint8_t expected[] = {0x10, 0x13, 0x00, 0x04, 'M',  'Q',  'T',  'T',  0x05, 0x00, 0x00,
+                                0x1e, 0x05, 0x11, 0xff, 0xff, 0xff, 0xff, 0x00, 0x01, 'b'};
+    uint8_t out[64];
+    TEST_ASSERT_EQUAL_UINT32(sizeof(expected),
+                             iotnet::core::encodeConnect(out, sizeof(out), options));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, out, sizeof(expected));
+
+    uint8_t buffer[32];
+    iotnet::core::MqttPacketReader reader(buffer, sizeof(buffer));
+    iotnet::core::MqttPacket packet;
+    iotnet::core::MqttConnack connack;
+    // Receive Maximum, a reason string and Topic Alias Maximum = 10.
+    const uint8_t connackPacket[] = {0x20, 0x0e, 0x01, 0x00, 0x0b, 0x21, 0x00, 0x14,
+                                     0x1f, 0x00, 0x02, 'o',  'k',  0x22, 0x00, 0x0a};
+    TEST_ASSERT_TRUE(readFirstPacket(reader, connackPacket, sizeof(connackPacket), packet));
+    TEST_ASSERT_FALSE(iotnet::core::decodeConnack(packet, connack));
+    TEST_ASSERT_TRUE(
+        iotnet::core::decodeConnack(packet, connack, iotnet::core::MqttVersion::V5));
+    TEST_ASSERT_TRUE(connack.sessionPresent);
+    TEST_ASSERT_EQUAL_UINT16(10, connack.topicAliasMaximum);
+
+    const uint8_t cutProperties[] = {0x20, 0x05, 0x00, 0x00, 0x03, 0x22, 0x00};
+    TEST_ASSERT_TRUE(readFirstPacket(reader, cutProperties, sizeof(cutProperties), packet));
+    TEST_ASSERT_FALSE(
+        iotnet::core::decodeConnack(packet, connack, iotnet::core::MqttVersion::V5));
+}
+
+void test_mqtt5_codec_publish_with_topic_alias() {
+    const iotnet::core::MqttVersion v5 = iotnet::core::MqttVersion::V5;
+    uint8_t out[64];
+    const uint8_t payload[] = {'4', '2'};
+
+    const uint8_t introduce[] = {0x30, 0x0b, 0x00, 0x03, 'a', '/', 'b',
+                                 0x03, 0x23, 0x00, 0x07, '4', '2'};
+    TEST_ASSERT_EQUAL_UINT32(sizeof(introduce),
+                             iotnet::core::encodePublish(out, sizeof(out), "a/b", payload, 2, 0,
+                                                         false, 0, v5, 7));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(introduce, out, sizeof(introduce));
+
+    const uint8_t aliased[] = {0x30, 0x08, 0x00, 0x00, 0x03, 0x23, 0x00, 0x07, '4', '2'};
+    TEST_ASSERT_EQUAL_UINT32(sizeof(aliased), iotnet::core::encodePublish(
+                                                  out, sizeof(out), nullptr, payload, 2, 0,
+                                                  false, 0, v5, 7));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(aliased, out, sizeof(aliased));
+
+    // Aliases need MQTT 5, and a topic-less publish needs an alias.
+    TEST_ASSERT_EQUAL_UINT32(0, iotnet::core::encodePublish(out, sizeof(out), "a/b", payload, 2,
+                                                            0, false, 0,
+                                                            iotnet::core::MqttVersion::V311, 7));
+    TEST_ASSERT_EQUAL_UINT32(0, iotnet::core::encodePublish(out, sizeof(out), nullptr, payload,
+                                                            2, 0, false, 0, v5, 0));
+
+    // Inbound MQTT 5 publishes skip their properties to reach the payload.
+    size_t length =
+        iotnet::core::encodePublish(out, sizeof(out), "a/b", payload, 2, 1, false, 9, v5, 7);
+    uint8_t buffer[32];
+    iotnet::core::MqttPacketReader reader(buffer, sizeof(buffer));
+    iotnet::core::MqttPacket packet;
+    TEST_ASSERT_TRUE(readFirstPacket(reader, out, length, packet));
+    iotnet::core::MqttPublish message;
+    TEST_ASSERT_TRUE(iotnet::core::decodePublish(packet, message, v5));
+    TEST_ASSERT_EQUAL_MEMORY("a/b", message.topic, 3);
+    TEST_ASSERT_EQUAL_UINT16(9, message.packetId);
+    TEST_ASSERT_EQUAL_UINT32(2, message.payloadLength);
+    TEST_ASSERT_EQUAL_MEMORY("42", message.payload, 2);
+
+    const iotnet::core::MqttSubscription subscription = {"a/#", 1};
+    const uint8_t subscribe[] = {0x82, 0x09, 0x00, 0x01, 0x00, 0x00, 0x03, 'a', '/', '#', 0x01};
+    TEST_ASSERT_EQUAL_UINT32(sizeof(subscribe), iotnet::core::encodeSubscribe(
+                                                    out, sizeof(out), 1, &subscription, 1, v5));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(subscribe, out, sizeof(subscribe));
+
+    const uint8_t suback[] = {0x90, 0x04, 0x00, 0x01, 0x00, 0x01};
+    TEST_ASSERT_TRUE(readFirstPacket(reader, suback, sizeof(suback), packet));
+    iotnet::core::MqttSuback ack;
+    TEST_ASSERT_TRUE(iotnet::core::decodeSuback(packet, ack, v5));
+    TEST_ASSERT_EQUAL_UINT32(1, ack.count);
+    TEST_ASSERT_EQUAL_UINT8(1, ack.returnCodes[0]);
+    // MQTT 5 "not authorized".
+    TEST_ASSERT_TRUE(iotnet::core::subackRefused(0x87));
+
+    const uint8_t pubackWithReason[] = {0x40, 0x04, 0x00, 0x09, 0x10, 0x00};
+    uint16_t packetId;
+    TEST_ASSERT_TRUE(readFirstPacket(reader, pubackWithReason, sizeof(pubackWithReason), packet));
+    TEST_ASSERT_FALSE(iotnet::core::decodePacketId(packet, packetId));
+    TEST_ASSERT_TRUE(iotnet::core::decodePacketId(packet, packetId, v5));
+    TEST_ASSERT_EQUAL_UINT16(9, packetId);
+}
+
+void test_topic_alias_table_assigns_up_to_broker_maximum() {
+    iotnet::core::TopicAliasTable aliases;
+    bool established = true;
+    TEST_ASSERT_EQUAL_UINT16(0, aliases.aliasFor(3, established));
+    TEST_ASSERT_FALSE(established);
+
+    aliases.reset(2);
+    TEST_ASSERT_EQUAL_UINT16(1, aliases.aliasFor(7, established));
+    TEST_ASSERT_FALSE(established);
+    // Not established until the publish introducing it went out.
+    TEST_ASSERT_EQUAL_UINT16(1, aliases.aliasFor(7, established));
+    TEST_ASSERT_FALSE(established);
+    aliases.markEstablished(7);
+    TEST_ASSERT_EQUAL_UINT16(1, aliases.aliasFor(7, established));
+    TEST_ASSERT_TRUE(established);
+
+    TEST_ASSERT_EQUAL_UINT16(2, aliases.aliasFor(0, established));
+    TEST_ASSERT_EQUAL_UINT16(0, aliases.aliasFor(1, established));
+    TEST_ASSERT_EQUAL_UINT16(0, aliases.aliasFor(iotnet::core::TopicAliasTable::CAPACITY,
+                                                 established));
+    TEST_ASSERT_EQUAL_UINT16(2, aliases.assignedCount());
+
+    // A new connection starts over.
+    aliases.reset(100);
+    TEST_ASSERT_EQUAL_UINT16(1, aliases.aliasFor(1, established));
+    TEST_ASSERT_FALSE(established);
+}
+
+void test_topic_alias_bytes_on_wire_per_publish() {
+    char topic[128];
+    snprintf(topic, sizeof(topic), "devices/%s/%s/V5", "019cc382-0dac-70b1-98dc-1b81b3ab2c00",
+             "espressif_fb2d6ad26fdf7b867baf41b8559a1c");
+    const uint8_t value[] = {'4', '2'};
+    uint8_t out[160];
+
+    size_t plain = iotnet::core::encodePublish(out, sizeof(out), topic, value, 2, 0, false, 0);
+    size_t first = iotnet::core::encodePublish(out, sizeof(out), topic, value, 2, 0, false, 0,
+                                               iotnet::core::MqttVersion::V5, 1);
+    size_t aliased = iotnet::core::encodePublish(out, sizeof(out), nullptr, value, 2, 0, false,
+                                                 0, iotnet::core::MqttVersion::V5, 1);
+    TEST_ASSERT_EQUAL_UINT32(2 + 2 + strlen(topic) + 2, plain);
+    TEST_ASSERT_EQUAL_UINT32(plain + 4, first);
+    TEST_ASSERT_EQUAL_UINT32(10, aliased);
+
+    char message[128];
+    snprintf(message, sizeof(message),
+             "pin publish: %zu bytes (3.1.1), %zu bytes first / %zu bytes aliased (MQTT 5)",
+             plain, first, aliased);
+    TEST_MESSAGE(message);
+}
+
+namespace {
+
+// The ArduinoJson-based parsers JsonCodec used before its scanner; the
+// scanner must accept and reject exactly what these do.
+bool referenceParseTrigger(const char *payload, char *otaId, size_t otaIdSize, char *version,
+                           size_t versionSize, long *nonce) {
+    JsonDocument doc;
+    if (deserializeJson(doc, payload)) {
+        return false;
+    }
+    if (!doc["ota_id"].is<const char *>() || !doc["version"].is<const char *>() ||
+        !doc["nonce"].is<long>()) {
+        return false;
+    }
+    const char *id = doc["ota_id"].as<const char *>();
+    const char *ver = doc["version"].as<const char *>();
+    if (!id || !ver || strlen(id) >= otaIdSize || strlen(ver) >= versionSize) {
+        return false;
+    }
+    strcpy(otaId, id);
+    strcpy(version, ver);
+    *nonce = doc["nonce"].as<long>();
+    return true;
+}
+
+bool referenceParseSession(const char *payload, char *cid, size_t cidSize, char *key,
+                           size_t keySize, int *expiresIn) {
+    JsonDocument doc;
+    if (deserializeJson(doc, payload)) {
+        return false;
+    }
+    if (!doc["cid"].is<const char *>() || !doc["session_key"].is<const char *>()) {
+        return false;
+    }
+    const char *c = doc["cid"].as<const char *>();
+    const char *k = doc["session_key"].as<const char *>();
+    if (!c || !k || strlen(c) == 0 || strlen(c) >= cidSize || strlen(k) == 0 ||
+        strlen(k) >= keySize) {
+        return false;
+    }
+    strcpy(cid, c);
+    strcpy(key, k);
+    *expiresIn = doc["expires_in"] | 0;
+    return true;
+}
+
+bool referenceParseLink(const char *payload, char *url, size_t urlSize) {
+    JsonDocument doc;
+    if (deserializeJson(doc, payload)) {
+        return false;
+    }
+    const char *u = doc["data"]["ota_url"].as<const char *>();
+    if (!u || strlen(u) == 0 || strlen(u) >= urlSize) {
+        return false;
+    }
+    strcpy(url, u);
+    return true;
+}
+
+// Valid, odd and broken documents; each one goes through all three parsers.
+const char *const JSON_CORPUS[] = {
+    "{\"ota_id\":\"ota-1\",\"version\":\"2.0.0\",\"nonce\":777}",
+    "  {\r\n\t\"ota_id\" : \"a\" , \"version\":\"\", \"nonce\" : -5 }  trailing",
+    "{\"ota_id\":\"x\",\"version\":\"y\",\"nonce\":9223372036854775807}",
+    "{\"ota_id\":\"x\",\"version\":\"y\",\"nonce\":-9223372036854775808}",
+    "{\"ota_id\":\"x\",\"version\":\"y\",\"nonce\":9223372036854775808}",
+    "{\"ota_id\":\"x\",\"version\":\"y\",\"nonce\":1.5}",
+    "{\"ota_id\":\"x\",\"version\":\"y\",\"nonce\":1e3}",
+    "{\"ota_id\":\"x\",\"version\":\"y\",\"nonce\":-0}",
+    "{\"ota_id\":\"x\",\"version\":\"y\",\"nonce\":+4}",
+    "{\"ota_id\":\"x\",\"version\":\"y\",\"nonce\":\"4\"}",
+    "{\"ota_id\":\"x\",\"version\":\"y\",\"nonce\":true}",
+    "{\"ota_id\":\"x\",\"version\":\"y\",\"nonce\":null}",
+    "{\"ota_id\":\"x\",\"version\":\"y\",\"nonce\":1-}",
+    "{\"ota_id\":\"x\",\"version\":\"y\",\"nonce\":.5e}",
+    "{\"ota_id\":\"x\",\"version\":\"y\",\"nonce\":-}",
+    "{\"ota_id\":7,\"version\":\"y\",\"nonce\":1}",
+    "{\"ota_id\":\"first\",\"ota_id\":\"second\",\"version\":\"v\",\"nonce\":1}",
+    "{\"ota_id\":\"x\",\"version\":\"v\",\"nonce\":1,\"nonce\":\"late\"}",
+    "{'ota_id':'single',version:\"unquoted\",nonce:3}",
+    "{\"ota_id\":\"a\\\"b\\\\c\\/d\\b\\f\\n\\r\\t\",\"version\":\"v\",\"nonce\":1}",
+    "{\"ota_id\":\"\\u00e9\\u20ac\\ud83d\\ude00\",\"version\":\"v\",\"nonce\":1}",
+    "{\"ota_id\":\"\\ude00\\ud83d\",\"version\":\"v\",\"nonce\":1}",
+    "{\"ota_id\":\"\\u0041\\udc00\\ud83d\\ude00\\ude00\",\"version\":\"v\",\"nonce\":1}",
+    "{\"ota_id\\u0000\":\"nul key\",\"ota_id\":\"x\",\"version\":\"v\",\"nonce\":1}",
+    "{\"ota_id\":\"nul\\u0000cut\",\"version\":\"v\",\"nonce\":1}",
+    "{\"ota_id\":\"bad\\x\",\"version\":\"v\",\"nonce\":1}",
+    "{\"ota_id\":\"bad\\u12g4\",\"version\":\"v\",\"nonce\":1}",
+    "{\"ota_id\":\"unterminated,\"version\":\"v\",\"nonce\":1",
+    "{\"ota_id\":\"x\",\"version\":\"v\",\"nonce\":1,}",
+    "{\"ota_id\":\"x\" \"version\":\"v\",\"nonce\":1}",
+    "{\"ota_id\":\"x\",\"version\":\"v\",\"nonce\":1 // comment\n}",
+    "{\"ota_id\":\"x\",\"version\":\"v\",\"nonce\":1,\"extra\":[1,{\"a\":[true,false,null]},2.5]}",
+    "{\"a\":[[[[[[[[[1]]]]]]]]],\"ota_id\":\"x\",\"version\":\"v\",\"nonce\":1}",
+    "{\"a\":[[[[[[[[[[1]]]]]]]]]],\"ota_id\":\"x\",\"version\":\"v\",\"nonce\":1}",
+    "{\"ota_id\":\"0123456789012345678901234567890123456789012345678\",\"version\":\"v\","
+    "\"nonce\":1}",
+    "{\"ota_id\":\"x\",\"version\":\"0123456789abcdef\",\"nonce\":1}",
+    "{\"ota_id\":\"x\",\"version\":\"v\",\"nonce\":tru}",
+    "[\"ota_id\",\"version\"]",
+    "\"ota_id\"",
+    "{}",
+    "",
+    "{",
+    "{\"cid\":\"c-1\",\"session_key\":\"k\",\"expires_in\":60}",
+    "{\"cid\":\"c-1\",\"session_key\":\"k\"}",
+    "{\"cid\":\"c-1\",\"session_key\":\"k\",\"expires_in\":2147483648}",
+    "{\"cid\":\"c-1\",\"session_key\":\"k\",\"expires_in\":-2147483648}",
+    "{\"cid\":\"c-1\",\"session_key\":\"k\",\"expires_in\":60.5}",
+    "{\"cid\":\"c-1\",\"session_key\":\"k\",\"expires_in\":\"60\"}",
+    "{\"cid\":\"c-1\",\"session_key\":\"k\",\"expires_in\":60,\"expires_in\":false}",
+    "{\"cid\":\"\",\"session_key\":\"k\"}",
+    "{\"cid\":\"c\",\"session_key\":null}",
+    "{\"cid\":\"\\u0000\",\"session_key\":\"k\"}",
+    "{\"data\":{\"ota_url\":\"https://example.com/fw.bin?a=1&b=\\u0032\"}}",
+    "{\"data\":{\"ota_url\":\"\"}}",
+    "{\"data\":{\"ota_url\":5}}",
+    "{\"data\":[\"ota_url\"]}",
+    "{\"ota_url\":\"https://root/level\"}",
+    "{\"data\":{\"inner\":{\"ota_url\":\"nested\"}}}",
+    "{\"data\":{\"ota_url\":\"old\"},\"data\":{\"other\":1}}",
+    "{\"data\":{\"ota_url\":\"first\",\"ota_url\":\"last\"},\"status\":\"ok\"}",
+    "{\"data\":{\"ota_url\":\"u\"},\"data\":{\"ota_url\":\"v\"}}",
+};
+
+}
+
+void test_json_scanner_matches_arduinojson_trigger() {
+    for (const char *payload : JSON_CORPUS) {
+        char otaId[48] = "";
+        char version[16] = "";
+        long nonce = 0;
+        char expectedId[48] = "";
+        char expectedVersion[16] = "";
+        long expectedNonce = 0;
+
+        bool ok = iotnet::core::parseOtaTriggerPayload(payload, otaId, sizeof(otaId), version,
+                                                       sizeof(version), &nonce);
+        bool expected = referenceParseTrigger(payload, expectedId, sizeof(expectedId),
+                                              expectedVersion, sizeof(expectedVersion),
+                                              &expectedNonce);
+        TEST_ASSERT_EQUAL_MESSAGE(expected, ok, payload);
+        if (expected) {
+            TEST_ASSERT_EQUAL_STRING_MESSAGE(expectedId, otaId, payload);
+            TEST_ASSERT_EQUAL_STRING_MESSAGE(expectedVersion, version, payload);
+            TEST_ASSERT_EQUAL_MESSAGE(expectedNonce, nonce, payload);
+        }
+    }
+}
+
+void test_json_scanner_matches_arduinojson_session() {
+    for (const char *payload : JSON_CORPUS) {
+        char cid[24] = "";
+        char key[24] = "";
+        int expiresIn = -1;
+        char expectedCid[24] = "";
+        char expectedKey[24] = "";
+        int expectedExpiresIn = -1;
+
+        bool ok = iotnet::core::parseOtaSessionResponsePayload(payload, cid, sizeof(cid), key,
+                                                               sizeof(key), &expiresIn);
+        bool expected = referenceParseSession(payload, expectedCid, sizeof(expectedCid),
+                                              expectedKey, sizeof(expectedKey),
+                                              &expectedExpiresIn);
+        TEST_ASSERT_EQUAL_MESSAGE(expected, ok, payload);
+        if (expected) {
+            TEST_ASSERT_EQUAL_STRING_MESSAGE(expectedCid, cid, payload);
+            TEST_ASSERT_EQUAL_STRING_MESSAGE(expectedKey, key, payload);
+            TEST_ASSERT_EQUAL_INT_MESSAGE(expectedExpiresIn, expiresIn, payload);
+        }
+    }
+}
+
+void test_json_scanner_matches_arduinojson_link() {
+    for (const char *payload : JSON_CORPUS) {
+        char url[64] = "";
+        char expectedUrl[64] = "";
+
+        bool ok = iotnet::core::parseOtaLinkResponsePayload(payload, url, sizeof(url));
+        bool expected = referenceParseLink(payload, expectedUrl, sizeof(expectedUrl));
+        TEST_ASSERT_EQUAL_MESSAGE(expected, ok, payload);
+        if (expected) {
+            TEST_ASSERT_EQUAL_STRING_MESSAGE(expectedUrl, url, payload);
+        }
+    }
+}
+
+void test_json_scanner_decodes_escapes() {
+    const char *payload = "{'ota_id':'q\\\"\\\\\\/\\t\\u00e9\\ud83d\\ude00',version:\"1.0\","
+                          "\"nonce\":-2147483648}";
+    char otaId[48];
+    char version[16];
+    long nonce = 0;
+
+    TEST_ASSERT_TRUE(iotnet::core::parseOtaTriggerPayload(payload, otaId, sizeof(otaId), version,
+                                                          sizeof(version), &nonce));
+    TEST_ASSERT_EQUAL_STRING("q\"\\/\t\xc3\xa9\xf0\x9f\x98\x80", otaId);
+    TEST_ASSERT_EQUAL_STRING("1.0", version);
+    TEST_ASSERT_EQUAL_INT(-2147483648L, nonce);
+
+    // The escaped text only fits once decoded.
+    char url[4];
+    TEST_ASSERT_TRUE(iotnet::core::parseOtaLinkResponsePayload(
+        "{\"data\":{\"ota_url\":\"\\u0061\\u0062\\u0063\"}}", url, sizeof(url)));
+    TEST_ASSERT_EQUAL_STRING("abc", url);
+    TEST_ASSERT_FALSE(iotnet::core::parseOtaLinkResponsePayload(
+        "{\"data\":{\"ota_url\":\"abcd\"}}", url, sizeof(url)));
+}
+
+void test_allocation_guard_counts_hot_path_allocations() {
+    using iotnet::core::AllocationGuard;
+    TEST_ASSERT_TRUE(AllocationGuard::enabled());
+
+    // Volatile so the compiler cannot drop the malloc/free pairs.
+    void *volatile outside = malloc(24);
+    uint32_t before = AllocationGuard::hotPathAllocations();
+
+    {
+        AllocationGuard::HotPath hotPath;
+        void *volatile inside = malloc(40);
+        TEST_ASSERT_EQUAL_UINT32(before + 1, AllocationGuard::hotPathAllocations());
+        TEST_ASSERT_EQUAL_UINT(40, AllocationGuard::lastHotPathAllocationSize());
+        free(inside);
+
+        int *volatile boxed = new int(7);
+        TEST_ASSERT_EQUAL_UINT32(before + 2, AllocationGuard::hotPathAllocations());
+        delete boxed;
+
+        {
+            AllocationGuard::Exempt exempt;
+            inside = malloc(64);
+            free(inside);
+        }
+        TEST_ASSERT_EQUAL_UINT32(before + 2, AllocationGuard::hotPathAllocations());
+        outside = realloc(outside, 48);
+        TEST_ASSERT_EQUAL_UINT32(before + 3, AllocationGuard::hotPathAllocations());
+    }
+    TEST_ASSERT_FALSE(AllocationGuard::inHotPath());
+    free(outside);
+    TEST_ASSERT_EQUAL_UINT32(before + 3, AllocationGuard::hotPathAllocations());
+}
+
+void test_allocation_guard_steady_state_is_allocation_free() {
+    using iotnet::core::AllocationGuard;
+    static iotnet::core::PinTable table;
+    static iotnet::core::PublishQueue queue;
+    static iotnet::core::PublishGate gate;
+    static iotnet::core::BatchFrame frame;
+    iotnet::core::TopicRouter router;
+    TEST_ASSERT_TRUE(router.configure("user-1", "board-1"));
+    table.markInitialized(4);
+    queue.reset();
+
+    uint8_t stream[256];
+    size_t length = iotnet::core::encodePublish(stream, sizeof(stream),
+                                                "devices/user-1/board-1/V4",
+                                                reinterpret_cast<const uint8_t *>("21.5"), 4, 1,
+                                                false, 9);
+    uint8_t readerBuffer[64];
+    iotnet::core::MqttPacketReader reader(readerBuffer, sizeof(readerBuffer));
+    const char *otaPayload = "{\"ota_id\":\"ota-1\",\"version\":\"2.0.0\",\"nonce\":777}";
+
+    uint32_t before = AllocationGuard::hotPathAllocations();
+    {
+        AllocationGuard::HotPath hotPath;
+        for (int round = 0; round < 100; round++) {
+            // Inbound: split the packet across two reads, route and store it.
+            iotnet::core::MqttPacket packet;
+            iotnet::core::MqttPublish message;
+            TEST_ASSERT_FALSE(readFirstPacket(reader, stream, 7, packet));
+            TEST_ASSERT_TRUE(readFirstPacket(reader, stream + 7, length - 7, packet));
+            TEST_ASSERT_TRUE(iotnet::core::decodePublish(packet, message));
+            iotnet::core::TopicRoute route = router.route(message.topic, message.topicLength);
+            char value[iotnet::core::PinTable::VALUE_SIZE];
+            memcpy(value, message.payload, message.payloadLength);
+            value[message.payloadLength] = '\0';
+            table.storeValue(route.pin, value);
+            uint8_t ack[4];
+            TEST_ASSERT_EQUAL_UINT(4, iotnet::core::encodePuback(ack, sizeof(ack), 9));
+
+            // Outbound: format, gate, queue, batch and encode.
+            iotnet::core::OutboundValue outbound = {};
+            outbound.pin = 4;
+            outbound.length = static_cast<uint8_t>(iotnet::core::formatFixed(
+                round * 0.25, 2, outbound.payload, sizeof(outbound.payload)));
+            outbound.sample = iotnet::core::numericSample(round * 0.25);
+            gate.admit(outbound.pin, outbound.sample, static_cast<uint32_t>(round));
+            TEST_ASSERT_TRUE(queue.push(outbound, iotnet::core::OverflowPolicy::DropOldest));
+            TEST_ASSERT_TRUE(queue.tryPop(outbound));
+            frame.appendValue(outbound.pin, outbound.payload, outbound.length);
+            size_t frameLength = 0;
+            const char *json = frame.finish(&frameLength);
+            uint8_t packetOut[256];
+            size_t packetLength = iotnet::core::encodePublish(
+                packetOut, sizeof(packetOut), "devices/user-1/board-1/batch",
+                reinterpret_cast<const uint8_t *>(json), frameLength, 0, false, 0);
+            TEST_ASSERT_NOT_EQUAL(0, packetLength);
+            frame.reset();
+
+            char otaId[16];
+            char version[16];
+            long nonce;
+            TEST_ASSERT_TRUE(iotnet::core::parseOtaTriggerPayload(
+                otaPayload, otaId, sizeof(otaId), version, sizeof(version), &nonce));
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(before, AllocationGuard::hotPathAllocations());
+}
+
+namespace {
+
+uint32_t hostNowMs() {
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+}
+
+void hostWait() {
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+
+const iotnet::core::PipelineHooks HOST_PIPELINE_HOOKS = {hostNowMs, hostWait};
+
+uint8_t imageByte(size_t offset) {
+    return static_cast<uint8_t>(offset * 131 + (offset >> 9));
+}
+
+// Delivers an image in uneven reads, with an empty read now and then, like
+// a TCP stream. Breaks at failAt when that is set.
+class FakeImageSource : public iotnet::core::ChunkSource {
+  public:
+    explicit FakeImageSource(long failAt = -1) : offset(0), calls(0), failAt(failAt) {}
+
+    int read(uint8_t *buffer, size_t size) override {
+        calls++;
+        if (failAt >= 0 && offset >= static_cast<size_t>(failAt)) {
+            return -1;
+        }
+        if (calls % 5 == 0) {
+            return 0;
+        }
+        size_t segment = 1 + (calls * 37) % 700;
+        if (segment < size) {
+            size = segment;
+        }
+        for (size_t i = 0; i < size; i++) {
+            buffer[i] = imageByte(offset + i);
+        }
+        offset += size;
+        return static_cast<int>(size);
+    }
+
+  private:
+    size_t offset;
+    size_t calls;
+    long failAt;
+};
+
+// Stands in for flash: slow on every write, checks the bytes arrive in
+// order and can fail after a number of writes.
+class SlowFlashSink : public iotnet::core::ChunkSink {
+  public:
+    explicit SlowFlashSink(int failAfterWrites = -1)
+        : bytes(0), writes(0), lastLength(0), corrupted(false),
+          failAfterWrites(failAfterWrites) {}
+
+    bool write(const uint8_t *data, size_t length) override {
+        if (failAfterWrites >= 0 && writes >= failAfterWrites) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(300));
+        for (size_t i = 0; i < length; i++) {
+            corrupted = corrupted || data[i] != imageByte(bytes + i);
+        }
+        bytes += length;
+        writes++;
+        lastLength = length;
+        return true;
+    }
+
+    size_t bytes;
+    int writes;
+    size_t lastLength;
+    bool corrupted;
+
+  private:
+    int failAfterWrites;
+};
+
+struct PipelineRun {
+    bool received;
+    bool written;
+    iotnet::core::PipelinePhaseStats networkStats;
+    iotnet::core::PipelinePhaseStats flashStats;
+};
+
+PipelineRun runPipeline(iotnet::core::ChunkSource &source, iotnet::core::ChunkSink &sink,
+                        size_t totalBytes, uint32_t idleTimeoutMs = 1000) {
+    static uint8_t storage[3 * 1024];
+    iotnet::core::ChunkRing ring;
+    TEST_ASSERT_TRUE(ring.attach(storage, 1024, 3));
+
+    PipelineRun run = {};
+    std::thread writer([&]() {
+        run.written = iotnet::core::drainChunkRing(ring, sink, HOST_PIPELINE_HOOKS,
+                                                   run.flashStats);
+    });
+    run.received = iotnet::core::fillChunkRing(ring, source, totalBytes, idleTimeoutMs,
+                                               HOST_PIPELINE_HOOKS, run.networkStats);
+    writer.join();
+    return run;
+}
+
+}
+
+void test_chunk_ring_hands_chunks_over_in_order() {
+    uint8_t storage[3 * 8];
+    iotnet::core::ChunkRing ring;
+    TEST_ASSERT_FALSE(ring.attach(nullptr, 8, 3));
+    TEST_ASSERT_FALSE(ring.attach(storage, 0, 3));
+    TEST_ASSERT_FALSE(ring.attach(storage, 8, 1));
+    TEST_ASSERT_FALSE(ring.attach(storage, 8, iotnet::core::ChunkRing::MAX_CHUNKS + 1));
+    TEST_ASSERT_TRUE(ring.attach(storage, 8, 3));
+
+    size_t length = 0;
+    TEST_ASSERT_NULL(ring.readableChunk(&length));
+    for (uint8_t i = 0; i < 3; i++) {
+        uint8_t *chunk = ring.writableChunk();
+        TEST_ASSERT_NOT_NULL(chunk);
+        chunk[0] = i;
+        ring.commit(i + 1);
+    }
+    TEST_ASSERT_NULL(ring.writableChunk());
+
+    const uint8_t *chunk = ring.readableChunk(&length);
+    TEST_ASSERT_EQUAL_UINT8(0, chunk[0]);
+    TEST_ASSERT_EQUAL(1, length);
+    ring.release();
+    TEST_ASSERT_TRUE(ring.writableChunk() == storage);
+
+    ring.close();
+    TEST_ASSERT_FALSE(ring.drained());
+    chunk = ring.readableChunk(&length);
+    TEST_ASSERT_EQUAL_UINT8(1, chunk[0]);
+    TEST_ASSERT_EQUAL(2, length);
+    ring.release();
+    chunk = ring.readableChunk(&length);
+    TEST_ASSERT_EQUAL_UINT8(2, chunk[0]);
+    ring.release();
+    TEST_ASSERT_NULL(ring.readableChunk(&length));
+    TEST_ASSERT_TRUE(ring.drained());
+    TEST_ASSERT_FALSE(ring.aborted());
+}
+
+void test_chunk_pipeline_streams_through_slow_sink() {
+    const size_t totalBytes = 50000;
+    FakeImageSource source;
+    SlowFlashSink sink;
+    PipelineRun run = runPipeline(source, sink, totalBytes);
+
+    TEST_ASSERT_TRUE(run.received);
+    TEST_ASSERT_TRUE(run.written);
+    TEST_ASSERT_FALSE(sink.corrupted);
+    TEST_ASSERT_EQUAL(totalBytes, sink.bytes);
+    // Every write but the last is a whole chunk, whatever the read sizes.
+    TEST_ASSERT_EQUAL_INT((totalBytes + 1023) / 1024, sink.writes);
+    TEST_ASSERT_EQUAL(totalBytes % 1024, sink.lastLength);
+
+    TEST_ASSERT_EQUAL(totalBytes, run.networkStats.bytes);
+    TEST_ASSERT_EQUAL(totalBytes, run.flashStats.bytes);
+    // The sink is the bottleneck, so the reader spent time waiting on it.
+    TEST_ASSERT_GREATER_THAN_UINT32(0, run.networkStats.waitMs);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(run.networkStats.elapsedMs, run.networkStats.waitMs);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(run.flashStats.elapsedMs, run.flashStats.waitMs);
+}
+
+void test_chunk_pipeline_stops_both_stages_on_failure() {
+    FakeImageSource source;
+    SlowFlashSink failingSink(3);
+    PipelineRun run = runPipeline(source, failingSink, 50000);
+    TEST_ASSERT_FALSE(run.received);
+    TEST_ASSERT_FALSE(run.written);
+    TEST_ASSERT_EQUAL_INT(3, failingSink.writes);
+
+    // A broken stream still hands everything it delivered to the sink, so
+    // a resumed download can continue from there.
+    FakeImageSource brokenSource(10000);
+    SlowFlashSink sink;
+    run = runPipeline(brokenSource, sink, 50000);
+    TEST_ASSERT_FALSE(run.received);
+    TEST_ASSERT_TRUE(run.written);
+    TEST_ASSERT_FALSE(sink.corrupted);
+    TEST_ASSERT_GREATER_OR_EQUAL(10000, sink.bytes);
+    TEST_ASSERT_EQUAL(run.networkStats.bytes, sink.bytes);
+
+    // A source that stops sending fails after the idle timeout.
+    class SilentSource : public iotnet::core::ChunkSource {
+      public:
+        int read(uint8_t *, size_t) override { return 0; }
+    } silent;
+    SlowFlashSink idleSink;
+    run = runPipeline(silent, idleSink, 50000, 20);
+    TEST_ASSERT_FALSE(run.received);
+    TEST_ASSERT_TRUE(run.written);
+    TEST_ASSERT_EQUAL(0, idleSink.bytes);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(20, run.networkStats.elapsedMs);
+}
+
+void test_download_checkpoint_validates_resumed_responses() {
+    using iotnet::core::ResumeDecision;
+    iotnet::core::DownloadCheckpoint checkpoint;
+    checkpoint.prepare("https://ota.example/fw.bin");
+    char range[32];
+    TEST_ASSERT_FALSE(checkpoint.formatRange(range, sizeof(range)));
+
+    TEST_ASSERT_TRUE(checkpoint.accept({200, 1000, nullptr, "\"v1\""}) ==
+                     ResumeDecision::Restart);
+    TEST_ASSERT_EQUAL(1000, checkpoint.totalLength());
+    TEST_ASSERT_EQUAL_STRING("\"v1\"", checkpoint.etag());
+    checkpoint.advance(400);
+    TEST_ASSERT_TRUE(checkpoint.formatRange(range, sizeof(range)));
+    TEST_ASSERT_EQUAL_STRING("bytes=400-", range);
+    TEST_ASSERT_FALSE(checkpoint.formatRange(range, 10));
+
+    TEST_ASSERT_TRUE(checkpoint.accept({206, 600, "bytes 400-999/1000", "\"v1\""}) ==
+                     ResumeDecision::Resume);
+    // Transient errors keep the checkpoint.
+    TEST_ASSERT_TRUE(checkpoint.accept({503, -1, nullptr, nullptr}) == ResumeDecision::Reject);
+    TEST_ASSERT_EQUAL(400, checkpoint.offset());
+    TEST_ASSERT_TRUE(checkpoint.accept({-1, -1, nullptr, nullptr}) == ResumeDecision::Reject);
+    TEST_ASSERT_TRUE(checkpoint.inProgress());
+
+    // A new URL with the same ETag still resumes.
+    checkpoint.prepare("https://ota.example/fw.bin?signature=2");
+    TEST_ASSERT_EQUAL(400, checkpoint.offset());
+
+    // Each mismatch drops the checkpoint.
+    const iotnet::core::RangeResponse stale[] = {
+        {206, 600, "bytes 400-999/1000", "\"v2\""},
+        {206, 600, "bytes 400-999/1000", nullptr},
+        {206, 600, "bytes 300-999/1000", "\"v1\""},
+        {206, 600, "bytes 400-999/1200", "\"v1\""},
+        {206, 500, "bytes 400-999/1000", "\"v1\""},
+        {206, 600, "bytes 400-999/*", "\"v1\""},
+        {416, -1, "bytes */1000", nullptr},
+    };
+    for (const iotnet::core::RangeResponse &response : stale) {
+        checkpoint.reset();
+        TEST_ASSERT_TRUE(checkpoint.accept({200, 1000, nullptr, "\"v1\""}) ==
+                         ResumeDecision::Restart);
+        checkpoint.advance(400);
+        TEST_ASSERT_TRUE(checkpoint.accept(response) == ResumeDecision::Reject);
+        TEST_ASSERT_FALSE(checkpoint.inProgress());
+    }
+
+    // A server that ignores Range sends the whole image again.
+    TEST_ASSERT_TRUE(checkpoint.accept({200, 1000, nullptr, "W/\"weak\""}) ==
+                     ResumeDecision::Restart);
+    TEST_ASSERT_EQUAL_STRING("", checkpoint.etag());
+    checkpoint.advance(10);
+    TEST_ASSERT_TRUE(checkpoint.accept({200, 1000, nullptr, nullptr}) ==
+                     ResumeDecision::Restart);
+    TEST_ASSERT_EQUAL(0, checkpoint.offset());
+
+    // Without an ETag only the same URL may continue.
+    checkpoint.advance(10);
+    checkpoint.prepare("https://ota.example/fw.bin?signature=2");
+    TEST_ASSERT_EQUAL(10, checkpoint.offset());
+    checkpoint.prepare("https://ota.example/other.bin");
+    TEST_ASSERT_FALSE(checkpoint.inProgress());
+
+    size_t first = 0;
+    size_t last = 0;
+    size_t total = 0;
+    TEST_ASSERT_TRUE(iotnet::core::parseContentRange("bytes 0-0/1", &first, &last, &total));
+    TEST_ASSERT_FALSE(iotnet::core::parseContentRange("bytes 5-4/10", &first, &last, &total));
+    TEST_ASSERT_FALSE(iotnet::core::parseContentRange("bytes 0-9/9", &first, &last, &total));
+    TEST_ASSERT_FALSE(iotnet::core::parseContentRange("items 0-9/10", &first, &last, &total));
+    TEST_ASSERT_FALSE(iotnet::core::parseContentRange("bytes 0-9/10 ", &first, &last, &total));
+    TEST_ASSERT_FALSE(iotnet::core::parseContentRange(
+        "bytes 0-9/99999999999999999999999", &first, &last, &total));
+}
+
+namespace {
+
+// In-process stand-in for the firmware host: honours Range and If-Range
+// like a CDN and cuts the first `cuts` connections at random points.
+class FlakyImageServer {
+  public:
+    static constexpr size_t IMAGE_BYTES = 100000;
+
+    FlakyImageServer(uint8_t version, int cuts, bool honoursRange = true)
+        : version(version), cutsLeft(cuts), honoursRange(honoursRange), seed(12345),
+          fullResponses(0), rangeResponses(0), body(*this) {}
+
+    uint8_t byteAt(size_t offset) const { return imageByte(offset) ^ version; }
+
+    iotnet::core::RangeResponse get(const char *range, const char *ifRange) {
+        snprintf(tag, sizeof(tag), "\"fw-%u\"", version);
+        snprintf(contentRange, sizeof(contentRange), "bytes */%zu", IMAGE_BYTES);
+
+        size_t start = 0;
+        bool partial = range && honoursRange && (!ifRange || strcmp(ifRange, tag) == 0) &&
+                       sscanf(range, "bytes=%zu-", &start) == 1;
+        if (partial && start >= IMAGE_BYTES) {
+            return {416, -1, contentRange, tag};
+        }
+        if (!partial) {
+            start = 0;
+        }
+        body.open(start, nextCut(IMAGE_BYTES - start));
+
+        if (!partial) {
+            fullResponses++;
+            return {200, static_cast<long>(IMAGE_BYTES), nullptr, tag};
+        }
+        rangeResponses++;
+        snprintf(contentRange, sizeof(contentRange), "bytes %zu-%zu/%zu", start,
+                 IMAGE_BYTES - 1, IMAGE_BYTES);
+        return {206, static_cast<long>(IMAGE_BYTES - start), contentRange, tag};
+    }
+
+    iotnet::core::ChunkSource &stream() { return body; }
+
+    uint8_t version;
+    int cutsLeft;
+    bool honoursRange;
+    uint32_t seed;
+    int fullResponses;
+    int rangeResponses;
+
+  private:
+    class Body : public iotnet::core::ChunkSource {
+      public:
+        explicit Body(FlakyImageServer &server) : server(server), offset(0), cutAt(0) {}
+
+        void open(size_t start, size_t cut) {
+            offset = start;
+            cutAt = start + cut;
+        }
+
+        int read(uint8_t *buffer, size_t size) override {
+            if (offset >= cutAt) {
+                return -1;
+            }
+            size_t length = size < 1460 ? size : 1460;
+            if (length > cutAt - offset) {
+                length = cutAt - offset;
+            }
+            for (size_t i = 0; i < length; i++) {
+                buffer[i] = server.byteAt(offset + i);
+            }
+            offset += length;
+            return static_cast<int>(length);
+        }
+
+      private:
+        FlakyImageServer &server;
+        size_t offset;
+        size_t cutAt;
+    };
+
+    size_t nextCut(size_t remaining) {
+        if (cutsLeft <= 0) {
+            return remaining;
+        }
+        cutsLeft--;
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 8) % remaining;
+    }
+
+    char tag[16];
+    char contentRange[48];
+    Body body;
+};
+
+// The OTA partition: begin() starts over, writes append.
+class FakeOtaPartition : public iotnet::core::ChunkSink {
+  public:
+    FakeOtaPartition() : length(0), begins(0) {}
+
+    void begin() {
+        length = 0;
+        begins++;
+    }
+
+    bool write(const uint8_t *data, size_t size) override {
+        if (length + size > sizeof(image)) {
+            return false;
+        }
+        memcpy(image + length, data, size);
+        length += size;
+        return true;
+    }
+
+    bool holds(const FlakyImageServer &server) const {
+        if (length != FlakyImageServer::IMAGE_BYTES) {
+            return false;
+        }
+        for (size_t i = 0; i < length; i++) {
+            if (image[i] != server.byteAt(i)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint8_t image[FlakyImageServer::IMAGE_BYTES];
+    size_t length;
+    int begins;
+};
+
+// The request loop of FirmwareFlasher::downloadAndFlash against the stand-in.
+bool downloadWithResume(FlakyImageServer &server, FakeOtaPartition &partition,
+                        iotnet::core::DownloadCheckpoint &checkpoint, int maxAttempts) {
+    checkpoint.prepare("http://127.0.0.1/firmware.bin");
+    for (int attempt = 0; attempt < maxAttempts && !checkpoint.complete(); attempt++) {
+        char range[32];
+        bool resuming = checkpoint.formatRange(range, sizeof(range));
+        const char *ifRange =
+            resuming && checkpoint.etag()[0] != '\0' ? checkpoint.etag() : nullptr;
+        iotnet::core::ResumeDecision decision =
+            checkpoint.accept(server.get(resuming ? range : nullptr, ifRange));
+        if (decision == iotnet::core::ResumeDecision::Reject) {
+            continue;
+        }
+        if (decision == iotnet::core::ResumeDecision::Restart) {
+            partition.begin();
+        }
+        PipelineRun run = runPipeline(server.stream(), partition, checkpoint.remaining());
+        TEST_ASSERT_TRUE(run.written);
+        checkpoint.advance(run.flashStats.bytes);
+    }
+    return checkpoint.complete();
+}
+
+}
+
+void test_download_resumes_through_connections_cut_at_random_points() {
+    static FakeOtaPartition partition;
+    iotnet::core::DownloadCheckpoint checkpoint;
+
+    FlakyImageServer server(1, 6);
+    TEST_ASSERT_TRUE(downloadWithResume(server, partition, checkpoint, 10));
+    TEST_ASSERT_TRUE(partition.holds(server));
+    TEST_ASSERT_EQUAL_INT(1, server.fullResponses);
+    TEST_ASSERT_EQUAL_INT(1, partition.begins);
+    TEST_ASSERT_GREATER_OR_EQUAL(6, server.rangeResponses);
+
+    // Every attempt of the first trigger is cut; the second trigger resumes
+    // from what reached flash instead of byte 0.
+    checkpoint.reset();
+    partition.begins = 0;
+    FlakyImageServer flaky(2, 100);
+    TEST_ASSERT_FALSE(downloadWithResume(flaky, partition, checkpoint, 3));
+    size_t kept = checkpoint.offset();
+    TEST_ASSERT_EQUAL(partition.length, kept);
+    flaky.cutsLeft = 0;
+    TEST_ASSERT_TRUE(downloadWithResume(flaky, partition, checkpoint, 1));
+    TEST_ASSERT_TRUE(partition.holds(flaky));
+    TEST_ASSERT_EQUAL_INT(1, partition.begins);
+
+    // A new image behind the same URL fails If-Range and restarts.
+    checkpoint.reset();
+    partition.begins = 0;
+    FlakyImageServer updated(3, 1);
+    TEST_ASSERT_FALSE(downloadWithResume(updated, partition, checkpoint, 1));
+    updated.version = 4;
+    TEST_ASSERT_TRUE(downloadWithResume(updated, partition, checkpoint, 5));
+    TEST_ASSERT_TRUE(partition.holds(updated));
+    TEST_ASSERT_EQUAL_INT(2, partition.begins);
+
+    // Without Range support every attempt restarts from byte 0.
+    checkpoint.reset();
+    partition.begins = 0;
+    FlakyImageServer plain(5, 2, false);
+    TEST_ASSERT_TRUE(downloadWithResume(plain, partition, checkpoint, 5));
+    TEST_ASSERT_TRUE(partition.holds(plain));
+    TEST_ASSERT_EQUAL_INT(3, partition.begins);
+    TEST_ASSERT_EQUAL_INT(0, plain.rangeResponses);
+}
+
+namespace {
+
+// Generated with Python's zlib: the text below at level 9 with extra, name
+// and comment header fields (dynamic Huffman blocks), a short phrase with
+// Z_FIXED, and bytes 0..199 at level 0 (a stored block).
+const uint8_t GZIP_TEXT[] = {
+    0x1f, 0x8b, 0x08, 0x1c, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x04, 0x00, 0x61, 0x62, 0x63, 0x64,
+    0x66, 0x77, 0x2e, 0x62, 0x69, 0x6e, 0x00, 0x63, 0x00, 0x85, 0x97, 0x4d, 0x8e, 0x1d, 0x37, 0x0c,
+    0x06, 0xf7, 0x39, 0xc5, 0x9c, 0xe0, 0x83, 0xf8, 0x27, 0x91, 0x17, 0xc9, 0xde, 0x0b, 0x2f, 0x8c,
+    0x18, 0x89, 0x01, 0xdb, 0x39, 0x7f, 0x60, 0xe4, 0x35, 0xd1, 0x7a, 0x6c, 0xd1, 0xab, 0x59, 0x70,
+    0x66, 0xa1, 0x9a, 0xa6, 0x4a, 0xf5, 0xed, 0xcb, 0xdf, 0x1f, 0x7f, 0x8e, 0x8f, 0x7f, 0x3f, 0x7d,
+    0xfd, 0xf9, 0xf9, 0x63, 0x60, 0x8c, 0x8f, 0xef, 0x3f, 0x3e, 0xfd, 0xf8, 0xf9, 0xfd, 0xd7, 0x8f,
+    0xaf, 0x9f, 0xff, 0xf8, 0xf6, 0x6b, 0x4c, 0xaf, 0xb1, 0x2c, 0x90, 0x5c, 0xf3, 0x7f, 0xfe, 0xfa,
+    0x7f, 0xc8, 0xaf, 0xe1, 0x52, 0xf0, 0x7c, 0x1f, 0xca, 0x6b, 0x48, 0x44, 0x90, 0x78, 0x9f, 0xea,
+    0x35, 0x55, 0x87, 0xf1, 0xfb, 0xd4, 0xae, 0xa9, 0x1b, 0xa6, 0xbd, 0x4f, 0xe7, 0x6b, 0xca, 0xcc,
+    0x58, 0xfe, 0x3e, 0x5d, 0xd7, 0xd4, 0x02, 0x41, 0x0f, 0x47, 0xf2, 0xeb, 0x17, 0x62, 0x62, 0xe8,
+    0xfb, 0x9f, 0xc7, 0x75, 0x60, 0x11, 0xd0, 0x7a, 0x9f, 0xd2, 0x48, 0x1e, 0x03, 0x32, 0xca, 0xf8,
+    0xc2, 0xa5, 0x63, 0x41, 0x0b, 0x2f, 0xba, 0x80, 0xa9, 0x2a, 0xac, 0x10, 0xa3, 0x0b, 0x99, 0x3a,
+    0x61, 0x16, 0x64, 0x74, 0x31, 0x33, 0x72, 0x38, 0x3f, 0xfd, 0xb3, 0x2e, 0x6e, 0x66, 0x86, 0x28,
+    0xdc, 0xe8, 0x02, 0x67, 0xc1, 0x18, 0x05, 0x1c, 0x5d, 0xe4, 0x26, 0x07, 0x98, 0xca, 0xf8, 0xe2,
+    0x36, 0xe7, 0x84, 0x14, 0x6e, 0x74, 0x81, 0x5b, 0x43, 0xa0, 0x05, 0x1c, 0x8f, 0xfc, 0x56, 0x06,
+    0x66, 0x01, 0xc7, 0x17, 0xb8, 0xb5, 0x16, 0x96, 0x3c, 0x9c, 0x8d, 0x2f, 0x76, 0x4e, 0x0a, 0x2f,
+    0xec, 0xf8, 0x62, 0xe7, 0x46, 0x88, 0xc2, 0x8e, 0x2f, 0x76, 0xee, 0x0e, 0x2a, 0xdf, 0x1b, 0x5f,
+    0xe0, 0x82, 0x0d, 0x5c, 0xc0, 0xf1, 0x05, 0x2e, 0x26, 0x43, 0x0a, 0x38, 0xbe, 0xc0, 0x45, 0x04,
+    0xac, 0x80, 0xe3, 0x0b, 0x9c, 0x4c, 0x4c, 0x7d, 0x3a, 0x5a, 0xa2, 0x13, 0xac, 0x42, 0x4e, 0x46,
+    0x2e, 0xd2, 0x40, 0x14, 0x72, 0x42, 0xb9, 0x49, 0x0b, 0xa3, 0x7c, 0x72, 0xc2, 0xb9, 0x4a, 0x0a,
+    0xaa, 0x4b, 0x2a, 0xb9, 0x4b, 0x04, 0x2e, 0xd8, 0x44, 0x73, 0x99, 0x1c, 0x5a, 0xb0, 0x89, 0xe5,
+    0x2a, 0x19, 0xcc, 0x1e, 0x8e, 0x26, 0x33, 0xd7, 0x89, 0x31, 0x0b, 0x39, 0x59, 0x89, 0x26, 0xe0,
+    0x85, 0x9c, 0x78, 0xae, 0xd3, 0x44, 0x94, 0x4f, 0x4e, 0x22, 0xd7, 0x49, 0x30, 0x0a, 0x38, 0x1d,
+    0xb9, 0x4e, 0x03, 0x5c, 0xc0, 0x29, 0xe5, 0x3a, 0x2d, 0x48, 0x01, 0xa7, 0x9c, 0xbb, 0xa4, 0xd0,
+    0xf9, 0x70, 0x36, 0x95, 0x5c, 0x27, 0x82, 0xd5, 0x1b, 0x4e, 0x73, 0x9d, 0x1c, 0xab, 0xb0, 0x53,
+    0xcb, 0x75, 0x32, 0x78, 0xf9, 0xe4, 0x74, 0xe6, 0x3a, 0x31, 0xa2, 0x80, 0xd3, 0x95, 0x9f, 0x4c,
+    0x80, 0x0a, 0x38, 0xf5, 0x5c, 0xa7, 0x09, 0x2e, 0xe0, 0x34, 0x72, 0x97, 0x04, 0xb2, 0x1e, 0xce,
+    0x36, 0x72, 0x9b, 0x06, 0xac, 0x5e, 0x73, 0xb9, 0x4c, 0x0b, 0xf3, 0x68, 0x85, 0x60, 0xc5, 0x3a,
+    0x6a, 0x21, 0x26, 0xc1, 0x8f, 0x5a, 0x88, 0x70, 0x8c, 0xa3, 0x16, 0xc4, 0x40, 0x47, 0x2b, 0x2c,
+    0x06, 0xfb, 0xc3, 0x91, 0x2e, 0x62, 0x34, 0x02, 0x5a, 0x88, 0x79, 0x6e, 0xd1, 0x84, 0x1d, 0xa5,
+    0x40, 0x2e, 0x98, 0x67, 0x29, 0x30, 0x0f, 0xf8, 0x59, 0x0a, 0x6c, 0x0b, 0x71, 0x96, 0x02, 0x87,
+    0x62, 0x9c, 0xa5, 0x20, 0x42, 0xa0, 0x78, 0xba, 0xf5, 0x35, 0x97, 0xc8, 0x21, 0x05, 0x5a, 0x4a,
+    0x41, 0x87, 0x41, 0xcf, 0x52, 0x50, 0x65, 0xd8, 0x59, 0x0a, 0xba, 0x02, 0xeb, 0x2c, 0x05, 0xa3,
+    0x09, 0x3f, 0x4b, 0xc1, 0x4c, 0x10, 0x67, 0x29, 0x58, 0x0c, 0xd0, 0xd3, 0xf3, 0x23, 0xbd, 0x30,
+    0x79, 0x81, 0xeb, 0xa7, 0xc6, 0xb9, 0x44, 0x0a, 0x39, 0x4b, 0x61, 0x0d, 0x82, 0x9e, 0xa5, 0xb0,
+    0xc4, 0x31, 0xcf, 0x52, 0x58, 0xcb, 0xb0, 0xce, 0x52, 0x70, 0x62, 0xf8, 0x59, 0x0a, 0xae, 0x81,
+    0xf1, 0xf4, 0x0e, 0x49, 0x2f, 0xb8, 0x4f, 0x50, 0x61, 0x97, 0x56, 0x08, 0x16, 0xf0, 0x59, 0x0b,
+    0x31, 0x07, 0xf4, 0xac, 0x85, 0x88, 0x05, 0x3b, 0x6b, 0x41, 0x14, 0xf3, 0x6c, 0x85, 0x45, 0x58,
+    0x67, 0x29, 0xd0, 0x70, 0xc4, 0xd3, 0x3b, 0x24, 0xbd, 0x40, 0x6a, 0x18, 0x85, 0x5c, 0x4a, 0x81,
+    0x9c, 0x41, 0x67, 0x29, 0x30, 0x05, 0xe4, 0x2c, 0x05, 0xb6, 0x09, 0x3d, 0x4b, 0x81, 0x43, 0x60,
+    0x67, 0x29, 0x88, 0x0c, 0xac, 0xb3, 0x14, 0x64, 0x2e, 0xf8, 0xd3, 0x3b, 0x24, 0xbd, 0xa0, 0x43,
+    0x11, 0x05, 0x5d, 0x4a, 0x41, 0x95, 0x30, 0xce, 0x52, 0xd0, 0xe5, 0xe0, 0xb3, 0x14, 0x8c, 0x0c,
+    0x72, 0x96, 0x82, 0x19, 0x43, 0xcf, 0x52, 0x30, 0x0f, 0xcc, 0xb3, 0x14, 0x26, 0x4f, 0xac, 0xa7,
+    0x87, 0x48, 0x7a, 0x61, 0x4e, 0x81, 0x17, 0x76, 0xf9, 0x84, 0x1b, 0xf7, 0x58, 0x78, 0x97, 0xc2,
+    0xea, 0x53, 0xa1, 0x6d, 0x05, 0x6f, 0x5b, 0xc1, 0xdb, 0x56, 0xf0, 0xad, 0x15, 0x6e, 0xa7, 0xca,
+    0xc7, 0x5b, 0x9b, 0x0b, 0xb1, 0xe5, 0xc2, 0xbb, 0x16, 0xe2, 0x37, 0xad, 0xd0, 0xa5, 0x42, 0x5f,
+    0x0a, 0xd4, 0x97, 0x02, 0x6d, 0xa5, 0x70, 0xbf, 0xf5, 0xb3, 0xaf, 0xfa, 0x58, 0xe0, 0x2d, 0x16,
+    0x8a, 0x14, 0xb8, 0x2f, 0x05, 0xee, 0x4b, 0x41, 0xfa, 0x52, 0x90, 0xbe, 0x14, 0x74, 0x2b, 0x85,
+    0xfb, 0xcd, 0x98, 0x2f, 0xb7, 0x3e, 0x16, 0x74, 0x8b, 0x85, 0x22, 0x05, 0xeb, 0x4b, 0xc1, 0xfa,
+    0x52, 0xb0, 0xbe, 0x14, 0x66, 0x5f, 0x0a, 0x73, 0x2b, 0x85, 0xfb, 0xd9, 0xb2, 0xb2, 0xfa, 0x58,
+    0x58, 0x5b, 0x2d, 0x14, 0x29, 0xac, 0xbe, 0x15, 0xbc, 0x6f, 0x05, 0xef, 0x5b, 0xc1, 0xfb, 0x56,
+    0x88, 0xad, 0x15, 0xee, 0xf7, 0x7e, 0x3e, 0xdf, 0xfa, 0x5c, 0x88, 0x2d, 0x17, 0x8a, 0x16, 0xfa,
+    0x54, 0xe8, 0x4b, 0x81, 0xfa, 0x52, 0xa0, 0xbe, 0x14, 0x68, 0x2b, 0x85, 0xfb, 0xcd, 0x98, 0x6f,
+    0xb8, 0x3e, 0x16, 0x78, 0x8b, 0x85, 0x22, 0x05, 0xee, 0x4b, 0x41, 0xfa, 0x52, 0x90, 0xbe, 0x14,
+    0xb4, 0x2f, 0x05, 0xdd, 0x4a, 0xe1, 0x7e, 0xb6, 0xac, 0xac, 0x3e, 0x16, 0x6c, 0x8b, 0x85, 0x77,
+    0x29, 0x58, 0x5b, 0x0a, 0xd6, 0x96, 0xc2, 0x6c, 0x4b, 0x61, 0xb6, 0xa5, 0x30, 0xb7, 0x52, 0xb8,
+    0x1d, 0x2b, 0x5f, 0x6f, 0x7d, 0x2d, 0x6c, 0xb9, 0xf0, 0x2e, 0x05, 0x6f, 0x5b, 0xc1, 0xdb, 0x56,
+    0xf0, 0xbe, 0x15, 0xa2, 0x6f, 0x85, 0xd8, 0x5a, 0xe1, 0x7e, 0xef, 0x67, 0x5e, 0xfd, 0x26, 0x17,
+    0xee, 0xb5, 0x50, 0xac, 0xd0, 0x97, 0x02, 0xf5, 0xa5, 0x40, 0x7d, 0x29, 0x50, 0x5f, 0x0a, 0xbc,
+    0x95, 0xc2, 0xfd, 0x64, 0xf9, 0x72, 0xeb, 0x63, 0x81, 0xb7, 0x58, 0x28, 0x52, 0x90, 0xbe, 0x14,
+    0xa4, 0x2f, 0x05, 0xed, 0x4b, 0x41, 0xfb, 0x52, 0xd0, 0xad, 0x14, 0xee, 0xb7, 0x7e, 0xbe, 0xdc,
+    0xfa, 0x58, 0xb0, 0x2d, 0x16, 0x8a, 0x14, 0xac, 0x2f, 0x85, 0xd9, 0x97, 0xc2, 0xec, 0x4b, 0x61,
+    0xf6, 0xa5, 0xb0, 0xb6, 0x54, 0xb8, 0xdf, 0xfa, 0x59, 0x0b, 0x7d, 0x2e, 0xf8, 0x96, 0x0b, 0x45,
+    0x0a, 0xde, 0xb7, 0x82, 0xf7, 0xad, 0x10, 0x7d, 0x2b, 0x44, 0xdf, 0x0a, 0xb1, 0xb5, 0xc2, 0xfd,
+    0x6e, 0xcc, 0x5c, 0x68, 0x6b, 0x61, 0x8b, 0x85, 0x22, 0x05, 0x7a, 0x95, 0xc2, 0x7f, 0x82, 0x7a,
+    0x8c, 0x36, 0x70, 0x17, 0x00, 0x00,
+};
+
+const uint8_t GZIP_FIXED[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xcb, 0x48, 0xcd, 0xc9, 0xc9, 0x57,
+    0xc8, 0x40, 0x22, 0x33, 0xf3, 0x4b, 0xf4, 0xf2, 0x52, 0x4b, 0x20, 0x3c, 0x00, 0x46, 0xa6, 0x5f,
+    0xc5, 0x1f, 0x00, 0x00, 0x00,
+};
+
+const uint8_t GZIP_STORED[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x01, 0xc8, 0x00, 0x37, 0xff, 0x00,
+    0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10,
+    0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20,
+    0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30,
+    0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x3e, 0x3f, 0x40,
+    0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x4b, 0x4c, 0x4d, 0x4e, 0x4f, 0x50,
+    0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x5b, 0x5c, 0x5d, 0x5e, 0x5f, 0x60,
+    0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70,
+    0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x7b, 0x7c, 0x7d, 0x7e, 0x7f, 0x80,
+    0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x8b, 0x8c, 0x8d, 0x8e, 0x8f, 0x90,
+    0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0x9b, 0x9c, 0x9d, 0x9e, 0x9f, 0xa0,
+    0xa1, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xab, 0xac, 0xad, 0xae, 0xaf, 0xb0,
+    0xb1, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xbb, 0xbc, 0xbd, 0xbe, 0xbf, 0xc0,
+    0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0x80, 0x61, 0x08, 0xed, 0xc8, 0x00, 0x00, 0x00,
+};
+
+size_t gzipTextPlain(char *out, size_t size) {
+    size_t length = 0;
+    for (int i = 0; length < size; i++) {
+        char line[48];
+        int written = snprintf(line, sizeof(line), "pin V%d value %d.%02d status %s\n", i % 50,
+                               (i * 37) % 1000, (i * 13) % 100, i % 7 ? "ok" : "stale");
+        size_t take = static_cast<size_t>(written) < size - length ? written : size - length;
+        memcpy(out + length, line, take);
+        length += take;
+    }
+    return length;
+}
+
+class CollectingSink : public iotnet::core::ChunkSink {
+  public:
+    CollectingSink() : length(0), writes(0), failing(false) {}
+
+    bool write(const uint8_t *data, size_t size) override {
+        if (failing || size > sizeof(bytes) - length) {
+            return false;
+        }
+        memcpy(bytes + length, data, size);
+        length += size;
+        writes++;
+        return true;
+    }
+
+    uint8_t bytes[8192];
+    size_t length;
+    int writes;
+    bool failing;
+};
+
+using GzipStatus = iotnet::core::GzipInflater::Status;
+
+}
+
+void test_gzip_inflater_decodes_stored_fixed_and_dynamic_blocks() {
+    static uint8_t window[iotnet::core::GzipInflater::MAX_WINDOW];
+    static char expected[6000];
+    TEST_ASSERT_EQUAL(sizeof(expected), gzipTextPlain(expected, sizeof(expected)));
+
+    CollectingSink sink;
+    iotnet::core::GzipInflater inflater(sink);
+    TEST_ASSERT_TRUE(inflater.attach(window, sizeof(window)));
+    TEST_ASSERT_TRUE(iotnet::core::GzipInflater::hasMagic(GZIP_TEXT, sizeof(GZIP_TEXT)));
+    TEST_ASSERT_TRUE(inflater.feed(GZIP_TEXT, sizeof(GZIP_TEXT)) == GzipStatus::Done);
+    TEST_ASSERT_EQUAL(sizeof(expected), sink.length);
+    TEST_ASSERT_EQUAL_MEMORY(expected, sink.bytes, sizeof(expected));
+    TEST_ASSERT_EQUAL(sizeof(GZIP_TEXT), inflater.inputBytes());
+    TEST_ASSERT_EQUAL(sizeof(expected), inflater.outputBytes());
+
+    // One byte at a time stops and resumes at every point of the stream.
+    sink.length = 0;
+    inflater.reset();
+    for (size_t i = 0; i + 1 < sizeof(GZIP_TEXT); i++) {
+        TEST_ASSERT_TRUE(inflater.feed(GZIP_TEXT + i, 1) == GzipStatus::NeedMore);
+    }
+    TEST_ASSERT_TRUE(inflater.feed(GZIP_TEXT + sizeof(GZIP_TEXT) - 1, 1) == GzipStatus::Done);
+    TEST_ASSERT_EQUAL(sizeof(expected), sink.length);
+    TEST_ASSERT_EQUAL_MEMORY(expected, sink.bytes, sizeof(expected));
+
+    const char phrase[] = "hello hello hello iot.net hello";
+    sink.length = 0;
+    inflater.reset();
+    TEST_ASSERT_TRUE(inflater.feed(GZIP_FIXED, sizeof(GZIP_FIXED)) == GzipStatus::Done);
+    TEST_ASSERT_EQUAL(sizeof(phrase) - 1, sink.length);
+    TEST_ASSERT_EQUAL_MEMORY(phrase, sink.bytes, sizeof(phrase) - 1);
+
+    sink.length = 0;
+    inflater.reset();
+    TEST_ASSERT_TRUE(inflater.feed(GZIP_STORED, 100) == GzipStatus::NeedMore);
+    TEST_ASSERT_TRUE(inflater.feed(GZIP_STORED + 100, sizeof(GZIP_STORED) - 100) ==
+                     GzipStatus::Done);
+    TEST_ASSERT_EQUAL(200, sink.length);
+    for (size_t i = 0; i < sink.length; i++) {
+        TEST_ASSERT_EQUAL_UINT8(i, sink.bytes[i]);
+    }
+}
+
+void test_gzip_inflater_rejects_corrupt_streams() {
+    static uint8_t window[iotnet::core::GzipInflater::MAX_WINDOW];
+    static uint8_t corrupt[sizeof(GZIP_TEXT)];
+    CollectingSink sink;
+    iotnet::core::GzipInflater inflater(sink);
+
+    // No window attached yet, then one that is not a power of two.
+    TEST_ASSERT_TRUE(inflater.feed(GZIP_FIXED, sizeof(GZIP_FIXED)) == GzipStatus::Error);
+    TEST_ASSERT_FALSE(inflater.attach(window, 1000));
+    TEST_ASSERT_TRUE(inflater.feed(GZIP_FIXED, sizeof(GZIP_FIXED)) == GzipStatus::Error);
+    TEST_ASSERT_TRUE(inflater.attach(window, sizeof(window)));
+
+    // A raw ESP32 image starts with 0xE9.
+    const uint8_t rawImage[] = {0xe9, 0x03, 0x02, 0x20};
+    TEST_ASSERT_FALSE(iotnet::core::GzipInflater::hasMagic(rawImage, sizeof(rawImage)));
+    TEST_ASSERT_TRUE(inflater.feed(rawImage, sizeof(rawImage)) == GzipStatus::Error);
+
+    memcpy(corrupt, GZIP_TEXT, sizeof(GZIP_TEXT));
+    corrupt[sizeof(GZIP_TEXT) - 8] ^= 0x01;
+    inflater.reset();
+    TEST_ASSERT_TRUE(inflater.feed(corrupt, sizeof(GZIP_TEXT)) == GzipStatus::Error);
+
+    // A stream cut short waits for more; bytes after the trailer are an error.
+    sink.length = 0;
+    inflater.reset();
+    TEST_ASSERT_TRUE(inflater.feed(GZIP_TEXT, sizeof(GZIP_TEXT) - 1) == GzipStatus::NeedMore);
+    inflater.reset();
+    TEST_ASSERT_TRUE(inflater.feed(GZIP_FIXED, sizeof(GZIP_FIXED)) == GzipStatus::Done);
+    TEST_ASSERT_TRUE(inflater.feed(GZIP_FIXED, 1) == GzipStatus::Error);
+
+    // The text refers back further than 1 KB.
+    sink.length = 0;
+    TEST_ASSERT_TRUE(inflater.attach(window, iotnet::core::GzipInflater::MIN_WINDOW));
+    TEST_ASSERT_TRUE(inflater.feed(GZIP_TEXT, sizeof(GZIP_TEXT)) == GzipStatus::Error);
+    TEST_ASSERT_LESS_OR_EQUAL(iotnet::core::GzipInflater::MIN_WINDOW, sink.length);
+
+    // A failing flash write stops the stream.
+    sink.failing = true;
+    TEST_ASSERT_TRUE(inflater.attach(window, sizeof(window)));
+    TEST_ASSERT_TRUE(inflater.feed(GZIP_STORED, sizeof(GZIP_STORED)) == GzipStatus::Error);
+}
+
+void test_ota_trigger_and_link_carry_delta_patch_fields() {
+    iotnetesp32::ota::OtaTriggerData trigger = {};
+    TEST_ASSERT_TRUE(iotnetesp32::ota::OtaUpdateService::parseTriggerPayload(
+        "{\"ota_id\":\"ota-1\",\"version\":\"2.1.0\",\"base_version\":\"2.0.0\","
+        "\"nonce\":5}",
+        &trigger));
+    TEST_ASSERT_EQUAL_STRING("2.1.0", trigger.version);
+    TEST_ASSERT_EQUAL_STRING("2.0.0", trigger.baseVersion);
+
+    iotnetesp32::ota::OtaSessionState state;
+    TEST_ASSERT_TRUE(iotnetesp32::ota::OtaUpdateService::storePendingSession(state, trigger, 0));
+    TEST_ASSERT_EQUAL_STRING("2.0.0", state.baseVersion());
+
+    // Without one the update is only offered as a full image.
+    TEST_ASSERT_TRUE(iotnetesp32::ota::OtaUpdateService::parseTriggerPayload(
+        "{\"ota_id\":\"ota-1\",\"version\":\"2.1.0\",\"nonce\":5}", &trigger));
+    TEST_ASSERT_EQUAL_STRING("", trigger.baseVersion);
+    TEST_ASSERT_TRUE(iotnetesp32::ota::OtaUpdateService::storePendingSession(state, trigger, 0));
+    TEST_ASSERT_EQUAL_STRING("", state.baseVersion());
+
+    char url[64];
+    const char *link = "{\"data\":{\"ota_url\":\"https://x/fw.bin\","
+                       "\"patch_url\":\"https://x/2.0.0-2.1.0.patch\"}}";
+    TEST_ASSERT_TRUE(iotnet::core::parseOtaLinkPatchUrl(link, url, sizeof(url)));
+    TEST_ASSERT_EQUAL_STRING("https://x/2.0.0-2.1.0.patch", url);
+    TEST_ASSERT_FALSE(iotnet::core::parseOtaLinkPatchUrl(
+        "{\"data\":{\"ota_url\":\"https://x/fw.bin\"}}", url, sizeof(url)));
+    TEST_ASSERT_FALSE(
+        iotnet::core::parseOtaLinkPatchUrl("{\"patch_url\":\"https://x/p\"}", url, sizeof(url)));
+}
+
+namespace {
+
+constexpr size_t DELTA_BASE_LENGTH = 8192;
+constexpr size_t DELTA_TARGET_LENGTH = 8392;
+
+// tools/delta_patch.py create, from deltaBase() to deltaTarget(): code
+// inserted, pointers moved, a block removed and data appended.
+const uint8_t DELTA_PATCH[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xf3, 0xf4, 0x73, 0x31, 0x64, 0x50,
+    0x60, 0x60, 0x58, 0x7b, 0x7c, 0xf2, 0x87, 0x13, 0x40, 0xfa, 0x74, 0x4d, 0xf7, 0xaf, 0x17, 0xcc,
+    0x0c, 0x0c, 0x29, 0x0c, 0x0c, 0x0c, 0x2b, 0xf8, 0x18, 0x46, 0xc1, 0x28, 0x18, 0x05, 0x23, 0x00,
+    0x30, 0x73, 0x09, 0x4a, 0xc8, 0xab, 0xe9, 0x9a, 0x58, 0x3b, 0x79, 0x06, 0x84, 0xc7, 0xa5, 0xe6,
+    0x14, 0x57, 0x35, 0x76, 0xf4, 0x4f, 0x9b, 0xbb, 0x64, 0xf5, 0xa6, 0x9d, 0x07, 0x8e, 0x9f, 0xbb,
+    0x7a, 0xe7, 0xf1, 0xab, 0x8f, 0x3f, 0xfe, 0xb3, 0xf1, 0x8a, 0x48, 0x2b, 0x69, 0x1a, 0x98, 0xdb,
+    0xb9, 0xfa, 0x04, 0x47, 0x25, 0x66, 0xe4, 0x97, 0xd5, 0xb6, 0x74, 0x4f, 0x9a, 0xb9, 0x60, 0xf9,
+    0xba, 0xad, 0x7b, 0x0e, 0x9f, 0xba, 0x78, 0xe3, 0xfe, 0xb3, 0xb7, 0x5f, 0x7e, 0x33, 0x71, 0x0a,
+    0x88, 0xcb, 0xa9, 0xea, 0x18, 0x5b, 0x39, 0x7a, 0xf8, 0x87, 0xc5, 0xa6, 0x64, 0x17, 0x55, 0x36,
+    0xb4, 0xf7, 0x4d, 0x9d, 0xb3, 0x78, 0xd5, 0xc6, 0x1d, 0x12, 0x50, 0xbb, 0x22, 0x3e, 0xfe, 0xff,
+    0x8f, 0xcb, 0x1d, 0x05, 0xc2, 0x10, 0x5a, 0x01, 0x8f, 0x9a, 0x51, 0x30, 0x0a, 0x46, 0xc1, 0x28,
+    0x18, 0x05, 0xa3, 0x60, 0x14, 0x0c, 0x3e, 0xc0, 0x32, 0x6a, 0xc1, 0xa8, 0x05, 0xa3, 0x16, 0x8c,
+    0x5a, 0x30, 0x0a, 0x46, 0xc1, 0x28, 0x18, 0x05, 0xa3, 0x60, 0x14, 0x8c, 0x82, 0x41, 0x0f, 0x0a,
+    0x18, 0xa1, 0x8c, 0x7f, 0xa3, 0x63, 0x6f, 0xf4, 0x06, 0x11, 0x50, 0x7a, 0x85, 0x20, 0x0d, 0x2d,
+    0x61, 0x63, 0x60, 0xd0, 0x61, 0x1c, 0x0d, 0xeb, 0x51, 0x30, 0x0a, 0x46, 0xc1, 0x28, 0x18, 0xd1,
+    0x80, 0x5b, 0x4c, 0x51, 0xc7, 0xdc, 0xc9, 0x37, 0x22, 0x39, 0xaf, 0xb2, 0xa5, 0x7f, 0xd6, 0xd2,
+    0x0d, 0xbb, 0x8f, 0x5d, 0xbc, 0xf3, 0xfc, 0xd3, 0x5f, 0x0e, 0x61, 0x39, 0x4d, 0x13, 0x7b, 0xaf,
+    0xd0, 0x84, 0xec, 0xb2, 0xc6, 0x9e, 0xe9, 0x8b, 0xd6, 0xee, 0x38, 0x7c, 0xee, 0xe6, 0x93, 0xf7,
+    0xbf, 0x58, 0x05, 0xa4, 0xd5, 0x0c, 0x6d, 0xdc, 0x83, 0x62, 0x33, 0x8a, 0xeb, 0x3a, 0xa7, 0xcc,
+    0x5f, 0xb5, 0xf5, 0xc0, 0xe9, 0x6b, 0x0f, 0xdf, 0x7c, 0x67, 0xe2, 0x95, 0x50, 0xd6, 0xb3, 0x74,
+    0xf1, 0x8f, 0x4a, 0x2d, 0xa8, 0x6e, 0x9b, 0x38, 0x67, 0xf9, 0xa6, 0xbd, 0x27, 0x2e, 0xdf, 0x7b,
+    0xf9, 0xe5, 0x3f, 0x97, 0xa8, 0x82, 0xb6, 0x99, 0xa3, 0x4f, 0x78, 0x52, 0x6e, 0x45, 0x73, 0xdf,
+    0xcc, 0x25, 0xeb, 0x77, 0x1d, 0xbd, 0x70, 0xfb, 0xd9, 0xc7, 0x3f, 0xec, 0x42, 0xb2, 0x1a, 0xc6,
+    0x76, 0x9e, 0x21, 0xf1, 0x59, 0xa5, 0x0d, 0xdd, 0xd3, 0x16, 0xae, 0xd9, 0x7e, 0xe8, 0xec, 0x8d,
+    0xc7, 0xef, 0x7e, 0xb2, 0xf0, 0x4b, 0xa9, 0x1a, 0x58, 0xbb, 0x05, 0xc6, 0xa4, 0x17, 0xd5, 0x76,
+    0x4c, 0x9e, 0xb7, 0x72, 0xcb, 0xfe, 0x53, 0x57, 0x1f, 0xbc, 0xfe, 0xc6, 0xc8, 0x23, 0xae, 0xa4,
+    0x6b, 0xe1, 0xec, 0x17, 0x99, 0x92, 0x5f, 0xd5, 0x3a, 0x61, 0xf6, 0xb2, 0x8d, 0x7b, 0x8e, 0x5f,
+    0xba, 0xfb, 0xe2, 0xf3, 0x3f, 0x4e, 0x11, 0x79, 0x2d, 0x53, 0x07, 0xef, 0xb0, 0xc4, 0x9c, 0xf2,
+    0xa6, 0xde, 0x19, 0x8b, 0xd7, 0xed, 0x3c, 0x72, 0xfe, 0xd6, 0xd3, 0x0f, 0xbf, 0xd9, 0x04, 0x65,
+    0xd4, 0x8d, 0x6c, 0x3d, 0x82, 0xe3, 0x32, 0x4b, 0xea, 0xbb, 0xa6, 0x2e, 0x58, 0xbd, 0xed, 0xe0,
+    0x99, 0xeb, 0x8f, 0xde, 0xfe, 0x60, 0xe6, 0x93, 0x54, 0xd1, 0xb7, 0x72, 0x0d, 0x88, 0x4e, 0x2b,
+    0xac, 0x69, 0x9f, 0x34, 0x77, 0xc5, 0xe6, 0x7d, 0x27, 0xaf, 0xdc, 0x7f, 0xf5, 0x95, 0x14, 0xff,
+    0x03, 0x00, 0x71, 0x07, 0x9e, 0x21, 0x24, 0x21, 0x00, 0x00,
+};
+
+void deltaBase(uint8_t *out) {
+    for (size_t i = 0; i < DELTA_BASE_LENGTH; i++) {
+        out[i] = imageByte(i);
+    }
+}
+
+void deltaTarget(uint8_t *out) {
+    static uint8_t base[DELTA_BASE_LENGTH];
+    deltaBase(base);
+    size_t length = 0;
+    memcpy(out, base, 1000);
+    length += 1000;
+    for (size_t i = 0; i < 100; i++) {
+        out[length++] = static_cast<uint8_t>(i * 7 + 3);
+    }
+    memcpy(out + length, base + 1000, 5000);
+    length += 5000;
+    memcpy(out + length, base + 6200, DELTA_BASE_LENGTH - 6200);
+    length += DELTA_BASE_LENGTH - 6200;
+    for (size_t i = 0; i < 300; i++) {
+        out[length++] = static_cast<uint8_t>(i * 11);
+    }
+    for (size_t k = 3100; k < 4100; k += 97) {
+        out[k] = static_cast<uint8_t>(out[k] + 4);
+    }
+}
+
+// An app partition backed by a temporary file, read for the base and
+// written for the target.
+class FilePartition : public iotnet::core::PatchBase, public iotnet::core::ChunkSink {
+  public:
+    explicit FilePartition(size_t capacity) : file(tmpfile()), capacity(capacity), written(0) {}
+    ~FilePartition() override { fclose(file); }
+
+    size_t size() const override { return capacity; }
+
+    bool read(size_t offset, uint8_t *buffer, size_t length) override {
+        return offset + length <= capacity &&
+               fseek(file, static_cast<long>(offset), SEEK_SET) == 0 &&
+               fread(buffer, 1, length, file) == length;
+    }
+
+    bool write(const uint8_t *data, size_t length) override {
+        if (written + length > capacity ||
+            fseek(file, static_cast<long>(written), SEEK_SET) != 0 ||
+            fwrite(data, 1, length, file) != length) {
+            return false;
+        }
+        written += length;
+        return true;
+    }
+
+    bool holds(const uint8_t *expected, size_t length) {
+        static uint8_t contents[16384];
+        return length == written && length <= sizeof(contents) && read(0, contents, length) &&
+               memcmp(contents, expected, length) == 0;
+    }
+
+    FILE *file;
+    size_t capacity;
+    size_t written;
+};
+
+void putLittleEndian32(uint8_t *out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+// Header for a hand-made patch over the first baseLength bytes of base.
+size_t deltaHeader(uint8_t *out, const uint8_t *base, size_t baseLength, const uint8_t *target,
+                   size_t targetLength) {
+    memcpy(out, "IND1", 4);
+    putLittleEndian32(out + 4, static_cast<uint32_t>(baseLength));
+    putLittleEndian32(out + 8, iotnet::core::crc32(base, baseLength));
+    putLittleEndian32(out + 12, static_cast<uint32_t>(targetLength));
+    putLittleEndian32(out + 16, iotnet::core::crc32(target, targetLength));
+    return iotnet::core::DeltaPatcher::HEADER_SIZE;
+}
+
+size_t deltaRecord(uint8_t *out, uint32_t diff, uint32_t extra, int32_t adjustment) {
+    putLittleEndian32(out, diff);
+    putLittleEndian32(out + 4, extra);
+    putLittleEndian32(out + 8, static_cast<uint32_t>(adjustment));
+    return iotnet::core::DeltaPatcher::RECORD_SIZE;
+}
+
+using DeltaStatus = iotnet::core::DeltaPatcher::Status;
+
+}
+
+void test_delta_patch_rebuilds_image_between_file_partitions() {
+    static uint8_t base[DELTA_BASE_LENGTH];
+    static uint8_t expected[DELTA_TARGET_LENGTH];
+    static uint8_t window[iotnet::core::GzipInflater::MAX_WINDOW];
+    deltaBase(base);
+    deltaTarget(expected);
+
+    // The running partition is larger than the image it holds.
+    FilePartition running(DELTA_BASE_LENGTH + 4096);
+    TEST_ASSERT_TRUE(running.write(base, DELTA_BASE_LENGTH));
+    FilePartition inactive(16384);
+
+    // The tool gzips its patches; the device inflates and patches in one pass,
+    // here in uneven pieces like network reads.
+    iotnet::core::DeltaPatcher patcher(running, inactive);
+    iotnet::core::GzipInflater inflater(patcher);
+    TEST_ASSERT_TRUE(inflater.attach(window, sizeof(window)));
+    for (size_t offset = 0, piece = 1; offset < sizeof(DELTA_PATCH); offset += piece, piece += 7) {
+        if (piece > sizeof(DELTA_PATCH) - offset) {
+            piece = sizeof(DELTA_PATCH) - offset;
+        }
+        TEST_ASSERT_TRUE(inflater.feed(DELTA_PATCH + offset, piece) != GzipStatus::Error);
+    }
+    TEST_ASSERT_TRUE(inflater.status() == GzipStatus::Done);
+    TEST_ASSERT_TRUE(patcher.status() == DeltaStatus::Done);
+    TEST_ASSERT_EQUAL(DELTA_TARGET_LENGTH, patcher.targetLength());
+    TEST_ASSERT_EQUAL(DELTA_TARGET_LENGTH, patcher.outputBytes());
+    TEST_ASSERT_TRUE(inactive.holds(expected, DELTA_TARGET_LENGTH));
+    TEST_ASSERT_LESS_THAN(DELTA_TARGET_LENGTH / 10, sizeof(DELTA_PATCH));
+
+    // Another firmware in the running partition: nothing reaches the target.
+    static uint8_t other[DELTA_BASE_LENGTH];
+    memcpy(other, base, sizeof(other));
+    other[5000] ^= 0x01;
+    FilePartition changed(DELTA_BASE_LENGTH);
+    TEST_ASSERT_TRUE(changed.write(other, sizeof(other)));
+    FilePartition untouched(16384);
+    iotnet::core::DeltaPatcher mismatched(changed, untouched);
+    iotnet::core::GzipInflater mismatchedInflater(mismatched);
+    TEST_ASSERT_TRUE(mismatchedInflater.attach(window, sizeof(window)));
+    TEST_ASSERT_TRUE(mismatchedInflater.feed(DELTA_PATCH, sizeof(DELTA_PATCH)) ==
+                     GzipStatus::Error);
+    TEST_ASSERT_TRUE(mismatched.status() == DeltaStatus::BaseMismatch);
+    TEST_ASSERT_EQUAL(0, untouched.written);
+
+    FilePartition shorter(DELTA_BASE_LENGTH - 1);
+    TEST_ASSERT_TRUE(shorter.write(base, DELTA_BASE_LENGTH - 1));
+    iotnet::core::DeltaPatcher truncatedBase(shorter, untouched);
+    iotnet::core::GzipInflater shorterInflater(truncatedBase);
+    TEST_ASSERT_TRUE(shorterInflater.attach(window, sizeof(window)));
+    TEST_ASSERT_TRUE(shorterInflater.feed(DELTA_PATCH, sizeof(DELTA_PATCH)) == GzipStatus::Error);
+    TEST_ASSERT_TRUE(truncatedBase.status() == DeltaStatus::BaseMismatch);
+}
+
+void test_delta_patcher_rejects_malformed_records() {
+    static uint8_t base[DELTA_BASE_LENGTH];
+    deltaBase(base);
+    FilePartition running(DELTA_BASE_LENGTH);
+    TEST_ASSERT_TRUE(running.write(base, DELTA_BASE_LENGTH));
+    CollectingSink sink;
+    iotnet::core::DeltaPatcher patcher(running, sink);
+
+    // Base bytes 100..149 with byte 120 raised by one, then "new".
+    uint8_t target[53];
+    memcpy(target, base + 100, 50);
+    target[20]++;
+    memcpy(target + 50, "new", 3);
+    uint8_t patch[128];
+    size_t length = deltaHeader(patch, base, 4096, target, sizeof(target));
+    length += deltaRecord(patch + length, 0, 0, 100);
+    length += deltaRecord(patch + length, 50, 3, 0);
+    memset(patch + length, 0, 50);
+    patch[length + 20] = 1;
+    memcpy(patch + length + 50, "new", 3);
+    length += 53;
+
+    TEST_ASSERT_TRUE(iotnet::core::DeltaPatcher::hasMagic(patch, length));
+    for (size_t i = 0; i < length; i++) {
+        TEST_ASSERT_TRUE(patcher.write(patch + i, 1));
+    }
+    TEST_ASSERT_TRUE(patcher.status() == DeltaStatus::Done);
+    TEST_ASSERT_EQUAL(sizeof(target), sink.length);
+    TEST_ASSERT_EQUAL_MEMORY(target, sink.bytes, sizeof(target));
+    TEST_ASSERT_EQUAL(length, patcher.patchBytes());
+    TEST_ASSERT_FALSE(patcher.write(patch, 1));
+    TEST_ASSERT_TRUE(patcher.status() == DeltaStatus::Error);
+
+    // A wrong target CRC only shows at the end.
+    uint8_t broken[128];
+    memcpy(broken, patch, length);
+    broken[16] ^= 0x01;
+    patcher.reset();
+    TEST_ASSERT_FALSE(patcher.write(broken, length));
+    TEST_ASSERT_TRUE(patcher.status() == DeltaStatus::Error);
+
+    // Diff bytes past the end of the base, and an adjustment before its start.
+    size_t header = deltaHeader(broken, base, 4096, target, sizeof(target));
+    deltaRecord(broken + header, 0, 0, 4090);
+    deltaRecord(broken + header + 12, 50, 3, 0);
+    patcher.reset();
+    TEST_ASSERT_FALSE(patcher.write(broken, header + 24));
+    TEST_ASSERT_TRUE(patcher.status() == DeltaStatus::Error);
+
+    deltaRecord(broken + header, 0, 3, -1);
+    patcher.reset();
+    TEST_ASSERT_FALSE(patcher.write(broken, header + 12 + 3));
+    TEST_ASSERT_TRUE(patcher.status() == DeltaStatus::Error);
+
+    // More bytes than the header's target length.
+    deltaRecord(broken + header, 50, 4, 0);
+    patcher.reset();
+    TEST_ASSERT_FALSE(patcher.write(broken, header + 12));
+    TEST_ASSERT_TRUE(patcher.status() == DeltaStatus::Error);
+
+    // A gzip stream or a plain image is not a patch.
+    patcher.reset();
+    TEST_ASSERT_FALSE(iotnet::core::DeltaPatcher::hasMagic(GZIP_FIXED, sizeof(GZIP_FIXED)));
+    TEST_ASSERT_FALSE(patcher.write(GZIP_FIXED, sizeof(GZIP_FIXED)));
+    TEST_ASSERT_TRUE(patcher.status() == DeltaStatus::Error);
+
+    // A base longer than the running partition.
+    header = deltaHeader(broken, base, DELTA_BASE_LENGTH, target, sizeof(target));
+    putLittleEndian32(broken + 4, DELTA_BASE_LENGTH + 1);
+    sink.length = 0;
+    patcher.reset();
+    TEST_ASSERT_FALSE(patcher.write(broken, header));
+    TEST_ASSERT_TRUE(patcher.status() == DeltaStatus::BaseMismatch);
+    TEST_ASSERT_EQUAL(0, sink.length);
+}
+
+namespace {
+
+void expectSha256(const char *expectedHex, iotnet::core::Sha256 &hash) {
+    uint8_t expected[iotnet::core::Sha256::DIGEST_SIZE];
+    uint8_t actual[iotnet::core::Sha256::DIGEST_SIZE];
+    TEST_ASSERT_TRUE(iotnet::core::parseSha256Hex(expectedHex, expected));
+    hash.finish(actual);
+    hash.reset();
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, actual, sizeof(actual));
+}
+
+}
+
+void test_sha256_matches_reference_digests_fed_in_pieces() {
+    iotnet::core::Sha256 hash;
+    expectSha256("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", hash);
+
+    hash.update("abc", 3);
+    expectSha256("BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD", hash);
+
+    // 56 bytes: the length no longer fits the first block's padding.
+    const char *twoBlocks = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    hash.update(twoBlocks, strlen(twoBlocks));
+    expectSha256("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1", hash);
+
+    // A million 'a' in pieces that never line up with the 64-byte blocks.
+    static uint8_t piece[997];
+    memset(piece, 'a', sizeof(piece));
+    size_t fed = 0;
+    for (size_t size = 1; fed < 1000000; size = (size + 61) % sizeof(piece) + 1) {
+        size_t take = size < 1000000 - fed ? size : 1000000 - fed;
+        hash.update(piece, take);
+        fed += take;
+    }
+    TEST_ASSERT_EQUAL_UINT32(1000000, hash.length());
+    expectSha256("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0", hash);
+
+    uint8_t digest[iotnet::core::Sha256::DIGEST_SIZE];
+    TEST_ASSERT_FALSE(iotnet::core::parseSha256Hex(
+        "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b85", digest));
+    TEST_ASSERT_FALSE(iotnet::core::parseSha256Hex(
+        "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b85g", digest));
+    TEST_ASSERT_FALSE(iotnet::core::parseSha256Hex(nullptr, digest));
+}
+
+void test_ota_link_response_carries_image_sha256() {
+    iotnetesp32::ota::OtaLinkData link;
+    TEST_ASSERT_TRUE(iotnetesp32::ota::OtaUpdateService::parseLinkResponse(
+        "{\"data\":{\"ota_url\":\"https://x/fw.bin\",\"patch_url\":\"https://x/fw.patch\","
+        "\"sha256\":\"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad\"}}",
+        &link));
+    TEST_ASSERT_EQUAL_STRING("https://x/fw.bin", link.otaUrl);
+    TEST_ASSERT_EQUAL_STRING("https://x/fw.patch", link.patchUrl);
+    TEST_ASSERT_TRUE(link.hasSha256);
+    TEST_ASSERT_EQUAL_HEX8(0xba, link.sha256[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xad, link.sha256[31]);
+
+    // Older backends send no digest: the image is flashed unverified.
+    TEST_ASSERT_TRUE(iotnetesp32::ota::OtaUpdateService::parseLinkResponse(
+        "{\"data\":{\"ota_url\":\"https://x/fw.bin\"}}", &link));
+    TEST_ASSERT_FALSE(link.hasSha256);
+    TEST_ASSERT_EQUAL_STRING("", link.patchUrl);
+
+    // A digest that cannot be read must not be mistaken for a missing one.
+    TEST_ASSERT_FALSE(iotnetesp32::ota::OtaUpdateService::parseLinkResponse(
+        "{\"data\":{\"ota_url\":\"https://x/fw.bin\",\"sha256\":\"ba7816bf\"}}", &link));
+    const char *const malformed[] = {
+        "\"\"",
+        "42",
+        "null",
+        "\"zz7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad\"",
+        "\"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad0000\"",
+    };
+    for (const char *value : malformed) {
+        char payload[200];
+        snprintf(payload, sizeof(payload),
+                 "{\"data\":{\"ota_url\":\"https://x/fw.bin\",\"sha256\":%s}}", value);
+        TEST_ASSERT_FALSE_MESSAGE(
+            iotnetesp32::ota::OtaUpdateService::parseLinkResponse(payload, &link), value);
+    }
+    TEST_ASSERT_FALSE(iotnetesp32::ota::OtaUpdateService::parseLinkResponse(
+        "{\"data\":{\"sha256\":"
+        "\"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad\"}}",
+        &link));
+}
+
 int main() {
     UNITY_BEGIN();
     RUN_TEST(test_client_config_struct_initialization);
@@ -314,5 +3198,66 @@ int main() {
     RUN_TEST(test_json_codec_null_payload);
     RUN_TEST(test_json_codec_oversized_payload);
     RUN_TEST(test_ota_session_reconnect_flow);
+    RUN_TEST(test_topic_router_routes_pins_and_ota_channels);
+    RUN_TEST(test_topic_router_rejects_foreign_and_malformed_topics);
+    RUN_TEST(test_topic_router_builds_pin_topics_from_prefix);
+    RUN_TEST(test_topic_router_builds_wildcard_filter);
+    RUN_TEST(test_topic_prefix_appends_channels_and_pins);
+    RUN_TEST(test_pin_table_store_and_update_flags);
+    RUN_TEST(test_pin_table_footprint);
+    RUN_TEST(test_pin_callback_index_dispatches_dirty_watched_pins);
+    RUN_TEST(test_pin_callback_index_capacity);
+    RUN_TEST(test_value_codec_parse_integers_with_range_checks);
+    RUN_TEST(test_value_codec_parse_floats_and_bools);
+    RUN_TEST(test_value_codec_format_integers);
+    RUN_TEST(test_value_codec_format_fixed_matches_printf);
+    RUN_TEST(test_publish_gate_numeric_policy);
+    RUN_TEST(test_publish_gate_text_policy_and_slots);
+    RUN_TEST(test_publish_gate_claims_writes_before_they_are_queued);
+    RUN_TEST(test_batch_frame_builds_compact_object);
+    RUN_TEST(test_batch_frame_rejects_entries_that_do_not_fit);
+    RUN_TEST(test_publish_queue_overflow_policies);
+    RUN_TEST(test_publish_queue_drop_oldest_releases_evicted_claims);
+    RUN_TEST(test_publish_queue_concurrent_producers);
+    RUN_TEST(test_network_mailbox_pin_set_and_inbound_values);
+    RUN_TEST(test_connection_state_machine_walks_every_state);
+    RUN_TEST(test_connection_state_machine_backs_off_with_jitter);
+    RUN_TEST(test_connection_state_machine_seeds_spread_reconnects);
+    RUN_TEST(test_connection_state_machine_times_out_pending_steps);
+    RUN_TEST(test_crc32_matches_reference_and_chains);
+    RUN_TEST(test_tls_session_record_validates_endpoint_and_contents);
+    RUN_TEST(test_tls_handshake_stats_split_full_and_resumed);
+    RUN_TEST(test_resume_snapshot_round_trips_client_state);
+    RUN_TEST(test_resume_snapshot_rejects_foreign_or_damaged_state);
+    RUN_TEST(test_mqtt_codec_connack_reads_session_present);
+    RUN_TEST(test_mqtt_codec_encodes_connect_with_will);
+    RUN_TEST(test_mqtt_codec_encodes_control_packets);
+    RUN_TEST(test_mqtt_codec_publish_round_trip_is_zero_copy);
+    RUN_TEST(test_mqtt_reader_assembles_packets_fed_byte_by_byte);
+    RUN_TEST(test_mqtt_suback_watch_reports_refused_wildcard);
+    RUN_TEST(test_mqtt_reader_truncates_oversized_publish);
+    RUN_TEST(test_mqtt_reader_rejects_malformed_streams);
+    RUN_TEST(test_mqtt5_codec_connect_and_connack_properties);
+    RUN_TEST(test_mqtt5_codec_publish_with_topic_alias);
+    RUN_TEST(test_topic_alias_table_assigns_up_to_broker_maximum);
+    RUN_TEST(test_topic_alias_bytes_on_wire_per_publish);
+    RUN_TEST(test_json_scanner_matches_arduinojson_trigger);
+    RUN_TEST(test_json_scanner_matches_arduinojson_session);
+    RUN_TEST(test_json_scanner_matches_arduinojson_link);
+    RUN_TEST(test_json_scanner_decodes_escapes);
+    RUN_TEST(test_allocation_guard_counts_hot_path_allocations);
+    RUN_TEST(test_allocation_guard_steady_state_is_allocation_free);
+    RUN_TEST(test_chunk_ring_hands_chunks_over_in_order);
+    RUN_TEST(test_chunk_pipeline_streams_through_slow_sink);
+    RUN_TEST(test_chunk_pipeline_stops_both_stages_on_failure);
+    RUN_TEST(test_download_checkpoint_validates_resumed_responses);
+    RUN_TEST(test_download_resumes_through_connections_cut_at_random_points);
+    RUN_TEST(test_gzip_inflater_decodes_stored_fixed_and_dynamic_blocks);
+    RUN_TEST(test_gzip_inflater_rejects_corrupt_streams);
+    RUN_TEST(test_ota_trigger_and_link_carry_delta_patch_fields);
+    RUN_TEST(test_delta_patch_rebuilds_image_between_file_partitions);
+    RUN_TEST(test_delta_patcher_rejects_malformed_records);
+    RUN_TEST(test_sha256_matches_reference_digests_fed_in_pieces);
+    RUN_TEST(test_ota_link_response_carries_image_sha256);
     return UNITY_END();
 }
@@ -0,0 +1,196 @@
+#!/usr/bin/env python3
+"""Create and apply delta patches for IotNetESP32 OTA updates.
+
+    delta_patch.py create old.bin new.bin update.patch
+    delta_patch.py apply old.bin update.patch rebuilt.bin
+
+old.bin must be exactly the image the devices are running (the .bin that was
+flashed, not the .elf). The format is described in src/core/DeltaPatcher.h.
+Patches are gzip-compressed unless --raw is given; the device inflates them
+while applying. Publish the patch as patch_url next to the full image's
+ota_url in the link response, and name old.bin's version as base_version in
+the OTA trigger. Devices running another version take the full image.
+"""
+
+import argparse
+import gzip
+import struct
+import sys
+import zlib
+
+MAGIC = b"IND1"
+HEADER = struct.Struct("<4sIIII")
+RECORD = struct.Struct("<IIi")
+
+# The base is indexed every BLOCK bytes and the target looked up at every
+# offset, so any common run of 2 * BLOCK - 1 bytes is found.
+BLOCK = 16
+MIN_MATCH = 24
+MAX_CANDIDATES = 16
+# How far the mismatches in a diff run may outweigh its matches before the
+# run ends; relocated code keeps matching most bytes around changed pointers.
+MAX_DRIFT = 32
+COMPARE_STEP = 64
+
+
+def index_base(base):
+    index = {}
+    for offset in range(0, len(base) - BLOCK + 1, BLOCK):
+        candidates = index.setdefault(base[offset:offset + BLOCK], [])
+        if len(candidates) < MAX_CANDIDATES:
+            candidates.append(offset)
+    return index
+
+
+def match_forward(base, old, target, new, limit):
+    length = 0
+    while length < limit:
+        step = min(COMPARE_STEP, limit - length)
+        if base[old + length:old + length + step] == target[new + length:new + length + step]:
+            length += step
+            continue
+        while length < limit and base[old + length] == target[new + length]:
+            length += 1
+        break
+    return length
+
+
+def match_backward(base, old, target, new, limit):
+    length = 0
+    while length < limit and base[old - length - 1] == target[new - length - 1]:
+        length += 1
+    return length
+
+
+def diff_length(base, old, target, new):
+    """Length of the run at this alignment that is cheaper as diff bytes."""
+    limit = min(len(base) - old, len(target) - new)
+    best_length = score = best_score = position = 0
+    while position < limit:
+        step = min(COMPARE_STEP, limit - position)
+        if base[old + position:old + position + step] == \
+                target[new + position:new + position + step]:
+            position += step
+            score += step
+        else:
+            score += 1 if base[old + position] == target[new + position] else -1
+            position += 1
+        if score > best_score:
+            best_score, best_length = score, position
+        elif score < best_score - MAX_DRIFT:
+            break
+    return best_length
+
+
+def find_match(index, base, target, scan):
+    """Earliest exact match of at least MIN_MATCH bytes at or after scan."""
+    for new in range(scan, len(target) - BLOCK + 1):
+        candidates = index.get(target[new:new + BLOCK])
+        if not candidates:
+            continue
+        best = None
+        for old in candidates:
+            back = match_backward(base, old, target, new, min(old, new - scan))
+            length = back + match_forward(base, old, target, new, min(len(base) - old,
+                                                                      len(target) - new))
+            if length >= MIN_MATCH and (best is None or length > best[2]):
+                best = (new - back, old - back, length)
+        if best:
+            return best[0], best[1]
+    return None
+
+
+def create(base, target):
+    index = index_base(base)
+    out = bytearray(HEADER.pack(MAGIC, len(base), zlib.crc32(base), len(target),
+                                zlib.crc32(target)))
+    new = old = 0
+    while new < len(target):
+        length = diff_length(base, old, target, new)
+        match = find_match(index, base, target, new + length)
+        if match:
+            extra_end, next_old = match
+        else:
+            extra_end, next_old = len(target), old + length
+        out += RECORD.pack(length, extra_end - new - length, next_old - old - length)
+        out += bytes((t - b) & 0xFF for t, b in zip(target[new:new + length],
+                                                    base[old:old + length]))
+        out += target[new + length:extra_end]
+        new, old = extra_end, next_old
+    return bytes(out)
+
+
+def apply(base, patch):
+    if patch[:2] == b"\x1f\x8b":
+        patch = gzip.decompress(patch)
+    magic, base_length, base_crc, target_length, target_crc = HEADER.unpack_from(patch)
+    if magic != MAGIC:
+        raise ValueError("not a delta patch")
+    if len(base) < base_length or zlib.crc32(base[:base_length]) != base_crc:
+        raise ValueError("patch was made against another base image")
+
+    target = bytearray()
+    cursor = HEADER.size
+    old = 0
+    while len(target) < target_length:
+        diff, extra, adjustment = RECORD.unpack_from(patch, cursor)
+        cursor += RECORD.size
+        target += bytes((d + b) & 0xFF for d, b in zip(patch[cursor:cursor + diff],
+                                                       base[old:old + diff]))
+        cursor += diff
+        old += diff
+        target += patch[cursor:cursor + extra]
+        cursor += extra
+        old += adjustment
+    if len(target) != target_length or zlib.crc32(target) != target_crc:
+        raise ValueError("rebuilt image does not match the patch's CRC-32")
+    if cursor != len(patch):
+        raise ValueError("trailing bytes after the last record")
+    return bytes(target)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command", required=True)
+    make = commands.add_parser("create", help="make a patch from old.bin to new.bin")
+    make.add_argument("old")
+    make.add_argument("new")
+    make.add_argument("patch")
+    make.add_argument("--raw", action="store_true", help="do not gzip the patch")
+    check = commands.add_parser("apply", help="rebuild new.bin from old.bin and a patch")
+    check.add_argument("old")
+    check.add_argument("patch")
+    check.add_argument("out")
+    args = parser.parse_args()
+
+    if args.command == "create":
+        with open(args.old, "rb") as file:
+            base = file.read()
+        with open(args.new, "rb") as file:
+            target = file.read()
+        patch = create(base, target)
+        if apply(base, patch) != target:
+            sys.exit("internal error: patch does not rebuild the new image")
+        if not args.raw:
+            patch = gzip.compress(patch, 9, mtime=0)
+        with open(args.patch, "wb") as file:
+            file.write(patch)
+        print("%s: %d bytes for a %d byte image (%.1f%%)"
+              % (args.patch, len(patch), len(target), 100.0 * len(patch) / max(len(target), 1)))
+    else:
+        with open(args.old, "rb") as file:
+            base = file.read()
+        with open(args.patch, "rb") as file:
+            patch = file.read()
+        try:
+            target = apply(base, patch)
+        except ValueError as error:
+            sys.exit("%s: %s" % (args.patch, error))
+        with open(args.out, "wb") as file:
+            file.write(target)
+        print("%s: %d bytes" % (args.out, len(target)))
+
+
+if __name__ == "__main__":
+    main()